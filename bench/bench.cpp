@@ -0,0 +1,1007 @@
+/// @file
+/// @brief  xtw benchmark suite
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+///
+/// usage: xtw_bench [--filter <substring>] [--quick] [--output <tsv>] [--baseline <tsv> [--skip-without-baseline]] [--threshold <relative>]
+///   Prints results as TSV (see xtw/benchmark.h). With --baseline, also prints a comparison
+///   and exits with 1 if a benchmark got slower or a baseline entry was not run.
+///   --skip-without-baseline exits with 77 (skipped, for ctest) before running anything if the baseline file does not exist.
+///   The shm_ring benchmarks run a copy of xtw_bench with --shm-ring-producer <ring name> as the other process.
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <filesystem>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <xtw/benchmark.h>
+#include <xtw/com.h>
+#include <xtw/debug.h>
+#include <xtw/deferred_handle_closer.h>
+#include <xtw/handle_pool.h>
+#include <xtw/io_context.h>
+#include <xtw/ipc.h>
+#include <xtw/mapped_file.h>
+#include <xtw/parallel.h>
+#include <xtw/profiler.h>
+#include <xtw/registry.h>
+#include <xtw/registry_walk.h>
+#include <xtw/slot_map.h>
+#include <xtw/stack_trace.h>
+#include <xtw/task_graph.h>
+#include <xtw/thread_arena.h>
+#include <xtw/thread_registry.h>
+#include <xtw/threading.h>
+#include <xtw/ui_dispatcher.h>
+#include <xtw/unique_handle.h>
+#include <xtw/utf.h>
+
+#include "./utf_scalar.h"
+
+namespace
+{
+    using namespace xtw;
+
+    struct __declspec(uuid("6f1c2a3e-5b0d-4e57-9a1c-3d2b8e7f0a11")) IBenchValue : IUnknown
+    {
+        virtual int STDMETHODCALLTYPE Value() = 0;
+    };
+
+    struct __declspec(uuid("0c9d8e7f-1a2b-4c3d-8e5f-6a7b8c9d0e12")) IBenchOther : IUnknown
+    {
+        virtual int STDMETHODCALLTYPE Other() = 0;
+    };
+
+    // in-process object implementing two interfaces, with the usual interlocked reference count.
+    class mock_object final : public IBenchValue, public IBenchOther
+    {
+        std::atomic<ULONG> reference_count_{1};
+
+    public:
+        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppv) override
+        {
+            if (!ppv) return E_POINTER;
+            if (riid == __uuidof(IUnknown) || riid == __uuidof(IBenchValue)) *ppv = static_cast<IBenchValue*>(this);
+            else if (riid == __uuidof(IBenchOther)) *ppv = static_cast<IBenchOther*>(this);
+            else return *ppv = nullptr, E_NOINTERFACE;
+            AddRef();
+            return S_OK;
+        }
+
+        ULONG STDMETHODCALLTYPE AddRef() override { return ++reference_count_; }
+
+        ULONG STDMETHODCALLTYPE Release() override
+        {
+            const ULONG count = --reference_count_;
+            if (count == 0) delete this;
+            return count;
+        }
+
+        int STDMETHODCALLTYPE Value() override { return 1; }
+        int STDMETHODCALLTYPE Other() override { return 2; }
+    };
+
+    // a partner thread answering each ping with a pong.
+    class ping_pong final
+    {
+        threading::auto_reset_event ping_{};
+        threading::auto_reset_event pong_{};
+        std::atomic_bool stop_{};
+        threading::thread partner_{};
+
+    public:
+        ping_pong()
+        {
+            partner_ = threading::thread([this]
+            {
+                while (ping_.wait_signal(), !stop_.load())
+                    pong_.notify_signal();
+            }, 65536, THREAD_PRIORITY_NORMAL, L"xtw_bench ping_pong");
+        }
+
+        ping_pong(const ping_pong& other) = delete;
+        ping_pong(ping_pong&& other) noexcept = delete;
+        ping_pong& operator=(const ping_pong& other) = delete;
+        ping_pong& operator=(ping_pong&& other) noexcept = delete;
+
+        ~ping_pong()
+        {
+            stop_.store(true);
+            ping_.notify_signal();
+            partner_.join();
+        }
+
+        void round_trip()
+        {
+            ping_.notify_signal();
+            pong_.wait_signal();
+        }
+    };
+
+    // a thread running the tasks posted to its self-woken ui_dispatcher.
+    class dispatcher_thread final
+    {
+        window::ui_dispatcher dispatcher_{};
+        threading::auto_reset_event done_{};
+        std::atomic_bool stop_{};
+        threading::thread thread_{};
+
+    public:
+        dispatcher_thread()
+        {
+            thread_ = threading::thread([this]
+            {
+                while (!stop_.load())
+                    if (dispatcher_.wait()) dispatcher_.drain();
+            }, 65536, THREAD_PRIORITY_NORMAL, L"xtw_bench dispatcher_thread");
+        }
+
+        dispatcher_thread(const dispatcher_thread& other) = delete;
+        dispatcher_thread(dispatcher_thread&& other) noexcept = delete;
+        dispatcher_thread& operator=(const dispatcher_thread& other) = delete;
+        dispatcher_thread& operator=(dispatcher_thread&& other) noexcept = delete;
+
+        ~dispatcher_thread()
+        {
+            dispatcher_.post([this] { stop_.store(true); });
+            thread_.join();
+        }
+
+        void round_trip()
+        {
+            dispatcher_.post([this] { done_.notify_signal(); });
+            done_.wait_signal();
+        }
+    };
+
+    // HKEY_CURRENT_USER\Software\xtw-bench\<process id>, deleted on destruction. With the portable backend,
+    // the registry is first pointed at a new temporary directory.
+    class scratch_registry final
+    {
+#if !defined(_WIN32)
+        std::string root_{};
+#endif
+        std::wstring path_{};
+        registry::registry_key_unique_handle key_{};
+
+    public:
+        scratch_registry()
+        {
+#if !defined(_WIN32)
+            char root[] = "/tmp/xtw-bench-registry-XXXXXX";
+            if (!::mkdtemp(root)) throw std::runtime_error("mkdtemp failed");
+            root_ = root;
+            ::setenv("XTW_PORTABLE_REGISTRY", root, 1);
+#endif
+            const std::string id = std::to_string(::GetCurrentProcessId());
+            path_ = L"Software\\xtw-bench\\" + std::wstring(id.begin(), id.end());
+            key_ = create(HKEY_CURRENT_USER, path_);
+        }
+
+        scratch_registry(const scratch_registry& other) = delete;
+        scratch_registry& operator=(const scratch_registry& other) = delete;
+
+        ~scratch_registry()
+        {
+            key_.reset();
+            ::RegDeleteTreeW(HKEY_CURRENT_USER, path_.c_str());
+#if !defined(_WIN32)
+            std::error_code ec{};
+            std::filesystem::remove_all(root_, ec);
+#endif
+        }
+
+        [[nodiscard]] HKEY get() const noexcept { return key_.get(); }
+
+        static registry::registry_key_unique_handle create(HKEY parent, const std::wstring& sub_key)
+        {
+            HKEY key{};
+            if (::RegCreateKeyExW(parent, sub_key.c_str(), 0, nullptr, REG_OPTION_NON_VOLATILE, KEY_ALL_ACCESS, nullptr, &key, nullptr) != ERROR_SUCCESS)
+                throw std::runtime_error("cannot create a registry key");
+            return registry::registry_key_unique_handle{key};
+        }
+    };
+
+    // a file of `size` bytes in the temporary directory, deleted on destruction.
+    class scratch_file final
+    {
+        std::wstring path_{};
+
+    public:
+        explicit scratch_file(size_t size)
+        {
+            wchar_t directory[MAX_PATH + 1]{};
+            ::GetTempPathW(MAX_PATH + 1, directory);
+            const std::string name = "xtw-bench-" + std::to_string(::GetCurrentProcessId()) + ".bin";
+            path_ = directory + std::wstring(name.begin(), name.end());
+
+            unique_handle file(::CreateFileW(path_.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+            if (file.get() == INVALID_HANDLE_VALUE)
+            {
+                (void)file.release();
+                throw std::runtime_error("cannot create a scratch file");
+            }
+
+            std::vector<uint64_t> chunk(1 << 14);
+            for (size_t written = 0; written < size; written += chunk.size() * sizeof(uint64_t))
+            {
+                for (size_t i = 0; i < chunk.size(); i++) chunk[i] = (written / sizeof(uint64_t) + i) * 0x9E3779B97F4A7C15ull;
+                DWORD n{};
+                if (!::WriteFile(file.get(), chunk.data(), static_cast<DWORD>(std::min(size - written, chunk.size() * sizeof(uint64_t))), &n, nullptr))
+                    throw std::runtime_error("cannot write a scratch file");
+            }
+        }
+
+        scratch_file(const scratch_file& other) = delete;
+        scratch_file& operator=(const scratch_file& other) = delete;
+        ~scratch_file() { ::DeleteFileW(path_.c_str()); }
+
+        [[nodiscard]] const wchar_t* path() const noexcept { return path_.c_str(); }
+    };
+
+    uint64_t checksum(const std::byte* data, size_t size) noexcept
+    {
+        uint64_t sum = 0;
+        for (size_t i = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+        {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            sum += word;
+        }
+        return sum;
+    }
+
+    // the other end of the shm_ring benchmarks: writes 64-byte records until the consumer closes the ring.
+    int run_ring_producer(const char* name)
+    {
+        const std::string n = name;
+        auto ring = ipc::shm_ring::open(std::wstring(n.begin(), n.end()).c_str());
+        std::byte record[64]{};
+        for (uint64_t i = 0;; i++)
+        {
+            std::memcpy(record, &i, sizeof(i));
+            if (ring.write(record, sizeof(record)) != ipc::shm_ring::status::ok) return 0;
+        }
+    }
+
+    // a ring read by this process and written by a child process running run_ring_producer.
+    class ring_pipeline final
+    {
+        ipc::shm_ring ring_{};
+#if defined(_WIN32)
+        unique_handle process_{};
+#else
+        pid_t process_{};
+#endif
+
+    public:
+        explicit ring_pipeline(ipc::shm_ring::mode mode)
+        {
+            const std::string name = "Local\\xtw-bench-ring-" + std::to_string(::GetCurrentProcessId()) + (mode == ipc::shm_ring::mode::spsc ? "-spsc" : "-mpsc");
+            ring_ = ipc::shm_ring::create(std::wstring(name.begin(), name.end()).c_str(), 65536, mode);
+
+#if defined(_WIN32)
+            wchar_t self[MAX_PATH + 1]{};
+            ::GetModuleFileNameW(nullptr, self, MAX_PATH + 1);
+            std::wstring command = L"\"" + std::wstring(self) + L"\" --shm-ring-producer " + std::wstring(name.begin(), name.end());
+            STARTUPINFOW si{sizeof(si)};
+            PROCESS_INFORMATION pi{};
+            if (!::CreateProcessW(self, command.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &si, &pi))
+                throw std::runtime_error("cannot start the producer process");
+            ::CloseHandle(pi.hThread);
+            process_.reset(pi.hProcess);
+#else
+            process_ = ::fork();
+            if (process_ < 0) throw std::runtime_error("cannot start the producer process");
+            if (process_ == 0)
+            {
+                ::execl("/proc/self/exe", "xtw_bench", "--shm-ring-producer", name.c_str(), nullptr);
+                ::_exit(127);
+            }
+#endif
+        }
+
+        ring_pipeline(const ring_pipeline& other) = delete;
+        ring_pipeline& operator=(const ring_pipeline& other) = delete;
+
+        ~ring_pipeline()
+        {
+            ring_ = ipc::shm_ring{}; // the producer sees the consumer go and exits.
+#if defined(_WIN32)
+            ::WaitForSingleObject(process_.get(), INFINITE);
+#else
+            ::waitpid(process_, nullptr, 0);
+#endif
+        }
+
+        uint64_t consume(size_t records)
+        {
+            uint64_t sum = 0;
+            for (size_t i = 0; i < records; i++)
+            {
+                const auto s = ring_.read([&](const std::byte* data, size_t length) { sum += checksum(data, length); }, 5000);
+                if (s != ipc::shm_ring::status::ok) throw std::runtime_error("the producer process stopped");
+            }
+            return sum;
+        }
+    };
+
+    struct arguments
+    {
+        std::string filter{};
+        std::string output{};
+        std::string baseline{};
+        double threshold = 0.05;
+        bool quick = false;
+        bool skip_without_baseline = false;
+    };
+
+    bool parse_arguments(int argc, char** argv, arguments& args)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            const std::string_view a = argv[i];
+            const bool has_value = i + 1 < argc;
+            if (a == "--quick") args.quick = true;
+            else if (a == "--skip-without-baseline") args.skip_without_baseline = true;
+            else if (a == "--filter" && has_value) args.filter = argv[++i];
+            else if (a == "--output" && has_value) args.output = argv[++i];
+            else if (a == "--baseline" && has_value) args.baseline = argv[++i];
+            else if (a == "--threshold" && has_value) args.threshold = std::strtod(argv[++i], nullptr);
+            else return false;
+        }
+        return args.threshold > 0;
+    }
+
+    bool read_file(const std::string& path, std::string& text)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    // repeats `unit` up to `length` code units.
+    template <class C>
+    std::basic_string<C> repeat_text(std::basic_string_view<C> unit, size_t length)
+    {
+        std::basic_string<C> text{};
+        while (text.size() + unit.size() <= length) text += unit;
+        return text;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc == 3 && std::string_view(argv[1]) == "--shm-ring-producer") return run_ring_producer(argv[2]);
+
+    arguments args{};
+    if (!parse_arguments(argc, argv, args))
+    {
+        std::fprintf(stderr, "usage: %s [--filter <substring>] [--quick] [--output <tsv>] [--baseline <tsv> [--skip-without-baseline]] [--threshold <relative>]\n", argv[0]);
+        return 2;
+    }
+
+    std::string baseline_text{};
+    if (!args.baseline.empty() && !read_file(args.baseline, baseline_text))
+    {
+        std::fprintf(stderr, "cannot read %s\n", args.baseline.c_str());
+        return args.skip_without_baseline ? 77 : 2;
+    }
+
+    benchmark::options opt{};
+    if (args.quick)
+    {
+        opt.min_samples = 5;
+        opt.max_samples = 15;
+        opt.min_sample_time_us = 1000;
+        opt.max_total_time_us = 100000;
+    }
+
+    benchmark::suite suite{};
+
+    // threading
+    suite.add("thread/spawn_join", []
+    {
+        threading::thread t([] {});
+        t.join();
+    });
+
+    ping_pong pp{};
+    suite.add("event/ping_pong", [&pp] { pp.round_trip(); });
+
+    // an event per operation: a new kernel object each time, or one from handle_pool.
+    suite.add("event/create_destroy", []
+    {
+        threading::auto_reset_event e{};
+        e.notify_signal();
+        benchmark::do_not_optimize(e.wait_signal(0));
+    });
+    suite.add("event/pooled", []
+    {
+        threading::pooled_auto_reset_event e{};
+        e.notify_signal();
+        benchmark::do_not_optimize(e.wait_signal(0));
+    });
+
+    // ui_dispatcher: posting and draining on one thread, and a round trip to a thread waiting for posts.
+    window::ui_dispatcher local_dispatcher([] { return true; });
+    suite.add("ui_dispatcher/post_drain", [&local_dispatcher]
+    {
+        local_dispatcher.post([] {});
+        benchmark::do_not_optimize(local_dispatcher.drain());
+    });
+    suite.add("ui_dispatcher/post_drain_64", [&local_dispatcher]
+    {
+        for (int i = 0; i < 64; i++) local_dispatcher.post([] {});
+        benchmark::do_not_optimize(local_dispatcher.drain());
+    });
+
+    dispatcher_thread remote{};
+    suite.add("ui_dispatcher/round_trip", [&remote] { remote.round_trip(); });
+
+    // thread_arena: 256 small allocations and their release, against the default allocator.
+    threading::thread_arena arena{};
+    std::vector<void*> blocks(256);
+    suite.add("thread_arena/allocate_256x48", [&arena, &blocks]
+    {
+        threading::thread_arena::scoped_mark scope(arena);
+        for (auto& b : blocks) b = arena.allocate(48);
+        benchmark::do_not_optimize(blocks.data());
+    });
+    suite.add("thread_arena/new_delete_256x48", [&blocks]
+    {
+        auto* r = std::pmr::new_delete_resource();
+        for (auto& b : blocks) b = r->allocate(48);
+        benchmark::do_not_optimize(blocks.data());
+        for (auto& b : blocks) r->deallocate(b, 48);
+    });
+    suite.add("thread_arena/vector_1024", [&arena]
+    {
+        threading::thread_arena::scoped_mark scope(arena);
+        std::pmr::vector<uint32_t> v(&arena);
+        for (uint32_t i = 0; i < 1024; i++) v.push_back(i);
+        benchmark::do_not_optimize(v.data());
+    });
+    suite.add("thread_arena/vector_1024_default", []
+    {
+        std::vector<uint32_t> v{};
+        for (uint32_t i = 0; i < 1024; i++) v.push_back(i);
+        benchmark::do_not_optimize(v.data());
+    });
+
+    // parallel: the same work on worker sets of 1, 2 and 4 participants; the 1-participant runs are the serial baselines.
+    std::vector<std::unique_ptr<threading::worker_set>> worker_sets{};
+    for (size_t workers : {0, 1, 3}) worker_sets.push_back(std::make_unique<threading::worker_set>(workers, L"xtw-bench::worker_set"));
+
+    std::vector<uint32_t> parallel_input(size_t{1} << 20);
+    for (size_t i = 0; i < parallel_input.size(); i++) parallel_input[i] = static_cast<uint32_t>(i * 2654435761u);
+    std::vector<uint32_t> parallel_output(parallel_input.size());
+
+    for (auto& w : worker_sets)
+    {
+        const std::string participants = "/p" + std::to_string(w->size());
+        threading::worker_set& workers = *w;
+        suite.add("parallel_for/square_1m" + participants, [&workers, &parallel_input, &parallel_output]
+        {
+            threading::parallel_for(0, parallel_input.size(), [&](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; i++) parallel_output[i] = parallel_input[i] * parallel_input[i];
+            }, 0, workers);
+            benchmark::do_not_optimize(parallel_output.data());
+        });
+        suite.add("parallel_for/empty_job" + participants, [&workers]
+        {
+            threading::parallel_for(0, workers.size() * 8, [](size_t i) { benchmark::do_not_optimize(i); }, 1, workers);
+        });
+        suite.add("parallel_reduce/sum_1m" + participants, [&workers, &parallel_input]
+        {
+            benchmark::do_not_optimize(threading::parallel_reduce(0, parallel_input.size(), uint64_t{}, [&](size_t begin, size_t end)
+            {
+                uint64_t sum = 0;
+                for (size_t i = begin; i < end; i++) sum += parallel_input[i];
+                return sum;
+            }, std::plus<>{}, 0, workers));
+        });
+        suite.add("parallel_sort/256k" + participants, [&workers, &parallel_input, &parallel_output]
+        {
+            std::copy_n(parallel_input.begin(), size_t{1} << 18, parallel_output.begin());
+            threading::parallel_sort(parallel_output.begin(), parallel_output.begin() + (ptrdiff_t{1} << 18), std::less<>{}, workers);
+            benchmark::do_not_optimize(parallel_output.data());
+        });
+    }
+
+    // task_graph: the scheduling cost of 256 empty nodes, as a chain and as independent nodes, per run.
+    std::vector<std::unique_ptr<threading::task_graph>> task_graphs{};
+    for (bool chain : {true, false})
+    {
+        auto& g = *task_graphs.emplace_back(std::make_unique<threading::task_graph>());
+        for (threading::task_graph::node_id i = 0; i < 256; i++)
+        {
+            g.add_node("node", [] {});
+            if (chain && i) g.add_edge(i - 1, i);
+        }
+        g.prepare();
+        for (auto& w : worker_sets)
+        {
+            threading::worker_set& workers = *w;
+            suite.add(std::string("task_graph/") + (chain ? "chain_256" : "independent_256") + "/p" + std::to_string(w->size()), [&g, &workers] { g.run(workers); });
+        }
+    }
+
+    // com_ptr
+    com_ptr<IBenchValue> value{};
+    value.attach(new mock_object());
+
+    suite.add("com_ptr/copy", [&value]
+    {
+        com_ptr<IBenchValue> copy = value;
+        benchmark::do_not_optimize(copy);
+    });
+
+    suite.add("com_ptr/move", [&value]
+    {
+        com_ptr<IBenchValue> moved = std::move(value);
+        value = std::move(moved);
+    });
+
+    suite.add("com_ptr/as_upcast", [&value]
+    {
+        auto unknown = value.as<IUnknown>();
+        benchmark::do_not_optimize(unknown);
+    });
+
+    suite.add("com_ptr/as_query_interface", [&value]
+    {
+        auto other = value.as<IBenchOther>();
+        benchmark::do_not_optimize(other);
+    });
+
+    // unique_handle
+    suite.add("unique_handle/churn", []
+    {
+        unique_handle h(::CreateEventW(nullptr, FALSE, FALSE, nullptr));
+        benchmark::do_not_optimize(h);
+    });
+    suite.add("unique_handle/churn_deferred", []
+    {
+        deferred_unique_handle h(::CreateEventW(nullptr, FALSE, FALSE, nullptr));
+        benchmark::do_not_optimize(h);
+    });
+
+    // debug output; without a debugger attached, OutputDebugStringA returns immediately.
+    debug::debug_output_stream log("xtw_bench ");
+    suite.add("debug_output_stream/line", [&log]
+    {
+        log << "line " << 42 << std::endl;
+    });
+
+    suite.add("debug_output_stream/temporary", []
+    {
+        debug::debug_output_stream("xtw_bench ") << "line " << 42 << '\n';
+    });
+
+    suite.add("strtime_now", []
+    {
+        char buf[28];
+        debug::output_debug_stream_detail::basic_callback_ostreambuf<char>::strtime_now(buf);
+        benchmark::do_not_optimize(buf);
+    });
+
+    // stack traces: capturing raw frames, and a failing XTW_THROW_ON_FAILURE with and without capture on throw.
+    suite.add("stack_trace/capture", []
+    {
+        auto t = debug::stack_trace::capture();
+        benchmark::do_not_optimize(t);
+    });
+
+    const auto throw_on_failure = [](bool capture)
+    {
+        debug::stack_trace::capture_on_throw(capture);
+        try { XTW_THROW_ON_FAILURE E_FAIL; }
+        catch (const win32_exception& e) { benchmark::do_not_optimize(e.frame_count()); }
+        debug::stack_trace::capture_on_throw(false);
+    };
+    suite.add("win32_exception/throw_catch", [&throw_on_failure] { throw_on_failure(false); });
+    suite.add("win32_exception/throw_catch_captured", [&throw_on_failure] { throw_on_failure(true); });
+
+    // symbols of a captured trace: the first lookup per address goes to the symbol handler, later ones hit the cache.
+    const auto symbolized = debug::stack_trace::capture();
+    suite.add("symbol_cache/describe_cached", [&symbolized]
+    {
+        auto s = debug::symbol_cache::instance().describe(symbolized[0]);
+        benchmark::do_not_optimize(s);
+    });
+
+    suite.add("symbol_cache/describe_uncached", [&symbolized]
+    {
+        debug::symbol_cache::instance().clear();
+        auto s = debug::symbol_cache::instance().describe(symbolized[0]);
+        benchmark::do_not_optimize(s);
+    });
+
+    suite.add("symbol_cache/module_offset_of", [&symbolized]
+    {
+        auto s = debug::symbol_cache::module_offset_of(symbolized[0]);
+        benchmark::do_not_optimize(s);
+    });
+
+    // GUID
+    const GUID guid = __uuidof(IBenchValue);
+    suite.add("guid/to_wstring", [&guid]
+    {
+        auto s = to_wstring(guid);
+        benchmark::do_not_optimize(s);
+    });
+
+    suite.add("guid/to_string", [&guid]
+    {
+        auto s = to_string(guid);
+        benchmark::do_not_optimize(s);
+    });
+
+    // slot_map: 4096 values looked up in a scattered order, against std::unordered_map with the same keys.
+    slot_map<uint64_t> slots{};
+    sharded_slot_map<uint64_t> sharded_slots{};
+    std::unordered_map<uint32_t, uint64_t> hashed{};
+    std::vector<uint32_t> slot_ids{};
+    std::vector<uint64_t> sharded_ids{};
+    for (uint64_t i = 0; i < 4096; i++)
+    {
+        slot_ids.push_back(slots.insert(i));
+        sharded_ids.push_back(sharded_slots.insert(i));
+        hashed.emplace(slot_ids.back(), i);
+    }
+    for (size_t i = slot_ids.size() - 1, x = 1; i > 0; i--) // Fisher-Yates with a fixed LCG
+    {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+        std::swap(slot_ids[i], slot_ids[(x >> 33) % (i + 1)]);
+        std::swap(sharded_ids[i], sharded_ids[(x >> 33) % (i + 1)]);
+    }
+
+    suite.add("slot_map/insert_erase", [&slots]
+    {
+        const auto id = slots.insert(1);
+        benchmark::do_not_optimize(slots.erase(id));
+    });
+    suite.add("slot_map/find", [&slots, &slot_ids, i = size_t{}]() mutable
+    {
+        benchmark::do_not_optimize(*slots.find(slot_ids[i++ & 4095]));
+    });
+    suite.add("slot_map/iterate_4096", [&slots]
+    {
+        uint64_t sum = 0;
+        for (uint64_t v : slots) sum += v;
+        benchmark::do_not_optimize(sum);
+    });
+    suite.add("slot_map/unordered_map_find", [&hashed, &slot_ids, i = size_t{}]() mutable
+    {
+        benchmark::do_not_optimize(hashed.find(slot_ids[i++ & 4095])->second);
+    });
+    suite.add("sharded_slot_map/visit", [&sharded_slots, &sharded_ids, i = size_t{}]() mutable
+    {
+        uint64_t value{};
+        sharded_slots.visit(sharded_ids[i++ & 4095], [&](const uint64_t& v) { value = v; });
+        benchmark::do_not_optimize(value);
+    });
+    suite.add("sharded_slot_map/insert_erase", [&sharded_slots]
+    {
+        const auto id = sharded_slots.insert(1);
+        benchmark::do_not_optimize(sharded_slots.erase(id));
+    });
+
+    // utf: the SIMD paths (as built) against the scalar paths, into preallocated buffers.
+    struct utf_input
+    {
+        const char* name;
+        std::wstring utf16;
+        std::string utf8;
+    };
+
+    std::vector<utf_input> utf_inputs{};
+    utf_inputs.push_back({"ascii_4k", repeat_text<wchar_t>(L"The quick brown fox jumps over the lazy dog. ", 4096), {}});
+    utf_inputs.push_back({"mixed_4k", repeat_text<wchar_t>(L"Caf\u00e9 \u65e5\u672c\u8a9e text \U0001F600 and ascii words. ", 4096), {}});
+    for (auto& in : utf_inputs) in.utf8 = utf::to_utf8(in.utf16);
+
+    std::vector<char> utf8_buffer(utf_inputs.back().utf8.size() * 2);
+    std::vector<wchar_t> utf16_buffer(utf_inputs.back().utf16.size() * 2);
+
+    for (const auto& in : utf_inputs)
+    {
+        const std::string name = in.name;
+        suite.add("utf/utf16_to_utf8/" + name + "/simd", [&in, &utf8_buffer]
+        {
+            auto n = utf::utf16_to_utf8(in.utf16, utf8_buffer.data(), utf8_buffer.size());
+            benchmark::do_not_optimize(n);
+        });
+
+        suite.add("utf/utf16_to_utf8/" + name + "/scalar", [&in, &utf8_buffer]
+        {
+            auto n = xtw_bench::utf_scalar::utf16_to_utf8(in.utf16, utf8_buffer.data(), utf8_buffer.size());
+            benchmark::do_not_optimize(n);
+        });
+
+        suite.add("utf/utf8_to_utf16/" + name + "/simd", [&in, &utf16_buffer]
+        {
+            auto n = utf::utf8_to_utf16(in.utf8, utf16_buffer.data(), utf16_buffer.size());
+            benchmark::do_not_optimize(n);
+        });
+
+        suite.add("utf/utf8_to_utf16/" + name + "/scalar", [&in, &utf16_buffer]
+        {
+            auto n = xtw_bench::utf_scalar::utf8_to_utf16(in.utf8, utf16_buffer.data(), utf16_buffer.size());
+            benchmark::do_not_optimize(n);
+        });
+    }
+
+    // registry enumeration: the sized-once ranges against the index loops, on a key with 64 sub keys and 64 values,
+    // and the parallel walker against a sequential walk of 8 x 8 keys.
+    scratch_registry reg{};
+    {
+        auto flat = scratch_registry::create(reg.get(), L"flat");
+        for (int i = 0; i < 64; i++)
+        {
+            const std::string n = std::to_string(i);
+            const std::wstring name = L"item " + std::wstring(n.begin(), n.end());
+            scratch_registry::create(flat.get(), name);
+            const std::wstring data = L"value of " + name;
+            ::RegSetValueExW(flat.get(), name.c_str(), 0, REG_SZ, reinterpret_cast<const BYTE*>(data.c_str()), static_cast<DWORD>((data.size() + 1) * sizeof(wchar_t)));
+            for (int j = 0; i < 8 && j < 8; j++)
+            {
+                const std::string m = std::to_string(j);
+                scratch_registry::create(reg.get(), L"tree\\" + name + L"\\" + std::wstring(m.begin(), m.end()));
+            }
+        }
+    }
+
+    const auto flat = registry::OpenKey(reg.get(), L"flat");
+    suite.add("registry/keys/EnumKeyName", [&flat]
+    {
+        size_t length = 0;
+        for (size_t i = 0; auto name = registry::EnumKeyName(flat.get(), i); i++) length += name->size();
+        benchmark::do_not_optimize(length);
+    });
+
+    suite.add("registry/keys/range", [&flat]
+    {
+        size_t length = 0;
+        for (std::wstring_view name : registry::keys(flat.get())) length += name.size();
+        benchmark::do_not_optimize(length);
+    });
+
+    suite.add("registry/values/RegEnumValueW", [&flat]
+    {
+        // per value: sizes, then a fresh buffer for the name and the data.
+        size_t length = 0;
+        for (DWORD i = 0;; i++)
+        {
+            DWORD name_length = 0, data_size = 0;
+            if (::RegQueryInfoKeyW(flat.get(), nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, &name_length, &data_size, nullptr, nullptr) != ERROR_SUCCESS) break;
+            std::wstring name(name_length + 1, L'\0');
+            std::vector<BYTE> data(std::max<DWORD>(data_size, 1));
+            name_length += 1;
+            DWORD type{};
+            if (::RegEnumValueW(flat.get(), i, name.data(), &name_length, nullptr, &type, data.data(), &data_size) != ERROR_SUCCESS) break;
+            length += name_length + data_size;
+        }
+        benchmark::do_not_optimize(length);
+    });
+
+    suite.add("registry/values/range", [&flat]
+    {
+        size_t length = 0;
+        for (const auto& v : registry::values(flat.get())) length += v.name.size() + v.size;
+        benchmark::do_not_optimize(length);
+    });
+
+    const auto tree = registry::OpenKey(reg.get(), L"tree");
+    suite.add("registry/walk/sequential", [&tree]
+    {
+        size_t count = 0;
+        std::vector<registry::registry_key_unique_handle> stack{};
+        stack.push_back(registry::OpenKey(tree.get(), L""));
+        while (!stack.empty())
+        {
+            auto key = std::move(stack.back());
+            stack.pop_back();
+            count++;
+            for (std::wstring_view name : registry::keys(key.get()))
+                stack.push_back(registry::OpenKey(key.get(), std::wstring(name).c_str()));
+        }
+        benchmark::do_not_optimize(count);
+    });
+
+    suite.add("registry/walk/parallel", [&reg]
+    {
+        std::atomic<size_t> count{};
+        registry::WalkSubtreeParallel(reg.get(), L"tree", [&count](std::wstring_view, HKEY) { count++; });
+        benchmark::do_not_optimize(count);
+    });
+
+    // mapped_file: an 8 MiB file read whole through a view against ReadFile into a reused buffer,
+    // and 1024 reads of 64 bytes at random offsets through a view against positioned ReadFile calls.
+    constexpr size_t scratch_file_size = 8u << 20;
+    scratch_file file(scratch_file_size);
+
+    suite.add("mapped_file/sequential/map", [&file]
+    {
+        auto f = mapped_file::open(file.path());
+        auto view = f.map();
+        auto sum = checksum(view.data(), view.size());
+        benchmark::do_not_optimize(sum);
+    });
+
+    std::vector<std::byte> read_buffer(1u << 20);
+    suite.add("mapped_file/sequential/ReadFile", [&file, &read_buffer]
+    {
+        unique_handle h(::CreateFileW(file.path(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+        uint64_t sum = 0;
+        DWORD n{};
+        while (::ReadFile(h.get(), read_buffer.data(), static_cast<DWORD>(read_buffer.size()), &n, nullptr) && n != 0)
+            sum += checksum(read_buffer.data(), n);
+        benchmark::do_not_optimize(sum);
+    });
+
+    std::vector<uint64_t> random_offsets(1024);
+    for (size_t i = 0, x = 1; i < random_offsets.size(); i++)
+    {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+        random_offsets[i] = (x >> 16) % (scratch_file_size - 64) / 8 * 8;
+    }
+
+    const auto random_file = mapped_file::open(file.path());
+    const auto random_view = random_file.map();
+    suite.add("mapped_file/random/map", [&random_view, &random_offsets]
+    {
+        uint64_t sum = 0;
+        for (uint64_t offset : random_offsets) sum += checksum(random_view.data() + offset, 64);
+        benchmark::do_not_optimize(sum);
+    });
+
+    unique_handle random_handle(::CreateFileW(file.path(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+    suite.add("mapped_file/random/ReadFile", [&random_handle, &random_offsets]
+    {
+        uint64_t sum = 0;
+        std::byte record[64];
+        for (uint64_t offset : random_offsets)
+        {
+            OVERLAPPED at{};
+            at.Offset = static_cast<DWORD>(offset);
+            at.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            DWORD n{};
+            if (::ReadFile(random_handle.get(), record, sizeof(record), &n, &at)) sum += checksum(record, n);
+        }
+        benchmark::do_not_optimize(sum);
+    });
+
+    // io_context: a posted function's round trip, and 4 KiB reads of the scratch file one at a time (latency; max_ns is the tail)
+    // and 32 in flight (throughput per batch).
+    io_context io(2);
+    threading::auto_reset_event io_done{};
+    suite.add("io_context/post_round_trip", [&io, &io_done]
+    {
+        io.post([&io_done] { io_done.notify_signal(); });
+        io_done.wait_signal();
+    });
+
+    unique_handle io_file(::CreateFileW(file.path(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr));
+    io.associate(io_file.get());
+    std::vector<std::byte> io_buffer(32 * 4096);
+
+    suite.add("io_context/read_4k_qd1", [&io, &io_file, &io_buffer, &io_done, &random_offsets]
+    {
+        static size_t next = 0;
+        const uint64_t offset = random_offsets[next++ % random_offsets.size()] / 4096 * 4096;
+        io.read(io_file.get(), offset, io_buffer.data(), 4096, [&io_done](DWORD, DWORD) { io_done.notify_signal(); });
+        io_done.wait_signal();
+    });
+
+    std::atomic<int> io_remaining{};
+    suite.add("io_context/read_4k_qd32", [&io, &io_file, &io_buffer, &io_done, &io_remaining, &random_offsets]
+    {
+        static size_t next = 0;
+        io_remaining.store(32);
+        std::vector<io_context::request> batch{};
+        for (size_t i = 0; i < 32; i++)
+        {
+            const uint64_t offset = random_offsets[next++ % random_offsets.size()] / 4096 * 4096;
+            batch.push_back({io_file.get(), offset, io_buffer.data() + i * 4096, 4096, false, [&io_done, &io_remaining](DWORD, DWORD)
+            {
+                if (--io_remaining == 0) io_done.notify_signal();
+            }});
+        }
+        io.submit(batch);
+        io_done.wait_signal();
+    });
+
+    // ipc: 1024 records of 64 bytes from a producer process, which starts on first use.
+    std::optional<ring_pipeline> mpsc_ring{}, spsc_ring{};
+    suite.add("shm_ring/two_process/mpsc", [&mpsc_ring]
+    {
+        if (!mpsc_ring) mpsc_ring.emplace(ipc::shm_ring::mode::mpsc);
+        benchmark::do_not_optimize(mpsc_ring->consume(1024));
+    });
+    suite.add("shm_ring/two_process/spsc", [&spsc_ring]
+    {
+        if (!spsc_ring) spsc_ring.emplace(ipc::shm_ring::mode::spsc);
+        benchmark::do_not_optimize(spsc_ring->consume(1024));
+    });
+
+    // sampling_profiler: the same computation on this thread alone and while sampled at 1 kHz; the difference is the sampling overhead.
+    // Registering this thread enables thread_registry for the rest of the run, so these come last.
+    const auto compute = []
+    {
+        uint64_t x = 1;
+        for (int i = 0; i < 1000000; i++) x = x * 6364136223846793005u + 1442695040888963407u;
+        benchmark::do_not_optimize(x);
+    };
+    suite.add("sampling_profiler/compute_1m", compute);
+
+    std::optional<threading::thread_registry::scoped_registration> bench_thread{};
+    std::optional<debug::sampling_profiler> profiler{};
+    uint64_t profiler_cleared = 0;
+    suite.add("sampling_profiler/compute_1m_sampled_1khz", [&bench_thread, &profiler, &profiler_cleared, &compute]
+    {
+        if (!profiler)
+        {
+            bench_thread.emplace(L"xtw_bench");
+            profiler.emplace(1000, 16384);
+            profiler->start();
+        }
+        compute();
+        if (profiler->sample_count() - profiler_cleared >= 8192)
+        {
+            profiler->clear();
+            profiler_cleared = profiler->sample_count();
+        }
+    });
+
+    const auto results = suite.run(opt, args.filter);
+    const std::string text = benchmark::format_results(results);
+    std::fputs(text.c_str(), stdout);
+
+    if (!args.output.empty())
+    {
+        std::ofstream out(args.output, std::ios::binary);
+        if (!(out << text))
+        {
+            std::fprintf(stderr, "cannot write %s\n", args.output.c_str());
+            return 2;
+        }
+    }
+
+    if (args.baseline.empty()) return 0;
+
+    auto baseline = benchmark::parse_results(baseline_text);
+    if (!args.filter.empty())
+        baseline.erase(std::remove_if(baseline.begin(), baseline.end(), [&](const benchmark::result& r) { return r.name.find(args.filter) == std::string::npos; }), baseline.end());
+
+    const auto comparisons = benchmark::compare(baseline, results, args.threshold);
+    std::fputs(benchmark::format_comparisons(comparisons).c_str(), stdout);
+
+    const bool missing = std::any_of(comparisons.begin(), comparisons.end(), [](const benchmark::comparison& c) { return c.result == benchmark::verdict::missing; });
+    return benchmark::has_regression(comparisons) || missing ? 1 : 0;
+}
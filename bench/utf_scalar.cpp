@@ -0,0 +1,27 @@
+/// @file
+/// @brief  xtw::utf conversions built without SIMD, for comparison in the benchmarks
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+// the xtw::utf functions have internal linkage, so this copy does not collide with the SIMD one in bench.cpp.
+#define XTW_UTF_NO_SIMD 1
+#include <xtw/utf.h>
+
+#if defined(XTW_UTF_USE_AVX2) || defined(XTW_UTF_USE_SSE2)
+#error "xtw/utf.h was included with SIMD before this point."
+#endif
+
+#include "./utf_scalar.h"
+
+namespace xtw_bench::utf_scalar
+{
+    std::optional<size_t> utf16_to_utf8(std::wstring_view utf16, char* buffer, size_t buffer_length) noexcept
+    {
+        return xtw::utf::utf16_to_utf8(utf16, buffer, buffer_length);
+    }
+
+    std::optional<size_t> utf8_to_utf16(std::string_view utf8, wchar_t* buffer, size_t buffer_length) noexcept
+    {
+        return xtw::utf::utf8_to_utf16(utf8, buffer, buffer_length);
+    }
+}
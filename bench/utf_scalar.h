@@ -0,0 +1,17 @@
+/// @file
+/// @brief  xtw::utf conversions built without SIMD, for comparison in the benchmarks
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+namespace xtw_bench::utf_scalar
+{
+    // xtw::utf::utf16_to_utf8 and utf8_to_utf16 compiled with XTW_UTF_NO_SIMD (utf_scalar.cpp).
+    std::optional<size_t> utf16_to_utf8(std::wstring_view utf16, char* buffer, size_t buffer_length) noexcept;
+    std::optional<size_t> utf8_to_utf16(std::string_view utf8, wchar_t* buffer, size_t buffer_length) noexcept;
+}
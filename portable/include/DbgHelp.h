@@ -0,0 +1,50 @@
+/// @file
+/// @brief  xtw portable backend: <DbgHelp.h>
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+///
+/// Declarations only; symbol lookups fail, so xtw::debug::symbol_cache reports modules and offsets.
+
+#pragma once
+
+#include <Windows.h>
+
+#define MAX_SYM_NAME 2000
+#define SYMOPT_UNDNAME 0x00000002
+#define SYMOPT_DEFERRED_LOADS 0x00000004
+#define SYMOPT_LOAD_LINES 0x00000010
+
+struct SYMBOL_INFOW
+{
+    ULONG SizeOfStruct;
+    ULONG TypeIndex;
+    ULONG64 Reserved[2];
+    ULONG Index;
+    ULONG Size;
+    ULONG64 ModBase;
+    ULONG Flags;
+    ULONG64 Value;
+    ULONG64 Address;
+    ULONG Register;
+    ULONG Scope;
+    ULONG Tag;
+    ULONG NameLen;
+    ULONG MaxNameLen;
+    WCHAR Name[1];
+};
+
+struct IMAGEHLP_LINEW64
+{
+    DWORD SizeOfStruct;
+    PVOID Key;
+    DWORD LineNumber;
+    PWSTR FileName;
+    DWORD64 Address;
+};
+
+DWORD SymSetOptions(DWORD options);
+DWORD SymGetOptions();
+BOOL SymInitializeW(HANDLE process, PCWSTR user_search_path, BOOL invade_process);
+BOOL SymRefreshModuleList(HANDLE process);
+BOOL SymFromAddrW(HANDLE process, DWORD64 address, DWORD64* displacement, SYMBOL_INFOW* symbol);
+BOOL SymGetLineFromAddrW64(HANDLE process, DWORD64 address, DWORD* displacement, IMAGEHLP_LINEW64* line);
@@ -0,0 +1,533 @@
+/// @file
+/// @brief  xtw portable backend: the subset of <Windows.h> used by the testable parts of xtw
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+///
+/// Lets xtw build and run on POSIX systems for benchmarks and tests (see portable/win32_posix.cpp).
+/// Events, threads, waits, timers, files, file mappings, and virtual memory behave as on Windows.
+/// The registry is a directory tree under $XTW_PORTABLE_REGISTRY, with change notifications through inotify (see portable/win32_registry.cpp).
+/// DbgHelp, thread inspection, and other facilities without a POSIX counterpart fail as they do when unavailable on Windows.
+/// Requires -fshort-wchar: xtw assumes UTF-16 wchar_t.
+
+#pragma once
+
+#if defined(_WIN32)
+#error "portable/include is for non-Windows builds; use the Windows SDK."
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+static_assert(sizeof(wchar_t) == 2, "build with -fshort-wchar: xtw assumes UTF-16 wchar_t.");
+
+// compiler extensions
+#define __declspec(x) XTW_PORTABLE_DECLSPEC_##x
+#define XTW_PORTABLE_DECLSPEC_noinline __attribute__((noinline))
+#define XTW_PORTABLE_DECLSPEC_novtable
+#define XTW_PORTABLE_DECLSPEC_uuid(x)
+#define __pragma(x)
+#define __stdcall
+#define __cdecl
+#define WINAPI
+#define CALLBACK
+#define STDMETHODCALLTYPE
+#define _Out_
+#define DECLSPEC_ALIGN(x) alignas(x)
+
+// types, sized as on Windows (LLP64): LONG, DWORD, and HRESULT are 32 bits.
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef uint32_t DWORD;
+typedef unsigned long long DWORD64;
+typedef short SHORT;
+typedef unsigned short USHORT;
+typedef int INT;
+typedef unsigned int UINT;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef unsigned long long ULONG64;
+typedef intptr_t INT_PTR;
+typedef intptr_t LONG_PTR;
+typedef uintptr_t UINT_PTR;
+typedef uintptr_t ULONG_PTR;
+typedef uintptr_t DWORD_PTR;
+typedef ULONG_PTR SIZE_T;
+typedef char CHAR;
+typedef wchar_t WCHAR;
+typedef int32_t HRESULT;
+typedef int32_t LSTATUS;
+typedef int32_t NTSTATUS;
+typedef void* PVOID;
+typedef void* LPVOID;
+typedef const void* LPCVOID;
+typedef BYTE* LPBYTE;
+typedef unsigned char* PUCHAR;
+typedef DWORD* LPDWORD;
+typedef ULONG* PULONG;
+typedef BOOL* PBOOL;
+typedef char* LPSTR;
+typedef const char* LPCSTR;
+typedef wchar_t* LPWSTR;
+typedef wchar_t* PWSTR;
+typedef const wchar_t* LPCWSTR;
+typedef const wchar_t* PCWSTR;
+typedef uintptr_t WPARAM;
+typedef intptr_t LPARAM;
+typedef intptr_t LRESULT;
+
+typedef void* HANDLE;
+typedef HANDLE HLOCAL;
+typedef struct HKEY__* HKEY;
+typedef HKEY* PHKEY;
+typedef DWORD REGSAM;
+typedef struct HWND__* HWND;
+typedef struct HINSTANCE__* HINSTANCE;
+typedef HINSTANCE HMODULE;
+typedef intptr_t (*FARPROC)();
+
+union LARGE_INTEGER
+{
+    struct
+    {
+        DWORD LowPart;
+        LONG HighPart;
+    };
+    LONGLONG QuadPart;
+};
+
+union ULARGE_INTEGER
+{
+    struct
+    {
+        DWORD LowPart;
+        DWORD HighPart;
+    };
+    ULONGLONG QuadPart;
+};
+
+struct FILETIME
+{
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+};
+
+struct POINT
+{
+    LONG x;
+    LONG y;
+};
+
+struct MSG
+{
+    HWND hwnd;
+    UINT message;
+    WPARAM wParam;
+    LPARAM lParam;
+    DWORD time;
+    POINT pt;
+};
+
+struct OVERLAPPED
+{
+    ULONG_PTR Internal;
+    ULONG_PTR InternalHigh;
+    union
+    {
+        struct
+        {
+            DWORD Offset;
+            DWORD OffsetHigh;
+        };
+        PVOID Pointer;
+    };
+    HANDLE hEvent;
+};
+typedef OVERLAPPED* LPOVERLAPPED;
+
+struct OVERLAPPED_ENTRY
+{
+    ULONG_PTR lpCompletionKey;
+    LPOVERLAPPED lpOverlapped;
+    ULONG_PTR Internal;
+    DWORD dwNumberOfBytesTransferred;
+};
+typedef OVERLAPPED_ENTRY* LPOVERLAPPED_ENTRY;
+
+struct SECURITY_ATTRIBUTES;
+typedef SECURITY_ATTRIBUTES* LPSECURITY_ATTRIBUTES;
+
+struct MEMORY_BASIC_INFORMATION
+{
+    PVOID BaseAddress;
+    PVOID AllocationBase;
+    DWORD AllocationProtect;
+    WORD PartitionId;
+    SIZE_T RegionSize;
+    DWORD State;
+    DWORD Protect;
+    DWORD Type;
+};
+typedef MEMORY_BASIC_INFORMATION* PMEMORY_BASIC_INFORMATION;
+
+struct SYSTEM_INFO
+{
+    WORD wProcessorArchitecture;
+    WORD wReserved;
+    DWORD dwPageSize;
+    LPVOID lpMinimumApplicationAddress;
+    LPVOID lpMaximumApplicationAddress;
+    DWORD_PTR dwActiveProcessorMask;
+    DWORD dwNumberOfProcessors;
+    DWORD dwProcessorType;
+    DWORD dwAllocationGranularity;
+    WORD wProcessorLevel;
+    WORD wProcessorRevision;
+};
+
+struct OSVERSIONINFOW
+{
+    DWORD dwOSVersionInfoSize;
+    DWORD dwMajorVersion;
+    DWORD dwMinorVersion;
+    DWORD dwBuildNumber;
+    DWORD dwPlatformId;
+    WCHAR szCSDVersion[128];
+};
+typedef OSVERSIONINFOW RTL_OSVERSIONINFOW;
+typedef RTL_OSVERSIONINFOW* PRTL_OSVERSIONINFOW;
+
+enum LOGICAL_PROCESSOR_RELATIONSHIP
+{
+    RelationProcessorCore = 0,
+    RelationNumaNode = 1,
+    RelationCache = 2,
+    RelationProcessorPackage = 3,
+};
+
+enum PROCESSOR_CACHE_TYPE
+{
+    CacheUnified = 0,
+    CacheInstruction = 1,
+    CacheData = 2,
+    CacheTrace = 3,
+};
+
+struct CACHE_DESCRIPTOR
+{
+    BYTE Level;
+    BYTE Associativity;
+    WORD LineSize;
+    DWORD Size;
+    PROCESSOR_CACHE_TYPE Type;
+};
+
+struct SYSTEM_LOGICAL_PROCESSOR_INFORMATION
+{
+    ULONG_PTR ProcessorMask;
+    LOGICAL_PROCESSOR_RELATIONSHIP Relationship;
+    union
+    {
+        struct { BYTE Flags; } ProcessorCore;
+        struct { DWORD NodeNumber; } NumaNode;
+        CACHE_DESCRIPTOR Cache;
+        ULONGLONG Reserved[2];
+    };
+};
+
+struct GUID
+{
+    uint32_t Data1;
+    unsigned short Data2;
+    unsigned short Data3;
+    unsigned char Data4[8];
+};
+
+typedef GUID IID;
+typedef GUID CLSID;
+typedef const IID& REFIID;
+typedef const GUID& REFGUID;
+
+inline bool operator==(const GUID& a, const GUID& b) noexcept { return std::memcmp(&a, &b, sizeof(GUID)) == 0; }
+inline bool operator!=(const GUID& a, const GUID& b) noexcept { return !(a == b); }
+
+struct NT_TIB
+{
+    void* ExceptionList;
+    PVOID StackBase;
+    PVOID StackLimit;
+};
+
+// values
+#define TRUE 1
+#define FALSE 0
+#define INFINITE 0xFFFFFFFF
+#define INVALID_HANDLE_VALUE ((HANDLE)(LONG_PTR)-1)
+#define MAX_PATH 260
+#define MAXIMUM_WAIT_OBJECTS 64
+#define MEMORY_ALLOCATION_ALIGNMENT 16
+
+#define ERROR_SUCCESS 0L
+#define ERROR_INVALID_FUNCTION 1L
+#define ERROR_FILE_NOT_FOUND 2L
+#define ERROR_PATH_NOT_FOUND 3L
+#define ERROR_ACCESS_DENIED 5L
+#define ERROR_INVALID_HANDLE 6L
+#define ERROR_NOT_ENOUGH_MEMORY 8L
+#define ERROR_INVALID_DATA 13L
+#define ERROR_OUTOFMEMORY 14L
+#define ERROR_HANDLE_EOF 38L
+#define ERROR_HANDLE_DISK_FULL 39L
+#define ERROR_FILE_EXISTS 80L
+#define ERROR_NOT_SUPPORTED 50L
+#define ERROR_INVALID_PARAMETER 87L
+#define ERROR_CALL_NOT_IMPLEMENTED 120L
+#define ERROR_INSUFFICIENT_BUFFER 122L
+#define ERROR_BUSY 170L
+#define ERROR_ALREADY_EXISTS 183L
+#define ERROR_INVALID_ADDRESS 487L
+#define ERROR_FILE_INVALID 1006L
+#define ERROR_BADDB 1009L
+#define ERROR_KEY_DELETED 1018L
+#define ERROR_MORE_DATA 234L
+#define ERROR_NO_MORE_ITEMS 259L
+#define ERROR_IO_PENDING 997L
+#define ERROR_NOT_ENOUGH_QUOTA 1816L
+#define ERROR_NO_SYSTEM_RESOURCES 1450L
+#define ERROR_INVALID_WINDOW_HANDLE 1400L
+
+#define WAIT_OBJECT_0 0x00000000L
+#define WAIT_ABANDONED 0x00000080L
+#define WAIT_ABANDONED_0 0x00000080L
+#define WAIT_IO_COMPLETION 0x000000C0L
+#define WAIT_TIMEOUT 258L
+#define WAIT_FAILED 0xFFFFFFFF
+#define STILL_ACTIVE 259
+
+#define S_OK ((HRESULT)0L)
+#define S_FALSE ((HRESULT)1L)
+#define E_NOTIMPL ((HRESULT)0x80004001L)
+#define E_NOINTERFACE ((HRESULT)0x80004002L)
+#define E_POINTER ((HRESULT)0x80004003L)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000EL)
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define HRESULT_FROM_WIN32(x) ((HRESULT)(x) <= 0 ? ((HRESULT)(x)) : ((HRESULT)(((x) & 0x0000FFFF) | (7 << 16) | 0x80000000)))
+
+#define SYNCHRONIZE 0x00100000L
+#define EVENT_ALL_ACCESS 0x1F0003
+#define DUPLICATE_SAME_ACCESS 0x00000002
+#define THREAD_SUSPEND_RESUME 0x0002
+#define THREAD_GET_CONTEXT 0x0008
+#define THREAD_QUERY_INFORMATION 0x0040
+#define THREAD_QUERY_LIMITED_INFORMATION 0x0800
+#define PROCESS_QUERY_LIMITED_INFORMATION 0x1000
+
+#define THREAD_PRIORITY_LOWEST (-2)
+#define THREAD_PRIORITY_BELOW_NORMAL (-1)
+#define THREAD_PRIORITY_NORMAL 0
+#define THREAD_PRIORITY_ABOVE_NORMAL 1
+#define THREAD_PRIORITY_HIGHEST 2
+#define THREAD_PRIORITY_TIME_CRITICAL 15
+
+#define MEM_COMMIT 0x00001000
+#define MEM_RESERVE 0x00002000
+#define MEM_DECOMMIT 0x00004000
+#define MEM_RELEASE 0x00008000
+#define MEM_LARGE_PAGES 0x20000000
+#define MEM_PRIVATE 0x00020000
+#define MEM_MAPPED 0x00040000
+#define PAGE_NOACCESS 0x01
+#define PAGE_READONLY 0x02
+#define PAGE_READWRITE 0x04
+#define SEC_COMMIT 0x08000000
+#define SEC_LARGE_PAGES 0x80000000
+
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define FILE_SHARE_READ 0x00000001
+#define FILE_SHARE_WRITE 0x00000002
+#define FILE_SHARE_DELETE 0x00000004
+#define CREATE_NEW 1
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define OPEN_ALWAYS 4
+#define TRUNCATE_EXISTING 5
+#define FILE_ATTRIBUTE_NORMAL 0x00000080
+#define FILE_FLAG_OVERLAPPED 0x40000000
+#define FILE_FLAG_NO_BUFFERING 0x20000000
+
+#define FILE_MAP_WRITE 0x0002
+#define FILE_MAP_READ 0x0004
+#define FILE_MAP_ALL_ACCESS 0x000F001F
+#define FILE_MAP_LARGE_PAGES 0x20000000
+
+#define HKEY_CLASSES_ROOT ((HKEY)(ULONG_PTR)((LONG)0x80000000))
+#define HKEY_CURRENT_USER ((HKEY)(ULONG_PTR)((LONG)0x80000001))
+#define HKEY_LOCAL_MACHINE ((HKEY)(ULONG_PTR)((LONG)0x80000002))
+#define HKEY_USERS ((HKEY)(ULONG_PTR)((LONG)0x80000003))
+#define HKEY_CURRENT_CONFIG ((HKEY)(ULONG_PTR)((LONG)0x80000005))
+#define KEY_QUERY_VALUE 0x0001
+#define KEY_SET_VALUE 0x0002
+#define KEY_CREATE_SUB_KEY 0x0004
+#define KEY_ENUMERATE_SUB_KEYS 0x0008
+#define KEY_NOTIFY 0x0010
+#define KEY_READ 0x20019
+#define KEY_WRITE 0x20006
+#define KEY_ALL_ACCESS 0xF003F
+#define REG_OPTION_NON_VOLATILE 0x00000000
+#define REG_CREATED_NEW_KEY 0x00000001
+#define REG_OPENED_EXISTING_KEY 0x00000002
+#define REG_NOTIFY_CHANGE_NAME 0x00000001
+#define REG_NOTIFY_CHANGE_ATTRIBUTES 0x00000002
+#define REG_NOTIFY_CHANGE_LAST_SET 0x00000004
+#define REG_NOTIFY_CHANGE_SECURITY 0x00000008
+#define REG_NOTIFY_THREAD_AGNOSTIC 0x10000000
+#define REG_NONE 0
+#define REG_SZ 1
+#define REG_EXPAND_SZ 2
+#define REG_BINARY 3
+#define REG_DWORD 4
+#define REG_MULTI_SZ 7
+#define REG_QWORD 11
+
+#define FORMAT_MESSAGE_ALLOCATE_BUFFER 0x00000100
+#define FORMAT_MESSAGE_IGNORE_INSERTS 0x00000200
+#define FORMAT_MESSAGE_FROM_HMODULE 0x00000800
+#define FORMAT_MESSAGE_FROM_SYSTEM 0x00001000
+#define LANG_NEUTRAL 0x00
+#define LANG_ENGLISH 0x09
+#define SUBLANG_DEFAULT 0x01
+#define SUBLANG_ENGLISH_US 0x01
+#define MAKELANGID(p, s) ((((WORD)(s)) << 10) | (WORD)(p))
+
+#define GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT 0x00000002
+#define GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS 0x00000004
+
+#define CSTR_LESS_THAN 1
+#define CSTR_EQUAL 2
+#define CSTR_GREATER_THAN 3
+
+// window message ids, for code that handles messages from a message_source; there is no window manager.
+#define WM_SIZE 0x0005
+#define WM_PAINT 0x000F
+#define WM_QUIT 0x0012
+#define WM_NCMOUSEMOVE 0x00A0
+#define WM_KEYDOWN 0x0100
+#define WM_MOUSEMOVE 0x0200
+#define WM_USER 0x0400
+#define WM_APP 0x8000
+
+// functions (portable/win32_posix.cpp)
+DWORD GetLastError();
+void SetLastError(DWORD error);
+
+BOOL CloseHandle(HANDLE handle);
+BOOL DuplicateHandle(HANDLE source_process, HANDLE source, HANDLE target_process, HANDLE* target, DWORD access, BOOL inherit, DWORD options);
+
+HANDLE CreateEventW(LPSECURITY_ATTRIBUTES attributes, BOOL manual_reset, BOOL initial_state, LPCWSTR name);
+BOOL SetEvent(HANDLE event);
+BOOL ResetEvent(HANDLE event);
+
+DWORD WaitForSingleObject(HANDLE handle, DWORD milliseconds);
+DWORD WaitForSingleObjectEx(HANDLE handle, DWORD milliseconds, BOOL alertable);
+DWORD WaitForMultipleObjects(DWORD count, const HANDLE* handles, BOOL wait_all, DWORD milliseconds);
+
+BOOL WaitOnAddress(volatile void* address, PVOID compare_address, SIZE_T address_size, DWORD milliseconds);
+void WakeByAddressSingle(PVOID address);
+void WakeByAddressAll(PVOID address);
+
+HANDLE GetCurrentProcess();
+HANDLE GetCurrentThread();
+DWORD GetCurrentProcessId();
+DWORD GetCurrentThreadId();
+HANDLE OpenThread(DWORD access, BOOL inherit, DWORD thread_id);
+BOOL SetThreadPriority(HANDLE thread, int priority);
+HRESULT SetThreadDescription(HANDLE thread, PCWSTR description);
+BOOL GetThreadTimes(HANDLE thread, FILETIME* creation, FILETIME* exit, FILETIME* kernel, FILETIME* user);
+BOOL QueryThreadCycleTime(HANDLE thread, ULONG64* cycle_time);
+BOOL GetExitCodeThread(HANDLE thread, LPDWORD exit_code);
+void Sleep(DWORD milliseconds);
+BOOL SwitchToThread();
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER* count);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* frequency);
+ULONGLONG GetTickCount64();
+DWORD GetTickCount();
+
+void GetSystemInfo(SYSTEM_INFO* info);
+BOOL GetLogicalProcessorInformation(SYSTEM_LOGICAL_PROCESSOR_INFORMATION* buffer, DWORD* returned_length);
+SIZE_T GetLargePageMinimum();
+LPVOID VirtualAlloc(LPVOID address, SIZE_T size, DWORD allocation_type, DWORD protect);
+BOOL VirtualFree(LPVOID address, SIZE_T size, DWORD free_type);
+BOOL VirtualLock(LPVOID address, SIZE_T size);
+SIZE_T VirtualQuery(LPCVOID address, PMEMORY_BASIC_INFORMATION buffer, SIZE_T length);
+HLOCAL LocalFree(HLOCAL memory);
+
+HMODULE LoadLibraryW(LPCWSTR file_name);
+BOOL FreeLibrary(HMODULE module);
+HMODULE GetModuleHandleW(LPCWSTR module_name);
+BOOL GetModuleHandleExW(DWORD flags, LPCWSTR module_name, HMODULE* module);
+DWORD GetModuleFileNameW(HMODULE module, LPWSTR file_name, DWORD size);
+FARPROC GetProcAddress(HMODULE module, LPCSTR proc_name);
+
+DWORD FormatMessageA(DWORD flags, LPCVOID source, DWORD message_id, DWORD language_id, LPSTR buffer, DWORD size, void* arguments);
+int CompareStringOrdinal(LPCWSTR string1, int count1, LPCWSTR string2, int count2, BOOL ignore_case);
+
+BOOL PostMessageW(HWND window, UINT message, WPARAM wparam, LPARAM lparam);
+
+void OutputDebugStringA(LPCSTR output_string);
+BOOL IsDebuggerPresent();
+void DebugBreak();
+
+WORD RtlCaptureStackBackTrace(DWORD frames_to_skip, DWORD frames_to_capture, PVOID* back_trace, DWORD* back_trace_hash);
+
+HANDLE CreateFileW(LPCWSTR file_name, DWORD desired_access, DWORD share_mode, LPSECURITY_ATTRIBUTES attributes, DWORD creation_disposition, DWORD flags_and_attributes, HANDLE template_file);
+BOOL ReadFile(HANDLE file, LPVOID buffer, DWORD bytes_to_read, LPDWORD bytes_read, LPOVERLAPPED overlapped);
+BOOL WriteFile(HANDLE file, LPCVOID buffer, DWORD bytes_to_write, LPDWORD bytes_written, LPOVERLAPPED overlapped);
+BOOL GetOverlappedResult(HANDLE file, LPOVERLAPPED overlapped, LPDWORD bytes_transferred, BOOL wait);
+BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER* size);
+BOOL DeleteFileW(LPCWSTR file_name);
+DWORD GetTempPathW(DWORD buffer_length, LPWSTR buffer);
+HANDLE CreateIoCompletionPort(HANDLE file, HANDLE existing_port, ULONG_PTR completion_key, DWORD concurrent_threads);
+BOOL PostQueuedCompletionStatus(HANDLE port, DWORD bytes_transferred, ULONG_PTR completion_key, LPOVERLAPPED overlapped);
+BOOL GetQueuedCompletionStatusEx(HANDLE port, LPOVERLAPPED_ENTRY entries, ULONG count, PULONG removed, DWORD milliseconds, BOOL alertable);
+
+HANDLE CreateFileMappingW(HANDLE file, LPSECURITY_ATTRIBUTES attributes, DWORD protect, DWORD maximum_size_high, DWORD maximum_size_low, LPCWSTR name);
+HANDLE OpenFileMappingW(DWORD desired_access, BOOL inherit_handle, LPCWSTR name);
+LPVOID MapViewOfFile(HANDLE mapping, DWORD desired_access, DWORD file_offset_high, DWORD file_offset_low, SIZE_T bytes_to_map);
+BOOL UnmapViewOfFile(LPCVOID base_address);
+BOOL FlushViewOfFile(LPCVOID base_address, SIZE_T bytes_to_flush);
+
+// registry (portable/win32_registry.cpp)
+LSTATUS RegOpenKeyW(HKEY key, LPCWSTR sub_key, PHKEY result);
+LSTATUS RegOpenKeyExW(HKEY key, LPCWSTR sub_key, DWORD options, REGSAM desired, PHKEY result);
+LSTATUS RegCreateKeyExW(HKEY key, LPCWSTR sub_key, DWORD reserved, LPWSTR class_name, DWORD options, REGSAM desired, LPSECURITY_ATTRIBUTES attributes, PHKEY result, LPDWORD disposition);
+LSTATUS RegCloseKey(HKEY key);
+LSTATUS RegDeleteKeyW(HKEY key, LPCWSTR sub_key);
+LSTATUS RegDeleteTreeW(HKEY key, LPCWSTR sub_key);
+LSTATUS RegEnumKeyExW(HKEY key, DWORD index, LPWSTR name, LPDWORD name_length, LPDWORD reserved, LPWSTR class_name, LPDWORD class_length, FILETIME* last_write_time);
+LSTATUS RegEnumValueW(HKEY key, DWORD index, LPWSTR value_name, LPDWORD value_name_length, LPDWORD reserved, LPDWORD type, LPBYTE data, LPDWORD data_size);
+LSTATUS RegQueryInfoKeyW(HKEY key, LPWSTR class_name, LPDWORD class_length, LPDWORD reserved, LPDWORD sub_keys, LPDWORD max_sub_key_length, LPDWORD max_class_length,
+                         LPDWORD values, LPDWORD max_value_name_length, LPDWORD max_value_length, LPDWORD security_descriptor, FILETIME* last_write_time);
+LSTATUS RegQueryValueExW(HKEY key, LPCWSTR value_name, LPDWORD reserved, LPDWORD type, LPBYTE data, LPDWORD data_size);
+LSTATUS RegQueryValueExA(HKEY key, LPCSTR value_name, LPDWORD reserved, LPDWORD type, LPBYTE data, LPDWORD data_size);
+LSTATUS RegSetValueExW(HKEY key, LPCWSTR value_name, DWORD reserved, DWORD type, const BYTE* data, DWORD data_size);
+LSTATUS RegDeleteValueW(HKEY key, LPCWSTR value_name);
+LSTATUS RegNotifyChangeKeyValue(HKEY key, BOOL watch_subtree, DWORD notify_filter, HANDLE event, BOOL asynchronous);
+
+static inline void MemoryBarrier() noexcept { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+#if defined(__x86_64__) || defined(__i386__)
+static inline void YieldProcessor() noexcept { __builtin_ia32_pause(); }
+#else
+static inline void YieldProcessor() noexcept {}
+#endif
+
+// CRT
+static inline int localtime_s(std::tm* result, const std::time_t* time) noexcept { return ::localtime_r(time, result) ? 0 : 1; }
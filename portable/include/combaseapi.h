@@ -0,0 +1,59 @@
+/// @file
+/// @brief  xtw portable backend: <combaseapi.h>
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+///
+/// IUnknown and the COM runtime functions used by xtw. There is no COM runtime: objects are in-process C++ objects,
+/// and __uuidof(T) yields a GUID unique to T within the process, since __declspec(uuid) is not available.
+
+#pragma once
+
+#include <Windows.h>
+
+typedef WCHAR OLECHAR;
+typedef OLECHAR* LPOLESTR;
+typedef const OLECHAR* LPCOLESTR;
+
+struct IUnknown
+{
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) = 0;
+    virtual ULONG STDMETHODCALLTYPE AddRef() = 0;
+    virtual ULONG STDMETHODCALLTYPE Release() = 0;
+};
+
+namespace xtw_portable
+{
+    template <class T>
+    static inline const GUID& uuid_of() noexcept
+    {
+        // derived from the address of this per-type object; stable within the process.
+        static const GUID id = []
+        {
+            GUID g{};
+            const auto address = reinterpret_cast<uintptr_t>(&id);
+            std::memcpy(g.Data4, &address, sizeof(address) < sizeof(g.Data4) ? sizeof(address) : sizeof(g.Data4));
+            g.Data1 = 0x78747770; // "xtwp"
+            return g;
+        }();
+        return id;
+    }
+}
+
+#define __uuidof(T) (::xtw_portable::uuid_of<T>())
+#define IID_PPV_ARGS(pp) __uuidof(**(pp)), reinterpret_cast<void**>(pp)
+
+typedef enum tagCOINIT
+{
+    COINIT_APARTMENTTHREADED = 0x2,
+    COINIT_MULTITHREADED = 0x0,
+    COINIT_DISABLE_OLE1DDE = 0x4,
+    COINIT_SPEED_OVER_MEMORY = 0x8,
+} COINIT;
+
+HRESULT CoInitializeEx(LPVOID reserved, DWORD co_init);
+void CoUninitialize();
+LPVOID CoTaskMemAlloc(SIZE_T size);
+void CoTaskMemFree(LPVOID pv);
+int StringFromGUID2(REFGUID guid, LPOLESTR buffer, int max);
+HRESULT IIDFromString(LPCOLESTR string, IID* iid);
+HRESULT CLSIDFromString(LPCOLESTR string, CLSID* clsid);
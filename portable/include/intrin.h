@@ -0,0 +1,12 @@
+/// @file
+/// @brief  xtw portable backend: <intrin.h>
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define _ReturnAddress() __builtin_return_address(0)
@@ -0,0 +1,11 @@
+/// @file
+/// @brief  xtw portable backend: <process.h>
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+/// Starts a thread; returns its handle (closed by CloseHandle), or 0 on failure with errno set.
+uintptr_t _beginthreadex(void* security, unsigned stack_size, unsigned (*start_address)(void*), void* arglist, unsigned initflag, unsigned* thrdaddr);
@@ -0,0 +1,1419 @@
+/// @file
+/// @brief  xtw portable backend: Win32 on POSIX
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+///
+/// Implements the functions declared in portable/include.
+/// Kernel objects (events, threads, files, file mappings, and completion ports) are reference-counted and share one lock; waiters sleep on one condition variable,
+/// which keeps WaitForMultipleObjects simple and exact at the cost of waking every waiter on each signal. Completion ports have their own.
+/// Files are file descriptors and mappings are mmap; share modes are not enforced, as POSIX has no mandatory locks.
+
+#include <Windows.h>
+#include <combaseapi.h>
+#include <DbgHelp.h>
+#include <process.h>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <xtw/utf.h>
+
+namespace
+{
+    thread_local DWORD last_error = ERROR_SUCCESS;
+
+    const HANDLE current_process_pseudo_handle = reinterpret_cast<HANDLE>(static_cast<LONG_PTR>(-1));
+    const HANDLE current_thread_pseudo_handle = reinterpret_cast<HANDLE>(static_cast<LONG_PTR>(-2));
+
+    // kernel objects
+
+    std::mutex kernel_mutex{};
+    std::condition_variable kernel_changed{};
+
+    struct kernel_object
+    {
+        enum struct kind { event, thread, file, mapping, port };
+
+        const kind type;
+        int references = 1; // guarded by kernel_mutex
+
+        explicit kernel_object(kind t) : type(t) {}
+        kernel_object(const kernel_object& other) = delete;
+        kernel_object(kernel_object&& other) noexcept = delete;
+        kernel_object& operator=(const kernel_object& other) = delete;
+        kernel_object& operator=(kernel_object&& other) noexcept = delete;
+        virtual ~kernel_object() = default;
+
+        // requires kernel_mutex
+        virtual bool signaled() const noexcept = 0;
+        virtual void acquire() noexcept {} // a satisfied wait consumes the signal of auto-reset objects.
+    };
+
+    struct event_object final : kernel_object
+    {
+        const bool manual_reset;
+        bool state; // guarded by kernel_mutex
+
+        event_object(bool manual, bool initial) : kernel_object(kind::event), manual_reset(manual), state(initial) {}
+        bool signaled() const noexcept override { return state; }
+        void acquire() noexcept override { if (!manual_reset) state = false; }
+    };
+
+    struct thread_object final : kernel_object
+    {
+        const DWORD id;
+        const pthread_t thread;
+        bool exited = false;  // guarded by kernel_mutex
+        DWORD exit_code = STILL_ACTIVE;
+
+        thread_object(DWORD thread_id, pthread_t t) : kernel_object(kind::thread), id(thread_id), thread(t) {}
+        bool signaled() const noexcept override { return exited; }
+    };
+
+    // requires kernel_mutex
+    void release(kernel_object* object) noexcept;
+
+    struct port_object final : kernel_object
+    {
+        std::deque<OVERLAPPED_ENTRY> packets{}; // guarded by kernel_mutex
+        std::condition_variable queued{};
+
+        port_object() : kernel_object(kind::port) {}
+        bool signaled() const noexcept override { return false; }
+    };
+
+    struct file_object final : kernel_object
+    {
+        const int fd;
+        const bool writable;
+        port_object* port{}; // guarded by kernel_mutex; set once by CreateIoCompletionPort, holding a reference.
+        ULONG_PTR completion_key{};
+
+        file_object(int f, bool w) : kernel_object(kind::file), fd(f), writable(w) {}
+        ~file_object() override
+        {
+            (void)::close(fd);
+            if (port) release(port); // destroyed under kernel_mutex
+        }
+        bool signaled() const noexcept override { return true; } // I/O is synchronous; nothing is ever pending.
+    };
+
+    struct mapping_object final : kernel_object
+    {
+        const int fd; // its own descriptor: the mapping outlives the file handle, as on Windows.
+        const uint64_t size;
+        const bool writable;
+        std::string shm_name{}; // of a named section this object created; the name is removed with it.
+
+        mapping_object(int f, uint64_t s, bool w) : kernel_object(kind::mapping), fd(f), size(s), writable(w) {}
+        ~mapping_object() override
+        {
+            (void)::close(fd);
+            if (!shm_name.empty()) (void)::shm_unlink(shm_name.c_str());
+        }
+        bool signaled() const noexcept override { return false; }
+    };
+
+    // requires kernel_mutex
+    void release(kernel_object* object) noexcept
+    {
+        if (--object->references == 0) delete object;
+    }
+
+    std::atomic<DWORD> next_thread_id{4};
+    std::unordered_map<DWORD, thread_object*> live_threads{}; // guarded by kernel_mutex; for OpenThread
+
+    // the calling thread's object. Threads not started by _beginthreadex (e.g. the main thread) are registered on first use.
+    struct current_thread_record
+    {
+        thread_object* object{};
+
+        current_thread_record() = default;
+        current_thread_record(const current_thread_record& other) = delete;
+        current_thread_record(current_thread_record&& other) noexcept = delete;
+        current_thread_record& operator=(const current_thread_record& other) = delete;
+        current_thread_record& operator=(current_thread_record&& other) noexcept = delete;
+
+        ~current_thread_record()
+        {
+            if (object) exit(0);
+        }
+
+        thread_object* get()
+        {
+            if (!object)
+            {
+                auto t = new thread_object(next_thread_id.fetch_add(4), ::pthread_self());
+                std::lock_guard lock(kernel_mutex);
+                live_threads.emplace(t->id, t);
+                object = t;
+            }
+            return object;
+        }
+
+        void exit(DWORD code) noexcept
+        {
+            std::lock_guard lock(kernel_mutex);
+            object->exited = true;
+            object->exit_code = code;
+            live_threads.erase(object->id);
+            release(std::exchange(object, nullptr));
+            kernel_changed.notify_all();
+        }
+    };
+
+    thread_local current_thread_record current_thread{};
+
+    kernel_object* object_of(HANDLE handle) noexcept
+    {
+        if (handle == current_thread_pseudo_handle) return current_thread.get();
+        if (!handle || handle == INVALID_HANDLE_VALUE || handle == current_process_pseudo_handle) return nullptr;
+        return static_cast<kernel_object*>(handle);
+    }
+
+    thread_object* thread_of(HANDLE handle) noexcept
+    {
+        kernel_object* object = object_of(handle);
+        return object && object->type == kernel_object::kind::thread ? static_cast<thread_object*>(object) : nullptr;
+    }
+
+    template <class OBJECT, kernel_object::kind KIND>
+    OBJECT* object_of_kind(HANDLE handle) noexcept
+    {
+        kernel_object* object = object_of(handle);
+        return object && object->type == KIND ? static_cast<OBJECT*>(object) : nullptr;
+    }
+
+    file_object* file_of(HANDLE handle) noexcept { return object_of_kind<file_object, kernel_object::kind::file>(handle); }
+    mapping_object* mapping_of(HANDLE handle) noexcept { return object_of_kind<mapping_object, kernel_object::kind::mapping>(handle); }
+    port_object* port_of(HANDLE handle) noexcept { return object_of_kind<port_object, kernel_object::kind::port>(handle); }
+
+    DWORD fail(DWORD error, DWORD result = 0) noexcept
+    {
+        last_error = error;
+        return result;
+    }
+
+    DWORD error_of(int error) noexcept
+    {
+        switch (error)
+        {
+        case ENOENT: return ERROR_FILE_NOT_FOUND;
+        case ENOTDIR: return ERROR_PATH_NOT_FOUND;
+        case EACCES: case EPERM: case EROFS: case EISDIR: return ERROR_ACCESS_DENIED;
+        case EEXIST: return ERROR_FILE_EXISTS;
+        case EBADF: return ERROR_INVALID_HANDLE;
+        case ENOMEM: return ERROR_NOT_ENOUGH_MEMORY;
+        case ENOSPC: return ERROR_HANDLE_DISK_FULL;
+        case EINVAL: return ERROR_INVALID_PARAMETER;
+        default: return ERROR_INVALID_FUNCTION;
+        }
+    }
+
+    // named kernel object namespace to a POSIX shared memory name: "Local\\name" and "Global\\name" become "/xtw-name".
+    bool shm_name_of(LPCWSTR name, std::string& result) noexcept
+    {
+        std::u16string_view n(reinterpret_cast<const char16_t*>(name));
+        for (std::u16string_view prefix : {u"Local\\", u"Global\\"})
+            if (n.substr(0, prefix.size()) == prefix) n.remove_prefix(prefix.size());
+        if (n.empty()) return false;
+
+        const auto length = xtw::utf::utf8_length(n);
+        if (!length) return false;
+        try
+        {
+            result.assign("/xtw-");
+            result.resize(5 + *length);
+            (void)xtw::utf::utf16_to_utf8(n, result.data() + 5, *length);
+        }
+        catch (...) { return false; }
+        std::replace(result.begin() + 1, result.end(), '/', '_');
+        return true;
+    }
+
+    // UTF-16 path to the file system's UTF-8.
+    bool narrow_path(LPCWSTR path, std::string& result) noexcept
+    {
+        if (!path) return false;
+        const auto length = xtw::utf::utf8_length(std::wstring_view(path));
+        if (!length) return false;
+        try { result.resize(*length); }
+        catch (...) { return false; }
+        return xtw::utf::utf16_to_utf8(std::wstring_view(path), result.data(), result.size()) == length;
+    }
+
+    // address waits: waiters and wakers meet on a bucket chosen by address.
+    struct address_bucket
+    {
+        std::mutex mutex{};
+        std::condition_variable changed{};
+    };
+
+    address_bucket& bucket_of(const volatile void* address) noexcept
+    {
+        static address_bucket buckets[64]{};
+        return buckets[(reinterpret_cast<uintptr_t>(address) >> 4) % std::size(buckets)];
+    }
+
+    // virtual memory: reservations, for MEM_RELEASE with size 0.
+    std::mutex reservations_mutex{};
+    std::map<uintptr_t, size_t> reservations{};
+
+    // mapped views, for UnmapViewOfFile and FlushViewOfFile. Also guarded by reservations_mutex.
+    std::map<uintptr_t, size_t> views{};
+
+    size_t page_size() noexcept
+    {
+        static const size_t size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        return size;
+    }
+
+    // messages of FormatMessageA
+    const char* message_of(DWORD code) noexcept
+    {
+        static const std::pair<DWORD, const char*> messages[] = {
+            {ERROR_SUCCESS, "The operation completed successfully."},
+            {ERROR_INVALID_FUNCTION, "Incorrect function."},
+            {ERROR_FILE_NOT_FOUND, "The system cannot find the file specified."},
+            {ERROR_PATH_NOT_FOUND, "The system cannot find the path specified."},
+            {ERROR_ACCESS_DENIED, "Access is denied."},
+            {ERROR_INVALID_HANDLE, "The handle is invalid."},
+            {ERROR_NOT_ENOUGH_MEMORY, "Not enough memory resources are available to process this command."},
+            {ERROR_INVALID_DATA, "The data is invalid."},
+            {ERROR_OUTOFMEMORY, "Not enough memory resources are available to complete this operation."},
+            {ERROR_HANDLE_EOF, "Reached the end of the file."},
+            {ERROR_HANDLE_DISK_FULL, "The disk is full."},
+            {ERROR_NOT_SUPPORTED, "The request is not supported."},
+            {ERROR_FILE_EXISTS, "The file exists."},
+            {ERROR_INVALID_PARAMETER, "The parameter is incorrect."},
+            {ERROR_CALL_NOT_IMPLEMENTED, "This function is not supported on this system."},
+            {ERROR_INSUFFICIENT_BUFFER, "The data area passed to a system call is too small."},
+            {ERROR_ALREADY_EXISTS, "Cannot create a file when that file already exists."},
+            {ERROR_KEY_DELETED, "Illegal operation attempted on a registry key that has been marked for deletion."},
+            {ERROR_INVALID_WINDOW_HANDLE, "Invalid window handle."},
+            {static_cast<DWORD>(E_NOTIMPL), "Not implemented"},
+            {static_cast<DWORD>(E_NOINTERFACE), "No such interface supported"},
+            {static_cast<DWORD>(E_POINTER), "Invalid pointer"},
+            {static_cast<DWORD>(E_FAIL), "Unspecified error"},
+        };
+
+        if ((code & 0xFFFF0000) == 0x80070000) code &= 0xFFFF; // HRESULT_FROM_WIN32
+        for (auto& [c, m] : messages)
+            if (c == code)
+                return m;
+        return nullptr;
+    }
+}
+
+// errors
+
+DWORD GetLastError() { return last_error; }
+void SetLastError(DWORD error) { last_error = error; }
+
+// kernel objects
+
+BOOL CloseHandle(HANDLE handle)
+{
+    if (handle == current_thread_pseudo_handle || handle == current_process_pseudo_handle) return TRUE;
+    kernel_object* object = object_of(handle);
+    if (!object) return fail(ERROR_INVALID_HANDLE, FALSE);
+
+    std::lock_guard lock(kernel_mutex);
+    release(object);
+    return TRUE;
+}
+
+BOOL DuplicateHandle(HANDLE source_process, HANDLE source, HANDLE target_process, HANDLE* target, DWORD, BOOL, DWORD options)
+{
+    if (source_process != current_process_pseudo_handle || target_process != current_process_pseudo_handle || !target || !(options & DUPLICATE_SAME_ACCESS))
+        return fail(ERROR_NOT_SUPPORTED, FALSE);
+
+    kernel_object* object = object_of(source);
+    if (!object) return fail(ERROR_INVALID_HANDLE, FALSE);
+
+    std::lock_guard lock(kernel_mutex);
+    object->references++;
+    *target = object;
+    return TRUE;
+}
+
+HANDLE CreateEventW(LPSECURITY_ATTRIBUTES, BOOL manual_reset, BOOL initial_state, LPCWSTR name)
+{
+    if (name) return fail(ERROR_NOT_SUPPORTED), nullptr; // named objects are not shared between processes here.
+    return new (std::nothrow) event_object(manual_reset, initial_state);
+}
+
+BOOL SetEvent(HANDLE event)
+{
+    kernel_object* object = object_of(event);
+    if (!object || object->type != kernel_object::kind::event) return fail(ERROR_INVALID_HANDLE, FALSE);
+
+    std::lock_guard lock(kernel_mutex);
+    static_cast<event_object*>(object)->state = true;
+    kernel_changed.notify_all();
+    return TRUE;
+}
+
+BOOL ResetEvent(HANDLE event)
+{
+    kernel_object* object = object_of(event);
+    if (!object || object->type != kernel_object::kind::event) return fail(ERROR_INVALID_HANDLE, FALSE);
+
+    std::lock_guard lock(kernel_mutex);
+    static_cast<event_object*>(object)->state = false;
+    return TRUE;
+}
+
+DWORD WaitForMultipleObjects(DWORD count, const HANDLE* handles, BOOL wait_all, DWORD milliseconds)
+{
+    if (count == 0 || count > MAXIMUM_WAIT_OBJECTS || !handles) return fail(ERROR_INVALID_PARAMETER, WAIT_FAILED);
+
+    kernel_object* objects[MAXIMUM_WAIT_OBJECTS]{};
+    for (DWORD i = 0; i < count; i++)
+        if (!(objects[i] = object_of(handles[i])))
+            return fail(ERROR_INVALID_HANDLE, WAIT_FAILED);
+
+    // requires kernel_mutex
+    const auto try_acquire = [&]() -> DWORD
+    {
+        if (wait_all)
+        {
+            if (!std::all_of(objects, objects + count, [](kernel_object* o) { return o->signaled(); })) return WAIT_TIMEOUT;
+            for (DWORD i = 0; i < count; i++) objects[i]->acquire();
+            return WAIT_OBJECT_0;
+        }
+
+        for (DWORD i = 0; i < count; i++)
+        {
+            if (objects[i]->signaled())
+            {
+                objects[i]->acquire();
+                return WAIT_OBJECT_0 + i;
+            }
+        }
+        return WAIT_TIMEOUT;
+    };
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds);
+    std::unique_lock lock(kernel_mutex);
+    while (true)
+    {
+        if (const DWORD result = try_acquire(); result != WAIT_TIMEOUT || milliseconds == 0) return result;
+
+        if (milliseconds == INFINITE)
+            kernel_changed.wait(lock);
+        else if (kernel_changed.wait_until(lock, deadline) == std::cv_status::timeout)
+            return try_acquire();
+    }
+}
+
+DWORD WaitForSingleObject(HANDLE handle, DWORD milliseconds)
+{
+    return WaitForMultipleObjects(1, &handle, FALSE, milliseconds);
+}
+
+DWORD WaitForSingleObjectEx(HANDLE handle, DWORD milliseconds, BOOL)
+{
+    return WaitForMultipleObjects(1, &handle, FALSE, milliseconds);
+}
+
+// address waits
+
+BOOL WaitOnAddress(volatile void* address, PVOID compare_address, SIZE_T address_size, DWORD milliseconds)
+{
+    if (address_size != 1 && address_size != 2 && address_size != 4 && address_size != 8) return fail(ERROR_INVALID_PARAMETER, FALSE);
+
+    auto& bucket = bucket_of(address);
+    std::unique_lock lock(bucket.mutex);
+    if (std::memcmp(const_cast<const void*>(address), compare_address, address_size) != 0) return TRUE;
+
+    if (milliseconds == INFINITE)
+        bucket.changed.wait(lock);
+    else if (bucket.changed.wait_for(lock, std::chrono::milliseconds(milliseconds)) == std::cv_status::timeout)
+        return fail(1460 /* ERROR_TIMEOUT */, FALSE);
+
+    return TRUE; // may be spurious, as on Windows.
+}
+
+void WakeByAddressSingle(PVOID address)
+{
+    auto& bucket = bucket_of(address);
+    std::lock_guard lock(bucket.mutex);
+    bucket.changed.notify_all(); // the bucket is shared by addresses; waking one waiter might wake the wrong one.
+}
+
+void WakeByAddressAll(PVOID address)
+{
+    auto& bucket = bucket_of(address);
+    std::lock_guard lock(bucket.mutex);
+    bucket.changed.notify_all();
+}
+
+// threads
+
+uintptr_t _beginthreadex(void*, unsigned, unsigned (*start_address)(void*), void* arglist, unsigned initflag, unsigned* thrdaddr)
+{
+    if (initflag != 0) return errno = EINVAL, 0; // CREATE_SUSPENDED is not supported.
+
+    struct start_context
+    {
+        unsigned (*start_address)(void*);
+        void* arglist;
+        thread_object* object;
+        std::mutex mutex{};
+        std::condition_variable ready{};
+        bool started = false;
+    } context{start_address, arglist, nullptr};
+
+    // the stack size is left to the system default: Windows commits it on demand within a larger reservation,
+    // which is what POSIX thread stacks do anyway.
+    pthread_t thread{};
+    const int error = ::pthread_create(&thread, nullptr, [](void* p) -> void*
+    {
+        auto& context = *static_cast<start_context*>(p);
+        const auto start_address = context.start_address;
+        void* const arglist = context.arglist;
+
+        thread_object* object = current_thread.get();
+        {
+            std::lock_guard lock(kernel_mutex);
+            object->references++; // for the creator's handle
+        }
+        {
+            std::lock_guard lock(context.mutex);
+            context.object = object;
+            context.started = true;
+            context.ready.notify_one();
+        }
+
+        current_thread.exit(start_address(arglist));
+        return nullptr;
+    }, &context);
+
+    if (error) return errno = error, 0;
+    (void)::pthread_detach(thread);
+
+    std::unique_lock lock(context.mutex);
+    context.ready.wait(lock, [&] { return context.started; });
+    if (thrdaddr) *thrdaddr = context.object->id;
+    return reinterpret_cast<uintptr_t>(static_cast<kernel_object*>(context.object));
+}
+
+HANDLE GetCurrentProcess() { return current_process_pseudo_handle; }
+HANDLE GetCurrentThread() { return current_thread_pseudo_handle; }
+DWORD GetCurrentProcessId() { return static_cast<DWORD>(::getpid()); }
+DWORD GetCurrentThreadId() { return current_thread.get()->id; }
+
+HANDLE OpenThread(DWORD, BOOL, DWORD thread_id)
+{
+    std::lock_guard lock(kernel_mutex);
+    auto it = live_threads.find(thread_id);
+    if (it == live_threads.end()) return fail(ERROR_INVALID_PARAMETER), nullptr;
+    it->second->references++;
+    return static_cast<kernel_object*>(it->second);
+}
+
+BOOL SetThreadPriority(HANDLE thread, int)
+{
+    // priorities of normal POSIX threads cannot be raised without privileges; accepted and ignored.
+    return thread_of(thread) ? TRUE : fail(ERROR_INVALID_HANDLE, FALSE);
+}
+
+HRESULT SetThreadDescription(HANDLE thread, PCWSTR description)
+{
+    thread_object* t = thread_of(thread);
+    if (!t) return HRESULT_FROM_WIN32(ERROR_INVALID_HANDLE);
+    if (!description) return S_OK;
+
+    std::string name = xtw::utf::to_utf8(description);
+    if (name.size() > 15) name.resize(15); // limit of pthread_setname_np, including the terminator
+    (void)::pthread_setname_np(t->thread, name.c_str());
+    return S_OK;
+}
+
+BOOL GetThreadTimes(HANDLE thread, FILETIME* creation, FILETIME* exit, FILETIME* kernel, FILETIME* user)
+{
+    thread_object* t = thread_of(thread);
+    if (!t || !creation || !exit || !kernel || !user) return fail(ERROR_INVALID_HANDLE, FALSE);
+
+    // only the CPU time is available; it is reported as user time.
+    clockid_t clock{};
+    timespec ts{};
+    {
+        std::lock_guard lock(kernel_mutex);
+        if (t->exited || ::pthread_getcpuclockid(t->thread, &clock) != 0) return fail(ERROR_INVALID_HANDLE, FALSE);
+    }
+    if (::clock_gettime(clock, &ts) != 0) return fail(ERROR_INVALID_HANDLE, FALSE);
+
+    const auto ticks = static_cast<ULONGLONG>(ts.tv_sec) * 10000000 + static_cast<ULONGLONG>(ts.tv_nsec) / 100; // 100ns
+    *creation = *exit = *kernel = FILETIME{};
+    *user = FILETIME{static_cast<DWORD>(ticks), static_cast<DWORD>(ticks >> 32)};
+    return TRUE;
+}
+
+BOOL GetExitCodeThread(HANDLE thread, LPDWORD exit_code)
+{
+    thread_object* t = thread_of(thread);
+    if (!t || !exit_code) return fail(ERROR_INVALID_HANDLE, FALSE);
+
+    std::lock_guard lock(kernel_mutex);
+    *exit_code = t->exit_code;
+    return TRUE;
+}
+
+BOOL QueryThreadCycleTime(HANDLE, ULONG64*)
+{
+    return fail(ERROR_NOT_SUPPORTED, FALSE);
+}
+
+void Sleep(DWORD milliseconds)
+{
+    if (milliseconds == 0) (void)::sched_yield();
+    else
+    {
+        // sleeps the whole time even when signals (e.g. a sampling profiler's) interrupt it.
+        timespec remaining{static_cast<time_t>(milliseconds / 1000), static_cast<long>(milliseconds % 1000) * 1000000};
+        while (::nanosleep(&remaining, &remaining) != 0 && errno == EINTR) {}
+    }
+}
+
+BOOL SwitchToThread()
+{
+    return ::sched_yield() == 0;
+}
+
+// time
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER* count)
+{
+    timespec ts{};
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    count->QuadPart = static_cast<LONGLONG>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* frequency)
+{
+    frequency->QuadPart = 1000000000;
+    return TRUE;
+}
+
+ULONGLONG GetTickCount64()
+{
+    timespec ts{};
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<ULONGLONG>(ts.tv_sec) * 1000 + static_cast<ULONGLONG>(ts.tv_nsec) / 1000000;
+}
+
+DWORD GetTickCount()
+{
+    return static_cast<DWORD>(GetTickCount64());
+}
+
+// memory
+
+void GetSystemInfo(SYSTEM_INFO* info)
+{
+    *info = SYSTEM_INFO{};
+    info->dwPageSize = static_cast<DWORD>(page_size());
+    info->dwAllocationGranularity = static_cast<DWORD>(page_size()); // mmap aligns reservations to pages only.
+    info->dwNumberOfProcessors = static_cast<DWORD>(std::max(1L, ::sysconf(_SC_NPROCESSORS_ONLN)));
+}
+
+BOOL GetLogicalProcessorInformation(SYSTEM_LOGICAL_PROCESSOR_INFORMATION* buffer, DWORD* returned_length)
+{
+    if (!returned_length) return fail(ERROR_INVALID_PARAMETER, FALSE);
+
+    // the caches of the first processor, from sysfs; cores, packages and NUMA nodes are not reported.
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info{};
+    for (int index = 0;; index++)
+    {
+        const std::string directory = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+        const auto read = [&directory](const char* name) -> std::string
+        {
+            std::string text{};
+            if (FILE* f = std::fopen((directory + name).c_str(), "r"))
+            {
+                char line[64]{};
+                if (std::fgets(line, sizeof(line), f)) text = line;
+                std::fclose(f);
+            }
+            while (!text.empty() && (text.back() == '\n' || text.back() == ' ')) text.pop_back();
+            return text;
+        };
+
+        const std::string level = read("level");
+        if (level.empty()) break;
+
+        const std::string type = read("type");
+        const std::string size = read("size"); // "48K"
+        char* unit{};
+        unsigned long long bytes = std::strtoull(size.c_str(), &unit, 10);
+        if (*unit == 'K') bytes <<= 10;
+        else if (*unit == 'M') bytes <<= 20;
+
+        auto& i = info.emplace_back();
+        i.ProcessorMask = 1;
+        i.Relationship = RelationCache;
+        i.Cache.Level = static_cast<BYTE>(std::atoi(level.c_str()));
+        i.Cache.Associativity = static_cast<BYTE>(std::atoi(read("ways_of_associativity").c_str()));
+        i.Cache.LineSize = static_cast<WORD>(std::atoi(read("coherency_line_size").c_str()));
+        i.Cache.Size = static_cast<DWORD>(bytes);
+        i.Cache.Type = type == "Data" ? CacheData : type == "Instruction" ? CacheInstruction : CacheUnified;
+    }
+
+    const DWORD required = static_cast<DWORD>(info.size() * sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+    const DWORD capacity = *returned_length;
+    *returned_length = required;
+    if (!buffer || capacity < required) return fail(ERROR_INSUFFICIENT_BUFFER, FALSE);
+    std::copy(info.begin(), info.end(), buffer);
+    return TRUE;
+}
+
+SIZE_T GetLargePageMinimum()
+{
+    // the default huge page size; allocations also need pages reserved in vm.nr_hugepages, as Windows needs SeLockMemoryPrivilege.
+    static const SIZE_T size = []
+    {
+        SIZE_T kb = 0;
+        if (FILE* f = std::fopen("/proc/meminfo", "r"))
+        {
+            char line[128]{};
+            while (std::fgets(line, sizeof(line), f))
+                if (std::sscanf(line, "Hugepagesize: %zu kB", &kb) == 1) break;
+            std::fclose(f);
+        }
+        return kb * 1024;
+    }();
+    return size;
+}
+
+LPVOID VirtualAlloc(LPVOID address, SIZE_T size, DWORD allocation_type, DWORD protect)
+{
+    if (size == 0 || (allocation_type & MEM_LARGE_PAGES) || !(allocation_type & (MEM_RESERVE | MEM_COMMIT)))
+        return fail(ERROR_INVALID_PARAMETER), nullptr;
+
+    const int protection = protect == PAGE_READWRITE ? PROT_READ | PROT_WRITE : protect == PAGE_READONLY ? PROT_READ : PROT_NONE;
+    if (allocation_type & MEM_RESERVE)
+    {
+        if (address) return fail(ERROR_NOT_SUPPORTED), nullptr;
+        size = (size + page_size() - 1) / page_size() * page_size();
+        void* p = ::mmap(nullptr, size, allocation_type & MEM_COMMIT ? protection : PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) return fail(ERROR_NOT_ENOUGH_MEMORY), nullptr;
+
+        std::lock_guard lock(reservations_mutex);
+        reservations.emplace(reinterpret_cast<uintptr_t>(p), size);
+        return p;
+    }
+
+    // commit within a reservation
+    const auto first = reinterpret_cast<uintptr_t>(address) / page_size() * page_size();
+    const auto last = (reinterpret_cast<uintptr_t>(address) + size + page_size() - 1) / page_size() * page_size();
+    if (!address || ::mprotect(reinterpret_cast<void*>(first), last - first, protection) != 0) return fail(ERROR_INVALID_ADDRESS), nullptr;
+    return address;
+}
+
+BOOL VirtualFree(LPVOID address, SIZE_T size, DWORD free_type)
+{
+    if (!address) return fail(ERROR_INVALID_PARAMETER, FALSE);
+
+    if (free_type == MEM_RELEASE)
+    {
+        if (size != 0) return fail(ERROR_INVALID_PARAMETER, FALSE);
+        std::lock_guard lock(reservations_mutex);
+        auto it = reservations.find(reinterpret_cast<uintptr_t>(address));
+        if (it == reservations.end()) return fail(ERROR_INVALID_ADDRESS, FALSE);
+        (void)::munmap(address, it->second);
+        reservations.erase(it);
+        return TRUE;
+    }
+
+    if (free_type == MEM_DECOMMIT)
+    {
+        const auto first = reinterpret_cast<uintptr_t>(address) / page_size() * page_size();
+        const auto last = (reinterpret_cast<uintptr_t>(address) + size + page_size() - 1) / page_size() * page_size();
+        if (first == last) return TRUE;
+        // returns the pages to the system; they read as zero when committed again, as on Windows.
+        if (::madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED) != 0 ||
+            ::mprotect(reinterpret_cast<void*>(first), last - first, PROT_NONE) != 0)
+            return fail(ERROR_INVALID_ADDRESS, FALSE);
+        return TRUE;
+    }
+
+    return fail(ERROR_INVALID_PARAMETER, FALSE);
+}
+
+BOOL VirtualLock(LPVOID address, SIZE_T size)
+{
+    // limited by RLIMIT_MEMLOCK, as Windows limits it by the working set quota.
+    return ::mlock(address, size) == 0 ? TRUE : fail(errno == ENOMEM || errno == EPERM ? 1453 /* ERROR_WORKING_SET_QUOTA */ : error_of(errno), FALSE);
+}
+
+SIZE_T VirtualQuery(LPCVOID address, PMEMORY_BASIC_INFORMATION buffer, SIZE_T length)
+{
+    if (!buffer || length < sizeof(MEMORY_BASIC_INFORMATION)) return fail(ERROR_INSUFFICIENT_BUFFER);
+
+    // only the regions this backend created: reservations and mapped views, each reported as one committed region.
+    const auto a = reinterpret_cast<uintptr_t>(address);
+    std::lock_guard lock(reservations_mutex);
+    for (auto* regions : {&reservations, &views})
+    {
+        auto it = regions->upper_bound(a);
+        if (it == regions->begin()) continue;
+        --it;
+        if (a >= it->first + it->second) continue;
+
+        const uintptr_t page = a / page_size() * page_size();
+        *buffer = MEMORY_BASIC_INFORMATION{};
+        buffer->BaseAddress = reinterpret_cast<PVOID>(page);
+        buffer->AllocationBase = reinterpret_cast<PVOID>(it->first);
+        buffer->RegionSize = it->first + it->second - page;
+        buffer->State = MEM_COMMIT;
+        buffer->Protect = PAGE_READWRITE;
+        buffer->AllocationProtect = PAGE_READWRITE;
+        buffer->Type = regions == &views ? MEM_MAPPED : MEM_PRIVATE;
+        return sizeof(MEMORY_BASIC_INFORMATION);
+    }
+    return fail(ERROR_INVALID_PARAMETER);
+}
+
+HLOCAL LocalFree(HLOCAL memory)
+{
+    std::free(memory);
+    return nullptr;
+}
+
+// files
+
+HANDLE CreateFileW(LPCWSTR file_name, DWORD desired_access, DWORD, LPSECURITY_ATTRIBUTES, DWORD creation_disposition, DWORD, HANDLE)
+{
+    std::string path{};
+    if (!narrow_path(file_name, path)) return fail(ERROR_INVALID_PARAMETER), INVALID_HANDLE_VALUE;
+
+    const bool writable = desired_access & GENERIC_WRITE;
+    int flags = O_CLOEXEC | (writable ? (desired_access & GENERIC_READ ? O_RDWR : O_WRONLY) : O_RDONLY);
+    switch (creation_disposition)
+    {
+    case CREATE_NEW: flags |= O_CREAT | O_EXCL; break;
+    case CREATE_ALWAYS: flags |= O_CREAT | O_TRUNC; break;
+    case OPEN_EXISTING: break;
+    case OPEN_ALWAYS: flags |= O_CREAT; break;
+    case TRUNCATE_EXISTING: flags |= O_TRUNC; break;
+    default: return fail(ERROR_INVALID_PARAMETER), INVALID_HANDLE_VALUE;
+    }
+
+    // CREATE_ALWAYS and OPEN_ALWAYS report whether the file existed.
+    const bool existed = (flags & O_CREAT) && !(flags & O_EXCL) && ::access(path.c_str(), F_OK) == 0;
+
+    const int fd = ::open(path.c_str(), flags, 0666);
+    if (fd < 0) return fail(error_of(errno)), INVALID_HANDLE_VALUE;
+
+    struct stat st{};
+    if (::fstat(fd, &st) == 0 && S_ISDIR(st.st_mode))
+    {
+        (void)::close(fd);
+        return fail(ERROR_ACCESS_DENIED), INVALID_HANDLE_VALUE;
+    }
+
+    auto object = new (std::nothrow) file_object(fd, writable);
+    if (!object)
+    {
+        (void)::close(fd);
+        return fail(ERROR_NOT_ENOUGH_MEMORY), INVALID_HANDLE_VALUE;
+    }
+    last_error = existed ? ERROR_ALREADY_EXISTS : ERROR_SUCCESS;
+    return object;
+}
+
+namespace
+{
+    // an overlapped request has completed: signals its event, and queues a packet if the file is associated with a port
+    // (unless the low bit of hEvent is set, as on Windows).
+    void complete(file_object* f, LPOVERLAPPED overlapped, DWORD error, DWORD bytes)
+    {
+        overlapped->Internal = error;
+        overlapped->InternalHigh = bytes;
+
+        const auto event = reinterpret_cast<ULONG_PTR>(overlapped->hEvent);
+        if (event & ~ULONG_PTR{1}) (void)SetEvent(reinterpret_cast<HANDLE>(event & ~ULONG_PTR{1}));
+
+        std::lock_guard lock(kernel_mutex);
+        if (f->port && !(event & 1))
+        {
+            f->port->packets.push_back(OVERLAPPED_ENTRY{f->completion_key, overlapped, error, bytes});
+            f->port->queued.notify_one();
+        }
+    }
+}
+
+BOOL ReadFile(HANDLE file, LPVOID buffer, DWORD bytes_to_read, LPDWORD bytes_read, LPOVERLAPPED overlapped)
+{
+    file_object* f = file_of(file);
+    if (!f) return fail(ERROR_INVALID_HANDLE, FALSE);
+
+    // an OVERLAPPED gives the position; the read completes before returning, as on a handle opened without FILE_FLAG_OVERLAPPED.
+    const ssize_t n = overlapped
+                          ? ::pread(f->fd, buffer, bytes_to_read, static_cast<off_t>(static_cast<uint64_t>(overlapped->OffsetHigh) << 32 | overlapped->Offset))
+                          : ::read(f->fd, buffer, bytes_to_read);
+    if (n < 0) return fail(error_of(errno), FALSE);
+    if (bytes_read) *bytes_read = static_cast<DWORD>(n);
+    if (overlapped)
+    {
+        if (n == 0 && bytes_to_read != 0) return fail(ERROR_HANDLE_EOF, FALSE); // fails to issue; nothing is queued.
+        complete(f, overlapped, ERROR_SUCCESS, static_cast<DWORD>(n));
+    }
+    return TRUE;
+}
+
+BOOL WriteFile(HANDLE file, LPCVOID buffer, DWORD bytes_to_write, LPDWORD bytes_written, LPOVERLAPPED overlapped)
+{
+    file_object* f = file_of(file);
+    if (!f) return fail(ERROR_INVALID_HANDLE, FALSE);
+    if (!f->writable) return fail(ERROR_ACCESS_DENIED, FALSE);
+
+    const ssize_t n = overlapped
+                          ? ::pwrite(f->fd, buffer, bytes_to_write, static_cast<off_t>(static_cast<uint64_t>(overlapped->OffsetHigh) << 32 | overlapped->Offset))
+                          : ::write(f->fd, buffer, bytes_to_write);
+    if (n < 0) return fail(error_of(errno), FALSE);
+    if (bytes_written) *bytes_written = static_cast<DWORD>(n);
+    if (overlapped) complete(f, overlapped, ERROR_SUCCESS, static_cast<DWORD>(n));
+    return TRUE;
+}
+
+BOOL GetOverlappedResult(HANDLE file, LPOVERLAPPED overlapped, LPDWORD bytes_transferred, BOOL)
+{
+    if (!file_of(file) || !overlapped || !bytes_transferred) return fail(ERROR_INVALID_PARAMETER, FALSE);
+    *bytes_transferred = static_cast<DWORD>(overlapped->InternalHigh); // requests complete before ReadFile/WriteFile return.
+    return overlapped->Internal == ERROR_SUCCESS ? TRUE : fail(static_cast<DWORD>(overlapped->Internal), FALSE);
+}
+
+BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER* size)
+{
+    file_object* f = file_of(file);
+    if (!f || !size) return fail(ERROR_INVALID_HANDLE, FALSE);
+
+    struct stat st{};
+    if (::fstat(f->fd, &st) != 0) return fail(error_of(errno), FALSE);
+    size->QuadPart = static_cast<LONGLONG>(st.st_size);
+    return TRUE;
+}
+
+BOOL DeleteFileW(LPCWSTR file_name)
+{
+    std::string path{};
+    if (!narrow_path(file_name, path)) return fail(ERROR_INVALID_PARAMETER, FALSE);
+    return ::unlink(path.c_str()) == 0 ? TRUE : fail(error_of(errno), FALSE);
+}
+
+DWORD GetTempPathW(DWORD buffer_length, LPWSTR buffer)
+{
+    const char* dir = std::getenv("TMPDIR");
+    std::string path = dir && *dir ? dir : "/tmp";
+    if (path.back() != '/') path += '/';
+
+    const std::u16string wide = xtw::utf::to_u16string(path);
+    if (buffer_length <= wide.size()) return static_cast<DWORD>(wide.size() + 1); // required, including the terminator
+    std::copy(wide.begin(), wide.end(), buffer);
+    buffer[wide.size()] = L'\0';
+    return static_cast<DWORD>(wide.size());
+}
+
+// I/O completion ports: overlapped requests complete within ReadFile/WriteFile, like cached reads on Windows, and queue their packets.
+
+HANDLE CreateIoCompletionPort(HANDLE file, HANDLE existing_port, ULONG_PTR completion_key, DWORD)
+{
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        if (existing_port) return fail(ERROR_INVALID_PARAMETER), nullptr;
+        auto port = new (std::nothrow) port_object();
+        return port ? port : (fail(ERROR_NOT_ENOUGH_MEMORY), nullptr);
+    }
+
+    file_object* f = file_of(file);
+    port_object* port = port_of(existing_port);
+    if (!f || (existing_port && !port)) return fail(ERROR_INVALID_HANDLE), nullptr;
+    if (!port) return fail(ERROR_NOT_SUPPORTED), nullptr; // creating a port and associating at once
+
+    std::lock_guard lock(kernel_mutex);
+    if (f->port) return fail(ERROR_INVALID_PARAMETER), nullptr; // a handle is associated once.
+    port->references++;
+    f->port = port;
+    f->completion_key = completion_key;
+    return port;
+}
+
+BOOL PostQueuedCompletionStatus(HANDLE port, DWORD bytes_transferred, ULONG_PTR completion_key, LPOVERLAPPED overlapped)
+{
+    port_object* p = port_of(port);
+    if (!p) return fail(ERROR_INVALID_HANDLE, FALSE);
+
+    std::lock_guard lock(kernel_mutex);
+    p->packets.push_back(OVERLAPPED_ENTRY{completion_key, overlapped, 0, bytes_transferred});
+    p->queued.notify_one();
+    return TRUE;
+}
+
+BOOL GetQueuedCompletionStatusEx(HANDLE port, LPOVERLAPPED_ENTRY entries, ULONG count, PULONG removed, DWORD milliseconds, BOOL)
+{
+    port_object* p = port_of(port);
+    if (!p) return fail(ERROR_INVALID_HANDLE, FALSE);
+    if (!entries || count == 0 || !removed) return fail(ERROR_INVALID_PARAMETER, FALSE);
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds);
+    std::unique_lock lock(kernel_mutex);
+    while (p->packets.empty())
+    {
+        if (milliseconds == 0) return fail(WAIT_TIMEOUT, FALSE);
+        if (milliseconds == INFINITE)
+            p->queued.wait(lock);
+        else if (p->queued.wait_until(lock, deadline) == std::cv_status::timeout && p->packets.empty())
+            return fail(WAIT_TIMEOUT, FALSE);
+    }
+
+    ULONG n = 0;
+    while (n < count && !p->packets.empty())
+    {
+        entries[n++] = p->packets.front();
+        p->packets.pop_front();
+    }
+    if (!p->packets.empty()) p->queued.notify_one(); // packets left for another waiter
+    *removed = n;
+    return TRUE;
+}
+
+// file mappings
+
+HANDLE CreateFileMappingW(HANDLE file, LPSECURITY_ATTRIBUTES, DWORD protect, DWORD maximum_size_high, DWORD maximum_size_low, LPCWSTR name)
+{
+    const bool writable = (protect & 0xFF) == PAGE_READWRITE;
+    if (!writable && (protect & 0xFF) != PAGE_READONLY) return fail(ERROR_INVALID_PARAMETER), nullptr;
+    uint64_t size = static_cast<uint64_t>(maximum_size_high) << 32 | maximum_size_low;
+
+    int fd = -1;
+    std::string shm_name{};
+    bool existed = false;
+    if (file == INVALID_HANDLE_VALUE && name)
+    {
+        // named sections are POSIX shared memory. Unlike on Windows, the name lives until the creating handle is closed,
+        // not the last one, and survives a creator that crashes.
+        if (!shm_name_of(name, shm_name) || (protect & SEC_LARGE_PAGES)) return fail(ERROR_INVALID_PARAMETER), nullptr;
+        if (size == 0) return fail(ERROR_INVALID_PARAMETER), nullptr;
+
+        fd = ::shm_open(shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (fd < 0 && errno == EEXIST)
+        {
+            // opens the existing section, with its size, as Windows does. Its name is not ours to remove.
+            existed = true;
+            fd = ::shm_open(std::exchange(shm_name, std::string()).c_str(), writable ? O_RDWR | O_CLOEXEC : O_RDONLY | O_CLOEXEC, 0);
+            struct stat st{};
+            if (fd >= 0 && ::fstat(fd, &st) == 0) size = static_cast<uint64_t>(st.st_size);
+        }
+        else if (fd >= 0 && ::ftruncate(fd, static_cast<off_t>(size)) != 0)
+        {
+            const int error = errno;
+            (void)::close(fd);
+            (void)::shm_unlink(shm_name.c_str());
+            return fail(error_of(error)), nullptr;
+        }
+        if (fd < 0) return fail(error_of(errno)), nullptr;
+    }
+    else if (file == INVALID_HANDLE_VALUE)
+    {
+        // backed by anonymous memory instead of the paging file.
+        if (size == 0) return fail(ERROR_INVALID_PARAMETER), nullptr;
+
+        // large pages come from hugetlbfs and, as with SEC_COMMIT on Windows, are allocated up front.
+        const bool large_pages = protect & SEC_LARGE_PAGES;
+        if (large_pages && (!(protect & SEC_COMMIT) || !GetLargePageMinimum() || size % GetLargePageMinimum())) return fail(ERROR_INVALID_PARAMETER), nullptr;
+
+        fd = ::memfd_create("xtw_portable_section", MFD_CLOEXEC | (large_pages ? MFD_HUGETLB : 0));
+        if (fd < 0 || ::ftruncate(fd, static_cast<off_t>(size)) != 0 || (large_pages && ::fallocate(fd, 0, 0, static_cast<off_t>(size)) != 0))
+        {
+            const int error = errno;
+            if (fd >= 0) (void)::close(fd);
+            return fail(large_pages ? ERROR_NO_SYSTEM_RESOURCES : error_of(error)), nullptr;
+        }
+    }
+    else
+    {
+        file_object* f = file_of(file);
+        if (!f) return fail(ERROR_INVALID_HANDLE), nullptr;
+        if (writable && !f->writable) return fail(ERROR_ACCESS_DENIED), nullptr;
+
+        struct stat st{};
+        if (::fstat(f->fd, &st) != 0) return fail(error_of(errno)), nullptr;
+        const auto file_size = static_cast<uint64_t>(st.st_size);
+        if (size == 0) size = file_size;
+        if (size == 0) return fail(ERROR_FILE_INVALID), nullptr;
+
+        // a writable mapping larger than the file extends the file; a read-only one cannot.
+        if (size > file_size && (!writable || ::ftruncate(f->fd, static_cast<off_t>(size)) != 0)) return fail(writable ? error_of(errno) : ERROR_NOT_ENOUGH_MEMORY), nullptr;
+
+        fd = ::fcntl(f->fd, F_DUPFD_CLOEXEC, 0);
+        if (fd < 0) return fail(error_of(errno)), nullptr;
+    }
+
+    auto object = new (std::nothrow) mapping_object(fd, size, writable);
+    if (!object)
+    {
+        (void)::close(fd);
+        if (!shm_name.empty()) (void)::shm_unlink(shm_name.c_str());
+        return fail(ERROR_NOT_ENOUGH_MEMORY), nullptr;
+    }
+    object->shm_name = std::move(shm_name);
+    last_error = existed ? ERROR_ALREADY_EXISTS : ERROR_SUCCESS;
+    return object;
+}
+
+HANDLE OpenFileMappingW(DWORD desired_access, BOOL, LPCWSTR name)
+{
+    std::string shm_name{};
+    if (!name || !shm_name_of(name, shm_name)) return fail(ERROR_INVALID_PARAMETER), nullptr;
+
+    const bool writable = desired_access & FILE_MAP_WRITE;
+    const int fd = ::shm_open(shm_name.c_str(), writable ? O_RDWR | O_CLOEXEC : O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) return fail(error_of(errno)), nullptr;
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        (void)::close(fd);
+        return fail(ERROR_FILE_INVALID), nullptr;
+    }
+
+    auto object = new (std::nothrow) mapping_object(fd, static_cast<uint64_t>(st.st_size), writable);
+    if (!object)
+    {
+        (void)::close(fd);
+        return fail(ERROR_NOT_ENOUGH_MEMORY), nullptr;
+    }
+    last_error = ERROR_SUCCESS;
+    return object;
+}
+
+LPVOID MapViewOfFile(HANDLE mapping, DWORD desired_access, DWORD file_offset_high, DWORD file_offset_low, SIZE_T bytes_to_map)
+{
+    mapping_object* m = mapping_of(mapping);
+    if (!m) return fail(ERROR_INVALID_HANDLE), nullptr;
+
+    const bool write = desired_access & FILE_MAP_WRITE;
+    if (write && !m->writable) return fail(ERROR_ACCESS_DENIED), nullptr;
+
+    const uint64_t offset = static_cast<uint64_t>(file_offset_high) << 32 | file_offset_low;
+    if (offset % page_size() || offset >= m->size) return fail(ERROR_INVALID_PARAMETER), nullptr;
+    if (bytes_to_map == 0) bytes_to_map = static_cast<SIZE_T>(m->size - offset);
+    if (bytes_to_map > m->size - offset) return fail(ERROR_ACCESS_DENIED), nullptr;
+
+    void* p = ::mmap(nullptr, bytes_to_map, write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, m->fd, static_cast<off_t>(offset));
+    if (p == MAP_FAILED) return fail(error_of(errno)), nullptr;
+
+    std::lock_guard lock(reservations_mutex);
+    views.emplace(reinterpret_cast<uintptr_t>(p), bytes_to_map);
+    return p;
+}
+
+BOOL UnmapViewOfFile(LPCVOID base_address)
+{
+    std::lock_guard lock(reservations_mutex);
+    auto it = views.find(reinterpret_cast<uintptr_t>(base_address));
+    if (it == views.end()) return fail(ERROR_INVALID_ADDRESS, FALSE);
+    (void)::munmap(const_cast<void*>(base_address), it->second);
+    views.erase(it);
+    return TRUE;
+}
+
+BOOL FlushViewOfFile(LPCVOID base_address, SIZE_T bytes_to_flush)
+{
+    const auto address = reinterpret_cast<uintptr_t>(base_address);
+    uintptr_t end{};
+    {
+        std::lock_guard lock(reservations_mutex);
+        auto it = views.upper_bound(address);
+        if (it == views.begin() || address >= std::prev(it)->first + std::prev(it)->second) return fail(ERROR_INVALID_ADDRESS, FALSE);
+        --it;
+        end = it->first + it->second;
+    }
+
+    // bytes_to_flush == 0 flushes to the end of the view.
+    if (bytes_to_flush != 0) end = std::min(end, address + bytes_to_flush);
+    const uintptr_t first = address / page_size() * page_size();
+    if (::msync(reinterpret_cast<void*>(first), end - first, MS_ASYNC) != 0) return fail(error_of(errno), FALSE);
+    return TRUE;
+}
+
+// modules
+
+HMODULE LoadLibraryW(LPCWSTR)
+{
+    return fail(126 /* ERROR_MOD_NOT_FOUND */), nullptr; // no DLLs to load; callers take their fallback paths.
+}
+
+BOOL FreeLibrary(HMODULE module)
+{
+    return module ? TRUE : fail(ERROR_INVALID_HANDLE, FALSE);
+}
+
+HMODULE GetModuleHandleW(LPCWSTR)
+{
+    return fail(126 /* ERROR_MOD_NOT_FOUND */), nullptr; // DLLs such as ntdll.dll do not exist here.
+}
+
+BOOL GetModuleHandleExW(DWORD flags, LPCWSTR module_name, HMODULE* module)
+{
+    if (!module || !(flags & GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS)) return fail(ERROR_NOT_SUPPORTED, FALSE);
+
+    Dl_info info{};
+    if (!::dladdr(module_name, &info) || !info.dli_fbase) return fail(126 /* ERROR_MOD_NOT_FOUND */, FALSE);
+    *module = static_cast<HMODULE>(info.dli_fbase);
+    return TRUE;
+}
+
+DWORD GetModuleFileNameW(HMODULE module, LPWSTR file_name, DWORD size)
+{
+    Dl_info info{};
+    if (!module || !::dladdr(module, &info) || !info.dli_fname) return fail(126 /* ERROR_MOD_NOT_FOUND */);
+
+    const std::wstring name = xtw::utf::to_utf16(info.dli_fname);
+    if (size == 0) return fail(ERROR_INSUFFICIENT_BUFFER);
+    const DWORD length = static_cast<DWORD>(std::min<size_t>(name.size(), size - 1));
+    std::copy_n(name.data(), length, file_name);
+    file_name[length] = L'\0';
+    return length < name.size() ? fail(ERROR_INSUFFICIENT_BUFFER, size) : length;
+}
+
+FARPROC GetProcAddress(HMODULE, LPCSTR)
+{
+    return fail(127 /* ERROR_PROC_NOT_FOUND */), nullptr;
+}
+
+// windows: there is no window manager, so no window handle is valid.
+
+BOOL PostMessageW(HWND, UINT, WPARAM, LPARAM)
+{
+    return fail(ERROR_INVALID_WINDOW_HANDLE, FALSE);
+}
+
+// strings
+
+DWORD FormatMessageA(DWORD flags, LPCVOID, DWORD message_id, DWORD, LPSTR buffer, DWORD size, void*)
+{
+    const char* message = (flags & FORMAT_MESSAGE_FROM_SYSTEM) ? message_of(message_id) : nullptr;
+    if (!message) return fail(317 /* ERROR_MR_MID_NOT_FOUND */);
+
+    const std::string text = std::string(message) + "\r\n";
+    if (flags & FORMAT_MESSAGE_ALLOCATE_BUFFER)
+    {
+        auto p = static_cast<char*>(std::malloc(text.size() + 1)); // freed by LocalFree
+        if (!p) return fail(ERROR_NOT_ENOUGH_MEMORY);
+        std::memcpy(p, text.c_str(), text.size() + 1);
+        *reinterpret_cast<char**>(buffer) = p;
+        return static_cast<DWORD>(text.size());
+    }
+
+    if (size <= text.size()) return fail(ERROR_INSUFFICIENT_BUFFER);
+    std::memcpy(buffer, text.c_str(), text.size() + 1);
+    return static_cast<DWORD>(text.size());
+}
+
+int CompareStringOrdinal(LPCWSTR string1, int count1, LPCWSTR string2, int count2, BOOL ignore_case)
+{
+    if (!string1 || !string2) return fail(ERROR_INVALID_PARAMETER);
+    const size_t length1 = count1 < 0 ? wcslen(string1) : static_cast<size_t>(count1);
+    const size_t length2 = count2 < 0 ? wcslen(string2) : static_cast<size_t>(count2);
+
+    // case folding covers ASCII only; Windows folds with its full uppercase table.
+    const auto fold = [ignore_case](wchar_t c) -> char16_t { return ignore_case && c >= L'a' && c <= L'z' ? static_cast<char16_t>(c - L'a' + L'A') : static_cast<char16_t>(c); };
+    for (size_t i = 0; i < length1 && i < length2; i++)
+        if (const char16_t a = fold(string1[i]), b = fold(string2[i]); a != b)
+            return a < b ? CSTR_LESS_THAN : CSTR_GREATER_THAN;
+    return length1 < length2 ? CSTR_LESS_THAN : length1 > length2 ? CSTR_GREATER_THAN : CSTR_EQUAL;
+}
+
+// debugging
+
+void OutputDebugStringA(LPCSTR)
+{
+    // no debugger to receive the output.
+}
+
+BOOL IsDebuggerPresent()
+{
+    return FALSE;
+}
+
+void DebugBreak()
+{
+    (void)::raise(SIGTRAP);
+}
+
+WORD RtlCaptureStackBackTrace(DWORD frames_to_skip, DWORD frames_to_capture, PVOID* back_trace, DWORD* back_trace_hash)
+{
+    void* frames[128];
+    const int captured = ::backtrace(frames, static_cast<int>(std::size(frames)));
+    const DWORD skip = frames_to_skip + 1; // this function
+    DWORD count = 0;
+    uintptr_t hash = 0;
+    for (DWORD i = skip; i < static_cast<DWORD>(captured) && count < frames_to_capture; i++)
+    {
+        back_trace[count++] = frames[i];
+        hash += reinterpret_cast<uintptr_t>(frames[i]);
+    }
+    if (back_trace_hash) *back_trace_hash = static_cast<DWORD>(hash);
+    return static_cast<WORD>(count);
+}
+
+// DbgHelp: names come from the dynamic symbol table (link with -rdynamic for more of them); no line information.
+
+namespace
+{
+    std::atomic<DWORD> symbol_options{};
+}
+
+DWORD SymSetOptions(DWORD options) { return symbol_options.exchange(options); }
+DWORD SymGetOptions() { return symbol_options.load(); }
+BOOL SymInitializeW(HANDLE, PCWSTR, BOOL) { return TRUE; }
+BOOL SymRefreshModuleList(HANDLE) { return TRUE; }
+
+BOOL SymFromAddrW(HANDLE, DWORD64 address, DWORD64* displacement, SYMBOL_INFOW* symbol)
+{
+    Dl_info info{};
+    if (!::dladdr(reinterpret_cast<void*>(address), &info) || !info.dli_sname) return fail(126 /* ERROR_MOD_NOT_FOUND */, FALSE);
+
+    int status = -1;
+    char* demangled = (symbol_options.load() & SYMOPT_UNDNAME) ? abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status) : nullptr;
+    const std::wstring name = xtw::utf::to_utf16(status == 0 ? demangled : info.dli_sname);
+    std::free(demangled);
+
+    symbol->NameLen = static_cast<ULONG>(std::min<size_t>(name.size(), symbol->MaxNameLen ? symbol->MaxNameLen - 1 : 0));
+    std::copy_n(name.data(), symbol->NameLen, symbol->Name);
+    symbol->Name[symbol->NameLen] = L'\0';
+    symbol->Address = reinterpret_cast<DWORD64>(info.dli_saddr);
+    symbol->ModBase = reinterpret_cast<DWORD64>(info.dli_fbase);
+    if (displacement) *displacement = address - symbol->Address;
+    return TRUE;
+}
+
+BOOL SymGetLineFromAddrW64(HANDLE, DWORD64, DWORD*, IMAGEHLP_LINEW64*)
+{
+    return fail(ERROR_NOT_SUPPORTED, FALSE);
+}
+
+// COM
+
+HRESULT CoInitializeEx(LPVOID, DWORD) { return S_OK; }
+void CoUninitialize() {}
+LPVOID CoTaskMemAlloc(SIZE_T size) { return std::malloc(size); }
+void CoTaskMemFree(LPVOID pv) { std::free(pv); }
+
+int StringFromGUID2(REFGUID guid, LPOLESTR buffer, int max)
+{
+    char text[40];
+    const int length = std::snprintf(text, sizeof(text), "{%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X}",
+                                     static_cast<unsigned>(guid.Data1), guid.Data2, guid.Data3,
+                                     guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3],
+                                     guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7]);
+    if (!buffer || max <= length) return 0;
+    for (int i = 0; i <= length; i++) buffer[i] = static_cast<OLECHAR>(text[i]);
+    return length + 1; // including the terminator
+}
+
+HRESULT IIDFromString(LPCOLESTR string, IID* iid)
+{
+    if (!string || !iid) return E_INVALIDARG;
+
+    char text[40]{};
+    for (int i = 0; i < 38; i++)
+    {
+        if (string[i] == L'\0' || string[i] > 0x7F) return E_INVALIDARG;
+        text[i] = static_cast<char>(string[i]);
+    }
+    if (string[38] != L'\0') return E_INVALIDARG;
+
+    unsigned d1{}, d2{}, d3{}, d4[8]{};
+    char close{};
+    if (std::sscanf(text, "{%8x-%4x-%4x-%2x%2x-%2x%2x%2x%2x%2x%2x%c", &d1, &d2, &d3, &d4[0], &d4[1], &d4[2], &d4[3], &d4[4], &d4[5], &d4[6], &d4[7], &close) != 12 || close != '}')
+        return E_INVALIDARG;
+
+    iid->Data1 = d1;
+    iid->Data2 = static_cast<unsigned short>(d2);
+    iid->Data3 = static_cast<unsigned short>(d3);
+    for (int i = 0; i < 8; i++) iid->Data4[i] = static_cast<unsigned char>(d4[i]);
+    return S_OK;
+}
+
+HRESULT CLSIDFromString(LPCOLESTR string, CLSID* clsid)
+{
+    return IIDFromString(string, clsid);
+}
+
+// C library, for UTF-16 wchar_t (-fshort-wchar).
+// The C library's own wide functions assume 4-byte wchar_t; libstdc++'s char_traits<wchar_t> calls these,
+// so the executable's definitions here take their place.
+
+extern "C"
+{
+    size_t wcslen(const wchar_t* s) noexcept
+    {
+        const wchar_t* p = s;
+        while (*p) ++p;
+        return static_cast<size_t>(p - s);
+    }
+
+    int wmemcmp(const wchar_t* a, const wchar_t* b, size_t n) noexcept
+    {
+        for (size_t i = 0; i < n; i++)
+            if (a[i] != b[i])
+                return static_cast<char16_t>(a[i]) < static_cast<char16_t>(b[i]) ? -1 : 1;
+        return 0;
+    }
+
+    // declared as const-correct C++ overloads by <wchar.h>, so defined under another name.
+    wchar_t* xtw_portable_wmemchr(const wchar_t* s, wchar_t c, size_t n) noexcept __asm__("wmemchr");
+    wchar_t* xtw_portable_wmemchr(const wchar_t* s, wchar_t c, size_t n) noexcept
+    {
+        for (size_t i = 0; i < n; i++)
+            if (s[i] == c)
+                return const_cast<wchar_t*>(s + i);
+        return nullptr;
+    }
+
+    wchar_t* wmemcpy(wchar_t* dst, const wchar_t* src, size_t n) noexcept
+    {
+        return static_cast<wchar_t*>(std::memcpy(dst, src, n * sizeof(wchar_t)));
+    }
+
+    wchar_t* wmemmove(wchar_t* dst, const wchar_t* src, size_t n) noexcept
+    {
+        return static_cast<wchar_t*>(std::memmove(dst, src, n * sizeof(wchar_t)));
+    }
+
+    wchar_t* wmemset(wchar_t* dst, wchar_t c, size_t n) noexcept
+    {
+        for (size_t i = 0; i < n; i++) dst[i] = c;
+        return dst;
+    }
+}
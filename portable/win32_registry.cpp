@@ -0,0 +1,942 @@
+/// @file
+/// @brief  xtw portable backend: the registry as a directory tree
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+///
+/// Keys are directories under $XTW_PORTABLE_REGISTRY/<predefined key name>, e.g. HKEY_CURRENT_USER/Software/Vendor.
+/// Values of a key are records in its "%values" file, which is replaced by rename on each change; changes are serialized
+/// with flock on the key directory, so other processes see each one whole.
+/// Key names are stored in UTF-8 with '%' and '/' escaped as %XX, so no key is stored as "%values", and are matched case-insensitively
+/// as CompareStringOrdinal does here. Without $XTW_PORTABLE_REGISTRY, no key exists and none can be created.
+/// Opened keys cache their sub key and value tables, revalidated with one stat per call.
+/// RegNotifyChangeKeyValue watches key directories with inotify, read by one background thread.
+
+#include <Windows.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <xtw/utf.h>
+
+namespace
+{
+    constexpr char values_file[] = "%values";
+    constexpr uint32_t values_magic = 0x31565258; // 'XRV1'
+
+    const char* const predefined_key_names[] = {
+        "HKEY_CLASSES_ROOT",
+        "HKEY_CURRENT_USER",
+        "HKEY_LOCAL_MACHINE",
+        "HKEY_USERS",
+        "HKEY_PERFORMANCE_DATA",
+        "HKEY_CURRENT_CONFIG",
+    };
+
+    struct value
+    {
+        std::wstring name;
+        DWORD type{};
+        std::vector<BYTE> data;
+    };
+
+    // identifies a version of a file or directory.
+    struct stamp
+    {
+        dev_t device{};
+        ino_t inode{};
+        off_t size{};
+        timespec modified{};
+
+        static stamp of(const struct stat& st) noexcept { return stamp{st.st_dev, st.st_ino, st.st_size, st.st_mtim}; }
+
+        bool operator==(const stamp& other) const noexcept
+        {
+            return device == other.device && inode == other.inode && size == other.size &&
+                modified.tv_sec == other.modified.tv_sec && modified.tv_nsec == other.modified.tv_nsec;
+        }
+    };
+
+    // file times are coarse, so a change right after a read may leave the stamp unchanged.
+    // A table read within this margin of its modification time is used once and not cached.
+    bool settled(const stamp& s, const timespec& read_at) noexcept
+    {
+        const int64_t elapsed = (static_cast<int64_t>(read_at.tv_sec) - s.modified.tv_sec) * 1000000000 + (read_at.tv_nsec - s.modified.tv_nsec);
+        return elapsed > 100'000'000;
+    }
+
+    timespec now() noexcept
+    {
+        timespec ts{};
+        ::clock_gettime(CLOCK_REALTIME, &ts);
+        return ts;
+    }
+
+    FILETIME filetime_of(const timespec& ts) noexcept
+    {
+        const auto ticks = (static_cast<ULONGLONG>(ts.tv_sec) + 11644473600) * 10000000 + static_cast<ULONGLONG>(ts.tv_nsec) / 100; // since 1601
+        return FILETIME{static_cast<DWORD>(ticks), static_cast<DWORD>(ticks >> 32)};
+    }
+
+    LSTATUS status_of(int error) noexcept
+    {
+        switch (error)
+        {
+        case ENOENT: case ENOTDIR: return ERROR_FILE_NOT_FOUND;
+        case EACCES: case EPERM: case EROFS: case ENOTEMPTY: return ERROR_ACCESS_DENIED;
+        case ENOMEM: return ERROR_OUTOFMEMORY;
+        default: return ERROR_INVALID_FUNCTION;
+        }
+    }
+
+    int compare_names(std::wstring_view a, std::wstring_view b) noexcept
+    {
+        return ::CompareStringOrdinal(a.data(), static_cast<int>(a.size()), b.data(), static_cast<int>(b.size()), TRUE) - CSTR_EQUAL;
+    }
+
+    // key names to directory names and back
+
+    std::string escape(std::string_view utf8)
+    {
+        const bool dots = utf8 == "." || utf8 == "..";
+        std::string result{};
+        for (char c : utf8)
+        {
+            if (c == '%' || c == '/' || (dots && c == '.'))
+            {
+                char hex[4];
+                std::snprintf(hex, sizeof(hex), "%%%02X", static_cast<unsigned char>(c));
+                result += hex;
+            }
+            else
+            {
+                result += c;
+            }
+        }
+        return result;
+    }
+
+    bool to_file_name(std::wstring_view name, std::string& result)
+    {
+        try { result = escape(xtw::utf::to_utf8(name)); }
+        catch (const std::invalid_argument&) { return false; }
+        return !result.empty();
+    }
+
+    // fails for files that are not keys, such as "%values".
+    bool from_file_name(std::string_view file, std::wstring& result)
+    {
+        const auto hex = [](char c) { return c >= '0' && c <= '9' ? c - '0' : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1; };
+
+        std::string utf8{};
+        for (size_t i = 0; i < file.size(); i++)
+        {
+            if (file[i] != '%')
+            {
+                utf8 += file[i];
+                continue;
+            }
+            if (i + 2 >= file.size() || hex(file[i + 1]) < 0 || hex(file[i + 2]) < 0) return false;
+            utf8 += static_cast<char>(hex(file[i + 1]) * 16 + hex(file[i + 2]));
+            i += 2;
+        }
+
+        if (utf8.empty() || escape(utf8) != file) return false; // only the canonical spelling
+        try { result = xtw::utf::to_utf16(utf8); }
+        catch (const std::invalid_argument&) { return false; }
+        return true;
+    }
+
+    bool is_directory(const std::string& path) noexcept
+    {
+        struct stat st{};
+        return ::stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    // finds a sub key directory by case-insensitive name.
+    bool find_child(const std::string& directory, std::wstring_view name, std::string& file)
+    {
+        if (!to_file_name(name, file)) return false;
+        if (is_directory(directory + '/' + file)) return true;
+
+        DIR* d = ::opendir(directory.c_str());
+        if (!d) return false;
+        bool found = false;
+        std::wstring entry_name{};
+        while (const dirent* e = ::readdir(d))
+        {
+            if (from_file_name(e->d_name, entry_name) && compare_names(entry_name, name) == 0 && is_directory(directory + '/' + e->d_name))
+            {
+                file = e->d_name;
+                found = true;
+                break;
+            }
+        }
+        ::closedir(d);
+        return found;
+    }
+
+    // values files: magic, then records of {type, name length in wchar_t, data size, name, data}.
+
+    LSTATUS read_values(int fd, std::vector<value>& values)
+    {
+        std::vector<BYTE> bytes{};
+        BYTE buffer[65536];
+        for (ssize_t n; (n = ::read(fd, buffer, sizeof(buffer))) != 0;)
+        {
+            if (n < 0) return status_of(errno);
+            bytes.insert(bytes.end(), buffer, buffer + n);
+        }
+
+        values.clear();
+        if (bytes.empty()) return ERROR_SUCCESS;
+
+        const auto u32_at = [&](size_t offset) { uint32_t v{}; std::memcpy(&v, bytes.data() + offset, sizeof(v)); return v; };
+        if (bytes.size() < 4 || u32_at(0) != values_magic) return ERROR_BADDB;
+        for (size_t p = 4; p < bytes.size();)
+        {
+            if (bytes.size() - p < 12) return ERROR_BADDB;
+            const uint32_t type = u32_at(p), name_length = u32_at(p + 4), data_size = u32_at(p + 8);
+            p += 12;
+            if ((bytes.size() - p) / sizeof(wchar_t) < name_length || bytes.size() - p - name_length * sizeof(wchar_t) < data_size) return ERROR_BADDB;
+
+            auto& v = values.emplace_back();
+            v.type = type;
+            v.name.resize(name_length);
+            std::memcpy(v.name.data(), bytes.data() + p, name_length * sizeof(wchar_t));
+            p += name_length * sizeof(wchar_t);
+            v.data.assign(bytes.data() + p, bytes.data() + p + data_size);
+            p += data_size;
+        }
+        return ERROR_SUCCESS;
+    }
+
+    LSTATUS load_values(const std::string& directory, std::vector<value>& values, stamp* version = nullptr)
+    {
+        const int fd = ::open((directory + '/' + values_file).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            values.clear();
+            if (version) *version = stamp{};
+            return errno == ENOENT ? ERROR_SUCCESS : status_of(errno);
+        }
+
+        struct stat st{};
+        LSTATUS status = ::fstat(fd, &st) == 0 ? read_values(fd, values) : status_of(errno);
+        if (version) *version = stamp::of(st);
+        ::close(fd);
+        return status;
+    }
+
+    LSTATUS store_values(const std::string& directory, const std::vector<value>& values)
+    {
+        static std::atomic<unsigned> sequence{};
+        char temporary_name[64];
+        std::snprintf(temporary_name, sizeof(temporary_name), "%s.%ld.%u", values_file, static_cast<long>(::getpid()), sequence.fetch_add(1));
+        const std::string temporary = directory + '/' + temporary_name;
+
+        std::vector<BYTE> bytes(4);
+        std::memcpy(bytes.data(), &values_magic, 4);
+        for (auto& v : values)
+        {
+            const uint32_t fields[] = {v.type, static_cast<uint32_t>(v.name.size()), static_cast<uint32_t>(v.data.size())};
+            bytes.insert(bytes.end(), reinterpret_cast<const BYTE*>(fields), reinterpret_cast<const BYTE*>(fields + 3));
+            bytes.insert(bytes.end(), reinterpret_cast<const BYTE*>(v.name.data()), reinterpret_cast<const BYTE*>(v.name.data() + v.name.size()));
+            bytes.insert(bytes.end(), v.data.begin(), v.data.end());
+        }
+
+        const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (fd < 0) return status_of(errno);
+        for (size_t written = 0; written < bytes.size();)
+        {
+            const ssize_t n = ::write(fd, bytes.data() + written, bytes.size() - written);
+            if (n < 0)
+            {
+                const int error = errno;
+                ::close(fd);
+                ::unlink(temporary.c_str());
+                return status_of(error);
+            }
+            written += static_cast<size_t>(n);
+        }
+        ::close(fd);
+
+        if (::rename(temporary.c_str(), (directory + '/' + values_file).c_str()) != 0)
+        {
+            const int error = errno;
+            ::unlink(temporary.c_str());
+            return status_of(error);
+        }
+        return ERROR_SUCCESS;
+    }
+
+    value* find_value(std::vector<value>& values, std::wstring_view name) noexcept
+    {
+        for (auto& v : values)
+            if (compare_names(v.name, name) == 0)
+                return &v;
+        return nullptr;
+    }
+
+    // removes a key directory with everything in it.
+    bool remove_tree(const std::string& directory, bool remove_self)
+    {
+        DIR* d = ::opendir(directory.c_str());
+        if (!d) return errno == ENOENT;
+        std::vector<std::string> entries{};
+        while (const dirent* e = ::readdir(d))
+            if (std::strcmp(e->d_name, ".") != 0 && std::strcmp(e->d_name, "..") != 0)
+                entries.emplace_back(e->d_name);
+        ::closedir(d);
+
+        bool ok = true;
+        for (auto& e : entries)
+        {
+            const std::string path = directory + '/' + e;
+            if (is_directory(path)) ok = remove_tree(path, true) && ok;
+            else ok = (::unlink(path.c_str()) == 0 || errno == ENOENT) && ok;
+        }
+        return ok && (!remove_self || ::rmdir(directory.c_str()) == 0);
+    }
+
+    std::vector<std::wstring> split(LPCWSTR sub_key)
+    {
+        std::vector<std::wstring> names{};
+        if (!sub_key) return names;
+        std::wstring_view path(sub_key);
+        while (!path.empty())
+        {
+            const size_t separator = path.find(L'\\');
+            if (const auto name = path.substr(0, separator); !name.empty()) names.emplace_back(name);
+            path = separator == std::wstring_view::npos ? std::wstring_view{} : path.substr(separator + 1);
+        }
+        return names;
+    }
+
+    int predefined_index(HKEY key) noexcept
+    {
+        const auto v = reinterpret_cast<uintptr_t>(key) - reinterpret_cast<uintptr_t>(HKEY_CLASSES_ROOT);
+        return v < std::size(predefined_key_names) ? static_cast<int>(v) : -1;
+    }
+}
+
+/// An opened key: the directory it was opened at, and its cached tables.
+struct HKEY__
+{
+    const std::string path;
+    const dev_t device;
+    const ino_t inode;
+
+    std::mutex mutex{};
+    std::vector<std::wstring> sub_keys{}; // sorted
+    stamp sub_keys_version{};
+    bool sub_keys_cached = false;
+    std::vector<value> values{};
+    stamp values_version{};
+    bool values_cached = false;
+
+    HKEY__(std::string p, const struct stat& st) : path(std::move(p)), device(st.st_dev), inode(st.st_ino) {}
+
+    // a key deleted, or deleted and created again, is gone for its handles, as on Windows.
+    LSTATUS check(struct stat& st) const noexcept
+    {
+        if (::stat(path.c_str(), &st) != 0 || st.st_dev != device || st.st_ino != inode) return ERROR_KEY_DELETED;
+        return ERROR_SUCCESS;
+    }
+
+    // requires mutex
+    LSTATUS refresh_sub_keys()
+    {
+        struct stat st{};
+        if (LSTATUS status = check(st); status != ERROR_SUCCESS) return status;
+        if (sub_keys_cached && sub_keys_version == stamp::of(st)) return ERROR_SUCCESS;
+
+        const timespec read_at = now();
+        DIR* d = ::opendir(path.c_str());
+        if (!d) return status_of(errno);
+        sub_keys.clear();
+        std::wstring name{};
+        while (const dirent* e = ::readdir(d))
+            if ((e->d_type == DT_DIR || e->d_type == DT_UNKNOWN) && from_file_name(e->d_name, name) && (e->d_type == DT_DIR || is_directory(path + '/' + e->d_name)))
+                sub_keys.push_back(name);
+        ::closedir(d);
+
+        std::sort(sub_keys.begin(), sub_keys.end(), [](const std::wstring& a, const std::wstring& b) { return compare_names(a, b) < 0; });
+        sub_keys_version = stamp::of(st);
+        sub_keys_cached = settled(sub_keys_version, read_at);
+        return ERROR_SUCCESS;
+    }
+
+    // requires mutex
+    LSTATUS refresh_values()
+    {
+        struct stat st{};
+        if (LSTATUS status = check(st); status != ERROR_SUCCESS) return status;
+
+        if (values_cached)
+        {
+            struct stat file{};
+            const stamp current = ::stat((path + '/' + values_file).c_str(), &file) == 0 ? stamp::of(file) : stamp{};
+            if (current == values_version) return ERROR_SUCCESS;
+        }
+
+        const timespec read_at = now();
+        if (LSTATUS status = load_values(path, values, &values_version); status != ERROR_SUCCESS)
+        {
+            values_cached = false;
+            return status;
+        }
+        values_cached = values_version.inode != 0 && settled(values_version, read_at);
+        return ERROR_SUCCESS;
+    }
+};
+
+namespace
+{
+    // directory of a key handle. Predefined keys are created on demand when `create` is set.
+    LSTATUS directory_of(HKEY key, bool create, std::string& path)
+    {
+        if (int index = predefined_index(key); index >= 0)
+        {
+            const char* root = std::getenv("XTW_PORTABLE_REGISTRY");
+            if (!root || !*root) return create ? ERROR_ACCESS_DENIED : ERROR_FILE_NOT_FOUND;
+            path = std::string(root) + '/' + predefined_key_names[index];
+            if (create)
+            {
+                (void)::mkdir(root, 0777);
+                if (::mkdir(path.c_str(), 0777) != 0 && errno != EEXIST) return status_of(errno);
+            }
+            return is_directory(path) ? ERROR_SUCCESS : ERROR_FILE_NOT_FOUND;
+        }
+
+        if (!key) return ERROR_INVALID_HANDLE;
+        struct stat st{};
+        if (LSTATUS status = key->check(st); status != ERROR_SUCCESS) return status;
+        path = key->path;
+        return ERROR_SUCCESS;
+    }
+
+    // the opened key behind a handle; predefined keys are opened for the call.
+    LSTATUS object_of(HKEY key, std::unique_ptr<HKEY__>& temporary, HKEY__*& object)
+    {
+        if (predefined_index(key) < 0)
+        {
+            object = key;
+            return key ? ERROR_SUCCESS : ERROR_INVALID_HANDLE;
+        }
+
+        std::string path{};
+        struct stat st{};
+        if (LSTATUS status = directory_of(key, false, path); status != ERROR_SUCCESS) return status;
+        if (::stat(path.c_str(), &st) != 0) return status_of(errno);
+        temporary = std::make_unique<HKEY__>(path, st);
+        object = temporary.get();
+        return ERROR_SUCCESS;
+    }
+
+    LSTATUS open_key(HKEY parent, LPCWSTR sub_key, bool create, PHKEY result, LPDWORD disposition)
+    {
+        if (!result) return ERROR_INVALID_PARAMETER;
+
+        std::string path{};
+        if (LSTATUS status = directory_of(parent, create, path); status != ERROR_SUCCESS) return status;
+
+        bool created = false;
+        std::string file{};
+        for (const auto& name : split(sub_key))
+        {
+            if (!find_child(path, name, file))
+            {
+                if (!create || !to_file_name(name, file)) return ERROR_FILE_NOT_FOUND;
+                if (::mkdir((path + '/' + file).c_str(), 0777) == 0) created = true;
+                else if (errno != EEXIST || !find_child(path, name, file)) return status_of(errno);
+            }
+            path += '/';
+            path += file;
+        }
+
+        struct stat st{};
+        if (::stat(path.c_str(), &st) != 0) return status_of(errno);
+        *result = new (std::nothrow) HKEY__(path, st);
+        if (!*result) return ERROR_OUTOFMEMORY;
+        if (disposition) *disposition = created ? REG_CREATED_NEW_KEY : REG_OPENED_EXISTING_KEY;
+        return ERROR_SUCCESS;
+    }
+
+    // read-modify-write of the values of a key, under an exclusive flock on its directory.
+    template <class F>
+    LSTATUS update_values(HKEY key, F&& modify)
+    {
+        std::string path{};
+        if (LSTATUS status = directory_of(key, true, path); status != ERROR_SUCCESS) return status;
+
+        const int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) return status_of(errno);
+        (void)::flock(fd, LOCK_EX);
+
+        std::vector<value> values{};
+        LSTATUS status = load_values(path, values);
+        if (status == ERROR_SUCCESS) status = modify(values);
+        if (status == ERROR_SUCCESS) status = store_values(path, values);
+
+        ::close(fd); // unlocks
+        return status;
+    }
+
+    bool is_string_type(DWORD type) noexcept { return type == REG_SZ || type == REG_EXPAND_SZ || type == REG_MULTI_SZ; }
+}
+
+namespace
+{
+    // change notifications. A registration signals its event once, at the first matching change, and is then dropped,
+    // as on Windows; deleting the key or closing its handle also signals it.
+    class change_notifier final
+    {
+        struct registration
+        {
+            HKEY key;
+            DWORD filter;
+            HANDLE event; // a duplicate, owned
+            std::vector<int> watches;
+        };
+
+        static constexpr uint32_t watch_mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+        std::mutex mutex_{};
+        int fd_ = -1;
+        std::map<int, std::vector<registration*>> by_watch_{}; // guarded by mutex_
+
+        // requires mutex_
+        void remove_watches(registration* r) noexcept
+        {
+            for (int wd : r->watches)
+            {
+                auto it = by_watch_.find(wd);
+                if (it == by_watch_.end()) continue;
+                it->second.erase(std::remove(it->second.begin(), it->second.end(), r), it->second.end());
+                if (it->second.empty())
+                {
+                    (void)::inotify_rm_watch(fd_, wd);
+                    by_watch_.erase(it);
+                }
+            }
+        }
+
+        // requires mutex_
+        void fire(registration* r) noexcept
+        {
+            remove_watches(r);
+            ::SetEvent(r->event);
+            ::CloseHandle(r->event);
+            delete r;
+        }
+
+        // what a change to a directory entry means: the values file is replaced on each change of values,
+        // and sub directories are sub keys. Temporary files and anything else are not changes.
+        static DWORD filter_of(const inotify_event& e) noexcept
+        {
+            if (e.mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) return ~DWORD{0};
+            if (e.len == 0) return 0;
+            if (std::strcmp(e.name, values_file) == 0) return REG_NOTIFY_CHANGE_LAST_SET;
+            std::wstring name{};
+            if ((e.mask & IN_ISDIR) && from_file_name(e.name, name)) return REG_NOTIFY_CHANGE_NAME;
+            return 0;
+        }
+
+        void run() noexcept
+        {
+            alignas(inotify_event) char buffer[16384];
+            while (true)
+            {
+                const ssize_t n = ::read(fd_, buffer, sizeof(buffer));
+                if (n <= 0)
+                {
+                    if (n < 0 && errno == EINTR) continue;
+                    return;
+                }
+
+                std::lock_guard lock(mutex_);
+                for (ssize_t p = 0; p < n;)
+                {
+                    const auto& e = *reinterpret_cast<const inotify_event*>(buffer + p);
+                    p += static_cast<ssize_t>(sizeof(inotify_event) + e.len);
+
+                    auto it = by_watch_.find(e.wd);
+                    if (it == by_watch_.end()) continue;
+
+                    const DWORD changed = filter_of(e);
+                    std::vector<registration*> matched{};
+                    for (registration* r : it->second)
+                        if (r->filter & changed)
+                            matched.push_back(r);
+                    for (registration* r : matched) fire(r);
+                }
+            }
+        }
+
+        // requires mutex_
+        bool add_watches(registration& r, const std::string& directory, bool subtree)
+        {
+            const int wd = ::inotify_add_watch(fd_, directory.c_str(), watch_mask);
+            if (wd < 0) return false;
+            r.watches.push_back(wd);
+            by_watch_[wd].push_back(&r);
+            if (!subtree) return true;
+
+            DIR* d = ::opendir(directory.c_str());
+            if (!d) return true; // deleted meanwhile; the watch reports it.
+            std::vector<std::string> children{};
+            std::wstring name{};
+            while (const dirent* e = ::readdir(d))
+                if (from_file_name(e->d_name, name))
+                    children.push_back(directory + '/' + e->d_name);
+            ::closedir(d);
+
+            for (auto& c : children)
+                if (is_directory(c))
+                    (void)add_watches(r, c, true);
+            return true;
+        }
+
+    public:
+        LSTATUS add(HKEY key, bool subtree, DWORD filter, HANDLE event)
+        {
+            std::lock_guard lock(mutex_);
+            if (fd_ < 0)
+            {
+                fd_ = ::inotify_init1(IN_CLOEXEC);
+                if (fd_ < 0) return status_of(errno);
+                std::thread([this] { run(); }).detach(); // lives as long as the process
+            }
+
+            auto r = std::make_unique<registration>(registration{key, filter, nullptr, {}});
+            if (!::DuplicateHandle(::GetCurrentProcess(), event, ::GetCurrentProcess(), &r->event, 0, FALSE, DUPLICATE_SAME_ACCESS)) return ERROR_INVALID_HANDLE;
+
+            // the key is checked after the watch is in place, so a deletion in between is not missed.
+            struct stat st{};
+            if (!add_watches(*r, key->path, subtree) || key->check(st) != ERROR_SUCCESS)
+            {
+                remove_watches(r.get());
+                ::CloseHandle(r->event);
+                return ERROR_KEY_DELETED;
+            }
+
+            (void)r.release(); // owned through by_watch_ until fired
+            return ERROR_SUCCESS;
+        }
+
+        // closing a key handle signals its pending notifications.
+        void close(HKEY key) noexcept
+        {
+            std::lock_guard lock(mutex_);
+            std::vector<registration*> matched{};
+            for (auto& [wd, registrations] : by_watch_)
+                for (registration* r : registrations)
+                    if (r->key == key && std::find(matched.begin(), matched.end(), r) == matched.end())
+                        matched.push_back(r);
+            for (registration* r : matched) fire(r);
+        }
+    };
+
+    change_notifier& notifier()
+    {
+        static auto n = new change_notifier(); // never destroyed: its thread runs until exit.
+        return *n;
+    }
+}
+
+LSTATUS RegOpenKeyW(HKEY key, LPCWSTR sub_key, PHKEY result)
+{
+    return open_key(key, sub_key, false, result, nullptr);
+}
+
+LSTATUS RegOpenKeyExW(HKEY key, LPCWSTR sub_key, DWORD, REGSAM, PHKEY result)
+{
+    return open_key(key, sub_key, false, result, nullptr);
+}
+
+LSTATUS RegCreateKeyExW(HKEY key, LPCWSTR sub_key, DWORD, LPWSTR, DWORD, REGSAM, LPSECURITY_ATTRIBUTES, PHKEY result, LPDWORD disposition)
+{
+    return open_key(key, sub_key, true, result, disposition);
+}
+
+LSTATUS RegCloseKey(HKEY key)
+{
+    if (predefined_index(key) >= 0) return ERROR_SUCCESS;
+    if (!key) return ERROR_INVALID_HANDLE;
+    notifier().close(key);
+    delete key;
+    return ERROR_SUCCESS;
+}
+
+LSTATUS RegDeleteKeyW(HKEY key, LPCWSTR sub_key)
+{
+    if (!sub_key) return ERROR_INVALID_PARAMETER;
+
+    HKEY target{};
+    if (LSTATUS status = open_key(key, sub_key, false, &target, nullptr); status != ERROR_SUCCESS) return status;
+    const std::string path = target->path;
+    RegCloseKey(target);
+
+    if (predefined_index(key) >= 0 && split(sub_key).empty()) return ERROR_ACCESS_DENIED;
+
+    // only keys without sub keys can be deleted.
+    DIR* d = ::opendir(path.c_str());
+    if (!d) return status_of(errno);
+    std::wstring name{};
+    bool has_sub_keys = false;
+    while (const dirent* e = ::readdir(d))
+        if (from_file_name(e->d_name, name) && is_directory(path + '/' + e->d_name))
+            has_sub_keys = true;
+    ::closedir(d);
+
+    if (has_sub_keys) return ERROR_ACCESS_DENIED;
+    return remove_tree(path, true) ? ERROR_SUCCESS : status_of(errno);
+}
+
+LSTATUS RegDeleteTreeW(HKEY key, LPCWSTR sub_key)
+{
+    HKEY target{};
+    if (LSTATUS status = open_key(key, sub_key, false, &target, nullptr); status != ERROR_SUCCESS) return status;
+    const std::string path = target->path;
+    RegCloseKey(target);
+
+    // without a sub key, the key itself stays, empty.
+    const bool remove_self = !split(sub_key).empty();
+    return remove_tree(path, remove_self) ? ERROR_SUCCESS : status_of(errno);
+}
+
+LSTATUS RegEnumKeyExW(HKEY key, DWORD index, LPWSTR name, LPDWORD name_length, LPDWORD, LPWSTR class_name, LPDWORD class_length, FILETIME* last_write_time)
+{
+    if (!name || !name_length) return ERROR_INVALID_PARAMETER;
+
+    std::unique_ptr<HKEY__> temporary{};
+    HKEY__* k{};
+    if (LSTATUS status = object_of(key, temporary, k); status != ERROR_SUCCESS) return status;
+
+    std::string path{};
+    {
+        std::lock_guard lock(k->mutex);
+        if (LSTATUS status = k->refresh_sub_keys(); status != ERROR_SUCCESS) return status;
+        if (index >= k->sub_keys.size()) return ERROR_NO_MORE_ITEMS;
+
+        const std::wstring& n = k->sub_keys[index];
+        if (n.size() >= *name_length) return ERROR_MORE_DATA;
+        std::copy(n.begin(), n.end(), name);
+        name[n.size()] = L'\0';
+        *name_length = static_cast<DWORD>(n.size());
+
+        if (last_write_time && !to_file_name(n, path)) return ERROR_FILE_NOT_FOUND;
+    }
+
+    if (class_name && class_length && *class_length) class_name[0] = L'\0';
+    if (class_length) *class_length = 0;
+    if (last_write_time)
+    {
+        struct stat st{};
+        *last_write_time = ::stat((k->path + '/' + path).c_str(), &st) == 0 ? filetime_of(st.st_mtim) : FILETIME{};
+    }
+    return ERROR_SUCCESS;
+}
+
+LSTATUS RegEnumValueW(HKEY key, DWORD index, LPWSTR value_name, LPDWORD value_name_length, LPDWORD, LPDWORD type, LPBYTE data, LPDWORD data_size)
+{
+    if (!value_name || !value_name_length || (data && !data_size)) return ERROR_INVALID_PARAMETER;
+
+    std::unique_ptr<HKEY__> temporary{};
+    HKEY__* k{};
+    if (LSTATUS status = object_of(key, temporary, k); status != ERROR_SUCCESS) return status;
+
+    std::lock_guard lock(k->mutex);
+    if (LSTATUS status = k->refresh_values(); status != ERROR_SUCCESS) return status;
+    if (index >= k->values.size()) return ERROR_NO_MORE_ITEMS;
+
+    // values are enumerated in the order they were first set, as on Windows.
+    const value& v = k->values[index];
+    if (v.name.size() >= *value_name_length) return ERROR_MORE_DATA;
+
+    std::copy(v.name.begin(), v.name.end(), value_name);
+    value_name[v.name.size()] = L'\0';
+    *value_name_length = static_cast<DWORD>(v.name.size());
+    if (type) *type = v.type;
+
+    if (data_size)
+    {
+        const DWORD capacity = *data_size;
+        *data_size = static_cast<DWORD>(v.data.size());
+        if (data)
+        {
+            if (capacity < v.data.size()) return ERROR_MORE_DATA;
+            std::copy(v.data.begin(), v.data.end(), data);
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+LSTATUS RegQueryInfoKeyW(HKEY key, LPWSTR class_name, LPDWORD class_length, LPDWORD, LPDWORD sub_keys, LPDWORD max_sub_key_length, LPDWORD max_class_length,
+                         LPDWORD values, LPDWORD max_value_name_length, LPDWORD max_value_length, LPDWORD security_descriptor, FILETIME* last_write_time)
+{
+    std::unique_ptr<HKEY__> temporary{};
+    HKEY__* k{};
+    if (LSTATUS status = object_of(key, temporary, k); status != ERROR_SUCCESS) return status;
+
+    std::lock_guard lock(k->mutex);
+    if (LSTATUS status = k->refresh_sub_keys(); status != ERROR_SUCCESS) return status;
+    if (LSTATUS status = k->refresh_values(); status != ERROR_SUCCESS) return status;
+
+    size_t longest_key = 0, longest_name = 0, largest_data = 0;
+    for (auto& n : k->sub_keys) longest_key = std::max(longest_key, n.size());
+    for (auto& v : k->values)
+    {
+        longest_name = std::max(longest_name, v.name.size());
+        largest_data = std::max(largest_data, v.data.size());
+    }
+
+    if (class_name && class_length && *class_length) class_name[0] = L'\0';
+    if (class_length) *class_length = 0;
+    if (sub_keys) *sub_keys = static_cast<DWORD>(k->sub_keys.size());
+    if (max_sub_key_length) *max_sub_key_length = static_cast<DWORD>(longest_key);
+    if (max_class_length) *max_class_length = 0;
+    if (values) *values = static_cast<DWORD>(k->values.size());
+    if (max_value_name_length) *max_value_name_length = static_cast<DWORD>(longest_name);
+    if (max_value_length) *max_value_length = static_cast<DWORD>(largest_data);
+    if (security_descriptor) *security_descriptor = 0;
+    if (last_write_time)
+    {
+        timespec latest = k->sub_keys_version.modified;
+        const timespec& v = k->values_version.modified;
+        if (v.tv_sec > latest.tv_sec || (v.tv_sec == latest.tv_sec && v.tv_nsec > latest.tv_nsec)) latest = v;
+        *last_write_time = filetime_of(latest);
+    }
+    return ERROR_SUCCESS;
+}
+
+LSTATUS RegQueryValueExW(HKEY key, LPCWSTR value_name, LPDWORD, LPDWORD type, LPBYTE data, LPDWORD data_size)
+{
+    if (data && !data_size) return ERROR_INVALID_PARAMETER;
+
+    std::unique_ptr<HKEY__> temporary{};
+    HKEY__* k{};
+    if (LSTATUS status = object_of(key, temporary, k); status != ERROR_SUCCESS) return status;
+
+    std::lock_guard lock(k->mutex);
+    if (LSTATUS status = k->refresh_values(); status != ERROR_SUCCESS) return status;
+
+    const value* v = find_value(k->values, value_name ? value_name : L""); // null names the default value
+    if (!v) return ERROR_FILE_NOT_FOUND;
+    if (type) *type = v->type;
+
+    if (data_size)
+    {
+        const DWORD capacity = *data_size;
+        *data_size = static_cast<DWORD>(v->data.size());
+        if (data)
+        {
+            if (capacity < v->data.size()) return ERROR_MORE_DATA;
+            std::copy(v->data.begin(), v->data.end(), data);
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+LSTATUS RegQueryValueExA(HKEY key, LPCSTR value_name, LPDWORD reserved, LPDWORD type, LPBYTE data, LPDWORD data_size)
+{
+    // the ANSI code page is UTF-8 here.
+    std::wstring name{};
+    try { name = xtw::utf::to_utf16(value_name ? value_name : ""); }
+    catch (const std::invalid_argument&) { return ERROR_FILE_NOT_FOUND; }
+
+    DWORD value_type{}, size{};
+    if (LSTATUS status = RegQueryValueExW(key, name.c_str(), reserved, &value_type, nullptr, &size); status != ERROR_SUCCESS) return status;
+
+    std::vector<BYTE> bytes(size);
+    if (LSTATUS status = RegQueryValueExW(key, name.c_str(), reserved, &value_type, bytes.data(), &size); status != ERROR_SUCCESS) return status;
+    bytes.resize(size);
+
+    if (is_string_type(value_type))
+    {
+        std::string narrow{};
+        try { narrow = xtw::utf::to_utf8(std::wstring_view(reinterpret_cast<const wchar_t*>(bytes.data()), bytes.size() / sizeof(wchar_t))); }
+        catch (const std::invalid_argument&) { return ERROR_INVALID_DATA; }
+        bytes.assign(narrow.begin(), narrow.end());
+    }
+
+    if (type) *type = value_type;
+    if (data_size)
+    {
+        const DWORD capacity = *data_size;
+        *data_size = static_cast<DWORD>(bytes.size());
+        if (data)
+        {
+            if (capacity < bytes.size()) return ERROR_MORE_DATA;
+            std::copy(bytes.begin(), bytes.end(), data);
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+LSTATUS RegSetValueExW(HKEY key, LPCWSTR value_name, DWORD, DWORD type, const BYTE* data, DWORD data_size)
+{
+    if (!data && data_size) return ERROR_INVALID_PARAMETER;
+    const std::wstring_view name = value_name ? value_name : L"";
+
+    return update_values(key, [&](std::vector<value>& values)
+    {
+        value* v = find_value(values, name);
+        if (!v) v = &values.emplace_back(value{std::wstring(name), 0, {}});
+        v->type = type;
+        v->data.assign(data, data + data_size);
+        return static_cast<LSTATUS>(ERROR_SUCCESS);
+    });
+}
+
+LSTATUS RegDeleteValueW(HKEY key, LPCWSTR value_name)
+{
+    const std::wstring_view name = value_name ? value_name : L"";
+
+    return update_values(key, [&](std::vector<value>& values)
+    {
+        value* v = find_value(values, name);
+        if (!v) return static_cast<LSTATUS>(ERROR_FILE_NOT_FOUND);
+        values.erase(values.begin() + (v - values.data()));
+        return static_cast<LSTATUS>(ERROR_SUCCESS);
+    });
+}
+
+LSTATUS RegNotifyChangeKeyValue(HKEY key, BOOL watch_subtree, DWORD notify_filter, HANDLE event, BOOL asynchronous)
+{
+    if (predefined_index(key) >= 0) return ERROR_NOT_SUPPORTED;
+    if (!key) return ERROR_INVALID_HANDLE;
+    if (!(notify_filter & (REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET))) return ERROR_SUCCESS; // nothing here changes attributes or security
+
+    if (asynchronous) return event ? notifier().add(key, watch_subtree, notify_filter, event) : ERROR_INVALID_PARAMETER;
+
+    HANDLE wait = ::CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    if (!wait) return ERROR_OUTOFMEMORY;
+    LSTATUS status = notifier().add(key, watch_subtree, notify_filter, wait);
+    if (status == ERROR_SUCCESS) ::WaitForSingleObject(wait, INFINITE);
+    ::CloseHandle(wait);
+    return status;
+}
@@ -0,0 +1,153 @@
+/// @file
+/// @brief  tests of xtw::capabilities and xtw::dispatched_function
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#include <Windows.h>
+
+#include <atomic>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#include <xtw/capabilities.h>
+#include <xtw/threading.h>
+
+#include "./test.h"
+
+using namespace xtw;
+
+namespace
+{
+    int narrow_kernel(int x) { return x + 1; }
+    int wide_kernel(int x) { return x + 2; }
+
+    std::atomic<int> selections{};
+
+    dispatched_function<int(int)>::function_pointer select(const capabilities& c)
+    {
+        selections++;
+        return c.cpu.avx2 ? &wide_kernel : &narrow_kernel;
+    }
+
+    void append(std::vector<int>& out, int value) { out.push_back(value); }
+
+    bool is_power_of_two(size_t n) { return n && (n & (n - 1)) == 0; }
+}
+
+XTW_TEST(current_is_computed_once)
+{
+    XTW_CHECK(&capabilities::current() == &capabilities::current());
+
+    SYSTEM_INFO si{};
+    ::GetSystemInfo(&si);
+    XTW_CHECK(capabilities::current().logical_processor_count == si.dwNumberOfProcessors);
+    XTW_CHECK(capabilities::current().logical_processor_count >= 1);
+}
+
+XTW_TEST(cpu_features_are_consistent)
+{
+    const cpu_features& f = capabilities::current().cpu;
+
+    // the features that need OS support imply the ones they extend.
+    XTW_CHECK(!f.avx2 || f.avx);
+    XTW_CHECK(!f.fma || f.avx);
+    XTW_CHECK(!f.avx512dq || f.avx512f);
+    XTW_CHECK(!f.avx512bw || f.avx512f);
+    XTW_CHECK(!f.avx512vl || f.avx512f);
+    XTW_CHECK(!f.avx512f || f.avx2);
+    XTW_CHECK(!f.sse4_2 || f.sse4_1);
+
+#if defined(_M_X64) || defined(__x86_64__)
+    XTW_CHECK(f.sse2); // part of x86-64
+#endif
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+XTW_TEST(cpu_features_match_the_compiler_runtime)
+{
+    // libgcc and compiler-rt check the same cpuid bits and XCR0 state.
+    const cpu_features& f = capabilities::current().cpu;
+    __builtin_cpu_init();
+    XTW_CHECK(f.sse2 == !!__builtin_cpu_supports("sse2"));
+    XTW_CHECK(f.ssse3 == !!__builtin_cpu_supports("ssse3"));
+    XTW_CHECK(f.sse4_2 == !!__builtin_cpu_supports("sse4.2"));
+    XTW_CHECK(f.popcnt == !!__builtin_cpu_supports("popcnt"));
+    XTW_CHECK(f.avx == !!__builtin_cpu_supports("avx"));
+    XTW_CHECK(f.avx2 == !!__builtin_cpu_supports("avx2"));
+    XTW_CHECK(f.bmi2 == !!__builtin_cpu_supports("bmi2"));
+    XTW_CHECK(f.avx512f == !!__builtin_cpu_supports("avx512f"));
+}
+#endif
+
+XTW_TEST(cache_sizes_are_plausible)
+{
+    const cache_sizes& c = capabilities::current().cache;
+    if (!c.line_size)
+    {
+        XTW_CHECK(c.l1_data == 0); // nothing reported
+        return;
+    }
+
+    XTW_CHECK(is_power_of_two(c.line_size));
+    XTW_CHECK(c.l1_data >= c.line_size);
+    XTW_CHECK(!c.l2 || c.l2 >= c.l1_data);
+    XTW_CHECK(!c.l3 || c.l3 >= c.l2);
+
+#if !defined(_WIN32)
+    if (long l1 = ::sysconf(_SC_LEVEL1_DCACHE_SIZE); l1 > 0) XTW_CHECK(c.l1_data == static_cast<size_t>(l1));
+#endif
+}
+
+XTW_TEST(dispatched_function_selects_once)
+{
+    static const dispatched_function<int(int)> kernel{&select};
+    const int before = selections.load();
+
+    const int expected = capabilities::current().cpu.avx2 ? 12 : 11;
+    for (int i = 0; i < 100; i++) XTW_CHECK(kernel(10) == expected);
+    XTW_CHECK(selections.load() - before == 1);
+    XTW_CHECK(kernel.get() == kernel.get());
+}
+
+XTW_TEST(concurrent_first_calls_agree)
+{
+    static const dispatched_function<int(int)> kernel{&select};
+    const int before = selections.load();
+
+    constexpr int thread_count = 8;
+    std::atomic<int> arrived{};
+    std::vector<dispatched_function<int(int)>::function_pointer> bound(thread_count);
+    std::vector<threading::thread> threads{};
+    for (int i = 0; i < thread_count; i++)
+    {
+        threads.emplace_back([&, i]
+        {
+            arrived++;
+            while (arrived.load() < thread_count) ::SwitchToThread();
+            bound[i] = kernel.get();
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    for (auto f : bound) XTW_CHECK(f == bound[0]);
+    XTW_CHECK(bound[0] == kernel.get());
+    XTW_CHECK(selections.load() - before >= 1);
+    XTW_CHECK(selections.load() - before <= thread_count);
+}
+
+XTW_TEST(dispatched_function_forwards_references)
+{
+    static const dispatched_function<void(std::vector<int>&, int)> push{[](const capabilities&) { return &append; }};
+    std::vector<int> out{};
+    push(out, 1);
+    push(out, 2);
+    XTW_CHECK((out == std::vector<int>{1, 2}));
+}
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
@@ -0,0 +1,101 @@
+/// @file
+/// @brief  tests of xtw::deferred_handle_closer
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#include <Windows.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include <xtw/deferred_handle_closer.h>
+#include <xtw/threading.h>
+
+#include "./test.h"
+
+using namespace xtw;
+
+namespace
+{
+    std::atomic<int> closed{};
+    std::atomic<DWORD> closing_thread{};
+
+    struct counting_closer
+    {
+        void operator()(HANDLE p) const noexcept
+        {
+            closing_thread.store(::GetCurrentThreadId());
+            ::CloseHandle(p);
+            closed++;
+        }
+    };
+
+    using counted_handle = deferred_unique_handle_t<HANDLE, counting_closer>;
+
+    counted_handle new_event() { return counted_handle(::CreateEventW(nullptr, TRUE, FALSE, nullptr)); }
+
+    // constructed before the closer and so destroyed after it: a handle released then must still be closed, on the spot.
+    struct released_after_shutdown
+    {
+        counted_handle handle = new_event();
+
+        ~released_after_shutdown()
+        {
+            const int before = closed.load();
+            handle.reset();
+            if (closed.load() != before + 1)
+            {
+                std::fputs("a handle released after the closer was destroyed was not closed\n", stderr);
+                std::_Exit(1);
+            }
+        }
+    } late{};
+}
+
+XTW_TEST(handles_are_closed_on_the_worker_thread)
+{
+    const int before = closed.load();
+    std::vector<counted_handle> handles{};
+    for (int i = 0; i < 100; i++)
+    {
+        handles.push_back(new_event());
+        XTW_REQUIRE(handles.back().get() != nullptr);
+    }
+    handles.clear();
+
+    deferred_handle_closer::instance().flush();
+    XTW_CHECK(closed.load() - before == 100);
+    XTW_CHECK(closing_thread.load() != ::GetCurrentThreadId());
+}
+
+XTW_TEST(flush_waits_for_handles_queued_from_other_threads)
+{
+    const int before = closed.load();
+    std::vector<threading::thread> threads{};
+    for (int t = 0; t < 4; t++)
+        threads.emplace_back([] { for (int i = 0; i < 250; i++) (void)new_event(); });
+    for (auto& t : threads) t.join();
+
+    deferred_handle_closer::instance().flush();
+    XTW_CHECK(closed.load() - before == 1000);
+}
+
+XTW_TEST(null_handles_are_not_queued)
+{
+    const int before = closed.load();
+    {
+        counted_handle empty{};
+        counted_handle moved_from = new_event();
+        counted_handle owner = std::move(moved_from);
+    }
+    deferred_handle_closer::instance().flush();
+    XTW_CHECK(closed.load() - before == 1);
+}
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
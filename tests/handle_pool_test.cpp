@@ -0,0 +1,109 @@
+/// @file
+/// @brief  tests of xtw::handle_pool and xtw::threading::pooled_event
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#include <Windows.h>
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include <xtw/handle_pool.h>
+#include <xtw/threading.h>
+
+#include "./test.h"
+
+using namespace xtw;
+using namespace xtw::threading;
+
+// pooled_auto_reset_event once drew manual-reset kernel events and pooled_manual_reset_event auto-reset ones (CreateEventW takes bManualReset).
+
+XTW_TEST(pooled_auto_reset_event_consumes_the_signal)
+{
+    pooled_auto_reset_event e{};
+    XTW_CHECK(!e.wait_signal(0));
+    e.notify_signal();
+    XTW_CHECK(e.wait_signal(0));
+    XTW_CHECK(!e.wait_signal(0));
+
+    pooled_auto_reset_event initially_set(true);
+    XTW_CHECK(initially_set.wait_signal(0));
+    XTW_CHECK(!initially_set.wait_signal(0));
+}
+
+XTW_TEST(pooled_manual_reset_event_stays_signaled_until_reset)
+{
+    pooled_manual_reset_event e{};
+    XTW_CHECK(!e.wait_signal(0));
+    e.notify_signal();
+    XTW_CHECK(e.wait_signal(0));
+    XTW_CHECK(e.wait_signal(0));
+    e.reset_signal_state();
+    XTW_CHECK(!e.wait_signal(0));
+
+    pooled_manual_reset_event initially_set(true);
+    XTW_CHECK(initially_set.wait_signal(0));
+    XTW_CHECK(initially_set.wait_signal(0));
+}
+
+XTW_TEST(released_events_come_back_reset)
+{
+    HANDLE recycled{};
+    {
+        pooled_manual_reset_event e{};
+        e.notify_signal(); // released while signaled
+        recycled = e.handle();
+    }
+
+    pooled_manual_reset_event again{};
+    XTW_CHECK(again.handle() == recycled); // from this thread's cache
+    XTW_CHECK(!again.wait_signal(0));
+
+    // the two kinds come from separate pools.
+    pooled_auto_reset_event other{};
+    XTW_CHECK(other.handle() != recycled);
+}
+
+XTW_TEST(pooled_auto_reset_event_releases_one_waiter_per_signal)
+{
+    pooled_auto_reset_event e{};
+    std::atomic_int woken{};
+    thread a([&] { e.wait_signal(); ++woken; });
+    thread b([&] { e.wait_signal(); ++woken; });
+
+    e.notify_signal();
+    while (woken.load() == 0) ::Sleep(1);
+    ::Sleep(20);
+    XTW_CHECK(woken.load() == 1);
+
+    while (a.joinable() && !a.join(10)) e.notify_signal();
+    while (b.joinable() && !b.join(10)) e.notify_signal();
+    XTW_CHECK(woken.load() == 2);
+}
+
+XTW_TEST(shared_list_is_capped_by_the_high_water_mark)
+{
+    using pool = handle_pool<event_pool_traits<false>, 4>;
+    pool::set_high_water_mark(3);
+
+    // objects released on an exiting thread move to the shared list, up to the mark.
+    std::vector<pool::handle_type> handles{};
+    for (int i = 0; i < 8; i++) handles.push_back(pool::acquire());
+    thread t([&] { for (auto& h : handles) pool::release(std::move(h)); });
+    t.join();
+    XTW_CHECK(pool::shared_count() == 3u);
+
+    pool::set_high_water_mark(1);
+    XTW_CHECK(pool::shared_count() == 1u);
+
+    auto h = pool::acquire(); // refilled from the shared list
+    XTW_CHECK(h.get() != nullptr);
+    XTW_CHECK(pool::shared_count() == 0u);
+    XTW_CHECK(::WaitForSingleObject(h.get(), 0) == WAIT_TIMEOUT);
+}
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
@@ -0,0 +1,201 @@
+/// @file
+/// @brief  tests of xtw::io_context
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#include <Windows.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <xtw/io_context.h>
+
+#include "./test.h"
+
+using namespace xtw;
+
+namespace
+{
+    // a file in the temporary directory, opened for overlapped I/O and deleted on destruction.
+    class scratch_file final
+    {
+        std::wstring path_{};
+        unique_handle handle_{};
+
+    public:
+        scratch_file()
+        {
+            static int sequence = 0;
+            wchar_t directory[MAX_PATH + 1]{};
+            ::GetTempPathW(MAX_PATH + 1, directory);
+            const std::string name = "xtw-io-" + std::to_string(::GetCurrentProcessId()) + "-" + std::to_string(sequence++) + ".bin";
+            path_ = directory + std::wstring(name.begin(), name.end());
+            handle_.reset(::CreateFileW(path_.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr));
+        }
+
+        scratch_file(const scratch_file& other) = delete;
+        scratch_file& operator=(const scratch_file& other) = delete;
+
+        ~scratch_file()
+        {
+            handle_.reset();
+            ::DeleteFileW(path_.c_str());
+        }
+
+        [[nodiscard]] HANDLE get() const noexcept { return handle_.get(); }
+    };
+
+    // waits for the context to finish all operations, so that a failed check does not hang the test.
+    bool drained(const io_context& io)
+    {
+        const ULONGLONG deadline = ::GetTickCount64() + 5000;
+        while (io.outstanding() != 0)
+        {
+            if (::GetTickCount64() > deadline) return false;
+            ::Sleep(1);
+        }
+        return true;
+    }
+}
+
+XTW_TEST(posted_functions_run_on_workers)
+{
+    io_context io(4);
+    std::atomic<int> runs{};
+    const DWORD caller = ::GetCurrentThreadId();
+    std::atomic<int> on_caller{};
+    for (int i = 0; i < 1000; i++)
+    {
+        XTW_REQUIRE(io.post([&]
+        {
+            runs++;
+            if (::GetCurrentThreadId() == caller) on_caller++;
+        }));
+    }
+    XTW_CHECK(drained(io));
+    XTW_CHECK(runs.load() == 1000);
+    XTW_CHECK(on_caller.load() == 0);
+}
+
+XTW_TEST(stop_does_not_wait_for_stop_packets_taken_by_another_worker)
+{
+    // with no traffic, one worker may dequeue every stop packet in one batch; the others must still stop.
+    for (int i = 0; i < 50; i++)
+    {
+        io_context io(8);
+        if (i % 2) (void)io.post([] {});
+    }
+}
+
+XTW_TEST(writes_and_reads_complete_through_the_port)
+{
+    scratch_file file{};
+    XTW_REQUIRE(file.get() != INVALID_HANDLE_VALUE);
+
+    io_context io(2);
+    io.associate(file.get());
+
+    const std::string text = "completion-based I/O";
+    io_context::result written{};
+    XTW_REQUIRE(io.write(file.get(), 4096, text.data(), static_cast<DWORD>(text.size()), written.handler()) == ERROR_SUCCESS);
+    XTW_REQUIRE(written.done.wait_signal(5000));
+    XTW_CHECK(written.error == ERROR_SUCCESS);
+    XTW_CHECK(written.bytes_transferred == text.size());
+
+    std::string read_back(text.size(), '\0');
+    io_context::result read{};
+    XTW_REQUIRE(io.read(file.get(), 4096, read_back.data(), static_cast<DWORD>(read_back.size()), read.handler()) == ERROR_SUCCESS);
+    XTW_REQUIRE(read.done.wait_signal(5000));
+    XTW_CHECK(read.error == ERROR_SUCCESS);
+    XTW_CHECK(read_back == text);
+
+    // a read at the end of the file fails to issue, or completes with ERROR_HANDLE_EOF.
+    io_context::result eof{};
+    const DWORD issued = io.read(file.get(), 1 << 20, read_back.data(), 1, eof.handler());
+    XTW_CHECK(issued == ERROR_HANDLE_EOF || (issued == ERROR_SUCCESS && eof.done.wait_signal(5000) && eof.error == ERROR_HANDLE_EOF));
+    XTW_CHECK(drained(io));
+}
+
+XTW_TEST(batches_are_issued_in_order)
+{
+    scratch_file file{};
+    io_context io(2);
+    io.associate(file.get());
+
+    std::vector<char> blocks(8 * 512);
+    for (size_t i = 0; i < blocks.size(); i++) blocks[i] = static_cast<char>('a' + i / 512);
+
+    std::atomic<int> completed{};
+    std::vector<io_context::request> batch{};
+    for (size_t i = 0; i < 8; i++)
+        batch.push_back({file.get(), i * 512, blocks.data() + i * 512, 512, true, [&](DWORD e, DWORD b) { if (e == ERROR_SUCCESS && b == 512) completed++; }});
+    XTW_CHECK(io.submit(batch) == 8u);
+    XTW_CHECK(drained(io));
+    XTW_CHECK(completed.load() == 8);
+
+    std::vector<char> read_back(blocks.size());
+    io_context::result read{};
+    XTW_REQUIRE(io.read(file.get(), 0, read_back.data(), static_cast<DWORD>(read_back.size()), read.handler()) == ERROR_SUCCESS);
+    XTW_REQUIRE(read.done.wait_signal(5000));
+    XTW_CHECK(read_back == blocks);
+}
+
+XTW_TEST(operations_are_limited_by_max_outstanding)
+{
+    io_context io(1, 2);
+    threading::manual_reset_event release{};
+    XTW_REQUIRE(io.post([&] { release.wait_signal(); }));
+    XTW_REQUIRE(io.post([] {}));
+    XTW_CHECK(io.outstanding() == 2u);
+    XTW_CHECK(!io.post([] {}));
+
+    release.notify_signal();
+    XTW_CHECK(drained(io));
+    XTW_CHECK(io.post([] {}));
+    XTW_CHECK(drained(io));
+}
+
+XTW_TEST(registered_buffers_are_held_while_requests_are_in_flight)
+{
+    scratch_file file{};
+    io_context io(2);
+    io.associate(file.get());
+    registered_buffers buffers(1000, 2);
+    XTW_CHECK(buffers.buffer_size() == 4096u); // rounded up to pages
+    XTW_CHECK(reinterpret_cast<uintptr_t>(buffers.buffer(1)) % 4096 == 0);
+
+    size_t index{};
+    XTW_REQUIRE(buffers.acquire(index));
+    std::memcpy(buffers.buffer(index), "registered", 10);
+    io_context::result written{};
+    XTW_REQUIRE(io.write(file.get(), 0, buffers, index, 10, written.handler()) == ERROR_SUCCESS);
+    XTW_REQUIRE(written.done.wait_signal(5000));
+    XTW_CHECK(written.bytes_transferred == 10u);
+
+    std::string seen{};
+    threading::manual_reset_event done{};
+    XTW_REQUIRE(io.read(file.get(), 0, buffers, 10, [&](DWORD e, DWORD b, std::byte* data)
+    {
+        if (e == ERROR_SUCCESS) seen.assign(reinterpret_cast<const char*>(data), b);
+        done.notify_signal();
+    }) == ERROR_SUCCESS);
+    XTW_REQUIRE(done.wait_signal(5000));
+    XTW_CHECK(seen == "registered");
+    XTW_CHECK(drained(io));
+
+    // both buffers are free again; a read larger than a buffer is refused.
+    size_t a{}, b{}, c{};
+    XTW_CHECK(buffers.acquire(a) && buffers.acquire(b) && !buffers.acquire(c));
+    XTW_CHECK(io.read(file.get(), 0, buffers, 10, [](DWORD, DWORD, std::byte*) {}) == ERROR_NOT_ENOUGH_QUOTA);
+    buffers.release(a);
+    buffers.release(b);
+    XTW_CHECK(io.read(file.get(), 0, buffers, 8192, [](DWORD, DWORD, std::byte*) {}) == ERROR_INVALID_PARAMETER);
+}
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
@@ -0,0 +1,268 @@
+/// @file
+/// @brief  tests of xtw::ipc::shm_ring
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#include <Windows.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <xtw/ipc.h>
+#include <xtw/threading.h>
+
+#include "./test.h"
+
+using namespace xtw;
+using ipc::shm_ring;
+
+namespace
+{
+    std::wstring ring_name()
+    {
+        static int sequence = 0;
+        const std::string name = "Local\\xtw-ipc-" + std::to_string(::GetCurrentProcessId()) + "-" + std::to_string(sequence++);
+        return std::wstring(name.begin(), name.end());
+    }
+
+    // a second mapping of a ring's section, as another process would see it.
+    class raw_section final
+    {
+        unique_handle section_{};
+        mapped_view_unique_handle view_{};
+
+    public:
+        explicit raw_section(const std::wstring& name)
+        {
+            section_.reset(::OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, name.c_str()));
+            if (section_) view_.reset(::MapViewOfFile(section_.get(), FILE_MAP_ALL_ACCESS, 0, 0, 0));
+        }
+
+        // creates a section of `size` bytes that is not a ring yet.
+        raw_section(const std::wstring& name, DWORD size)
+        {
+            section_.reset(::CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, size, name.c_str()));
+            if (section_) view_.reset(::MapViewOfFile(section_.get(), FILE_MAP_ALL_ACCESS, 0, 0, 0));
+        }
+
+        explicit operator bool() const noexcept { return view_.get() != nullptr; }
+        [[nodiscard]] ipc::shm_ring_detail::header* header() const noexcept { return static_cast<ipc::shm_ring_detail::header*>(view_.get()); }
+        [[nodiscard]] std::byte* data() const noexcept { return static_cast<std::byte*>(view_.get()) + header()->header_size; }
+    };
+
+    struct numbered
+    {
+        uint32_t producer;
+        uint32_t sequence;
+    };
+
+    bool write_text(shm_ring& ring, const std::string& text) { return ring.write(text.data(), text.size(), 5000) == shm_ring::status::ok; }
+
+    std::string read_text(shm_ring& ring, shm_ring::status* status = nullptr, DWORD timeout = 5000)
+    {
+        std::string text{};
+        const auto s = ring.read([&](const std::byte* data, size_t length) { text.assign(reinterpret_cast<const char*>(data), length); }, timeout);
+        if (status) *status = s;
+        return text;
+    }
+
+    template <class F>
+    bool throws(F&& f)
+    {
+        try { f(); }
+        catch (const win32_exception&) { return true; }
+        return false;
+    }
+}
+
+XTW_TEST(records_round_trip_across_wraps)
+{
+    const auto name = ring_name();
+    auto consumer = shm_ring::create(name.c_str(), 4096);
+    auto producer = shm_ring::open(name.c_str());
+    XTW_CHECK(consumer.capacity() == 4096u);
+    XTW_CHECK(producer.ring_mode() == shm_ring::mode::mpsc);
+    XTW_CHECK(producer.consumer_alive());
+    XTW_CHECK(consumer.producers_alive());
+
+    // sizes that do not divide the capacity make records reach the end of the ring and skip to its beginning.
+    for (size_t i = 0; i < 500; i++)
+    {
+        const std::string text(1 + i * 37 % 700, static_cast<char>('a' + i % 26));
+        XTW_REQUIRE(write_text(producer, text));
+        XTW_REQUIRE(read_text(consumer) == text);
+    }
+
+    XTW_CHECK(!producer.try_write("x", producer.max_record_size() + 1));
+    XTW_CHECK(throws([] { (void)shm_ring::open(L"Local\\xtw-ipc-missing"); }));
+    XTW_CHECK(throws([&] { (void)shm_ring::create(name.c_str(), 4096); })); // exists
+}
+
+XTW_TEST(concurrent_producers_keep_their_own_order)
+{
+    const auto name = ring_name();
+    auto consumer = shm_ring::create(name.c_str(), 16384);
+
+    constexpr uint32_t producer_count = 4;
+    constexpr uint32_t records = 5000;
+    std::vector<threading::thread> producers{};
+    for (uint32_t p = 0; p < producer_count; p++)
+    {
+        producers.emplace_back([&name, p]
+        {
+            auto producer = shm_ring::open(name.c_str());
+            for (uint32_t i = 0; i < records; i++)
+            {
+                const numbered n{p, i};
+                if (producer.write(&n, sizeof(n), 5000) != shm_ring::status::ok) return;
+            }
+        });
+    }
+
+    std::vector<uint32_t> next(producer_count);
+    bool ordered = true;
+    for (uint32_t i = 0; i < producer_count * records; i++)
+    {
+        numbered n{};
+        const auto s = consumer.read([&](const std::byte* data, size_t length)
+        {
+            if (length == sizeof(n)) std::memcpy(&n, data, sizeof(n));
+        }, 5000);
+        XTW_REQUIRE(s == shm_ring::status::ok);
+        XTW_REQUIRE(n.producer < producer_count);
+        ordered &= n.sequence == next[n.producer]++;
+    }
+    for (auto& t : producers) t.join();
+
+    XTW_CHECK(ordered);
+    XTW_CHECK(!consumer.try_read([](const std::byte*, size_t) {}));
+}
+
+XTW_TEST(single_producer_rings_refuse_a_second_producer)
+{
+    const auto name = ring_name();
+    auto consumer = shm_ring::create(name.c_str(), 8192, shm_ring::mode::spsc);
+    {
+        auto producer = shm_ring::open(name.c_str());
+        XTW_CHECK(producer.ring_mode() == shm_ring::mode::spsc);
+        XTW_CHECK(throws([&] { (void)shm_ring::open(name.c_str()); }));
+
+        threading::thread writer([&producer]
+        {
+            for (uint32_t i = 0; i < 20000; i++)
+                if (producer.write(&i, sizeof(i), 5000) != shm_ring::status::ok) return;
+        });
+
+        bool ordered = true;
+        for (uint32_t i = 0; i < 20000; i++)
+        {
+            uint32_t value = ~0u;
+            XTW_REQUIRE(consumer.read([&](const std::byte* data, size_t) { std::memcpy(&value, data, sizeof(value)); }, 5000) == shm_ring::status::ok);
+            ordered &= value == i;
+        }
+        writer.join();
+        XTW_CHECK(ordered);
+    }
+
+    // the slot is free again once the producer closes the ring.
+    auto next = shm_ring::open(name.c_str());
+    XTW_CHECK(write_text(next, "again"));
+    XTW_CHECK(read_text(consumer) == "again");
+}
+
+XTW_TEST(open_rejects_malformed_sections)
+{
+    const auto name = ring_name();
+    raw_section section(name, 8192);
+    XTW_REQUIRE(section);
+    auto h = new(section.header()) ipc::shm_ring_detail::header{};
+    XTW_CHECK(throws([&] { (void)shm_ring::open(name.c_str()); })); // no magic yet
+
+    const auto rejected = [&](uint32_t header_size, uint64_t capacity)
+    {
+        h->header_size = header_size;
+        h->capacity = capacity;
+        h->magic.store(ipc::shm_ring_detail::magic);
+        return throws([&] { (void)shm_ring::open(name.c_str()); });
+    };
+
+    constexpr auto header_size = static_cast<uint32_t>((sizeof(ipc::shm_ring_detail::header) + 63) & ~size_t{63});
+    XTW_CHECK(!rejected(header_size, 4096));
+    XTW_CHECK(rejected(header_size, 3000));             // not a power of two
+    XTW_CHECK(rejected(header_size, 2048));             // too small
+    XTW_CHECK(rejected(header_size, 8192));             // beyond the section
+    XTW_CHECK(rejected(header_size, uint64_t{1} << 63)); // overflows
+    XTW_CHECK(rejected(8, 4096));                       // overlaps the header
+    XTW_CHECK(rejected(header_size + 8, 4096));         // misaligned
+    XTW_CHECK(rejected(1u << 20, 4096));                // beyond the section
+}
+
+XTW_TEST(records_of_lost_producers_are_reclaimed)
+{
+    const auto name = ring_name();
+    auto consumer = shm_ring::create(name.c_str(), 4096);
+    auto producer = shm_ring::open(name.c_str());
+    raw_section section(name);
+    XTW_REQUIRE(section);
+    auto h = section.header();
+
+    // a producer in slot 2 that died after marking its reservation; no such process exists.
+    constexpr DWORD dead_pid = 0x7FFFFFF0;
+    XTW_REQUIRE(h->producer_pids[1].load() == 0);
+    h->producer_pids[1].store(dead_pid);
+
+    XTW_REQUIRE(write_text(producer, "before"));
+    const uint64_t position = h->reserve.fetch_add(16);
+    reinterpret_cast<std::atomic<uint64_t>*>(section.data() + (position & (h->capacity - 1)))->store(8 | ipc::shm_ring_detail::claimed | uint64_t{2} << ipc::shm_ring_detail::slot_shift);
+    XTW_REQUIRE(write_text(producer, "after"));
+
+    XTW_CHECK(read_text(consumer) == "before");
+    XTW_CHECK(!consumer.producers_alive());
+    shm_ring::status s{};
+    XTW_CHECK(read_text(consumer, &s, 1000).empty());
+    XTW_CHECK(s == shm_ring::status::peer_lost);
+
+    XTW_CHECK(consumer.reclaim_lost_producers());
+    XTW_CHECK(consumer.producers_alive());
+    XTW_CHECK(h->producer_pids[1].load() == 0);
+    XTW_CHECK(read_text(consumer) == "after");
+
+    // a reservation without a mark may belong to a live producer: nothing is reclaimed.
+    h->producer_pids[1].store(dead_pid);
+    (void)h->reserve.fetch_add(16);
+    XTW_CHECK(!consumer.reclaim_lost_producers());
+    XTW_CHECK(h->producer_pids[1].load() == dead_pid);
+    h->producer_pids[1].store(0);
+}
+
+XTW_TEST(waits_time_out_and_notice_a_closed_consumer)
+{
+    const auto name = ring_name();
+    auto consumer = std::make_unique<shm_ring>(shm_ring::create(name.c_str(), 4096));
+    auto producer = shm_ring::open(name.c_str());
+
+    shm_ring::status s{};
+    const ULONGLONG start = ::GetTickCount64();
+    (void)read_text(*consumer, &s, 50);
+    XTW_CHECK(s == shm_ring::status::timeout);
+    XTW_CHECK(::GetTickCount64() - start >= 40);
+
+    const std::string record(1000, 'x');
+    while (producer.try_write(record.data(), record.size())) {}
+    XTW_CHECK(producer.write(record.data(), record.size(), 50) == shm_ring::status::timeout);
+
+    consumer.reset();
+    XTW_CHECK(!producer.consumer_alive());
+    XTW_CHECK(producer.write(record.data(), record.size(), 5000) == shm_ring::status::peer_lost);
+}
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
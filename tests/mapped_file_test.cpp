@@ -0,0 +1,165 @@
+/// @file
+/// @brief  tests of xtw::mapped_file
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#include <Windows.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <xtw/mapped_file.h>
+
+#include "./test.h"
+
+using namespace xtw;
+
+namespace
+{
+    // a path in the temporary directory, deleted on destruction.
+    class scratch_path final
+    {
+        std::wstring path_{};
+
+    public:
+        explicit scratch_path(const char* name)
+        {
+            static int sequence = 0;
+            wchar_t directory[MAX_PATH + 1]{};
+            ::GetTempPathW(MAX_PATH + 1, directory);
+            const std::string file = "xtw-mapped-" + std::to_string(::GetCurrentProcessId()) + "-" + std::to_string(sequence++) + "-" + name;
+            path_ = directory + std::wstring(file.begin(), file.end());
+        }
+
+        scratch_path(const scratch_path& other) = delete;
+        scratch_path& operator=(const scratch_path& other) = delete;
+        ~scratch_path() { ::DeleteFileW(path_.c_str()); }
+
+        [[nodiscard]] const wchar_t* get() const noexcept { return path_.c_str(); }
+    };
+
+    // byte i of the test pattern.
+    std::byte pattern(uint64_t i) { return static_cast<std::byte>(i * 131 + (i >> 12)); }
+
+    void fill(const mapped_view& view)
+    {
+        for (size_t i = 0; i < view.size(); i++) view.data()[i] = pattern(view.offset() + i);
+    }
+
+    bool matches(const std::byte* data, uint64_t offset, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+            if (data[i] != pattern(offset + i)) return false;
+        return true;
+    }
+}
+
+XTW_TEST(written_data_is_read_back)
+{
+    scratch_path path("data.bin");
+    constexpr uint64_t size = 3u << 20;
+    {
+        auto f = mapped_file::open(path.get(), mapped_file::access::read_write, size);
+        XTW_CHECK(f.size() == size);
+        XTW_CHECK(f.writable());
+        auto view = f.map();
+        XTW_REQUIRE(view.size() == size);
+        fill(view);
+        XTW_CHECK(view.flush());
+    }
+
+    auto f = mapped_file::open(path.get());
+    XTW_CHECK(f.size() == size);
+    XTW_CHECK(!f.writable());
+    auto view = f.map();
+    XTW_CHECK(matches(view.data(), 0, view.size()));
+
+    // unaligned offsets are aligned internally; lengths are clipped to the file.
+    auto middle = f.map(12345, 1000);
+    XTW_CHECK(middle.offset() == 12345u);
+    XTW_CHECK(middle.size() == 1000u);
+    XTW_CHECK(matches(middle.data(), 12345, middle.size()));
+
+    auto tail = f.map(size - 10);
+    XTW_CHECK(tail.size() == 10u);
+    XTW_CHECK(f.map(size).empty());
+
+    bool thrown = false;
+    try { (void)f.map(size + 1); }
+    catch (const std::out_of_range&) { thrown = true; }
+    XTW_CHECK(thrown);
+}
+
+XTW_TEST(missing_files_throw)
+{
+    scratch_path path("missing.bin");
+    bool thrown = false;
+    try { (void)mapped_file::open(path.get()); }
+    catch (const win32_exception&) { thrown = true; }
+    XTW_CHECK(thrown);
+}
+
+XTW_TEST(evicted_pages_keep_their_data)
+{
+    scratch_path path("evict.bin");
+    auto f = mapped_file::open(path.get(), mapped_file::access::read_write, 1u << 20);
+    auto view = f.map(0, 1u << 20);
+    fill(view); // dirty, not flushed
+
+    XTW_CHECK(view.prefetch(4096, 65536));
+    XTW_CHECK(view.evict());
+    XTW_CHECK(matches(view.data(), 0, view.size()));
+
+    XTW_CHECK(view.evict(100, 10)); // unaligned ranges cover their pages
+    XTW_CHECK(!view.evict(view.size()));
+    XTW_CHECK(!view.prefetch(view.size()));
+}
+
+XTW_TEST(window_slides_over_the_file)
+{
+    scratch_path path("window.bin");
+    constexpr uint64_t size = 5u << 20;
+    {
+        auto f = mapped_file::open(path.get(), mapped_file::access::read_write, size);
+        fill(f.map());
+    }
+
+    auto f = mapped_file::open(path.get());
+    mapped_window window(f, 1u << 20);
+    for (uint64_t offset = 0; offset + 4096 <= size; offset += 300000)
+        XTW_CHECK(matches(window.at(offset, 4096), offset, 4096));
+    XTW_CHECK(window.view().size() <= 1u << 20);
+
+    bool thrown = false;
+    try { (void)window.at(size - 100, 200); }
+    catch (const std::out_of_range&) { thrown = true; }
+    XTW_CHECK(thrown);
+}
+
+XTW_TEST(anonymous_mappings_fall_back_to_normal_pages)
+{
+    constexpr uint64_t size = 3u << 20;
+    for (bool large : {false, true})
+    {
+        auto f = mapped_file::create_anonymous(size, large); // large pages are used only where they are available.
+        XTW_CHECK(f.size() == size);
+        XTW_CHECK(large || !f.large_pages());
+        if (f.large_pages()) XTW_CHECK(f.view_alignment() == ::GetLargePageMinimum());
+
+        auto view = f.map();
+        XTW_REQUIRE(view.size() == size);
+        fill(view);
+
+        // a second view of the same section sees the writes.
+        auto other = f.map(1u << 20, 4096);
+        XTW_CHECK(matches(other.data(), 1u << 20, 4096));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
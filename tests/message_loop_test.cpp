@@ -0,0 +1,215 @@
+/// @file
+/// @brief  tests of xtw::window::message_loop
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#include <Windows.h>
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <xtw/message_loop.h>
+
+#include "./test.h"
+
+using namespace xtw::window;
+
+namespace
+{
+    // a queue of messages and a clock, both scripted; waits advance the clock.
+    class scripted_source final : public message_source
+    {
+    public:
+        std::deque<queued_message> queue{};
+        std::vector<queued_message> dispatched{};
+        std::deque<size_t> signaled{}; // handle indices returned by the next waits, before input or timeouts
+        int64_t time{};
+        int64_t time_per_peek{};
+        size_t wait_count{};
+
+        bool peek(queued_message& msg) override
+        {
+            time += time_per_peek;
+            if (queue.empty()) return false;
+            msg = queue.front();
+            queue.pop_front();
+            return true;
+        }
+
+        void dispatch(const queued_message& msg) override { dispatched.push_back(msg); }
+
+        wake wait(size_t count, void* const*, uint32_t milliseconds) override
+        {
+            wait_count++;
+            if (!signaled.empty() && signaled.front() < count)
+            {
+                const size_t index = signaled.front();
+                signaled.pop_front();
+                return wake{wake_reason::handle, index};
+            }
+            if (!queue.empty()) return wake{wake_reason::input, 0};
+            if (milliseconds != infinite) time += int64_t{milliseconds} * 1000;
+            return wake{wake_reason::timeout, 0};
+        }
+
+        int64_t now() override { return time; }
+
+        void post(uintptr_t window, uint32_t id, uintptr_t wparam = 0, intptr_t lparam = 0)
+        {
+            queue.push_back(queued_message{reinterpret_cast<void*>(window), id, wparam, lparam, 0, 0, 0});
+        }
+
+        // the dispatched messages as (window, id, lparam) triples, and forgets them.
+        std::vector<std::vector<intptr_t>> take()
+        {
+            std::vector<std::vector<intptr_t>> r{};
+            for (auto& m : dispatched) r.push_back({static_cast<intptr_t>(reinterpret_cast<uintptr_t>(m.window)), static_cast<intptr_t>(m.id), m.lparam});
+            dispatched.clear();
+            return r;
+        }
+    };
+
+    using triples = std::vector<std::vector<intptr_t>>;
+
+    constexpr uintptr_t left_button = 0x0001; // MK_LBUTTON
+    constexpr uintptr_t restored = 0;         // SIZE_RESTORED
+    constexpr uintptr_t maximized = 2;        // SIZE_MAXIMIZED
+}
+
+XTW_TEST(mouse_moves_collapse_to_the_last)
+{
+    scripted_source source{};
+    message_loop loop(source);
+
+    source.post(1, WM_MOUSEMOVE, 0, 10);
+    source.post(1, WM_MOUSEMOVE, 0, 11);
+    source.post(1, WM_MOUSEMOVE, 0, 12);
+    source.post(1, WM_MOUSEMOVE, left_button, 13); // another key state: a new stream
+    source.post(1, WM_MOUSEMOVE, left_button, 14);
+    source.post(2, WM_MOUSEMOVE, left_button, 20); // another window
+    source.post(2, WM_NCMOUSEMOVE, 0, 21);
+    source.post(2, WM_NCMOUSEMOVE, 0, 22);
+    XTW_CHECK(loop.pump());
+
+    XTW_CHECK((source.take() == triples{{1, WM_MOUSEMOVE, 12}, {1, WM_MOUSEMOVE, 14}, {2, WM_MOUSEMOVE, 20}, {2, WM_NCMOUSEMOVE, 22}}));
+}
+
+XTW_TEST(coalescing_keeps_the_order_with_other_messages)
+{
+    scripted_source source{};
+    message_loop loop(source);
+
+    source.post(1, WM_MOUSEMOVE, 0, 1);
+    source.post(1, WM_MOUSEMOVE, 0, 2);
+    source.post(1, WM_KEYDOWN, 0, 3);
+    source.post(1, WM_MOUSEMOVE, 0, 4);
+    source.post(1, WM_MOUSEMOVE, 0, 5);
+    XTW_CHECK(loop.pump());
+
+    XTW_CHECK((source.take() == triples{{1, WM_MOUSEMOVE, 2}, {1, WM_KEYDOWN, 3}, {1, WM_MOUSEMOVE, 5}}));
+}
+
+XTW_TEST(sizes_collapse_per_window)
+{
+    scripted_source source{};
+    message_loop loop(source);
+
+    source.post(1, WM_SIZE, restored, 100);
+    source.post(1, WM_SIZE, restored, 101);
+    source.post(1, WM_SIZE, maximized, 102); // any WM_SIZE supersedes the previous one
+    source.post(2, WM_SIZE, restored, 200);
+    source.post(2, WM_SIZE, restored, 201);
+    source.post(1, WM_SIZE, restored, 103);
+    XTW_CHECK(loop.pump());
+
+    XTW_CHECK((source.take() == triples{{1, WM_SIZE, 102}, {2, WM_SIZE, 201}, {1, WM_SIZE, 103}}));
+}
+
+XTW_TEST(paint_arrives_once_per_window_per_drain)
+{
+    scripted_source source{};
+    message_loop loop(source);
+
+    source.post(1, WM_PAINT);
+    source.post(2, WM_PAINT);
+    source.post(1, WM_PAINT); // window 1 is still invalid: the drain ends here
+    source.post(3, WM_KEYDOWN, 0, 1);
+    XTW_CHECK(loop.pump());
+    XTW_CHECK((source.take() == triples{{1, WM_PAINT, 0}, {2, WM_PAINT, 0}}));
+
+    XTW_CHECK(loop.pump());
+    XTW_CHECK((source.take() == triples{{3, WM_KEYDOWN, 1}}));
+
+    // the next drain may paint again.
+    source.post(1, WM_PAINT);
+    XTW_CHECK(loop.pump());
+    XTW_CHECK((source.take() == triples{{1, WM_PAINT, 0}}));
+}
+
+XTW_TEST(quit_flushes_collapsed_messages)
+{
+    scripted_source source{};
+    message_loop loop(source);
+
+    source.post(1, WM_MOUSEMOVE, 0, 1);
+    source.post(1, WM_MOUSEMOVE, 0, 2);
+    source.post(0, WM_QUIT, 7);
+    source.post(1, WM_KEYDOWN);
+    XTW_CHECK(!loop.pump());
+    XTW_CHECK(loop.quit_requested());
+    XTW_CHECK(loop.exit_code() == 7);
+    XTW_CHECK((source.take() == triples{{1, WM_MOUSEMOVE, 2}}));
+    XTW_CHECK(!loop.pump());
+    XTW_CHECK(source.queue.size() == 1u);
+}
+
+XTW_TEST(drains_stop_at_the_message_budget)
+{
+    scripted_source source{};
+    source.time_per_peek = 1000;
+    message_loop loop(source);
+    loop.set_message_budget(2500);
+
+    for (int i = 0; i < 5; i++) source.post(1, WM_KEYDOWN, 0, i);
+    XTW_CHECK(loop.pump());
+    XTW_CHECK(source.take().size() == 3u);
+    XTW_CHECK(loop.pump());
+    XTW_CHECK(source.take().size() == 2u);
+}
+
+XTW_TEST(frames_are_paced_and_report_counts)
+{
+    scripted_source source{};
+    message_loop loop(source);
+    int signaled = 0;
+    int marker = 0;
+    loop.add_wait(&marker, [&] { signaled++; });
+
+    source.post(1, WM_MOUSEMOVE, 0, 1);
+    source.post(1, WM_MOUSEMOVE, 0, 2);
+    source.signaled.push_back(0);
+
+    std::vector<message_loop::frame_info> frames{};
+    const int exit_code = loop.run([&](const message_loop::frame_info& f)
+    {
+        frames.push_back(f);
+        if (f.frame_index == 2) source.post(0, WM_QUIT, 3);
+        return true;
+    }, 16000);
+
+    XTW_CHECK(exit_code == 3);
+    XTW_REQUIRE(frames.size() == 3u);
+    XTW_CHECK(frames[0].dispatched_count == 1u);
+    XTW_CHECK(frames[0].coalesced_count == 1u);
+    XTW_CHECK(frames[1].time - frames[0].time == 16000);
+    XTW_CHECK(frames[2].delta_time == 16000);
+    XTW_CHECK(signaled == 1);
+
+    loop.remove_wait(&marker);
+}
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
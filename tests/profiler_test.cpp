@@ -0,0 +1,100 @@
+/// @file
+/// @brief  tests of xtw::debug::sampling_profiler
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#include <Windows.h>
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include <xtw/profiler.h>
+#include <xtw/threading.h>
+
+#include "./test.h"
+
+using namespace xtw;
+
+namespace
+{
+    // keeps a thread busy until stopped.
+    uint64_t spin(const std::atomic_bool& stop)
+    {
+        uint64_t x = 1;
+        while (!stop.load(std::memory_order_relaxed))
+            for (int i = 0; i < 1000; i++) x = x * 6364136223846793005u + 1442695040888963407u;
+        return x;
+    }
+}
+
+XTW_TEST(registered_threads_are_sampled)
+{
+    debug::sampling_profiler profiler(1000);
+    std::atomic_bool stop{};
+    std::atomic<uint64_t> sink{};
+    threading::thread busy([&] { sink = spin(stop); }, threading::thread::join_on_destructor, 65536, THREAD_PRIORITY_NORMAL, L"busy");
+
+    profiler.start();
+    while (profiler.sample_count() < 20) ::Sleep(10);
+    profiler.stop();
+    stop.store(true);
+
+    const uint64_t count = profiler.sample_count();
+    const std::string folded = profiler.folded_stacks(true);
+    XTW_CHECK(folded.rfind("busy;", 0) == 0);
+
+    // every sample is aggregated once.
+    uint64_t total = 0;
+    for (size_t line = 0; line < folded.size();)
+    {
+        const size_t end = folded.find('\n', line);
+        total += std::stoull(folded.substr(folded.rfind(' ', end) + 1, end - folded.rfind(' ', end) - 1));
+        line = end + 1;
+    }
+    XTW_CHECK(total == count);
+    XTW_CHECK(profiler.folded_stacks().empty());
+}
+
+XTW_TEST(sampled_threads_sleep_and_wait_the_whole_time)
+{
+    debug::sampling_profiler profiler(1000);
+    threading::manual_reset_event never{};
+    std::atomic<int64_t> slept_ms{}, waited_ms{};
+    threading::thread sleeper([&]
+    {
+        const ULONGLONG start = ::GetTickCount64();
+        ::Sleep(200);
+        slept_ms = static_cast<int64_t>(::GetTickCount64() - start);
+        (void)never.wait_signal(200);
+        waited_ms = static_cast<int64_t>(::GetTickCount64() - start) - slept_ms;
+    });
+
+    profiler.start();
+    sleeper.join();
+    profiler.stop();
+    XTW_CHECK(slept_ms.load() >= 199);
+    XTW_CHECK(waited_ms.load() >= 199);
+}
+
+#if !defined(_WIN32)
+XTW_TEST(one_profiler_samples_at_a_time)
+{
+    debug::sampling_profiler first(100), second(100);
+    first.start();
+    bool thrown = false;
+    try { second.start(); }
+    catch (const std::logic_error&) { thrown = true; }
+    XTW_CHECK(thrown);
+
+    first.stop();
+    second.start();
+    second.stop();
+}
+#endif
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
@@ -0,0 +1,199 @@
+/// @file
+/// @brief  tests of xtw::registry::snapshot
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#include <Windows.h>
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <xtw/registry_snapshot.h>
+
+#include "./scratch_registry.h"
+#include "./test.h"
+
+using namespace xtw::registry;
+
+namespace
+{
+    // scratch
+    //   (default) = "root"
+    //   Alpha: Name = "alpha", Count = 7, Size = 1 << 40, Zeta = "z", beta = "b"
+    //   beta\gamma: Name = "deep"
+    //   Beta2
+    void fill(const xtw_test::scratch_key& scratch)
+    {
+        scratch.set_string(L"", L"", L"root");
+        scratch.set_string(L"Alpha", L"Name", L"alpha");
+        scratch.set<DWORD>(L"Alpha", L"Count", REG_DWORD, 7);
+        scratch.set<ULONGLONG>(L"Alpha", L"Size", REG_QWORD, ULONGLONG{1} << 40);
+        scratch.set_string(L"Alpha", L"Zeta", L"z");
+        scratch.set_string(L"Alpha", L"beta", L"b");
+        scratch.set_string(L"beta\\gamma", L"Name", L"deep");
+        ::RegCloseKey(scratch.create(L"Beta2"));
+    }
+
+    std::wstring temporary_file(const wchar_t* name)
+    {
+        wchar_t directory[MAX_PATH + 1]{};
+        ::GetTempPathW(MAX_PATH + 1, directory);
+        return directory + xtw_test::widen("xtw-snapshot-" + std::to_string(::GetCurrentProcessId()) + "-") + name;
+    }
+
+    bool write_file(const std::wstring& path, const std::vector<std::byte>& bytes)
+    {
+        auto file = xtw::unique_handle(::CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+        if (file.get() == INVALID_HANDLE_VALUE) return (void)file.release(), false;
+        DWORD written{};
+        return ::WriteFile(file.get(), bytes.data(), static_cast<DWORD>(bytes.size()), &written, nullptr) && written == bytes.size();
+    }
+
+    std::vector<std::byte> image_of(const snapshot& s) { return std::vector<std::byte>(s.image(), s.image() + s.image_size()); }
+
+    snapshot_detail::header header_of(const std::vector<std::byte>& image)
+    {
+        snapshot_detail::header h{};
+        std::memcpy(&h, image.data(), sizeof(h));
+        return h;
+    }
+
+    template <class RECORD>
+    RECORD* records(std::vector<std::byte>& image, uint64_t offset) { return reinterpret_cast<RECORD*>(image.data() + offset); }
+
+    // writes a modified image and loads it back.
+    bool loads(const std::vector<std::byte>& image)
+    {
+        const auto path = temporary_file(L"modified.bin");
+        const bool written = write_file(path, image);
+        const bool loaded = written && snapshot::load(path.c_str()).has_value();
+        ::DeleteFileW(path.c_str());
+        return loaded;
+    }
+}
+
+XTW_TEST(capture_reflects_the_subtree)
+{
+    xtw_test::scratch_key scratch{};
+    fill(scratch);
+
+    auto s = snapshot::capture(HKEY_CURRENT_USER, scratch.path().c_str());
+    XTW_REQUIRE(s.has_value());
+    XTW_CHECK(s->key_count() == 5);
+    XTW_CHECK(s->value_count() == 7);
+
+    auto root = s->root();
+    XTW_REQUIRE(root.sub_key_count() == 3);
+    XTW_CHECK(root.sub_key_at(0).name() == L"Alpha"); // sorted case-insensitively
+    XTW_CHECK(root.sub_key_at(1).name() == L"beta");
+    XTW_CHECK(root.sub_key_at(2).name() == L"Beta2");
+
+    XTW_CHECK(s->ReadStringValue(L"", L"") == L"root");
+    XTW_CHECK(s->ReadStringValue(std::wstring_view{}, std::wstring_view{}) == L"root"); // null views name the default value too
+    XTW_CHECK(s->ReadStringValue(L"ALPHA", L"name") == L"alpha");
+    XTW_CHECK(s->ReadStringValue(L"Beta\\Gamma", L"NAME") == L"deep");
+    XTW_CHECK(!s->ReadStringValue(L"Alpha", L"Count").has_value()); // not a string
+    XTW_CHECK(!s->ReadStringValue(L"Missing", L"Name").has_value());
+
+    auto alpha = s->open(L"alpha");
+    XTW_REQUIRE(alpha.has_value());
+    XTW_CHECK(alpha->value(L"count")->as_dword() == DWORD{7});
+    XTW_CHECK(alpha->value(L"Size")->as_qword() == ULONGLONG{1} << 40);
+    XTW_CHECK(!alpha->value(L"Size")->as_dword().has_value());
+    XTW_REQUIRE(alpha->value_count() == 5);
+    for (size_t i = 1; i < alpha->value_count(); i++)
+        XTW_CHECK(snapshot_detail::compare_name(alpha->value_at(i - 1).name(), alpha->value_at(i).name()) < 0);
+
+    auto gamma = s->open(L"beta\\gamma");
+    XTW_REQUIRE(gamma.has_value());
+    XTW_CHECK(gamma->parent()->name() == L"beta");
+    XTW_CHECK(!s->root().parent().has_value());
+}
+
+XTW_TEST(capture_of_a_missing_key_fails)
+{
+    xtw_test::scratch_key scratch{};
+    XTW_CHECK(!snapshot::capture(HKEY_CURRENT_USER, (scratch.path() + L"\\missing").c_str()).has_value());
+}
+
+XTW_TEST(save_and_load_round_trip)
+{
+    xtw_test::scratch_key scratch{};
+    fill(scratch);
+    auto s = snapshot::capture(HKEY_CURRENT_USER, scratch.path().c_str());
+    XTW_REQUIRE(s.has_value());
+
+    const auto path = temporary_file(L"round-trip.bin");
+    XTW_REQUIRE(s->save(path.c_str()));
+    auto loaded = snapshot::load(path.c_str());
+    ::DeleteFileW(path.c_str());
+
+    XTW_REQUIRE(loaded.has_value());
+    XTW_CHECK(image_of(*loaded) == image_of(*s));
+    XTW_CHECK(loaded->ReadStringValue(L"beta\\gamma", L"Name") == L"deep");
+    XTW_CHECK(loaded->open(L"Alpha")->value(L"Count")->as_dword() == DWORD{7});
+}
+
+XTW_TEST(load_rejects_malformed_images)
+{
+    xtw_test::scratch_key scratch{};
+    fill(scratch);
+    auto s = snapshot::capture(HKEY_CURRENT_USER, scratch.path().c_str());
+    XTW_REQUIRE(s.has_value());
+    const auto image = image_of(*s);
+    XTW_REQUIRE(loads(image));
+
+    XTW_CHECK(!snapshot::load(temporary_file(L"missing.bin").c_str()).has_value());
+    XTW_CHECK(!loads(std::vector<std::byte>(image.begin(), image.begin() + sizeof(snapshot_detail::header) - 1)));
+    XTW_CHECK(!loads(std::vector<std::byte>(image.begin(), image.end() - 8))); // truncated
+
+    auto bad_magic = image;
+    bad_magic[0] = std::byte{0};
+    XTW_CHECK(!loads(bad_magic));
+
+    auto out_of_bounds = image;
+    records<snapshot_detail::key_record>(out_of_bounds, header_of(image).keys_offset)[1].first_value = 1000;
+    XTW_CHECK(!loads(out_of_bounds));
+}
+
+XTW_TEST(load_rejects_unsorted_tables)
+{
+    xtw_test::scratch_key scratch{};
+    fill(scratch);
+    auto s = snapshot::capture(HKEY_CURRENT_USER, scratch.path().c_str());
+    XTW_REQUIRE(s.has_value());
+    const auto image = image_of(*s);
+    const auto h = header_of(image);
+
+    // keys 1..3 are the children of the root: Alpha, beta, Beta2.
+    auto swapped_keys = image;
+    auto keys = records<snapshot_detail::key_record>(swapped_keys, h.keys_offset);
+    std::swap(keys[1].name_offset, keys[2].name_offset);
+    std::swap(keys[1].name_length, keys[2].name_length);
+    XTW_CHECK(!loads(swapped_keys));
+
+    auto duplicate_keys = image;
+    keys = records<snapshot_detail::key_record>(duplicate_keys, h.keys_offset);
+    keys[3].name_offset = keys[2].name_offset;
+    keys[3].name_length = keys[2].name_length;
+    XTW_CHECK(!loads(duplicate_keys));
+
+    auto wrong_parent = image;
+    records<snapshot_detail::key_record>(wrong_parent, h.keys_offset)[2].parent = 1;
+    XTW_CHECK(!loads(wrong_parent));
+
+    // the values of Alpha, sorted: beta, Count, Name, Size, Zeta.
+    const auto alpha = snapshot_detail::keys_of(image.data())[1];
+    XTW_REQUIRE(alpha.value_count == 5);
+    auto swapped_values = image;
+    auto values = records<snapshot_detail::value_record>(swapped_values, h.values_offset) + alpha.first_value;
+    std::swap(values[0], values[4]);
+    XTW_CHECK(!loads(swapped_values));
+}
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
@@ -0,0 +1,186 @@
+/// @file
+/// @brief  tests of xtw::registry::watched_cache
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#include <Windows.h>
+
+#include <atomic>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <xtw/registry_watched_cache.h>
+
+#include "./scratch_registry.h"
+#include "./test.h"
+
+using namespace xtw::registry;
+
+namespace
+{
+    // changes reach the cache through its worker thread; polls until the cache shows the expected value.
+    bool eventually(watched_cache& cache, const std::wstring& sub_key, const wchar_t* name, const std::optional<std::wstring>& expected)
+    {
+        const ULONGLONG deadline = ::GetTickCount64() + 5000;
+        while (cache.ReadStringValue(sub_key, name) != expected)
+        {
+            if (::GetTickCount64() > deadline) return false;
+            ::Sleep(1);
+        }
+        return true;
+    }
+
+    void delete_tree(const xtw_test::scratch_key& scratch, const wchar_t* sub_key)
+    {
+        ::RegDeleteTreeW(scratch.get(), sub_key);
+    }
+}
+
+XTW_TEST(reads_are_served_and_refreshed_on_change)
+{
+    xtw_test::scratch_key scratch{};
+    scratch.set_string(L"app", L"Name", L"first");
+    const std::wstring app = scratch.path() + L"\\app";
+
+    watched_cache cache(HKEY_CURRENT_USER);
+    XTW_CHECK(cache.ReadStringValue(app, L"Name") == L"first");
+    XTW_CHECK(cache.ReadStringValue(app, L"NAME") == L"first"); // names are case-insensitive
+    XTW_CHECK(cache.watched_key_count() == 1);
+
+    scratch.set_string(L"app", L"Name", L"second");
+    XTW_CHECK(eventually(cache, app, L"Name", L"second"));
+
+    scratch.set_string(L"app", L"Name", L"third");
+    XTW_CHECK(eventually(cache, app, L"Name", L"third"));
+    XTW_CHECK(cache.watched_key_count() == 1);
+}
+
+XTW_TEST(missing_values_are_cached_until_set)
+{
+    xtw_test::scratch_key scratch{};
+    scratch.set_string(L"app", L"Other", L"x");
+    const std::wstring app = scratch.path() + L"\\app";
+
+    watched_cache cache(HKEY_CURRENT_USER);
+    XTW_CHECK(!cache.ReadStringValue(app, L"Name").has_value());
+    XTW_CHECK(cache.watched_key_count() == 1);
+
+    scratch.set_string(L"app", L"Name", L"late");
+    XTW_CHECK(eventually(cache, app, L"Name", L"late"));
+
+    HKEY key = scratch.create(L"app");
+    XTW_CHECK(::RegDeleteValueW(key, L"Name") == ERROR_SUCCESS);
+    ::RegCloseKey(key);
+    XTW_CHECK(eventually(cache, app, L"Name", std::nullopt));
+}
+
+XTW_TEST(missing_keys_are_not_watched)
+{
+    xtw_test::scratch_key scratch{};
+    const std::wstring app = scratch.path() + L"\\app";
+
+    watched_cache cache(HKEY_CURRENT_USER);
+    XTW_CHECK(!cache.ReadStringValue(app, L"Name").has_value());
+    XTW_CHECK(cache.watched_key_count() == 0);
+
+    // read through to the registry again: the key appears without a notification.
+    scratch.set_string(L"app", L"Name", L"created");
+    XTW_CHECK(cache.ReadStringValue(app, L"Name") == L"created");
+    XTW_CHECK(cache.watched_key_count() == 1);
+}
+
+XTW_TEST(deleted_keys_are_dropped_and_reopened)
+{
+    xtw_test::scratch_key scratch{};
+    scratch.set_string(L"app", L"Name", L"before");
+    const std::wstring app = scratch.path() + L"\\app";
+
+    watched_cache cache(HKEY_CURRENT_USER);
+    XTW_CHECK(cache.ReadStringValue(app, L"Name") == L"before");
+
+    delete_tree(scratch, L"app");
+    XTW_CHECK(eventually(cache, app, L"Name", std::nullopt));
+    XTW_CHECK(cache.watched_key_count() == 0);
+
+    // recreated at the same path: a new key, opened again by path.
+    scratch.set_string(L"app", L"Name", L"after");
+    XTW_CHECK(cache.ReadStringValue(app, L"Name") == L"after");
+    XTW_CHECK(cache.watched_key_count() == 1);
+
+    scratch.set_string(L"app", L"Name", L"changed");
+    XTW_CHECK(eventually(cache, app, L"Name", L"changed"));
+}
+
+XTW_TEST(sub_key_changes_do_not_lose_values)
+{
+    xtw_test::scratch_key scratch{};
+    scratch.set_string(L"app", L"Name", L"value");
+    const std::wstring app = scratch.path() + L"\\app";
+
+    watched_cache cache(HKEY_CURRENT_USER);
+    XTW_CHECK(cache.ReadStringValue(app, L"Name") == L"value");
+
+    // a new sub key is a name change: the key is refreshed and keeps its values.
+    ::RegCloseKey(scratch.create(L"app\\child"));
+    scratch.set_string(L"app", L"Name", L"after child");
+    XTW_CHECK(eventually(cache, app, L"Name", L"after child"));
+}
+
+XTW_TEST(readers_on_several_threads_see_changes)
+{
+    xtw_test::scratch_key scratch{};
+    scratch.set_string(L"app", L"Name", L"0");
+    const std::wstring app = scratch.path() + L"\\app";
+
+    watched_cache cache(HKEY_CURRENT_USER);
+    std::atomic_bool stop{};
+    std::atomic<int> failures{};
+    std::vector<xtw::threading::thread> readers{};
+    for (int i = 0; i < 4; i++)
+    {
+        readers.emplace_back([&]
+        {
+            while (!stop.load())
+                if (!cache.ReadStringValue(app, L"Name").has_value())
+                    failures++;
+        });
+    }
+
+    for (int i = 1; i <= 20; i++) scratch.set_string(L"app", L"Name", xtw_test::widen(std::to_string(i)));
+    XTW_CHECK(eventually(cache, app, L"Name", L"20"));
+
+    stop.store(true);
+    for (auto& t : readers) t.join();
+    XTW_CHECK(failures.load() == 0);
+}
+
+XTW_TEST(notification_signals_once_per_registration)
+{
+    xtw_test::scratch_key scratch{};
+    HKEY key = scratch.create(L"app");
+    xtw::threading::auto_reset_event changed{};
+
+    constexpr DWORD filter = REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET | REG_NOTIFY_THREAD_AGNOSTIC;
+    XTW_REQUIRE(::RegNotifyChangeKeyValue(key, FALSE, filter, changed.handle(), TRUE) == ERROR_SUCCESS);
+    XTW_CHECK(!changed.wait_signal(50));
+
+    scratch.set_string(L"app", L"Name", L"x");
+    XTW_CHECK(changed.wait_signal(5000));
+
+    // not armed again: further changes do not signal.
+    scratch.set_string(L"app", L"Name", L"y");
+    XTW_CHECK(!changed.wait_signal(200));
+
+    // a deleted key signals pending notifications and refuses new ones.
+    XTW_REQUIRE(::RegNotifyChangeKeyValue(key, FALSE, filter, changed.handle(), TRUE) == ERROR_SUCCESS);
+    delete_tree(scratch, L"app");
+    XTW_CHECK(changed.wait_signal(5000));
+    XTW_CHECK(::RegNotifyChangeKeyValue(key, FALSE, filter, changed.handle(), TRUE) == ERROR_KEY_DELETED);
+    ::RegCloseKey(key);
+}
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
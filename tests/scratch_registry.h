@@ -0,0 +1,104 @@
+/// @file
+/// @brief  xtw tests: scratch registry keys
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+///
+/// scratch_key creates HKEY_CURRENT_USER\Software\xtw-test\<process id>-<n> and deletes it, with everything under it, on destruction.
+/// With the portable backend, the registry is first pointed at a new temporary directory, which is removed at exit.
+
+#pragma once
+
+#include <Windows.h>
+
+#include <stdexcept>
+#include <string>
+
+#if !defined(_WIN32)
+#include <cstdlib>
+#include <filesystem>
+#endif
+
+namespace xtw_test
+{
+    // ASCII only; std::to_wstring goes through the C library's wide functions, which the portable backend does not cover.
+    static inline std::wstring widen(const std::string& s) { return std::wstring(s.begin(), s.end()); }
+
+#if !defined(_WIN32)
+    class portable_registry_root final
+    {
+        std::string path_{};
+
+    public:
+        portable_registry_root()
+        {
+            char path[] = "/tmp/xtw-registry-XXXXXX";
+            if (!::mkdtemp(path)) throw std::runtime_error("mkdtemp failed");
+            path_ = path;
+            ::setenv("XTW_PORTABLE_REGISTRY", path, 1);
+        }
+
+        portable_registry_root(const portable_registry_root& other) = delete;
+        portable_registry_root& operator=(const portable_registry_root& other) = delete;
+
+        ~portable_registry_root()
+        {
+            std::error_code ec{};
+            std::filesystem::remove_all(path_, ec);
+        }
+    };
+#endif
+
+    class scratch_key final
+    {
+        std::wstring path_{};
+        HKEY key_{};
+
+    public:
+        scratch_key()
+        {
+#if !defined(_WIN32)
+            static const portable_registry_root root{};
+#endif
+            static int sequence = 0;
+            path_ = L"Software\\xtw-test\\" + widen(std::to_string(::GetCurrentProcessId()) + "-" + std::to_string(sequence++));
+            if (::RegCreateKeyExW(HKEY_CURRENT_USER, path_.c_str(), 0, nullptr, REG_OPTION_NON_VOLATILE, KEY_ALL_ACCESS, nullptr, &key_, nullptr) != ERROR_SUCCESS)
+                throw std::runtime_error("cannot create a scratch registry key");
+        }
+
+        scratch_key(const scratch_key& other) = delete;
+        scratch_key& operator=(const scratch_key& other) = delete;
+
+        ~scratch_key()
+        {
+            ::RegCloseKey(key_);
+            ::RegDeleteTreeW(HKEY_CURRENT_USER, path_.c_str());
+        }
+
+        [[nodiscard]] HKEY get() const noexcept { return key_; }
+        [[nodiscard]] const std::wstring& path() const noexcept { return path_; } // from HKEY_CURRENT_USER
+
+        /// Creates (or opens) a key below the scratch key, and sets values on it.
+        HKEY create(const wchar_t* sub_key) const
+        {
+            HKEY key{};
+            if (::RegCreateKeyExW(key_, sub_key, 0, nullptr, REG_OPTION_NON_VOLATILE, KEY_ALL_ACCESS, nullptr, &key, nullptr) != ERROR_SUCCESS)
+                throw std::runtime_error("cannot create a registry key");
+            return key;
+        }
+
+        void set_string(const wchar_t* sub_key, const wchar_t* name, const std::wstring& value) const
+        {
+            HKEY key = create(sub_key);
+            ::RegSetValueExW(key, name, 0, REG_SZ, reinterpret_cast<const BYTE*>(value.c_str()), static_cast<DWORD>((value.size() + 1) * sizeof(wchar_t)));
+            ::RegCloseKey(key);
+        }
+
+        template <class T>
+        void set(const wchar_t* sub_key, const wchar_t* name, DWORD type, const T& value) const
+        {
+            HKEY key = create(sub_key);
+            ::RegSetValueExW(key, name, 0, type, reinterpret_cast<const BYTE*>(&value), sizeof(T));
+            ::RegCloseKey(key);
+        }
+    };
+}
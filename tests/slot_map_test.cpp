@@ -0,0 +1,225 @@
+/// @file
+/// @brief  tests of xtw::slot_map and xtw::sharded_slot_map
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <xtw/slot_map.h>
+#include <xtw/threading.h>
+
+#include "./test.h"
+
+using namespace xtw;
+
+namespace
+{
+    // throws from its constructor when asked to.
+    struct fragile
+    {
+        int value;
+
+        explicit fragile(int v) : value(v)
+        {
+            if (v < 0) throw std::runtime_error("fragile");
+        }
+    };
+
+    // every value is reachable through its own id, and through the id of its position.
+    template <class T, class Id>
+    bool consistent(const slot_map<T, Id>& m)
+    {
+        for (size_t i = 0; i < m.size(); i++)
+            if (m.find(m.id_at(i)) != m.begin() + i) return false;
+        return true;
+    }
+}
+
+XTW_TEST(values_are_found_by_their_ids)
+{
+    slot_map<std::string> m{};
+    const auto a = m.insert("a");
+    const auto b = m.insert("b");
+    const auto c = m.emplace(3, 'c');
+    XTW_CHECK(a != 0 && b != 0 && c != 0);
+    XTW_CHECK(m.size() == 3u);
+    XTW_CHECK(*m.find(a) == "a");
+    XTW_CHECK(*m.find(c) == "ccc");
+
+    // erasing moves the last value into the hole; the ids of the others still work.
+    XTW_CHECK(m.erase(a));
+    XTW_CHECK(!m.erase(a));
+    XTW_CHECK(!m.contains(a));
+    XTW_CHECK(m.find(a) == nullptr);
+    XTW_CHECK(*m.find(b) == "b");
+    XTW_CHECK(*m.find(c) == "ccc");
+    XTW_CHECK(consistent(m));
+
+    // the freed slot is reused with a new generation, so the stale id does not find the new value.
+    const auto d = m.insert("d");
+    XTW_CHECK(slot_map<std::string>::index_of(d) == slot_map<std::string>::index_of(a));
+    XTW_CHECK(d != a);
+    XTW_CHECK(m.find(a) == nullptr);
+    XTW_CHECK(*m.find(d) == "d");
+
+    XTW_CHECK(m.find(slot_map<std::string>::make_id(1000, 1)) == nullptr); // beyond the slots
+    XTW_CHECK(m.find(0) == nullptr);
+}
+
+XTW_TEST(iteration_is_dense)
+{
+    slot_map<int> m{};
+    std::vector<uint32_t> ids{};
+    for (int i = 0; i < 100; i++) ids.push_back(m.insert(i));
+    for (int i = 0; i < 100; i += 3) m.erase(ids[i]);
+
+    XTW_CHECK(m.size() == 66u);
+    XTW_CHECK(consistent(m));
+    std::vector<int> seen(m.begin(), m.end());
+    std::sort(seen.begin(), seen.end());
+    bool expected = true;
+    for (size_t i = 0, v = 0; i < seen.size(); i++, v++)
+    {
+        if (v % 3 == 0) v++;
+        expected &= seen[i] == static_cast<int>(v);
+    }
+    XTW_CHECK(expected);
+
+    m.clear();
+    XTW_CHECK(m.empty());
+    XTW_CHECK(std::none_of(ids.begin(), ids.end(), [&](uint32_t id) { return m.contains(id); }));
+}
+
+XTW_TEST(exhausted_slots_are_retired)
+{
+    using map = slot_map<int, uint32_t>;
+    map m(2);
+    auto id = m.insert(0);
+    const uint32_t first = id;
+    for (uint32_t g = 1; g < map::max_generation; g++)
+    {
+        m.erase(id);
+        id = m.insert(0);
+        XTW_REQUIRE(map::index_of(id) == map::index_of(first));
+    }
+    XTW_CHECK(map::generation_of(id) == map::max_generation);
+
+    // the last generation is not reused: the next value takes the other slot, and then no slot is left.
+    m.erase(id);
+    const auto other = m.insert(1);
+    XTW_CHECK(map::index_of(other) != map::index_of(first));
+    XTW_CHECK(!m.contains(first) && !m.contains(id));
+
+    bool thrown = false;
+    try { (void)m.insert(2); }
+    catch (const std::length_error&) { thrown = true; }
+    XTW_CHECK(thrown);
+    XTW_CHECK(m.size() == 1u);
+}
+
+XTW_TEST(failed_inserts_leave_the_map_unchanged)
+{
+    slot_map<fragile> m(4);
+    const auto a = m.emplace(1);
+    const auto b = m.emplace(2);
+    m.erase(a); // one free slot, one fresh slot left
+
+    for (int attempt = 0; attempt < 3; attempt++)
+    {
+        bool thrown = false;
+        try { (void)m.emplace(-1); }
+        catch (const std::runtime_error&) { thrown = true; }
+        XTW_CHECK(thrown);
+    }
+    XTW_CHECK(m.size() == 1u);
+    XTW_CHECK(m.find(b)->value == 2);
+
+    // both slots are still available.
+    const auto c = m.emplace(3);
+    const auto d = m.emplace(4);
+    const auto e = m.emplace(5);
+    XTW_CHECK(m.size() == 4u);
+    XTW_CHECK(m.find(c)->value == 3 && m.find(d)->value == 4 && m.find(e)->value == 5);
+    XTW_CHECK(consistent(m));
+}
+
+XTW_TEST(sharded_map_spreads_values_and_finds_them)
+{
+    sharded_slot_map<int, uint64_t, 4> m{};
+    std::vector<uint64_t> ids{};
+    for (int i = 0; i < 64; i++) ids.push_back(m.insert(i));
+
+    XTW_CHECK(std::set<uint64_t>(ids.begin(), ids.end()).size() == ids.size());
+    XTW_CHECK(m.size() == 64u);
+    for (int i = 0; i < 64; i++)
+    {
+        int value = -1;
+        XTW_CHECK(m.visit(ids[i], [&](const int& v) { value = v; }));
+        XTW_CHECK(value == i);
+    }
+
+    XTW_CHECK(m.update(ids[5], [](int& v) { v = 500; }));
+    XTW_CHECK(m.erase(ids[6]));
+    XTW_CHECK(!m.erase(ids[6]));
+    XTW_CHECK(!m.contains(ids[6]));
+    XTW_CHECK(!m.visit(ids[6], [](const int&) {}));
+
+    int sum = 0;
+    size_t count = 0;
+    m.for_each([&](uint64_t id, const int& v)
+    {
+        count++;
+        sum += v;
+        XTW_CHECK(m.contains(id));
+    });
+    XTW_CHECK(count == 63u);
+    XTW_CHECK(sum == 63 * 64 / 2 - 5 - 6 + 500);
+}
+
+XTW_TEST(sharded_map_takes_concurrent_inserts_and_erases)
+{
+    sharded_slot_map<uint64_t> m{};
+    constexpr int thread_count = 8;
+    constexpr int operations = 5000;
+    std::atomic<int> mismatches{};
+
+    std::vector<threading::thread> threads{};
+    for (int t = 0; t < thread_count; t++)
+    {
+        threads.emplace_back([&, t]
+        {
+            std::vector<uint64_t> mine{};
+            for (int i = 0; i < operations; i++)
+            {
+                const uint64_t tag = uint64_t(t) << 32 | uint32_t(i);
+                mine.push_back(m.insert(tag));
+                if (i % 2) // erase every other one again
+                {
+                    const uint64_t id = mine[mine.size() / 2];
+                    if (!m.visit(id, [&](const uint64_t& v) { if (v >> 32 != uint64_t(t)) mismatches++; })) mismatches++;
+                    m.erase(id);
+                    mine.erase(mine.begin() + static_cast<ptrdiff_t>(mine.size() / 2));
+                }
+            }
+            for (uint64_t id : mine)
+                if (!m.contains(id)) mismatches++;
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    XTW_CHECK(mismatches.load() == 0);
+    XTW_CHECK(m.size() == size_t{thread_count} * operations / 2);
+}
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
@@ -0,0 +1,130 @@
+/// @file
+/// @brief  tests of xtw::debug::stack_trace and the throw-site capture of XTW_THROW_ON_FAILURE
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#include <Windows.h>
+#include <intrin.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <xtw/debug.h>
+#include <xtw/stack_trace.h>
+
+#include "./test.h"
+
+using namespace xtw;
+using namespace xtw::debug;
+
+namespace
+{
+    __declspec(noinline) stack_trace capture_here() { return stack_trace::capture(); }
+
+    // the whole stack, and the stack from this function's call site.
+    __declspec(noinline) void capture_both(stack_trace& whole, stack_trace& from)
+    {
+        whole = stack_trace::capture();
+        from = stack_trace::capture_from(_ReturnAddress());
+    }
+
+    __declspec(noinline) void fail(HRESULT hr) { XTW_THROW_ON_FAILURE hr; }
+
+    // the exception thrown by fail(hr).
+    win32_exception failure(HRESULT hr)
+    {
+        try { fail(hr); }
+        catch (const win32_exception& e) { return e; }
+        throw std::logic_error("fail(hr) did not throw");
+    }
+}
+
+XTW_TEST(captures_are_raw_frames_with_a_stable_hash)
+{
+    volatile size_t count = 2; // a loop not unrolled: both captures come from one call site
+    std::vector<stack_trace> traces(count);
+    for (auto& t : traces) t = capture_here();
+    const stack_trace& a = traces[0];
+    const stack_trace& b = traces[1];
+    XTW_REQUIRE(!a.empty());
+    XTW_CHECK(a.size() == b.size());
+    XTW_CHECK(a.hash() == b.hash());
+
+    // the innermost frame is a return address into capture_here.
+    const auto here = reinterpret_cast<uintptr_t>(&capture_here);
+    const auto first = reinterpret_cast<uintptr_t>(a[0]);
+    XTW_CHECK(first > here && first - here < 256);
+
+    XTW_CHECK(stack_trace::capture(1000).empty());
+}
+
+XTW_TEST(captures_start_at_the_call_site)
+{
+    stack_trace whole{};
+    stack_trace from{};
+    capture_both(whole, from);
+    XTW_REQUIRE(whole.size() >= 2);
+    XTW_REQUIRE(!from.empty());
+    XTW_CHECK(from[0] == whole[1]);
+    XTW_CHECK(from.size() == whole.size() - 1);
+
+    // not found: the whole stack is kept.
+    int local{};
+    XTW_CHECK(stack_trace::capture_from(&local).size() > from.size());
+}
+
+XTW_TEST(throw_site_stacks_are_opt_in)
+{
+    XTW_CHECK(win32_exception::stack_capture() == nullptr);
+    XTW_CHECK(stack_trace::of(win32_exception(E_FAIL)).empty());
+
+    const win32_exception plain = failure(E_FAIL);
+    XTW_CHECK(plain.call_site() != nullptr);
+    XTW_CHECK(plain.frame_count() == 0u);
+    XTW_CHECK(stack_trace::of(plain).empty());
+
+    stack_trace::capture_on_throw(true);
+    const win32_exception captured = failure(E_FAIL);
+    stack_trace::capture_on_throw(false);
+    XTW_CHECK(win32_exception::stack_capture() == nullptr);
+
+    XTW_REQUIRE(captured.frame_count() >= 2);
+    XTW_CHECK(captured.frames()[0] == captured.call_site());
+    const stack_trace t = stack_trace::of(captured);
+    XTW_CHECK(t.size() == captured.frame_count());
+    XTW_CHECK(t[0] == captured.call_site());
+
+    // the call site is in fail().
+    const auto site = reinterpret_cast<uintptr_t>(captured.call_site());
+    const auto function = reinterpret_cast<uintptr_t>(&fail);
+    XTW_CHECK(site > function && site - function < 256);
+}
+
+XTW_TEST(successes_do_not_throw)
+{
+    stack_trace::capture_on_throw(true);
+    bool thrown = false;
+    try { fail(S_OK); }
+    catch (const win32_exception&) { thrown = true; }
+    stack_trace::capture_on_throw(false);
+    XTW_CHECK(!thrown);
+}
+
+XTW_TEST(failures_describe_their_frames_without_symbols)
+{
+    const std::string plain = describe_failure(failure(E_FAIL));
+    XTW_CHECK(plain.find(" at 0x") != std::string::npos);
+    XTW_CHECK(plain.find("#0 ") == std::string::npos);
+
+    stack_trace::capture_on_throw(true);
+    const std::string captured = describe_failure(failure(E_FAIL));
+    stack_trace::capture_on_throw(false);
+    XTW_CHECK(captured.find("#0 0x") != std::string::npos);
+}
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
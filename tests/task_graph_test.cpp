@@ -0,0 +1,89 @@
+/// @file
+/// @brief  tests of xtw::threading::task_graph
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#include <Windows.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <xtw/task_graph.h>
+
+#include "./test.h"
+
+using namespace xtw::threading;
+
+XTW_TEST(nodes_run_after_their_predecessors)
+{
+    worker_set workers(3);
+    task_graph g{};
+    std::atomic<int> clock{};
+    std::vector<int> at(5, -1);
+    std::vector<task_graph::node_id> ids{};
+    for (int i = 0; i < 5; i++)
+        ids.push_back(g.add_node("n" + std::to_string(i), [&, i] { at[i] = clock++; }));
+    g.add_edge(ids[0], ids[1]);
+    g.add_edge(ids[0], ids[2]);
+    g.add_edge(ids[1], ids[3]);
+    g.add_edge(ids[2], ids[3]);
+    g.add_edge(ids[3], ids[4]);
+
+    for (int run = 0; run < 3; run++)
+    {
+        g.run(workers);
+        XTW_CHECK(clock.load() == 5 * (run + 1));
+        XTW_CHECK(at[0] < at[1] && at[0] < at[2]);
+        XTW_CHECK(at[1] < at[3] && at[2] < at[3] && at[3] < at[4]);
+    }
+    XTW_CHECK(g.priority(ids[0]) == 4);
+    XTW_CHECK(g.priority(ids[4]) == 1);
+}
+
+XTW_TEST(cycles_are_rejected)
+{
+    task_graph g{};
+    const auto a = g.add_node("a", [] {});
+    const auto b = g.add_node("b", [] {});
+    g.add_edge(a, b);
+    g.add_edge(b, a);
+
+    bool thrown = false;
+    try { g.prepare(); }
+    catch (const std::logic_error&) { thrown = true; }
+    XTW_CHECK(thrown);
+}
+
+XTW_TEST(timings_cover_the_last_run_only)
+{
+    worker_set workers(1);
+    task_graph g{};
+    bool fail = false;
+    const auto a = g.add_node("a", [&] { if (fail) throw std::runtime_error("a"); });
+    const auto b = g.add_node("b", [] {});
+    g.add_edge(a, b);
+
+    g.run(workers);
+    XTW_CHECK(g.timings()[a].end != 0 && g.timings()[b].end != 0);
+    XTW_CHECK(g.timings()[a].end <= g.timings()[b].start);
+
+    // b does not run after a throws: its timing from the previous run is gone.
+    fail = true;
+    bool thrown = false;
+    try { g.run(workers); }
+    catch (const std::runtime_error&) { thrown = true; }
+    XTW_CHECK(thrown);
+    XTW_CHECK(g.timings()[a].end != 0);
+    XTW_CHECK(g.timings()[b].start == 0 && g.timings()[b].end == 0);
+
+    const std::string trace = g.export_trace_json();
+    XTW_CHECK(trace.find("\"a\"") != std::string::npos);
+    XTW_CHECK(trace.find("\"b\"") == std::string::npos);
+}
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
@@ -0,0 +1,101 @@
+/// @file
+/// @brief  xtw tests: a minimal test runner
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+///
+/// Each tests/<name>_test.cpp is one executable and one ctest test:
+///   XTW_TEST(name) { XTW_CHECK(condition); XTW_REQUIRE(condition); }
+///   int main(int argc, char** argv) { return xtw_test::run(argc, argv); }
+/// A failed XTW_CHECK marks the test failed and continues; a failed XTW_REQUIRE, or an exception, ends the test.
+/// The optional argument runs only the tests whose names contain it.
+
+#pragma once
+
+#include <cstdio>
+#include <exception>
+#include <string_view>
+#include <vector>
+
+namespace xtw_test
+{
+    struct test_case
+    {
+        const char* name;
+        void (*body)();
+    };
+
+    struct required_check_failed {};
+
+    namespace test_detail
+    {
+        static inline std::vector<test_case>& tests()
+        {
+            static std::vector<test_case> t{};
+            return t;
+        }
+
+        static inline bool current_failed{};
+    }
+
+    static inline bool add(const char* name, void (*body)())
+    {
+        test_detail::tests().push_back(test_case{name, body});
+        return true;
+    }
+
+    static inline bool check(bool condition, const char* expression, const char* file, int line) noexcept
+    {
+        if (condition) return true;
+        std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+        test_detail::current_failed = true;
+        return false;
+    }
+
+    static inline int run(int argc, char** argv)
+    {
+        const std::string_view filter = argc > 1 ? argv[1] : "";
+        int run = 0, failed = 0;
+        for (auto& t : test_detail::tests())
+        {
+            if (std::string_view(t.name).find(filter) == std::string_view::npos) continue;
+
+            std::printf("[ RUN    ] %s\n", t.name);
+            std::fflush(stdout);
+            test_detail::current_failed = false;
+            try
+            {
+                t.body();
+            }
+            catch (const required_check_failed&)
+            {
+            }
+            catch (const std::exception& e)
+            {
+                std::fprintf(stderr, "unexpected exception: %s\n", e.what());
+                test_detail::current_failed = true;
+            }
+            catch (...)
+            {
+                std::fprintf(stderr, "unexpected exception\n");
+                test_detail::current_failed = true;
+            }
+
+            run++;
+            if (test_detail::current_failed) failed++;
+            std::printf("[ %s ] %s\n", test_detail::current_failed ? "FAILED" : "    OK", t.name);
+        }
+
+        std::printf("%d tests, %d failed\n", run, failed);
+        return failed == 0 && run > 0 ? 0 : 1;
+    }
+}
+
+#define XTW_TEST(name)                                                               \
+    static void name();                                                              \
+    [[maybe_unused]] static const bool name##_registered = xtw_test::add(#name, name); \
+    static void name()
+
+#define XTW_CHECK(condition) (void)xtw_test::check(static_cast<bool>(condition), #condition, __FILE__, __LINE__)
+
+#define XTW_REQUIRE(condition) \
+    (xtw_test::check(static_cast<bool>(condition), #condition, __FILE__, __LINE__) ? (void)0 : throw xtw_test::required_check_failed{})
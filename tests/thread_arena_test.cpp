@@ -0,0 +1,113 @@
+/// @file
+/// @brief  tests of xtw::threading::thread_arena
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#include <Windows.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <vector>
+
+#include <xtw/thread_arena.h>
+#include <xtw/threading.h>
+
+#include "./test.h"
+
+using namespace xtw::threading;
+
+XTW_TEST(allocations_are_bumped_and_rewound)
+{
+    thread_arena arena(arena_options{size_t{1} << 20, size_t{64} << 10});
+    XTW_CHECK(arena.reserved() == size_t{1} << 20);
+    XTW_CHECK(arena.committed() == 0u);
+
+    void* a = arena.allocate(10, 1);
+    void* b = arena.allocate(100, 64);
+    XTW_CHECK(arena.owns(a) && arena.owns(b));
+    XTW_CHECK(reinterpret_cast<uintptr_t>(b) % 64 == 0);
+    XTW_CHECK(static_cast<std::byte*>(b) >= static_cast<std::byte*>(a) + 10);
+    XTW_CHECK(arena.committed() == size_t{64} << 10);
+
+    const auto m = arena.mark();
+    {
+        thread_arena::scoped_mark scope(arena);
+        std::memset(arena.allocate(200000, 16), 0xCC, 200000);
+        XTW_CHECK(arena.used() > 200000u);
+        XTW_CHECK(arena.committed() == size_t{256} << 10);
+    }
+    XTW_CHECK(arena.mark() == m);
+
+    arena.trim();
+    XTW_CHECK(arena.committed() == size_t{64} << 10);
+    XTW_CHECK(arena.allocate(100, 64) == static_cast<std::byte*>(b) + 128); // reuses the rewound space
+
+    arena.reset();
+    XTW_CHECK(arena.used() == 0u);
+}
+
+XTW_TEST(requests_beyond_the_range_go_upstream)
+{
+    std::pmr::unsynchronized_pool_resource upstream{};
+    thread_arena arena(arena_options{size_t{64} << 10, size_t{64} << 10, false, &upstream});
+    XTW_CHECK(arena.upstream() == &upstream);
+
+    void* inside = arena.allocate(1000);
+    void* outside = arena.allocate(size_t{128} << 10);
+    XTW_CHECK(arena.owns(inside));
+    XTW_CHECK(!arena.owns(outside));
+    arena.deallocate(outside, size_t{128} << 10);
+    arena.deallocate(inside, 1000); // a no-op
+
+    std::pmr::vector<int> v(&arena);
+    for (int i = 0; i < 100000; i++) v.push_back(i); // outgrows the range
+    XTW_CHECK(v[99999] == 99999);
+}
+
+XTW_TEST(large_pages_fall_back_to_normal_pages)
+{
+    // large pages are used only where they are available (privilege on Windows, the hugetlbfs pool elsewhere).
+    thread_arena arena(arena_options{size_t{3} << 20, size_t{64} << 10, true});
+    if (arena.large_pages())
+    {
+        const size_t page = ::GetLargePageMinimum();
+        XTW_CHECK(page != 0 && arena.reserved() % page == 0);
+        XTW_CHECK(arena.committed() == arena.reserved());
+        arena.trim(); // no-op
+        XTW_CHECK(arena.committed() == arena.reserved());
+    }
+    else
+    {
+        XTW_CHECK(arena.reserved() == size_t{3} << 20);
+    }
+
+    auto p = static_cast<std::byte*>(arena.allocate(size_t{2} << 20, 4096));
+    XTW_REQUIRE(arena.owns(p));
+    std::memset(p, 0x5A, size_t{2} << 20);
+    XTW_CHECK(p[(size_t{2} << 20) - 1] == std::byte{0x5A});
+}
+
+XTW_TEST(threads_own_their_arena)
+{
+    XTW_CHECK(thread_arena::current() == nullptr);
+    XTW_CHECK(thread_arena::current_resource() == std::pmr::get_default_resource());
+
+    thread_arena* seen{};
+    bool owned{};
+    thread t([&]
+    {
+        seen = thread_arena::current();
+        if (seen) owned = seen->owns(seen->allocate(64));
+    }, arena_options{size_t{1} << 20});
+    t.join();
+    XTW_CHECK(seen != nullptr);
+    XTW_CHECK(owned);
+    XTW_CHECK(thread_arena::current() == nullptr);
+}
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
@@ -0,0 +1,151 @@
+/// @file
+/// @brief  tests of xtw::threading::thread_registry
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <xtw/thread_registry.h>
+#include <xtw/threading.h>
+
+#include "./test.h"
+
+using namespace xtw::threading;
+
+namespace
+{
+    bool registered(DWORD id)
+    {
+        const auto threads = thread_registry::instance().threads();
+        return std::any_of(threads.begin(), threads.end(), [id](const auto& t) { return t.first == id; });
+    }
+
+    const thread_statistics* find(const std::vector<thread_statistics>& samples, DWORD id)
+    {
+        auto it = std::find_if(samples.begin(), samples.end(), [id](const thread_statistics& s) { return s.thread_id == id; });
+        return it != samples.end() ? &*it : nullptr;
+    }
+
+    int64_t cpu_time_us(HANDLE thread)
+    {
+        FILETIME creation{}, exit{}, kernel{}, user{};
+        if (!::GetThreadTimes(thread, &creation, &exit, &kernel, &user)) return 0;
+        return static_cast<int64_t>(((uint64_t{kernel.dwHighDateTime} << 32 | kernel.dwLowDateTime) + (uint64_t{user.dwHighDateTime} << 32 | user.dwLowDateTime)) / 10);
+    }
+}
+
+// runs first: nothing is observed before the registry is used.
+XTW_TEST(registration_is_opt_in)
+{
+    XTW_CHECK(thread_observer::installed() == nullptr);
+    manual_reset_event release{};
+    thread early([&] { release.wait_signal(); }, thread::join_on_destructor);
+
+    XTW_CHECK(thread_registry::instance().size() == 0u);
+    XTW_CHECK(thread_observer::installed() != nullptr);
+    XTW_CHECK(!registered(early.thread_id()));
+    release.notify_signal();
+}
+
+XTW_TEST(threads_register_until_they_exit)
+{
+    manual_reset_event release{};
+    thread t([&] { release.wait_signal(); }, thread::join_on_destructor, 65536, THREAD_PRIORITY_NORMAL, L"registered");
+    const DWORD id = t.thread_id();
+
+    const auto threads = thread_registry::instance().threads();
+    auto it = std::find_if(threads.begin(), threads.end(), [id](const auto& p) { return p.first == id; });
+    XTW_REQUIRE(it != threads.end());
+    XTW_CHECK(it->second == L"registered");
+
+    release.notify_signal();
+    XTW_CHECK(t.join(5000));
+    XTW_CHECK(!registered(id));
+}
+
+XTW_TEST(waits_count_as_blocked_time)
+{
+    manual_reset_event entered{}, release{};
+    thread t([&]
+    {
+        entered.notify_signal();
+        (void)release.wait_signal(50); // times out
+        release.wait_signal();
+    }, thread::join_on_destructor);
+    XTW_REQUIRE(entered.wait_signal(5000));
+    ::Sleep(100);
+
+    const auto samples = thread_registry::instance().sample();
+    const thread_statistics* s = find(samples, t.thread_id());
+    XTW_REQUIRE(s != nullptr);
+    XTW_CHECK(s->blocked == blocked_in::event_wait);
+    XTW_CHECK(s->blocked_time_us >= 50000);
+    XTW_CHECK(s->lifetime_us >= s->blocked_time_us);
+    release.notify_signal();
+}
+
+XTW_TEST(samples_report_cpu_time_and_os_state)
+{
+    std::atomic_bool stop{};
+    std::atomic_bool busy{};
+    thread t([&]
+    {
+        // at least 50 ms of CPU time, then keep running until sampled.
+        while (cpu_time_us(::GetCurrentThread()) < 50000) {}
+        busy.store(true);
+        while (!stop.load()) {}
+    }, thread::join_on_destructor);
+    while (!busy.load()) ::Sleep(1);
+
+    const auto cheap = thread_registry::instance().sample();
+    const thread_statistics* s = find(cheap, t.thread_id());
+    XTW_REQUIRE(s != nullptr);
+    XTW_CHECK(s->kernel_time_us + s->user_time_us >= 30000);
+    XTW_CHECK(!s->os_info_valid);
+
+    const auto full = thread_registry::instance().sample(true);
+    s = find(full, t.thread_id());
+    XTW_REQUIRE(s != nullptr);
+#if defined(_WIN32)
+    if (s->os_info_valid) XTW_CHECK(s->context_switches > 0);
+#else
+    XTW_REQUIRE(s->os_info_valid);
+    XTW_CHECK(s->context_switches > 0);
+    XTW_CHECK(s->voluntary_context_switches <= s->context_switches);
+    XTW_CHECK(s->os_state == 'R' || s->os_state == 'S');
+#endif
+    stop.store(true);
+}
+
+XTW_TEST(other_threads_register_in_scope_and_names_are_escaped)
+{
+    const DWORD self = ::GetCurrentThreadId();
+    {
+        const std::wstring name = std::wstring(L"m\"ain \\ ") + wchar_t(0x00E9) + wchar_t(0xD83D) + wchar_t(0xDE00) + wchar_t(0xD800) + L"\n";
+        thread_registry::scoped_registration registration(name.c_str());
+        thread_registry::scoped_registration nested(L"ignored");
+        XTW_CHECK(registered(self));
+        {
+            thread_registry::scoped_blocking blocking(blocked_in::join);
+            const auto samples = thread_registry::instance().sample();
+            const thread_statistics* s = find(samples, self);
+            XTW_REQUIRE(s != nullptr);
+            XTW_CHECK(s->blocked == blocked_in::join);
+
+            const std::string json = thread_registry::to_json(samples);
+            XTW_CHECK(json.find("\"name\":\"m\\\"ain \\\\ \xC3\xA9\xF0\x9F\x98\x80\xEF\xBF\xBD\\u000a\"") != std::string::npos);
+        }
+    }
+    XTW_CHECK(!registered(self));
+}
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
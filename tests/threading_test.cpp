@@ -0,0 +1,106 @@
+/// @file
+/// @brief  tests of xtw::threading
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#include <Windows.h>
+
+#include <atomic>
+
+#include <xtw/threading.h>
+
+#include "./test.h"
+
+using namespace xtw::threading;
+
+// joins t, signaling e until it exits, so that a failed check does not leave the test hanging.
+template <class E>
+static void release_and_join(thread& t, E& e)
+{
+    while (t.joinable() && !t.join(10)) e.notify_signal();
+}
+
+// auto_reset_event once created manual-reset kernel events and manual_reset_event auto-reset ones (CreateEventW takes bManualReset).
+
+XTW_TEST(auto_reset_event_consumes_the_signal)
+{
+    auto_reset_event e{};
+    XTW_CHECK(!e.wait_signal(0));
+    e.notify_signal();
+    XTW_CHECK(e.wait_signal(0));
+    XTW_CHECK(!e.wait_signal(0));
+}
+
+XTW_TEST(auto_reset_event_initial_state)
+{
+    auto_reset_event e(true);
+    XTW_CHECK(e.wait_signal(0));
+    XTW_CHECK(!e.wait_signal(0));
+}
+
+XTW_TEST(manual_reset_event_stays_signaled_until_reset)
+{
+    manual_reset_event e{};
+    XTW_CHECK(!e.wait_signal(0));
+    e.notify_signal();
+    XTW_CHECK(e.wait_signal(0));
+    XTW_CHECK(e.wait_signal(0));
+    e.reset_signal_state();
+    XTW_CHECK(!e.wait_signal(0));
+}
+
+XTW_TEST(manual_reset_event_initial_state)
+{
+    manual_reset_event e(true);
+    XTW_CHECK(e.wait_signal(0));
+    XTW_CHECK(e.wait_signal(0));
+}
+
+XTW_TEST(auto_reset_event_releases_one_waiter_per_signal)
+{
+    auto_reset_event e{};
+    std::atomic_int woken{};
+    thread a([&] { e.wait_signal(); ++woken; });
+    thread b([&] { e.wait_signal(); ++woken; });
+
+    e.notify_signal();
+    while (woken.load() == 0) ::Sleep(1);
+    ::Sleep(20);
+    XTW_CHECK(woken.load() == 1);
+
+    e.notify_signal();
+    release_and_join(a, e);
+    release_and_join(b, e);
+    XTW_CHECK(woken.load() == 2);
+}
+
+XTW_TEST(manual_reset_event_releases_all_waiters)
+{
+    manual_reset_event e{};
+    std::atomic_int woken{};
+    thread a([&] { e.wait_signal(); ++woken; });
+    thread b([&] { e.wait_signal(); ++woken; });
+
+    e.notify_signal();
+    XTW_CHECK(a.join(1000));
+    XTW_CHECK(b.join(1000));
+    release_and_join(a, e);
+    release_and_join(b, e);
+    XTW_CHECK(woken.load() == 2);
+}
+
+XTW_TEST(thread_join_with_timeout)
+{
+    manual_reset_event go{};
+    thread t([&] { go.wait_signal(); });
+    XTW_CHECK(t.joinable());
+    XTW_CHECK(!t.join(10));
+    go.notify_signal();
+    XTW_CHECK(t.join());
+    XTW_CHECK(!t.joinable());
+}
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
@@ -0,0 +1,159 @@
+/// @file
+/// @brief  tests of xtw::window::ui_dispatcher
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#include <Windows.h>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <xtw/threading.h>
+#include <xtw/ui_dispatcher.h>
+
+#include "./test.h"
+
+using namespace xtw;
+using namespace xtw::window;
+
+XTW_TEST(tasks_run_in_posting_order_with_one_wake_per_batch)
+{
+    int wakes = 0;
+    ui_dispatcher d([&] { return ++wakes, true; });
+
+    std::vector<int> order{};
+    for (int i = 0; i < 5; i++) d.post([&order, i] { order.push_back(i); });
+    XTW_CHECK(wakes == 1);
+    XTW_CHECK(order.empty());
+
+    XTW_CHECK(d.drain() == 5u);
+    XTW_CHECK((order == std::vector<int>{0, 1, 2, 3, 4}));
+
+    d.post([&order] { order.push_back(5); }); // the list is empty again: a new batch
+    XTW_CHECK(wakes == 2);
+    XTW_CHECK(d.drain() == 1u);
+    XTW_CHECK(d.drain() == 0u);
+}
+
+XTW_TEST(partial_drains_wake_again_for_the_rest)
+{
+    int wakes = 0;
+    ui_dispatcher d([&] { return ++wakes, true; });
+    int runs = 0;
+    for (int i = 0; i < 10; i++) d.post([&runs] { runs++; });
+
+    XTW_CHECK(d.drain(4) == 4u);
+    XTW_CHECK(wakes == 2);
+    XTW_CHECK(d.drain(4) == 4u);
+    XTW_CHECK(d.drain() == 2u);
+    XTW_CHECK(wakes == 3);
+    XTW_CHECK(runs == 10);
+}
+
+XTW_TEST(a_throwing_task_keeps_the_rest)
+{
+    int wakes = 0;
+    ui_dispatcher d([&] { return ++wakes, true; });
+    int runs = 0;
+    d.post([&runs] { runs++; });
+    d.post([] { throw std::runtime_error("task"); });
+    d.post([&runs] { runs++; });
+
+    bool thrown = false;
+    try { (void)d.drain(); }
+    catch (const std::runtime_error&) { thrown = true; }
+    XTW_CHECK(thrown);
+    XTW_CHECK(runs == 1);
+    XTW_CHECK(wakes == 2);
+
+    XTW_CHECK(d.drain() == 1u);
+    XTW_CHECK(runs == 2);
+}
+
+XTW_TEST(failed_wakes_are_retried_by_the_next_post)
+{
+    int attempts = 0;
+    bool fail = true;
+    ui_dispatcher d([&] { return ++attempts, !fail; });
+
+    d.post([] {});
+    XTW_CHECK(attempts == 1);
+    fail = false;
+    d.post([] {}); // the list is not empty, but the last wake failed
+    XTW_CHECK(attempts == 2);
+    d.post([] {});
+    XTW_CHECK(attempts == 2);
+    XTW_CHECK(d.drain() == 3u);
+}
+
+XTW_TEST(pending_tasks_are_destroyed_without_running)
+{
+    auto token = std::make_shared<int>(0);
+    {
+        ui_dispatcher d([] { return true; });
+        d.post([token] { ++*token; });
+        d.post([token] { ++*token; });
+        XTW_CHECK(token.use_count() == 3);
+    }
+    XTW_CHECK(token.use_count() == 1);
+    XTW_CHECK(*token == 0);
+}
+
+XTW_TEST(window_messages_are_routed_to_their_dispatcher)
+{
+    const HWND window = reinterpret_cast<HWND>(uintptr_t{0x1234});
+    ui_dispatcher d(window);
+    XTW_CHECK(d.window() == window);
+    XTW_CHECK(d.message() == ui_dispatcher::default_message);
+
+    int runs = 0;
+    d.post([&runs] { runs++; }); // PostMessageW fails for this made-up window; handle_message still drains.
+    XTW_CHECK(!d.handle_message(window, WM_APP, 0, 0));
+    XTW_CHECK(!d.handle_message(nullptr, ui_dispatcher::default_message, 0, 0));
+    XTW_CHECK(runs == 0);
+
+    MSG msg{};
+    msg.hwnd = window;
+    msg.message = ui_dispatcher::default_message;
+    XTW_CHECK(d.handle_message(msg));
+    XTW_CHECK(runs == 1);
+}
+
+XTW_TEST(self_woken_dispatchers_wake_a_waiting_thread)
+{
+    ui_dispatcher d{};
+#if defined(_WIN32)
+    XTW_CHECK(d.wake_handle() != nullptr);
+#else
+    XTW_CHECK(d.wake_descriptor() >= 0);
+#endif
+    XTW_CHECK(!d.wait(0));
+
+    constexpr int posts = 10000;
+    std::atomic<int> runs{};
+    threading::thread consumer([&]
+    {
+        while (runs.load() < posts)
+            if (d.wait(5000)) d.drain();
+            else return;
+    });
+
+    for (int i = 0; i < posts; i++) d.post([&runs] { runs++; });
+    XTW_CHECK(consumer.join(10000));
+    XTW_CHECK(runs.load() == posts);
+
+    // drained: the wake object is reset.
+    XTW_CHECK(!d.wait(0));
+
+    bool thrown = false;
+    try { (void)ui_dispatcher([] { return true; }).wait(0); }
+    catch (const std::logic_error&) { thrown = true; }
+    XTW_CHECK(thrown);
+}
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
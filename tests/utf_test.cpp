@@ -0,0 +1,262 @@
+/// @file
+/// @brief  tests of xtw::utf
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+///
+/// Needs no Win32 backend; on POSIX it is also built with the default 4-byte wchar_t, where only the char16_t interface exists.
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <xtw/utf.h>
+
+#include "./test.h"
+
+using namespace xtw;
+
+namespace
+{
+    // straightforward encoders to check against
+    void append_utf8(std::string& s, char32_t cp)
+    {
+        if (cp < 0x80)
+        {
+            s += static_cast<char>(cp);
+        }
+        else if (cp < 0x800)
+        {
+            s += static_cast<char>(0xC0 | cp >> 6);
+            s += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else if (cp < 0x10000)
+        {
+            s += static_cast<char>(0xE0 | cp >> 12);
+            s += static_cast<char>(0x80 | (cp >> 6 & 0x3F));
+            s += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else
+        {
+            s += static_cast<char>(0xF0 | cp >> 18);
+            s += static_cast<char>(0x80 | (cp >> 12 & 0x3F));
+            s += static_cast<char>(0x80 | (cp >> 6 & 0x3F));
+            s += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    void append_utf16(std::u16string& s, char32_t cp)
+    {
+        if (cp < 0x10000)
+        {
+            s += static_cast<char16_t>(cp);
+        }
+        else
+        {
+            s += static_cast<char16_t>(0xD800 + ((cp - 0x10000) >> 10));
+            s += static_cast<char16_t>(0xDC00 + ((cp - 0x10000) & 0x3FF));
+        }
+    }
+
+    bool is_scalar_value(char32_t cp) { return cp < 0xD800 || (cp > 0xDFFF && cp <= 0x10FFFF); }
+
+    // converts both ways through the buffer interface, checking lengths and contents against the reference encodings.
+    bool round_trips(const std::u16string& utf16, const std::string& utf8)
+    {
+        if (utf::utf8_length(utf16) != utf8.size() || utf::utf16_length(utf8) != utf16.size()) return false;
+
+        std::string narrow(utf8.size(), '\0');
+        if (utf::utf16_to_utf8(utf16, narrow.data(), narrow.size()) != utf8.size() || narrow != utf8) return false;
+
+        std::u16string wide(utf16.size(), u'\0');
+        if (utf::utf8_to_utf16(utf8, wide.data(), wide.size()) != utf16.size() || wide != utf16) return false;
+
+        return utf::to_utf8(utf16) == utf8 && utf::to_u16string(utf8) == utf16;
+    }
+
+    bool is_rejected(std::u16string_view utf16)
+    {
+        std::string buffer(utf16.size() * 3 + 8, '\0');
+        return !utf::utf8_length(utf16) && !utf::utf16_to_utf8(utf16, buffer.data(), buffer.size());
+    }
+
+    bool is_rejected(std::string_view utf8)
+    {
+        std::u16string buffer(utf8.size() + 8, u'\0');
+        return !utf::utf16_length(utf8) && !utf::utf8_to_utf16(utf8, buffer.data(), buffer.size());
+    }
+
+    // prefix lengths placing what follows at, just before, and just after the SSE2 (16) and AVX2 (32) block boundaries.
+    constexpr size_t boundary_prefixes[] = {0, 1, 14, 15, 16, 17, 30, 31, 32, 33, 63, 64};
+}
+
+XTW_TEST(every_scalar_value_round_trips)
+{
+    std::u16string utf16{};
+    std::string utf8{};
+    for (char32_t cp = 0; cp <= 0x10FFFF; cp++)
+    {
+        if (!is_scalar_value(cp)) continue;
+        append_utf16(utf16, cp);
+        append_utf8(utf8, cp);
+    }
+    XTW_CHECK(round_trips(utf16, utf8));
+}
+
+XTW_TEST(ascii_runs_of_every_length_round_trip)
+{
+    // ASCII runs end at every offset within and across the SIMD blocks, followed by 2-, 3- and 4-byte sequences.
+    for (char32_t tail : {U'\0', U'\u00E9', U'\u65E5', U'\U0001F600'})
+    {
+        for (size_t n = 0; n <= 100; n++)
+        {
+            std::u16string utf16{};
+            std::string utf8{};
+            for (size_t i = 0; i < n; i++)
+            {
+                const auto c = static_cast<char32_t>(0x20 + i % 0x5F);
+                append_utf16(utf16, c);
+                append_utf8(utf8, c);
+            }
+            append_utf16(utf16, tail);
+            append_utf8(utf8, tail);
+            for (size_t i = 0; i < n; i++)
+            {
+                append_utf16(utf16, U'a');
+                append_utf8(utf8, U'a');
+            }
+            XTW_CHECK(round_trips(utf16, utf8));
+        }
+    }
+}
+
+XTW_TEST(empty_strings)
+{
+    XTW_CHECK(round_trips(u"", ""));
+    XTW_CHECK(utf::utf16_to_utf8(u"", nullptr, 0) == size_t{0});
+    XTW_CHECK(utf::utf8_to_utf16("", static_cast<char16_t*>(nullptr), 0) == size_t{0});
+}
+
+XTW_TEST(lone_surrogates_are_rejected)
+{
+    for (size_t prefix : boundary_prefixes)
+    {
+        const std::u16string ascii(prefix, u'x');
+        XTW_CHECK(is_rejected(ascii + u'\xD800'));                  // high surrogate at the end
+        XTW_CHECK(is_rejected(ascii + u'\xDBFF' + u"abc"));         // high surrogate before a non-surrogate
+        XTW_CHECK(is_rejected(ascii + u'\xD800' + u'\xD800' + u"a")); // high surrogate before a high surrogate
+        XTW_CHECK(is_rejected(ascii + u'\xDC00' + u"abc"));         // low surrogate first
+        XTW_CHECK(is_rejected(ascii + u'\xDFFF'));                  // low surrogate at the end
+        XTW_CHECK(is_rejected(u"\U0001F600" + ascii + u'\xDC00'));   // low surrogate after a pair
+
+        std::u16string pair = ascii + u"\U0001F600" + ascii; // well-formed for comparison
+        XTW_CHECK(!is_rejected(pair));
+    }
+}
+
+XTW_TEST(overlong_and_out_of_range_utf8_is_rejected)
+{
+    const char* const ill_formed[] = {
+        "\xC0\x80",         // overlong U+0000
+        "\xC1\xBF",         // overlong U+007F
+        "\xE0\x80\x80",     // overlong U+0000
+        "\xE0\x9F\xBF",     // overlong U+07FF
+        "\xF0\x80\x80\x80", // overlong U+0000
+        "\xF0\x8F\xBF\xBF", // overlong U+FFFF
+        "\xED\xA0\x80",     // U+D800, a surrogate
+        "\xED\xBF\xBF",     // U+DFFF, a surrogate
+        "\xF4\x90\x80\x80", // U+110000
+        "\xF5\x80\x80\x80", // lead byte beyond U+10FFFF
+        "\xFE",
+        "\xFF",
+        "\x80",             // continuation without a lead byte
+        "\xBF",
+        "\xC3\x28",         // lead byte followed by a non-continuation
+        "\xE2\x28\xA1",
+        "\xF0\x9F\x28\x80",
+    };
+
+    for (size_t prefix : boundary_prefixes)
+    {
+        const std::string ascii(prefix, 'x');
+        for (const char* s : ill_formed)
+        {
+            XTW_CHECK(is_rejected(ascii + s));
+            XTW_CHECK(is_rejected(ascii + s + "abcdefghijklmnopqrstuvwxyz0123456789"));
+        }
+    }
+
+    // boundaries of the valid ranges
+    XTW_CHECK(round_trips(u"\u0080\u07FF\u0800\uFFFF\U00010000\U0010FFFF", "\xC2\x80\xDF\xBF\xE0\xA0\x80\xEF\xBF\xBF\xF0\x90\x80\x80\xF4\x8F\xBF\xBF"));
+    XTW_CHECK(round_trips(u"\uD7FF\uE000", "\xED\x9F\xBF\xEE\x80\x80"));
+}
+
+XTW_TEST(truncated_utf8_is_rejected_at_block_boundaries)
+{
+    const std::string sequences[] = {"\xC3\xA9", "\xE6\x97\xA5", "\xF0\x9F\x98\x80"};
+    for (const auto& full : sequences)
+    {
+        for (size_t cut = 1; cut < full.size(); cut++)
+        {
+            const std::string partial = full.substr(0, cut);
+            for (size_t boundary : {size_t{16}, size_t{32}, size_t{64}})
+            {
+                // the truncated sequence ends exactly at the boundary, straddles it, and starts on it.
+                XTW_CHECK(is_rejected(std::string(boundary - partial.size(), 'x') + partial));
+                XTW_CHECK(is_rejected(std::string(boundary - 1, 'x') + partial + std::string(boundary, 'y')));
+                XTW_CHECK(is_rejected(std::string(boundary, 'x') + partial));
+                XTW_CHECK(is_rejected(std::string(boundary, 'x') + partial + std::string(boundary, 'y')));
+            }
+        }
+    }
+}
+
+XTW_TEST(small_buffers_are_reported)
+{
+    const std::u16string utf16 = std::u16string(40, u'a') + u"\u00E9\U0001F600";
+    const std::string utf8 = std::string(40, 'a') + "\xC3\xA9\xF0\x9F\x98\x80";
+
+    std::string narrow(utf8.size(), '\0');
+    for (size_t capacity = 0; capacity < utf8.size(); capacity++)
+        XTW_CHECK(!utf::utf16_to_utf8(utf16, narrow.data(), capacity));
+    XTW_CHECK(utf::utf16_to_utf8(utf16, narrow.data(), narrow.size()) == utf8.size());
+
+    std::u16string wide(utf16.size(), u'\0');
+    for (size_t capacity = 0; capacity < utf16.size(); capacity++)
+        XTW_CHECK(!utf::utf8_to_utf16(utf8, wide.data(), capacity));
+    XTW_CHECK(utf::utf8_to_utf16(utf8, wide.data(), wide.size()) == utf16.size());
+}
+
+XTW_TEST(string_conversions_throw_on_ill_formed_input)
+{
+    bool thrown = false;
+    try { (void)utf::to_utf8(u"a\xD800"); }
+    catch (const std::invalid_argument&) { thrown = true; }
+    XTW_CHECK(thrown);
+
+    thrown = false;
+    try { (void)utf::to_u16string("a\xC0\x80"); }
+    catch (const std::invalid_argument&) { thrown = true; }
+    XTW_CHECK(thrown);
+}
+
+#if defined(XTW_UTF_WCHAR_IS_UTF16)
+XTW_TEST(wchar_t_interface)
+{
+    const std::wstring wide = L"caf\u00E9 \U0001F600";
+    const std::string utf8 = "caf\xC3\xA9 \xF0\x9F\x98\x80";
+    XTW_CHECK(utf::to_utf8(wide) == utf8);
+    XTW_CHECK(utf::to_utf16(utf8) == wide);
+    XTW_CHECK(utf::utf8_length(wide) == utf8.size());
+
+    std::vector<wchar_t> buffer(wide.size());
+    XTW_CHECK(utf::utf8_to_utf16(utf8, buffer.data(), buffer.size()) == wide.size());
+    XTW_CHECK(std::wstring_view(buffer.data(), buffer.size()) == wide);
+}
+#endif
+
+int main(int argc, char** argv)
+{
+    return xtw_test::run(argc, argv);
+}
@@ -0,0 +1,284 @@
+/// @file
+/// @brief  xtw::benchmark
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace xtw::benchmark
+{
+    struct options
+    {
+        size_t min_samples = 15;
+        size_t max_samples = 101;
+        int64_t min_sample_time_us = 2000;  // iterations per sample are doubled until one sample takes this long
+        int64_t max_total_time_us = 2000000; // stops sampling after this, once min_samples are taken
+    };
+
+    /// Per-iteration times in nanoseconds. median and mad (median absolute deviation) are robust to outliers
+    /// such as preemptions, which the mean and standard deviation are not.
+    struct result
+    {
+        std::string name;
+        uint64_t iterations; // per sample
+        size_t samples;
+        double median_ns;
+        double mad_ns;
+        double min_ns;
+        double max_ns;
+    };
+
+    namespace benchmark_detail
+    {
+        static inline int64_t qpc() noexcept
+        {
+            LARGE_INTEGER c{};
+            ::QueryPerformanceCounter(&c);
+            return c.QuadPart;
+        }
+
+        static inline double qpc_frequency() noexcept
+        {
+            static const double frequency = []
+            {
+                LARGE_INTEGER f{};
+                ::QueryPerformanceFrequency(&f);
+                return static_cast<double>(f.QuadPart);
+            }();
+            return frequency;
+        }
+
+        static inline double median_of(std::vector<double>& v)
+        {
+            if (v.empty()) return 0.0;
+            const size_t n = v.size() / 2;
+            std::nth_element(v.begin(), v.begin() + static_cast<ptrdiff_t>(n), v.end());
+            const double upper = v[n];
+            if (v.size() % 2) return upper;
+            return (*std::max_element(v.begin(), v.begin() + static_cast<ptrdiff_t>(n)) + upper) / 2;
+        }
+
+        static inline const volatile void* volatile sink{};
+
+        static inline std::string sanitize(std::string_view name)
+        {
+            std::string s(name);
+            std::replace(s.begin(), s.end(), '\t', ' '); // field separator
+            std::replace(s.begin(), s.end(), '\n', ' ');
+            return s;
+        }
+    }
+
+    /// Keeps the compiler from discarding a computed value.
+    template <class T>
+    static inline void do_not_optimize(const T& value) noexcept
+    {
+#if defined(__GNUC__)
+        asm volatile("" : : "r"(std::addressof(value)) : "memory");
+#else
+        benchmark_detail::sink = std::addressof(value); // the address is never read back.
+#endif
+    }
+
+    /// Measures f(), calling it repeatedly in samples of equal iteration counts.
+    template <class F>
+    static inline result measure(std::string_view name, F&& f, const options& opt = {})
+    {
+        using namespace benchmark_detail;
+        const double frequency = qpc_frequency();
+        const auto run = [&](uint64_t iterations)
+        {
+            const int64_t start = qpc();
+            for (uint64_t i = 0; i < iterations; i++) f();
+            return qpc() - start;
+        };
+
+        // calibration; also warms caches and branch predictors.
+        uint64_t iterations = 1;
+        const auto min_ticks = static_cast<int64_t>(static_cast<double>(opt.min_sample_time_us) * frequency / 1e6);
+        while (run(iterations) < min_ticks && iterations < (uint64_t{1} << 40))
+            iterations *= 2;
+
+        const size_t max_samples = std::max<size_t>(opt.max_samples, 1); // at least one sample to take statistics of
+        std::vector<double> samples{};
+        samples.reserve(max_samples);
+        const auto max_ticks = static_cast<int64_t>(static_cast<double>(opt.max_total_time_us) * frequency / 1e6);
+        const int64_t begin = qpc();
+        while (samples.size() < max_samples && (samples.size() < opt.min_samples || qpc() - begin < max_ticks))
+            samples.push_back(static_cast<double>(run(iterations)) * 1e9 / frequency / static_cast<double>(iterations));
+
+        result r{};
+        r.name = sanitize(name);
+        r.iterations = iterations;
+        r.samples = samples.size();
+        r.min_ns = *std::min_element(samples.begin(), samples.end());
+        r.max_ns = *std::max_element(samples.begin(), samples.end());
+        r.median_ns = median_of(samples);
+        for (double& s : samples) s = std::abs(s - r.median_ns);
+        r.mad_ns = median_of(samples);
+        return r;
+    }
+
+    /// Named benchmarks, run in registration order.
+    class suite final
+    {
+        std::vector<std::pair<std::string, std::function<void()>>> benchmarks_{};
+
+    public:
+        suite() = default;
+        suite(const suite& other) = delete;
+        suite(suite&& other) noexcept = default;
+        suite& operator=(const suite& other) = delete;
+        suite& operator=(suite&& other) noexcept = default;
+        ~suite() = default;
+
+        suite& add(std::string name, std::function<void()> body)
+        {
+            benchmarks_.emplace_back(std::move(name), std::move(body));
+            return *this;
+        }
+
+        /// Runs the benchmarks whose names contain filter.
+        [[nodiscard]] std::vector<result> run(const options& opt = {}, std::string_view filter = {}) const
+        {
+            std::vector<result> results{};
+            for (auto& [name, body] : benchmarks_)
+                if (name.find(filter) != std::string::npos)
+                    results.push_back(measure(name, body, opt));
+            return results;
+        }
+    };
+
+    /// Tab-separated results with a header line; read back by parse_results().
+    [[nodiscard]] static inline std::string format_results(const std::vector<result>& results)
+    {
+        std::string text = "name\titerations\tsamples\tmedian_ns\tmad_ns\tmin_ns\tmax_ns\n";
+        char buf[160];
+        for (auto& r : results)
+        {
+            std::snprintf(buf, sizeof(buf), "\t%llu\t%zu\t%.3f\t%.3f\t%.3f\t%.3f\n",
+                          static_cast<unsigned long long>(r.iterations), r.samples, r.median_ns, r.mad_ns, r.min_ns, r.max_ns);
+            text += benchmark_detail::sanitize(r.name);
+            text += buf;
+        }
+        return text;
+    }
+
+    /// Parses the output of format_results(). Malformed lines are skipped.
+    [[nodiscard]] static inline std::vector<result> parse_results(std::string_view text)
+    {
+        std::vector<result> results{};
+        bool header = true;
+        while (!text.empty())
+        {
+            const size_t eol = text.find('\n');
+            std::string line(text.substr(0, eol));
+            text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+            if (std::exchange(header, false) || line.empty()) continue;
+
+            const size_t tab = line.find('\t');
+            if (tab == std::string::npos) continue;
+
+            result r{};
+            r.name = line.substr(0, tab);
+            unsigned long long iterations{};
+            if (std::sscanf(line.c_str() + tab, "\t%llu\t%zu\t%lf\t%lf\t%lf\t%lf", &iterations, &r.samples, &r.median_ns, &r.mad_ns, &r.min_ns, &r.max_ns) != 6) continue;
+            r.iterations = iterations;
+            results.push_back(std::move(r));
+        }
+        return results;
+    }
+
+    enum struct verdict
+    {
+        unchanged,
+        faster,
+        slower,
+        missing, // in the baseline only
+        added,   // in the current results only
+    };
+
+    struct comparison
+    {
+        std::string name;
+        double baseline_ns;
+        double current_ns;
+        double ratio;        // current / baseline
+        double threshold_ns; // smallest difference considered significant
+        verdict result;
+    };
+
+    /// Compares medians against a baseline. A difference is significant only if it exceeds both
+    /// relative_threshold of the baseline and mad_factor times the combined noise (MAD scaled to a standard deviation)
+    /// of the two runs, so noisy benchmarks need a larger change to be reported.
+    [[nodiscard]] static inline std::vector<comparison> compare(
+        const std::vector<result>& baseline, const std::vector<result>& current,
+        double relative_threshold = 0.05, double mad_factor = 3.0)
+    {
+        const auto find = [](const std::vector<result>& v, const std::string& name) -> const result*
+        {
+            auto it = std::find_if(v.begin(), v.end(), [&](const result& r) { return r.name == name; });
+            return it != v.end() ? &*it : nullptr;
+        };
+
+        std::vector<comparison> comparisons{};
+        for (auto& b : baseline)
+        {
+            const result* c = find(current, b.name);
+            if (!c)
+            {
+                comparisons.push_back(comparison{b.name, b.median_ns, 0.0, 0.0, 0.0, verdict::missing});
+                continue;
+            }
+
+            constexpr double mad_to_sigma = 1.4826;
+            const double noise = mad_to_sigma * std::sqrt(b.mad_ns * b.mad_ns + c->mad_ns * c->mad_ns);
+            const double threshold = std::max(relative_threshold * b.median_ns, mad_factor * noise);
+            const double diff = c->median_ns - b.median_ns;
+            const verdict v = diff > threshold ? verdict::slower : -diff > threshold ? verdict::faster : verdict::unchanged;
+            comparisons.push_back(comparison{b.name, b.median_ns, c->median_ns, b.median_ns > 0 ? c->median_ns / b.median_ns : 0.0, threshold, v});
+        }
+
+        for (auto& c : current)
+            if (!find(baseline, c.name))
+                comparisons.push_back(comparison{c.name, 0.0, c.median_ns, 0.0, 0.0, verdict::added});
+
+        return comparisons;
+    }
+
+    [[nodiscard]] static inline bool has_regression(const std::vector<comparison>& comparisons) noexcept
+    {
+        return std::any_of(comparisons.begin(), comparisons.end(), [](const comparison& c) { return c.result == verdict::slower; });
+    }
+
+    /// One human-readable line per comparison.
+    [[nodiscard]] static inline std::string format_comparisons(const std::vector<comparison>& comparisons)
+    {
+        static constexpr const char* verdict_names[] = {"unchanged", "faster", "SLOWER", "missing", "added"};
+        std::string text{};
+        char buf[160];
+        for (auto& c : comparisons)
+        {
+            std::snprintf(buf, sizeof(buf), ": %.3f ns -> %.3f ns (x%.3f, threshold %.3f ns) %s\n",
+                          c.baseline_ns, c.current_ns, c.ratio, c.threshold_ns, verdict_names[static_cast<int>(c.result)]);
+            text += c.name;
+            text += buf;
+        }
+        return text;
+    }
+}
@@ -0,0 +1,218 @@
+/// @file
+/// @brief  xtw::capabilities
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define XTW_CAPABILITIES_X86 1
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define XTW_CAPABILITIES_X86 1
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "./windows_version.h"
+
+namespace xtw
+{
+    struct cpu_features
+    {
+        bool sse2;
+        bool sse3;
+        bool ssse3;
+        bool sse4_1;
+        bool sse4_2;
+        bool popcnt;
+        bool avx;  // includes OS support (XSAVE enabled for YMM)
+        bool avx2;
+        bool fma;
+        bool bmi1;
+        bool bmi2;
+        bool avx512f; // includes OS support (XSAVE enabled for ZMM)
+        bool avx512dq;
+        bool avx512bw;
+        bool avx512vl;
+    };
+
+    struct cache_sizes
+    {
+        size_t line_size;
+        size_t l1_data; // per core
+        size_t l2;
+        size_t l3;
+    };
+
+    struct capabilities
+    {
+        windows_version os;
+        cpu_features cpu;
+        cache_sizes cache;
+        size_t logical_processor_count;
+
+        // gets current capabilities. computed once.
+        [[nodiscard]] static const capabilities& current()
+        {
+            static const capabilities c = []
+            {
+                capabilities result{};
+                result.os = windows_version::current();
+                result.cpu = query_cpu_features();
+                result.cache = query_cache_sizes();
+
+                SYSTEM_INFO si{};
+                ::GetSystemInfo(&si);
+                result.logical_processor_count = si.dwNumberOfProcessors;
+                return result;
+            }();
+            return c;
+        }
+
+    private:
+#if defined(XTW_CAPABILITIES_X86)
+        // r = {eax, ebx, ecx, edx} of cpuid(leaf, sub_leaf)
+        static void cpuid(unsigned r[4], unsigned leaf, unsigned sub_leaf) noexcept
+        {
+#if defined(_MSC_VER)
+            int regs[4]{};
+            __cpuidex(regs, static_cast<int>(leaf), static_cast<int>(sub_leaf));
+            for (int i = 0; i < 4; i++) r[i] = static_cast<unsigned>(regs[i]);
+#else
+            r[0] = r[1] = r[2] = r[3] = 0;
+            __get_cpuid_count(leaf, sub_leaf, &r[0], &r[1], &r[2], &r[3]); // leaves zero above the maximum leaf.
+#endif
+        }
+
+        // XCR0; only valid when the OS has set CR4.OSXSAVE.
+#if defined(__GNUC__) && !defined(_MSC_VER)
+        __attribute__((target("xsave")))
+#endif
+        static unsigned long long xcr0() noexcept
+        {
+            return _xgetbv(0);
+        }
+#endif
+
+        static cpu_features query_cpu_features() noexcept
+        {
+            cpu_features f{};
+#if defined(XTW_CAPABILITIES_X86)
+            const auto bit = [](unsigned reg, int n) { return (reg >> n & 1u) != 0; };
+
+            unsigned r[4]{}; // eax, ebx, ecx, edx
+            cpuid(r, 0, 0);
+            const unsigned max_leaf = r[0];
+
+            cpuid(r, 1, 0);
+            f.sse2 = bit(r[3], 26);
+            f.sse3 = bit(r[2], 0);
+            f.ssse3 = bit(r[2], 9);
+            f.fma = bit(r[2], 12);
+            f.sse4_1 = bit(r[2], 19);
+            f.sse4_2 = bit(r[2], 20);
+            f.popcnt = bit(r[2], 23);
+
+            const bool os_xsave = bit(r[2], 27);
+            const unsigned long long xcr = os_xsave ? xcr0() : 0;
+            const bool os_ymm = (xcr & 0x06) == 0x06; // SSE, AVX state
+            const bool os_zmm = (xcr & 0xE6) == 0xE6; // and opmask, ZMM_Hi256, Hi16_ZMM state
+
+            f.avx = bit(r[2], 28) && os_ymm;
+            f.fma = f.fma && os_ymm;
+
+            if (max_leaf >= 7)
+            {
+                cpuid(r, 7, 0);
+                f.bmi1 = bit(r[1], 3);
+                f.avx2 = bit(r[1], 5) && os_ymm;
+                f.bmi2 = bit(r[1], 8);
+                f.avx512f = bit(r[1], 16) && os_zmm;
+                f.avx512dq = bit(r[1], 17) && f.avx512f;
+                f.avx512bw = bit(r[1], 30) && f.avx512f;
+                f.avx512vl = bit(r[1], 31) && f.avx512f;
+            }
+#endif
+            return f;
+        }
+
+        static cache_sizes query_cache_sizes()
+        {
+            cache_sizes c{};
+
+            DWORD length{};
+            (void)::GetLogicalProcessorInformation(nullptr, &length);
+            std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+            if (info.empty() || !::GetLogicalProcessorInformation(info.data(), &length)) return c;
+
+            for (const auto& i : info)
+            {
+                if (i.Relationship != RelationCache) continue;
+
+                const CACHE_DESCRIPTOR& d = i.Cache;
+                if (d.Type == CacheInstruction || d.Type == CacheTrace) continue;
+                if (!c.line_size) c.line_size = d.LineSize;
+
+                size_t* target = d.Level == 1 ? &c.l1_data : d.Level == 2 ? &c.l2 : d.Level == 3 ? &c.l3 : nullptr;
+                if (target && !*target) *target = d.Size;
+            }
+            return c;
+        }
+    };
+
+    /// Function pointer bound to the best kernel variant on first call.
+    ///
+    ///   static inline const dispatched_function<size_t(const char*, size_t)> count_zero{
+    ///       [](const capabilities& c) { return c.cpu.avx2 ? &count_zero_avx2 : &count_zero_sse2; }};
+    ///
+    /// The selector runs once; later calls load the bound pointer and call it directly.
+    template <class Signature>
+    class dispatched_function;
+
+    template <class R, class... Args>
+    class dispatched_function<R(Args...)> final
+    {
+    public:
+        using function_pointer = R(*)(Args...);
+        using selector_type = function_pointer(*)(const capabilities&);
+
+    private:
+        selector_type selector_{};
+        mutable std::atomic<function_pointer> target_{};
+
+    public:
+        constexpr explicit dispatched_function(selector_type selector) noexcept : selector_(selector) {}
+
+        dispatched_function(const dispatched_function& other) = delete;
+        dispatched_function(dispatched_function&& other) noexcept = delete;
+        dispatched_function& operator=(const dispatched_function& other) = delete;
+        dispatched_function& operator=(dispatched_function&& other) noexcept = delete;
+        ~dispatched_function() = default;
+
+        // binds on first call. concurrent first calls may run the selector more than once, which is harmless.
+        [[nodiscard]] function_pointer get() const
+        {
+            function_pointer f = target_.load(std::memory_order_relaxed);
+            if (!f)
+            {
+                f = selector_(capabilities::current());
+                target_.store(f, std::memory_order_relaxed);
+            }
+            return f;
+        }
+
+        R operator()(Args... args) const
+        {
+            return get()(std::forward<Args>(args)...);
+        }
+    };
+}
@@ -16,6 +16,8 @@
 #include <type_traits>
 #include <utility>
 
+#include "./utf.h"
+
 // com_util
 namespace xtw
 {
@@ -47,11 +49,7 @@ namespace xtw
 
     static inline std::string to_string(GUID guid)
     {
-        std::wstring o = to_wstring(guid); // assumes no non-ascii character.
-        std::string s;
-        s.reserve(o.size());
-        std::transform(o.begin(), o.end(), std::back_insert_iterator(s), [](wchar_t w) { return static_cast<char>(w); });
-        return s;
+        return utf::to_utf8(to_wstring(guid));
     }
 }
 
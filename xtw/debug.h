@@ -6,8 +6,10 @@
 #pragma once
 
 #include <Windows.h>
+#include <intrin.h>
 
 #include <cassert>
+#include <cstdio>
 
 #include <chrono>
 #include <string>
@@ -98,7 +100,7 @@ namespace xtw::debug
                     auto ti = system_clock::to_time_t(now);
                     std::tm tm{};
                     (void)localtime_s(&tm, &ti);
-                    auto q = std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm); // YYYY-MM-DD HH:MM:SS
+                    [[maybe_unused]] auto q = std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm); // YYYY-MM-DD HH:MM:SS
                     for (size_t i = 0; i < sizeof(buf) - 1; i++) *p++ = static_cast<T>(buf[i]);
                     assert(q == sizeof(buf) - 1);
                 }
@@ -107,8 +109,8 @@ namespace xtw::debug
                     // 7 characters
                     char buf[8]{};
                     static_assert(microseconds::period::num == 1 && microseconds::period::den == 1000000);
-                    auto f = duration_cast<microseconds>(now.time_since_epoch()).count() * microseconds::period::num % microseconds::period::den;
-                    auto q = std::snprintf(buf, sizeof(buf), ".%06d", static_cast<int>(f));
+                    auto f = static_cast<unsigned>(duration_cast<microseconds>(now.time_since_epoch()).count() * microseconds::period::num % microseconds::period::den);
+                    [[maybe_unused]] auto q = std::snprintf(buf, sizeof(buf), ".%06u", f);
                     for (size_t i = 0; i < sizeof(buf) - 1; i++) *p++ = static_cast<T>(buf[i]);
                     assert(q == sizeof(buf) - 1);
                 }
@@ -150,6 +152,32 @@ namespace xtw::debug
         template <class T> constexpr T operator %(T r) const { return (void)F::operator()(r), r; }
         template <class T> constexpr T operator %=(T r) const { return (void)F::operator()(r), r; }
     };
+
+    // callback by `%` operator, with the return address into the caller's code.
+    // The operators are not inlined, so the address is the expression's own call site whichever way F was compiled.
+    template <class F>
+    struct percent_operator_call_site_redirection : F
+    {
+        constexpr explicit percent_operator_call_site_redirection(F f) : F(std::move(f)) {}
+        template <class T> __declspec(noinline) T operator %(T r) const { return (void)F::operator()(r, _ReturnAddress()), r; }
+        template <class T> __declspec(noinline) T operator %=(T r) const { return (void)F::operator()(r, _ReturnAddress()), r; }
+    };
+
+    // "message at 0xcall_site" and one "#n 0xaddress" line per captured frame. Symbols are not looked up here;
+    // xtw/stack_trace.h resolves them (stack_trace::of(e).to_string()).
+    static inline std::string describe_failure(const win32_exception& e)
+    {
+        std::string result = e.what();
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), " at %p\n", e.call_site());
+        result += buf;
+        for (size_t i = 0; i < e.frame_count(); i++)
+        {
+            std::snprintf(buf, sizeof(buf), "#%zu %p\n", i, e.frames()[i]);
+            result += buf;
+        }
+        return result;
+    }
 }
 
 
@@ -157,7 +185,7 @@ namespace xtw::debug
 #define XTW_DEBUG_BREAK() (::IsDebuggerPresent() ? ::DebugBreak() : void(0))
 #define XTW_DEBUG_LOG(...) (::xtw::debug::debug_output_stream{__VA_ARGS__})
 #define XTW_TRACE_LOG(...) (::xtw::debug::debug_output_stream{__VA_ARGS__})
-#define XTW_EXPECT_SUCCESS (::xtw::debug::percent_operator_redirection([](::HRESULT hr) { if (FAILED(hr)) { XTW_DEBUG_LOG("EXPECT_SUCCESS FAILED: ") << " at " << __FILE__ << ":" << __LINE__ << ": " << ::xtw::win32_exception(hr).what() << ")"; XTW_DEBUG_BREAK(); } }))%=
+#define XTW_EXPECT_SUCCESS (::xtw::debug::percent_operator_call_site_redirection([](::HRESULT hr, const void* call_site) { if (FAILED(hr)) { XTW_DEBUG_LOG("EXPECT_SUCCESS FAILED: ") << " at " << __FILE__ << ":" << __LINE__ << ": " << ::xtw::debug::describe_failure(::xtw::win32_exception(hr, nullptr, call_site)); XTW_DEBUG_BREAK(); } }))%=
 #else
 #define XTW_DEBUG_BREAK() void(0)
 #define XTW_DEBUG_LOG(...) (::xtw::debug::null_ostream{})
@@ -165,4 +193,4 @@ namespace xtw::debug
 #define XTW_EXPECT_SUCCESS
 #endif
 
-#define XTW_THROW_ON_FAILURE (::xtw::debug::percent_operator_redirection([](::HRESULT hr) { if (FAILED(hr)) { XTW_DEBUG_BREAK(); throw ::xtw::win32_exception(hr); } }))%=
+#define XTW_THROW_ON_FAILURE (::xtw::debug::percent_operator_call_site_redirection([](::HRESULT hr, const void* call_site) { if (FAILED(hr)) { XTW_DEBUG_BREAK(); throw ::xtw::win32_exception(hr, nullptr, call_site); } }))%=
@@ -0,0 +1,167 @@
+/// @file
+/// @brief  xtw::debug::symbol_cache
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+#include <DbgHelp.h>
+#pragma comment(lib, "DbgHelp.lib")
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "./utf.h"
+
+namespace xtw::debug
+{
+    struct symbol_info
+    {
+        std::string function; // undecorated name; empty if unknown
+        std::string module;   // file name of the module, e.g. "app.exe"
+        uintptr_t displacement; // from the start of the function (or module, if the function is unknown)
+        std::string file;     // source file; empty if no line information
+        uint32_t line;
+    };
+
+    /// Process-wide address-to-symbol cache over DbgHelp.
+    /// DbgHelp is initialized on first use and is not thread-safe, so all lookups are serialized here.
+    /// Each address is resolved once; later lookups are a hash map hit.
+    class symbol_cache final
+    {
+        std::mutex mutex_{};
+        std::unordered_map<uintptr_t, symbol_info> cache_{};
+        bool initialized_{};
+
+        symbol_cache() = default;
+
+    public:
+        symbol_cache(const symbol_cache& other) = delete;
+        symbol_cache(symbol_cache&& other) noexcept = delete;
+        symbol_cache& operator=(const symbol_cache& other) = delete;
+        symbol_cache& operator=(symbol_cache&& other) noexcept = delete;
+        ~symbol_cache() = default;
+
+        [[nodiscard]] static symbol_cache& instance()
+        {
+            static symbol_cache c{};
+            return c;
+        }
+
+        /// Resolves an address. The returned reference stays valid until clear().
+        const symbol_info& resolve(const void* address)
+        {
+            std::lock_guard lock(mutex_);
+            const auto key = reinterpret_cast<uintptr_t>(address);
+            if (auto it = cache_.find(key); it != cache_.end()) return it->second;
+            return cache_.emplace(key, lookup(key)).first->second;
+        }
+
+        /// "function" if known, otherwise "module+0xoffset", otherwise "0xaddress".
+        [[nodiscard]] std::string name_of(const void* address)
+        {
+            const symbol_info& s = resolve(address);
+            if (!s.function.empty()) return s.function;
+
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), s.module.empty() ? "0x%llx" : "+0x%llx",
+                          static_cast<unsigned long long>(s.module.empty() ? reinterpret_cast<uintptr_t>(address) : s.displacement));
+            return s.module + buf;
+        }
+
+        /// "function+0xdisp (file:line) [module]"
+        [[nodiscard]] std::string describe(const void* address)
+        {
+            const symbol_info& s = resolve(address);
+            std::string result = name_of(address);
+            if (!s.function.empty())
+            {
+                char buf[32];
+                std::snprintf(buf, sizeof(buf), "+0x%llx", static_cast<unsigned long long>(s.displacement));
+                result += buf;
+            }
+            if (!s.file.empty()) result += " (" + s.file + ":" + std::to_string(s.line) + ")";
+            if (!s.module.empty()) result += " [" + s.module + "]";
+            return result;
+        }
+
+        /// Drops cached entries, e.g. after modules were unloaded.
+        void clear()
+        {
+            std::lock_guard lock(mutex_);
+            cache_.clear();
+            if (initialized_) (void)::SymRefreshModuleList(::GetCurrentProcess());
+        }
+
+        /// "module+0xoffset", otherwise "0xaddress". Uses the loader only: no DbgHelp, no symbol loading, no lock of this cache.
+        [[nodiscard]] static std::string module_offset_of(const void* address)
+        {
+            const symbol_info s = locate_module(reinterpret_cast<uintptr_t>(address));
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), s.module.empty() ? "0x%llx" : "+0x%llx",
+                          static_cast<unsigned long long>(s.module.empty() ? reinterpret_cast<uintptr_t>(address) : s.displacement));
+            return s.module + buf;
+        }
+
+    private:
+        // module and displacement from the module base.
+        static symbol_info locate_module(uintptr_t address)
+        {
+            symbol_info result{};
+
+            HMODULE module{};
+            if (::GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, reinterpret_cast<LPCWSTR>(address), &module))
+            {
+                wchar_t path[MAX_PATH]{};
+                const DWORD len = ::GetModuleFileNameW(module, path, MAX_PATH);
+                std::wstring_view name(path, len);
+                if (auto slash = name.find_last_of(L"\\/"); slash != std::wstring_view::npos) name.remove_prefix(slash + 1);
+                result.module = utf::to_utf8(name);
+                result.displacement = address - reinterpret_cast<uintptr_t>(module);
+            }
+            return result;
+        }
+
+        // requires mutex_
+        symbol_info lookup(uintptr_t address)
+        {
+            const HANDLE process = ::GetCurrentProcess();
+            if (!initialized_)
+            {
+                ::SymSetOptions(::SymGetOptions() | SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS | SYMOPT_LOAD_LINES);
+                (void)::SymInitializeW(process, nullptr, TRUE); // fails if the application initialized DbgHelp itself; lookups still work then.
+                initialized_ = true;
+            }
+
+            symbol_info result = locate_module(address);
+
+            alignas(SYMBOL_INFOW) std::byte buffer[sizeof(SYMBOL_INFOW) + MAX_SYM_NAME * sizeof(wchar_t)]{};
+            auto symbol = reinterpret_cast<SYMBOL_INFOW*>(buffer);
+            symbol->SizeOfStruct = sizeof(SYMBOL_INFOW);
+            symbol->MaxNameLen = MAX_SYM_NAME;
+
+            DWORD64 displacement{};
+            if (::SymFromAddrW(process, address, &displacement, symbol))
+            {
+                result.function = utf::to_utf8(std::wstring_view(symbol->Name, symbol->NameLen));
+                result.displacement = static_cast<uintptr_t>(displacement);
+            }
+
+            IMAGEHLP_LINEW64 line{};
+            line.SizeOfStruct = sizeof(IMAGEHLP_LINEW64);
+            DWORD line_displacement{};
+            if (::SymGetLineFromAddrW64(process, address, &line_displacement, &line))
+            {
+                result.file = utf::to_utf8(line.FileName);
+                result.line = line.LineNumber;
+            }
+
+            return result;
+        }
+    };
+}
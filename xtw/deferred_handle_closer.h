@@ -0,0 +1,184 @@
+/// @file
+/// @brief  xtw::deferred_handle_closer
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "./threading.h"
+#include "./unique_handle.h"
+
+namespace xtw
+{
+    /// Background thread closing handles in batches.
+    /// Closing a large file or section handle can block for milliseconds (flushing, tearing down the mapping);
+    /// handles released through deferred_closer are closed here instead of on the releasing thread.
+    /// The closer is a function-local static; handles released after its destruction (by other statics) are closed synchronously.
+    class deferred_handle_closer final
+    {
+    public:
+        using close_function = void (*)(void* handle) noexcept;
+
+    private:
+        struct entry
+        {
+            void* handle;
+            close_function close;
+        };
+
+        std::mutex mutex_{};
+        std::condition_variable flushed_{};
+        std::vector<entry> queue_{};  // guarded by mutex_
+        uint64_t enqueued_{};         // guarded by mutex_
+        uint64_t closed_{};           // guarded by mutex_
+        bool stop_{};                 // guarded by mutex_
+        threading::auto_reset_event wake_{};
+        threading::thread worker_{};
+
+        // set when the instance is destroyed. Trivially destructible, so it stays readable during the rest of static destruction.
+        static std::atomic<bool>& shut_down() noexcept
+        {
+            static std::atomic<bool> s{};
+            return s;
+        }
+
+        deferred_handle_closer()
+        {
+            worker_ = threading::thread([this] { this->worker_main(); }, 65536, THREAD_PRIORITY_BELOW_NORMAL, L"xtw::deferred_handle_closer");
+        }
+
+    public:
+        deferred_handle_closer(const deferred_handle_closer& other) = delete;
+        deferred_handle_closer(deferred_handle_closer&& other) noexcept = delete;
+        deferred_handle_closer& operator=(const deferred_handle_closer& other) = delete;
+        deferred_handle_closer& operator=(deferred_handle_closer&& other) noexcept = delete;
+
+        // closes what is left on static destruction.
+        ~deferred_handle_closer()
+        {
+            shut_down().store(true, std::memory_order_release);
+            {
+                std::lock_guard lock(mutex_);
+                stop_ = true;
+            }
+            wake_.notify_signal();
+            worker_.join();
+        }
+
+        /// Gets the process-wide closer. The worker thread starts on first use.
+        /// Must not be called after the closer is destroyed; see close_deferred().
+        [[nodiscard]] static deferred_handle_closer& instance()
+        {
+            static deferred_handle_closer c{};
+            return c;
+        }
+
+        /// Queues a handle on the process-wide closer, or closes it synchronously
+        /// if the closer has been destroyed or its worker thread could not be started.
+        static void close_deferred(void* handle, close_function close) noexcept
+        {
+            if (shut_down().load(std::memory_order_acquire)) return close(handle);
+
+            try { instance().post(handle, close); }
+            catch (...) { close(handle); }
+        }
+
+        /// Queues a handle to be closed with close(handle). Closes it synchronously if it cannot be queued.
+        void post(void* handle, close_function close) noexcept
+        {
+            bool queued{};
+            bool was_empty{};
+            {
+                std::lock_guard lock(mutex_);
+                if (!stop_)
+                {
+                    try
+                    {
+                        queue_.push_back(entry{handle, close});
+                        enqueued_++;
+                        queued = true;
+                        was_empty = queue_.size() == 1;
+                    }
+                    catch (const std::bad_alloc&) { }
+                }
+            }
+
+            if (!queued) return close(handle);
+
+            // the worker drains the whole queue per wake; only the first handle of a batch needs to wake it.
+            if (was_empty) wake_.notify_signal();
+        }
+
+        /// Blocks until every handle queued before this call is closed.
+        void flush()
+        {
+            std::unique_lock lock(mutex_);
+            const uint64_t target = enqueued_;
+            flushed_.wait(lock, [&] { return closed_ >= target; });
+        }
+
+    private:
+        void worker_main()
+        {
+            std::vector<entry> batch{};
+            while (true)
+            {
+                bool stop{};
+                {
+                    std::lock_guard lock(mutex_);
+                    batch.swap(queue_);
+                    stop = stop_;
+                }
+
+                for (auto& e : batch)
+                    e.close(e.handle);
+
+                {
+                    std::lock_guard lock(mutex_);
+                    closed_ += batch.size();
+                }
+                flushed_.notify_all();
+                batch.clear();
+
+                if (stop) return; // nothing is queued after stop_.
+                wake_.wait_signal();
+            }
+        }
+    };
+
+    /// Closer adapter: hands the handle to deferred_handle_closer, which closes it with CLOSER on its thread.
+    template <class CLOSER>
+    struct deferred_closer
+    {
+        static_assert(std::is_empty_v<CLOSER> && std::is_default_constructible_v<CLOSER>, "CLOSER must be stateless.");
+
+        template <class HANDLE>
+        void operator()(HANDLE p) const noexcept
+        {
+            if (!p) return;
+
+            static_assert(sizeof(HANDLE) == sizeof(void*));
+            deferred_handle_closer::close_deferred(
+                reinterpret_cast<void*>(p),
+                [](void* h) noexcept { CLOSER{}(reinterpret_cast<HANDLE>(h)); });
+        }
+    };
+
+    template <class HANDLE, class CLOSER>
+    using deferred_unique_handle_t = unique_handle_t<HANDLE, deferred_closer<CLOSER>>;
+
+    using deferred_unique_handle = deferred_unique_handle_t<HANDLE, default_handle_closer>;
+
+    static_assert(sizeof(deferred_unique_handle) == sizeof(HANDLE));
+}
@@ -0,0 +1,236 @@
+/// @file
+/// @brief  xtw::handle_pool
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "./unique_handle.h"
+
+namespace xtw
+{
+    /// Process-wide pool of reusable kernel objects of one kind.
+    ///
+    /// Traits provides:
+    ///   using handle_type = unique_handle_t<...>;
+    ///   static handle_type create();                     // throws on failure
+    ///   static bool reset(const handle_type&) noexcept;  // returns the object to its initial state
+    ///
+    /// Objects are reset when released, so acquire() always returns an object in its initial state.
+    /// Each thread keeps a small cache in front of the shared free list, so steady-state acquire/release takes no locks.
+    /// The shared free list is capped at the high-water mark; objects released beyond it are closed.
+    template <class Traits, size_t ThreadCacheSize = 16>
+    class handle_pool final
+    {
+    public:
+        using handle_type = typename Traits::handle_type;
+
+    private:
+        struct shared_list
+        {
+            std::mutex mutex{};
+            std::vector<handle_type> free{};
+            std::atomic<size_t> high_water_mark{1024};
+        };
+
+        static shared_list& shared() noexcept
+        {
+            static shared_list s{};
+            return s;
+        }
+
+        struct thread_cache
+        {
+            handle_type items[ThreadCacheSize]{};
+            size_t count{};
+
+            thread_cache() = default;
+            thread_cache(const thread_cache& other) = delete;
+            thread_cache(thread_cache&& other) noexcept = delete;
+            thread_cache& operator=(const thread_cache& other) = delete;
+            thread_cache& operator=(thread_cache&& other) noexcept = delete;
+            ~thread_cache() { flush(count); }
+
+            // moves the oldest n items to the shared list.
+            void flush(size_t n) noexcept
+            {
+                auto& s = shared();
+                {
+                    std::lock_guard lock(s.mutex);
+                    const size_t limit = s.high_water_mark.load(std::memory_order_relaxed);
+                    for (size_t i = 0; i < n && s.free.size() < limit; i++)
+                    {
+                        try { s.free.push_back(std::move(items[i])); }
+                        catch (const std::bad_alloc&) { break; }
+                    }
+                }
+
+                for (size_t i = 0; i < n; i++)
+                    items[i].reset(); // closes what did not fit under the high-water mark
+
+                for (size_t i = n; i < count; i++)
+                    items[i - n] = std::move(items[i]);
+                count -= n;
+            }
+
+            // takes up to half a cache of items from the shared list.
+            void refill()
+            {
+                auto& s = shared();
+                std::lock_guard lock(s.mutex);
+                while (count < ThreadCacheSize / 2 && !s.free.empty())
+                {
+                    items[count++] = std::move(s.free.back());
+                    s.free.pop_back();
+                }
+            }
+        };
+
+        static thread_cache& local() noexcept
+        {
+            static thread_local thread_cache c{};
+            return c;
+        }
+
+    public:
+        handle_pool() = delete;
+
+        /// Takes an object in its initial state. Creates a new one when the pool is empty.
+        [[nodiscard]] static handle_type acquire()
+        {
+            auto& c = local();
+            if (c.count == 0) c.refill();
+            if (c.count != 0) return std::move(c.items[--c.count]);
+            return Traits::create();
+        }
+
+        /// Returns an object to the pool. The caller must not signal or wait on it afterwards.
+        static void release(handle_type h) noexcept
+        {
+            if (!h || !Traits::reset(h)) return; // closed
+
+            auto& c = local();
+            if (c.count == ThreadCacheSize) c.flush(ThreadCacheSize / 2);
+            c.items[c.count++] = std::move(h);
+        }
+
+        /// Caps the number of idle objects kept in the shared list.
+        static void set_high_water_mark(size_t count)
+        {
+            auto& s = shared();
+            std::vector<handle_type> excess{};
+            {
+                std::lock_guard lock(s.mutex);
+                s.high_water_mark.store(count, std::memory_order_relaxed);
+                while (s.free.size() > count)
+                {
+                    excess.push_back(std::move(s.free.back()));
+                    s.free.pop_back();
+                }
+            }
+            // excess handles are closed outside the lock.
+        }
+
+        /// Number of idle objects in the shared list, not counting per-thread caches.
+        [[nodiscard]] static size_t shared_count() noexcept
+        {
+            auto& s = shared();
+            std::lock_guard lock(s.mutex);
+            return s.free.size();
+        }
+    };
+
+    template <bool AutoReset>
+    struct event_pool_traits
+    {
+        using handle_type = unique_handle;
+
+        static handle_type create()
+        {
+            auto h = handle_type(::CreateEventW(nullptr, !AutoReset, FALSE, nullptr)); // bManualReset
+            if (!h) throw std::bad_alloc();
+            return h;
+        }
+
+        static bool reset(const handle_type& h) noexcept
+        {
+            return ::ResetEvent(h.get());
+        }
+    };
+}
+
+namespace xtw::threading
+{
+    /// Event with the interface of threading::event, backed by a pooled kernel event.
+    /// Constructing and destroying one does not create or close a kernel object in the steady state.
+    template <bool AutoReset>
+    class pooled_event final
+    {
+        using pool = handle_pool<event_pool_traits<AutoReset>>;
+
+        unique_handle handle_{};
+
+    public:
+        explicit pooled_event(bool initial_state = false)
+            : handle_(pool::acquire())
+        {
+            if (initial_state) ::SetEvent(handle_.get());
+        }
+
+        pooled_event(const pooled_event& other) = delete;
+        pooled_event(pooled_event&& other) noexcept = default;
+        pooled_event& operator=(const pooled_event& other) = delete;
+
+        pooled_event& operator=(pooled_event&& other) noexcept
+        {
+            if (this != &other)
+            {
+                pool::release(std::move(handle_));
+                handle_ = std::move(other.handle_);
+            }
+            return *this;
+        }
+
+        ~pooled_event() { pool::release(std::move(handle_)); }
+
+        [[nodiscard]] HANDLE handle() const noexcept { return handle_.get(); }
+
+        void notify_signal()
+        {
+            ::SetEvent(this->handle());
+        }
+
+        void reset_signal_state()
+        {
+            ::ResetEvent(this->handle());
+        }
+
+        bool wait_signal(DWORD milliseconds = INFINITE)
+        {
+            if (!handle()) throw std::logic_error("invalid call");
+
+            auto result = ::WaitForSingleObject(handle(), milliseconds);
+            if (result == WAIT_OBJECT_0) return true;
+            if (result == WAIT_TIMEOUT) return false;
+            if (result == WAIT_ABANDONED) throw std::runtime_error("handle abandoned");
+            throw std::runtime_error("object corrupted");
+        }
+    };
+
+    using pooled_auto_reset_event = pooled_event<true>;
+    using pooled_manual_reset_event = pooled_event<false>;
+
+    static_assert(std::is_nothrow_move_assignable_v<pooled_manual_reset_event>);
+    static_assert(std::is_nothrow_move_constructible_v<pooled_manual_reset_event>);
+}
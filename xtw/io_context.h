@@ -0,0 +1,376 @@
+/// @file
+/// @brief  xtw::io_context
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "./threading.h"
+#include "./unique_handle.h"
+#include "./win32_exception.h"
+
+namespace xtw
+{
+    /// Fixed-size I/O buffers carved from one page-aligned, locked allocation.
+    /// Buffers are suitable for FILE_FLAG_NO_BUFFERING and stay resident, so requests do not fault pages in.
+    class registered_buffers final
+    {
+        struct region_closer
+        {
+            void operator()(void* p) const noexcept { if (p) ::VirtualFree(p, 0, MEM_RELEASE); }
+        };
+
+        unique_handle_t<void*, region_closer> region_{};
+        size_t buffer_size_{};
+        size_t count_{};
+        std::mutex mutex_{};
+        std::vector<uint32_t> free_{};
+
+    public:
+        registered_buffers(size_t buffer_size, size_t count)
+            : buffer_size_((buffer_size + 4095) & ~size_t{4095})
+            , count_(count)
+        {
+            region_.reset(::VirtualAlloc(nullptr, buffer_size_ * count_, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+            if (!region_) throw std::bad_alloc();
+            (void)::VirtualLock(region_.get(), buffer_size_ * count_); // best effort; limited by the working set quota.
+
+            free_.reserve(count_);
+            for (size_t i = count_; i-- > 0;)
+                free_.push_back(static_cast<uint32_t>(i));
+        }
+
+        registered_buffers(const registered_buffers& other) = delete;
+        registered_buffers(registered_buffers&& other) noexcept = delete;
+        registered_buffers& operator=(const registered_buffers& other) = delete;
+        registered_buffers& operator=(registered_buffers&& other) noexcept = delete;
+        ~registered_buffers() = default;
+
+        [[nodiscard]] size_t buffer_size() const noexcept { return buffer_size_; }
+        [[nodiscard]] size_t count() const noexcept { return count_; }
+        [[nodiscard]] std::byte* buffer(size_t index) const noexcept { return static_cast<std::byte*>(region_.get()) + index * buffer_size_; }
+
+        /// Takes a free buffer index. Returns false when all buffers are in use.
+        bool acquire(size_t& index)
+        {
+            std::lock_guard lock(mutex_);
+            if (free_.empty()) return false;
+            index = free_.back();
+            free_.pop_back();
+            return true;
+        }
+
+        void release(size_t index)
+        {
+            std::lock_guard lock(mutex_);
+            free_.push_back(static_cast<uint32_t>(index));
+        }
+    };
+
+    /// Completion-based asynchronous I/O on an I/O completion port.
+    /// Reads and writes are issued as overlapped requests, and completions are reaped in batches by a small set of worker threads.
+    /// Handles passed to read/write must be opened with FILE_FLAG_OVERLAPPED (or be overlapped sockets) and associated first.
+    /// All outstanding operations must complete before the context is destroyed.
+    /// Completions are reported through callbacks, or through the event of `result`; there are no coroutine awaitables, as xtw targets C++17.
+    /// Off Windows, the portable backend emulates the port: requests complete inside ReadFile/WriteFile and queue their packets,
+    /// so issuing blocks as a cached read does. There is no io_uring or epoll backend.
+    class io_context final
+    {
+    public:
+        using completion_handler = std::function<void(DWORD error, DWORD bytes_transferred)>;
+
+        struct request
+        {
+            HANDLE handle;
+            uint64_t offset; // ignored for sockets and pipes
+            void* buffer;
+            DWORD size;
+            bool write;
+            completion_handler handler;
+        };
+
+        /// Completion reported through an event, for callers that wait instead of continuing in a callback.
+        struct result
+        {
+            DWORD error{};
+            DWORD bytes_transferred{};
+            threading::manual_reset_event done{};
+
+            [[nodiscard]] completion_handler handler()
+            {
+                done.reset_signal_state();
+                return [this](DWORD e, DWORD b)
+                {
+                    error = e;
+                    bytes_transferred = b;
+                    done.notify_signal();
+                };
+            }
+        };
+
+    private:
+        struct operation : OVERLAPPED
+        {
+            HANDLE handle{};
+            completion_handler handler{};
+            operation* next_free{};
+        };
+
+        static inline constexpr ULONG_PTR stop_key = ~ULONG_PTR{};
+        static inline constexpr ULONG_PTR post_key = ~ULONG_PTR{} - 1;
+
+        unique_handle port_{};
+
+        // operations live in one contiguous array, so that it can be registered with SetFileIoOverlappedRange.
+        std::unique_ptr<operation[]> operations_{};
+        size_t operation_capacity_{};
+        std::mutex free_mutex_{};
+        operation* free_list_{};
+        std::atomic<size_t> outstanding_{};
+
+        std::vector<threading::thread> workers_{};
+
+    public:
+        explicit io_context(size_t worker_count = 2, size_t max_outstanding = 1024, const wchar_t* thread_name = L"xtw::io_context")
+            : operations_(std::make_unique<operation[]>(max_outstanding))
+            , operation_capacity_(max_outstanding)
+        {
+            port_.reset(::CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, static_cast<DWORD>(worker_count)));
+            if (!port_) throw win32_exception(HRESULT_FROM_WIN32(::GetLastError()));
+
+            for (size_t i = max_outstanding; i-- > 0;)
+            {
+                operations_[i].next_free = free_list_;
+                free_list_ = &operations_[i];
+            }
+
+            try
+            {
+                workers_.reserve(worker_count);
+                for (size_t i = 0; i < worker_count; i++)
+                    workers_.emplace_back([this] { this->worker_main(); }, threading::thread::join_on_destructor, 65536, THREAD_PRIORITY_NORMAL, thread_name);
+            }
+            catch (...)
+            {
+                stop_workers(); // the started workers would otherwise be joined while waiting for completions.
+                throw;
+            }
+        }
+
+        io_context(const io_context& other) = delete;
+        io_context(io_context&& other) noexcept = delete;
+        io_context& operator=(const io_context& other) = delete;
+        io_context& operator=(io_context&& other) noexcept = delete;
+
+        ~io_context() { stop_workers(); }
+
+        [[nodiscard]] HANDLE port() const noexcept { return port_.get(); }
+        /// Number of operations issued or posted whose handlers have not returned yet.
+        [[nodiscard]] size_t outstanding() const noexcept { return outstanding_.load(std::memory_order_relaxed); }
+
+        /// Associates a file or socket handle with this context.
+        /// With lock_operations, the operation array is registered with SetFileIoOverlappedRange,
+        /// so the kernel does not probe and lock each OVERLAPPED per request (requires SeLockMemoryPrivilege; ignored when not held).
+        void associate(HANDLE handle, bool lock_operations = false)
+        {
+            if (::CreateIoCompletionPort(handle, port_.get(), 0, 0) != port_.get())
+                throw win32_exception(HRESULT_FROM_WIN32(::GetLastError()));
+
+            if (lock_operations)
+            {
+                using SetFileIoOverlappedRangeFn = BOOL(WINAPI*)(HANDLE, PUCHAR, ULONG);
+                static const auto pfnSetFileIoOverlappedRange = reinterpret_cast<SetFileIoOverlappedRangeFn>(reinterpret_cast<void (*)()>(::GetProcAddress(::GetModuleHandleW(L"kernel32.dll"), "SetFileIoOverlappedRange")));
+                if (pfnSetFileIoOverlappedRange)
+                    (void)pfnSetFileIoOverlappedRange(handle, reinterpret_cast<PUCHAR>(operations_.get()), static_cast<ULONG>(sizeof(operation) * operation_capacity_));
+            }
+        }
+
+        /// Issues a read. Returns ERROR_SUCCESS if the handler will be called on a worker thread; otherwise the error, and the handler is not called.
+        DWORD read(HANDLE handle, uint64_t offset, void* buffer, DWORD size, completion_handler handler)
+        {
+            return issue(request{handle, offset, buffer, size, false, std::move(handler)});
+        }
+
+        /// Issues a write. Same completion rules as read().
+        DWORD write(HANDLE handle, uint64_t offset, const void* buffer, DWORD size, completion_handler handler)
+        {
+            return issue(request{handle, offset, const_cast<void*>(buffer), size, true, std::move(handler)});
+        }
+
+        using buffer_handler = std::function<void(DWORD error, DWORD bytes_transferred, std::byte* data)>;
+
+        /// Issues a read into a free buffer of `buffers`, chosen at issue time (as with io_uring's provided buffers),
+        /// so that buffers are held only while reads are in flight. The handler sees the data; the buffer is released when it returns.
+        /// Returns ERROR_NOT_ENOUGH_QUOTA when no buffer is free, and ERROR_INVALID_PARAMETER when size exceeds buffer_size().
+        DWORD read(HANDLE handle, uint64_t offset, registered_buffers& buffers, DWORD size, buffer_handler handler)
+        {
+            if (size > buffers.buffer_size()) return ERROR_INVALID_PARAMETER;
+            size_t index{};
+            if (!buffers.acquire(index)) return ERROR_NOT_ENOUGH_QUOTA;
+
+            std::byte* data = buffers.buffer(index);
+            DWORD error = issue(request{handle, offset, data, size, false, [&buffers, index, data, h = std::move(handler)](DWORD e, DWORD b)
+            {
+                h(e, b, data);
+                buffers.release(index);
+            }});
+            if (error != ERROR_SUCCESS) buffers.release(index);
+            return error;
+        }
+
+        /// Issues a write of buffer `index` of `buffers`, taken with acquire() and filled by the caller.
+        /// The buffer is released on completion, before the handler is called, or when the request fails to issue.
+        DWORD write(HANDLE handle, uint64_t offset, registered_buffers& buffers, size_t index, DWORD size, completion_handler handler)
+        {
+            if (size > buffers.buffer_size())
+            {
+                buffers.release(index);
+                return ERROR_INVALID_PARAMETER;
+            }
+
+            DWORD error = issue(request{handle, offset, buffers.buffer(index), size, true, [&buffers, index, h = std::move(handler)](DWORD e, DWORD b)
+            {
+                buffers.release(index);
+                if (h) h(e, b);
+            }});
+            if (error != ERROR_SUCCESS) buffers.release(index);
+            return error;
+        }
+
+        /// Issues requests back to back. Returns the number of requests issued; it stops at the first request that fails to issue.
+        size_t submit(std::vector<request>& batch)
+        {
+            size_t issued = 0;
+            for (auto& r : batch)
+            {
+                if (issue(std::move(r)) != ERROR_SUCCESS) break;
+                issued++;
+            }
+            return issued;
+        }
+
+        /// Runs a function on a worker thread.
+        bool post(std::function<void()> function)
+        {
+            operation* op = acquire();
+            if (!op) return false;
+
+            op->handle = nullptr;
+            op->handler = [f = std::move(function)](DWORD, DWORD) { f(); };
+            if (!::PostQueuedCompletionStatus(port_.get(), 0, post_key, op))
+            {
+                release(op);
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        operation* acquire() noexcept
+        {
+            std::lock_guard lock(free_mutex_);
+            operation* op = free_list_;
+            if (op)
+            {
+                free_list_ = op->next_free;
+                outstanding_.fetch_add(1, std::memory_order_relaxed);
+            }
+            return op;
+        }
+
+        void release(operation* op) noexcept
+        {
+            op->handler = nullptr;
+            std::lock_guard lock(free_mutex_);
+            op->next_free = free_list_;
+            free_list_ = op;
+            outstanding_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        DWORD issue(request r)
+        {
+            operation* op = acquire();
+            if (!op) return ERROR_NOT_ENOUGH_QUOTA;
+
+            static_cast<OVERLAPPED&>(*op) = OVERLAPPED{};
+            op->Offset = static_cast<DWORD>(r.offset);
+            op->OffsetHigh = static_cast<DWORD>(r.offset >> 32);
+            op->handle = r.handle;
+            op->handler = std::move(r.handler);
+
+            // the completion packet is queued even when the request completes synchronously.
+            BOOL ok = r.write
+                          ? ::WriteFile(r.handle, r.buffer, r.size, nullptr, op)
+                          : ::ReadFile(r.handle, r.buffer, r.size, nullptr, op);
+
+            if (!ok)
+            {
+                DWORD error = ::GetLastError();
+                if (error != ERROR_IO_PENDING)
+                {
+                    release(op);
+                    return error;
+                }
+            }
+            return ERROR_SUCCESS;
+        }
+
+        void stop_workers() noexcept
+        {
+            for (size_t i = 0; i < workers_.size(); i++)
+                ::PostQueuedCompletionStatus(port_.get(), 0, stop_key, nullptr);
+            workers_.clear(); // joins
+        }
+
+        void worker_main()
+        {
+            OVERLAPPED_ENTRY entries[64]{};
+            while (true)
+            {
+                ULONG count = 0;
+                if (!::GetQueuedCompletionStatusEx(port_.get(), entries, static_cast<ULONG>(std::size(entries)), &count, INFINITE, FALSE))
+                    continue;
+
+                size_t stops = 0;
+                for (ULONG i = 0; i < count; i++)
+                {
+                    if (entries[i].lpCompletionKey == stop_key)
+                    {
+                        stops++;
+                        continue;
+                    }
+
+                    auto op = static_cast<operation*>(entries[i].lpOverlapped);
+                    DWORD bytes = entries[i].dwNumberOfBytesTransferred;
+                    DWORD error = ERROR_SUCCESS;
+                    if (op->handle && !::GetOverlappedResult(op->handle, op, &bytes, FALSE))
+                        error = ::GetLastError();
+
+                    // the operation is released after its handler, so that outstanding() counts running handlers.
+                    if (op->handler) op->handler(error, bytes);
+                    release(op);
+                }
+
+                if (stops)
+                {
+                    // one stop packet per worker: pass on the ones taken from the others in the same batch.
+                    for (size_t i = 1; i < stops; i++) ::PostQueuedCompletionStatus(port_.get(), 0, stop_key, nullptr);
+                    return;
+                }
+            }
+        }
+    };
+}
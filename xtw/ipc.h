@@ -0,0 +1,484 @@
+/// @file
+/// @brief  xtw::ipc
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "./mapped_file.h"
+#include "./unique_handle.h"
+#include "./win32_exception.h"
+
+namespace xtw::ipc
+{
+    namespace shm_ring_detail
+    {
+        static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free, "atomics in shared memory must be lock-free.");
+
+        static inline constexpr uint32_t magic = 0x474E5258; // 'XRNG'
+        static inline constexpr uint32_t max_producers = 16;
+
+        // record header: length in the low 32 bits, flags above, and the producer slot (1-based; 0 for none) in bits 40-47.
+        static inline constexpr uint64_t committed = uint64_t{1} << 32;
+        static inline constexpr uint64_t padding = uint64_t{1} << 33;
+        static inline constexpr uint64_t claimed = uint64_t{1} << 34; // reserved and being written
+        static inline constexpr int slot_shift = 40;
+
+        static inline constexpr uint64_t align8(uint64_t x) noexcept { return (x + 7) & ~uint64_t{7}; }
+
+        struct header
+        {
+            std::atomic<uint32_t> magic; // written last by the creator
+            uint32_t header_size;
+            uint64_t capacity; // power of two
+            uint32_t single_producer;
+
+            alignas(64) std::atomic<uint64_t> reserve; // producers: end of reserved space
+            alignas(64) std::atomic<uint64_t> head;    // consumer: start of unread records
+            alignas(64) std::atomic<uint32_t> consumer_waiting; // also the futex word off Windows
+            std::atomic<uint32_t> consumer_pid;
+            std::atomic<uint32_t> producer_pids[max_producers];
+        };
+
+        static inline bool is_process_alive(DWORD pid) noexcept
+        {
+            if (pid == 0) return false;
+#if defined(_WIN32)
+            auto process = unique_handle(::OpenProcess(SYNCHRONIZE, FALSE, pid));
+            if (!process) return ::GetLastError() == ERROR_ACCESS_DENIED; // exists but is not accessible.
+            return ::WaitForSingleObject(process.get(), 0) == WAIT_TIMEOUT;
+#else
+            if (::kill(static_cast<pid_t>(pid), 0) != 0 && errno != EPERM) return false;
+
+            // an exited child that has not been waited for is a zombie, which kill() still finds.
+            char path[32]{};
+            std::snprintf(path, sizeof(path), "/proc/%u/stat", static_cast<unsigned>(pid));
+            FILE* f = std::fopen(path, "r");
+            if (!f) return true;
+            char line[512]{};
+            const bool read = std::fgets(line, sizeof(line), f) != nullptr;
+            std::fclose(f);
+            const char* state = read ? std::strrchr(line, ')') : nullptr; // "pid (comm) S ...", where comm may contain ')'
+            return !(state && state[1] == ' ' && (state[2] == 'Z' || state[2] == 'X'));
+#endif
+        }
+
+#if !defined(_WIN32)
+        // process-shared futex on a word in the section.
+        static inline void futex_wait(std::atomic<uint32_t>& word, uint32_t expected, DWORD milliseconds) noexcept
+        {
+            timespec timeout{static_cast<time_t>(milliseconds / 1000), static_cast<long>(milliseconds % 1000) * 1000000};
+            (void)::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, milliseconds == INFINITE ? nullptr : &timeout, nullptr, 0);
+        }
+
+        static inline void futex_wake(std::atomic<uint32_t>& word) noexcept
+        {
+            (void)::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+        }
+#endif
+    }
+
+    /// Variable-length record ring in a named shared memory section.
+    /// One consumer process creates the ring; producer processes open it and write concurrently (MPSC), or one producer does (SPSC),
+    /// which then reserves space without compare-and-swap. Records are read in place, and the consumer is woken only while it is idle:
+    /// through a named event on Windows, and through a futex on a word of the section elsewhere.
+    /// Each side records its process id, so a dead peer is detected while waiting.
+    ///
+    /// A producer that dies between reserving space and committing its record leaves the record unfinished, and the consumer stops at it.
+    /// read() then reports status::peer_lost, and reclaim_lost_producers() skips the records of the dead producers.
+    /// Records of producers that died within the few instructions between reserving and marking their record, or that got no slot
+    /// (beyond max_producers), cannot be told apart from ones still being written; such a ring must be created again.
+    class shm_ring final
+    {
+    public:
+        enum struct status
+        {
+            ok,
+            timeout,
+            peer_lost,
+        };
+
+        enum struct mode
+        {
+            mpsc, // any number of producers
+            spsc, // one producer at a time
+        };
+
+    private:
+        unique_handle section_{};
+        mapped_view_unique_handle view_{};
+#if defined(_WIN32)
+        unique_handle event_{};
+#endif
+        shm_ring_detail::header* header_{};
+        std::byte* data_{};
+        bool consumer_{};
+        uint32_t producer_slot_{};
+        uint64_t cached_head_{}; // producer: a head seen earlier; the head only moves forward, so it can only underestimate free space.
+
+        [[noreturn]] static void throw_last_error()
+        {
+            throw win32_exception(HRESULT_FROM_WIN32(::GetLastError()));
+        }
+
+        [[noreturn]] static void throw_invalid_data()
+        {
+            throw win32_exception(HRESULT_FROM_WIN32(ERROR_INVALID_DATA));
+        }
+
+        std::atomic<uint64_t>& record_header_at(uint64_t position) const noexcept
+        {
+            return *reinterpret_cast<std::atomic<uint64_t>*>(data_ + (position & (header_->capacity - 1)));
+        }
+
+        // maps the section; returns the mapped size.
+        size_t map([[maybe_unused]] const wchar_t* name, size_t section_size)
+        {
+            view_.reset(::MapViewOfFile(section_.get(), FILE_MAP_ALL_ACCESS, 0, 0, section_size));
+            if (!view_) throw_last_error();
+
+            MEMORY_BASIC_INFORMATION region{};
+            if (!::VirtualQuery(view_.get(), &region, sizeof(region))) throw_last_error();
+
+#if defined(_WIN32)
+            event_.reset(::CreateEventW(nullptr, FALSE, FALSE, (std::wstring(name) + L".wake").c_str()));
+            if (!event_) throw_last_error();
+#endif
+
+            header_ = static_cast<shm_ring_detail::header*>(view_.get());
+            return region.RegionSize;
+        }
+
+        void wake_consumer() noexcept
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the fence in read
+            if (header_->consumer_waiting.load(std::memory_order_relaxed) && header_->consumer_waiting.exchange(0))
+            {
+#if defined(_WIN32)
+                ::SetEvent(event_.get());
+#else
+                shm_ring_detail::futex_wake(header_->consumer_waiting);
+#endif
+            }
+        }
+
+        // waits while consumer_waiting is 1, or until woken.
+        void wait_for_producers(DWORD milliseconds) noexcept
+        {
+#if defined(_WIN32)
+            (void)::WaitForSingleObject(event_.get(), milliseconds);
+#else
+            shm_ring_detail::futex_wait(header_->consumer_waiting, 1, milliseconds);
+#endif
+        }
+
+        // a clean close is not a crash; clears this process from the peer table.
+        void unregister() noexcept
+        {
+            if (!header_) return;
+            if (consumer_) header_->consumer_pid.store(0);
+            else if (producer_slot_) header_->producer_pids[producer_slot_ - 1].store(0);
+            header_ = nullptr;
+            producer_slot_ = 0;
+        }
+
+    public:
+        shm_ring() = default;
+        shm_ring(const shm_ring& other) = delete;
+        shm_ring& operator=(const shm_ring& other) = delete;
+
+        shm_ring(shm_ring&& other) noexcept { *this = std::move(other); }
+
+        shm_ring& operator=(shm_ring&& other) noexcept
+        {
+            if (this == &other) return *this;
+            unregister();
+            section_ = std::move(other.section_);
+            view_ = std::move(other.view_);
+#if defined(_WIN32)
+            event_ = std::move(other.event_);
+#endif
+            header_ = std::exchange(other.header_, nullptr);
+            data_ = std::exchange(other.data_, nullptr);
+            consumer_ = other.consumer_;
+            producer_slot_ = std::exchange(other.producer_slot_, 0);
+            cached_head_ = other.cached_head_;
+            return *this;
+        }
+
+        ~shm_ring() { unregister(); }
+
+        /// Creates the ring as its consumer. capacity is rounded up to a power of two; records up to capacity / 2 bytes fit.
+        [[nodiscard]] static shm_ring create(const wchar_t* name, size_t capacity, mode m = mode::mpsc)
+        {
+            size_t cap = 4096;
+            while (cap < capacity) cap <<= 1;
+
+            const size_t header_size = (sizeof(shm_ring_detail::header) + 63) & ~size_t{63};
+            const uint64_t section_size = header_size + cap;
+
+            shm_ring r{};
+            r.consumer_ = true;
+            r.section_.reset(::CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(section_size >> 32), static_cast<DWORD>(section_size), name));
+            if (!r.section_) throw_last_error();
+            if (::GetLastError() == ERROR_ALREADY_EXISTS) throw win32_exception(HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS));
+            r.map(name, static_cast<size_t>(section_size));
+
+            // fresh sections are zero-filled.
+            auto h = new(r.header_) shm_ring_detail::header{};
+            h->header_size = static_cast<uint32_t>(header_size);
+            h->capacity = cap;
+            h->single_producer = m == mode::spsc;
+            h->consumer_pid.store(::GetCurrentProcessId());
+            r.data_ = reinterpret_cast<std::byte*>(r.header_) + header_size;
+
+            h->magic.store(shm_ring_detail::magic, std::memory_order_release);
+            return r;
+        }
+
+        /// Opens an existing ring as a producer.
+        /// Throws ERROR_INVALID_DATA for a section that does not hold a ring, and ERROR_BUSY for an SPSC ring that already has a producer
+        /// (or had one that died, until the consumer reclaims it).
+        [[nodiscard]] static shm_ring open(const wchar_t* name)
+        {
+            using namespace shm_ring_detail;
+
+            shm_ring r{};
+            r.section_.reset(::OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, name));
+            if (!r.section_) throw_last_error();
+            const size_t mapped = r.map(name, 0);
+
+            // the section comes from another process: check the layout before trusting it.
+            if (mapped < sizeof(header) || r.header_->magic.load(std::memory_order_acquire) != magic) throw_invalid_data();
+            const uint64_t capacity = r.header_->capacity;
+            const uint64_t header_size = r.header_->header_size;
+            if (header_size < sizeof(header) || header_size % 64 != 0 || header_size > mapped) throw_invalid_data();
+            if (capacity < 4096 || (capacity & (capacity - 1)) != 0 || capacity > mapped - header_size) throw_invalid_data();
+
+            r.data_ = reinterpret_cast<std::byte*>(r.header_) + header_size;
+
+            const bool single = r.header_->single_producer != 0;
+            for (uint32_t i = 0; i < (single ? 1 : max_producers); i++)
+            {
+                uint32_t expected = 0;
+                if (r.header_->producer_pids[i].compare_exchange_strong(expected, ::GetCurrentProcessId()))
+                {
+                    r.producer_slot_ = i + 1;
+                    break;
+                }
+            }
+
+            if (single && !r.producer_slot_)
+            {
+                r.header_ = nullptr;
+                throw win32_exception(HRESULT_FROM_WIN32(ERROR_BUSY));
+            }
+            // without a slot an MPSC producer still works, but the consumer cannot watch it.
+            return r;
+        }
+
+        explicit operator bool() const noexcept { return header_ != nullptr; }
+        [[nodiscard]] size_t capacity() const noexcept { return static_cast<size_t>(header_->capacity); }
+        [[nodiscard]] size_t max_record_size() const noexcept { return static_cast<size_t>(header_->capacity / 2 - 8); }
+        [[nodiscard]] mode ring_mode() const noexcept { return header_->single_producer ? mode::spsc : mode::mpsc; }
+
+        /// Producer: appends a record. Returns false if the ring is full or the record is too large.
+        bool try_write(const void* data, size_t length) noexcept
+        {
+            using namespace shm_ring_detail;
+            if (length > max_record_size()) return false;
+
+            const uint64_t capacity = header_->capacity;
+            const uint64_t need = align8(8 + length);
+            const bool single = header_->single_producer != 0;
+
+            uint64_t position = header_->reserve.load(std::memory_order_relaxed);
+            uint64_t pad{}, total{};
+            while (true)
+            {
+                const uint64_t contiguous = capacity - (position & (capacity - 1));
+                pad = need <= contiguous ? 0 : contiguous; // records never wrap; skip to the beginning instead.
+                total = pad + need;
+                if (position + total - cached_head_ > capacity)
+                {
+                    cached_head_ = header_->head.load(std::memory_order_acquire);
+                    if (position + total - cached_head_ > capacity) return false;
+                }
+
+                if (single)
+                {
+                    header_->reserve.store(position + total, std::memory_order_relaxed); // no other producer to race with.
+                    break;
+                }
+                if (header_->reserve.compare_exchange_weak(position, position + total, std::memory_order_relaxed)) break;
+            }
+
+            // mark the reservation first, so that the consumer can skip it if this process dies before committing.
+            const uint64_t slot = uint64_t{producer_slot_} << slot_shift;
+            if (pad) record_header_at(position).store((pad - 8) | padding | committed, std::memory_order_release);
+            const uint64_t record = position + pad;
+            record_header_at(record).store(length | claimed | slot, std::memory_order_relaxed);
+
+            std::memcpy(data_ + ((record + 8) & (capacity - 1)), data, length);
+            record_header_at(record).store(length | committed, std::memory_order_release);
+
+            wake_consumer();
+            return true;
+        }
+
+        /// Producer: appends a record, yielding while the ring is full.
+        status write(const void* data, size_t length, DWORD timeout_milliseconds = INFINITE)
+        {
+            if (length > max_record_size()) throw std::length_error("record is too large");
+
+            const ULONGLONG start = ::GetTickCount64();
+            for (unsigned spin = 0; !try_write(data, length); spin++)
+            {
+                if (spin % 1024 == 1023)
+                {
+                    if (!shm_ring_detail::is_process_alive(header_->consumer_pid.load())) return status::peer_lost;
+                    if (timeout_milliseconds != INFINITE && ::GetTickCount64() - start >= timeout_milliseconds) return status::timeout;
+                }
+                if (spin < 64) ::YieldProcessor();
+                else ::Sleep(spin < 1024 ? 0 : 1);
+            }
+            return status::ok;
+        }
+
+        /// Consumer: passes the oldest record to f(const std::byte* data, size_t length) in place, then releases it.
+        template <class F, std::enable_if_t<std::is_invocable_v<F&, const std::byte*, size_t>>* = nullptr>
+        bool try_read(F&& f)
+        {
+            using namespace shm_ring_detail;
+            const uint64_t capacity = header_->capacity;
+
+            while (true)
+            {
+                const uint64_t position = header_->head.load(std::memory_order_relaxed);
+                std::atomic<uint64_t>& h = record_header_at(position);
+                const uint64_t value = h.load(std::memory_order_acquire);
+                if (!(value & committed)) return false;
+
+                const size_t length = static_cast<size_t>(value & 0xFFFFFFFF);
+                const uint64_t size = align8(8 + length);
+                if (!(value & padding)) f(static_cast<const std::byte*>(data_ + ((position + 8) & (capacity - 1))), length);
+
+                // clear the whole record, so that stale bytes never look like a committed header on the next lap.
+                std::memset(data_ + (position & (capacity - 1)), 0, static_cast<size_t>(size));
+                header_->head.store(position + size, std::memory_order_release);
+                if (!(value & padding)) return true;
+            }
+        }
+
+        /// Consumer: waits for a record. Returns status::peer_lost if a registered producer process has exited,
+        /// until reclaim_lost_producers() forgets it.
+        template <class F, std::enable_if_t<std::is_invocable_v<F&, const std::byte*, size_t>>* = nullptr>
+        status read(F&& f, DWORD timeout_milliseconds = INFINITE)
+        {
+            const ULONGLONG start = ::GetTickCount64();
+            while (true)
+            {
+                if (try_read(f)) return status::ok;
+
+                header_->consumer_waiting.store(1);
+                std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the fence in try_write
+                if (try_read(f))
+                {
+                    header_->consumer_waiting.store(0);
+                    return status::ok;
+                }
+
+                const ULONGLONG elapsed = ::GetTickCount64() - start;
+                if (timeout_milliseconds != INFINITE && elapsed >= timeout_milliseconds)
+                {
+                    header_->consumer_waiting.store(0);
+                    return status::timeout;
+                }
+
+                DWORD wait = 100; // wakes periodically to watch producers.
+                if (timeout_milliseconds != INFINITE) wait = std::min<DWORD>(wait, static_cast<DWORD>(timeout_milliseconds - elapsed));
+                wait_for_producers(wait);
+                if (header_->consumer_waiting.exchange(0) && !producers_alive()) // still set: not woken by a producer
+                {
+                    if (try_read(f)) return status::ok;
+                    return status::peer_lost;
+                }
+            }
+        }
+
+        /// Consumer: false if a registered producer process exited without closing the ring.
+        [[nodiscard]] bool producers_alive() const noexcept
+        {
+            for (auto& pid : header_->producer_pids)
+            {
+                DWORD p = pid.load();
+                if (p && !shm_ring_detail::is_process_alive(p)) return false;
+            }
+            return true;
+        }
+
+        /// Consumer: forgets producers that exited without closing the ring, and turns the records they reserved
+        /// but never committed into padding, so that reading goes on past them. Their slots become free for new producers.
+        /// Returns false, forgetting nobody, if an unmarked reservation stops the walk; it may be a live producer's, so call again later.
+        bool reclaim_lost_producers() noexcept
+        {
+            using namespace shm_ring_detail;
+
+            uint32_t lost = 0; // bit i: slot i + 1
+            DWORD pids[max_producers]{};
+            for (uint32_t i = 0; i < max_producers; i++)
+            {
+                pids[i] = header_->producer_pids[i].load();
+                if (pids[i] && !is_process_alive(pids[i])) lost |= 1u << i;
+            }
+            if (!lost) return true;
+
+            // the lost producers reserve nothing more, so all their records lie between head and reserve.
+            const uint64_t end = header_->reserve.load(std::memory_order_acquire);
+            for (uint64_t position = header_->head.load(std::memory_order_relaxed); position < end;)
+            {
+                std::atomic<uint64_t>& h = record_header_at(position);
+                const uint64_t value = h.load(std::memory_order_acquire);
+                if (!(value & (committed | claimed))) return false;
+
+                const uint64_t slot = value >> slot_shift & 0xFF;
+                if (!(value & committed) && slot && (lost >> (slot - 1) & 1))
+                    h.store((value & 0xFFFFFFFF) | padding | committed, std::memory_order_release);
+                position += align8(8 + (value & 0xFFFFFFFF));
+            }
+
+            for (uint32_t i = 0; i < max_producers; i++)
+                if (lost >> i & 1) header_->producer_pids[i].compare_exchange_strong(pids[i], 0);
+            return true;
+        }
+
+        /// Producer: false if the consumer process has exited.
+        [[nodiscard]] bool consumer_alive() const noexcept
+        {
+            return shm_ring_detail::is_process_alive(header_->consumer_pid.load());
+        }
+    };
+}
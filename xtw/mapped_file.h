@@ -0,0 +1,321 @@
+/// @file
+/// @brief  xtw::mapped_file
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L) || __cplusplus >= 202002L
+#include <span>
+#endif
+
+#include "./unique_handle.h"
+#include "./win32_exception.h"
+
+namespace xtw
+{
+    struct mapped_view_closer
+    {
+        void operator()(void* p) const noexcept { if (p) ::UnmapViewOfFile(p); }
+    };
+
+    using mapped_view_unique_handle = unique_handle_t<void*, mapped_view_closer>;
+
+    /// A mapped range of a file. Owns the view; the data is accessed in place without copies.
+    class mapped_view final
+    {
+        mapped_view_unique_handle base_{}; // aligned to allocation granularity
+        std::byte* data_{};
+        size_t size_{};
+        uint64_t offset_{};
+
+    public:
+        mapped_view() = default;
+        mapped_view(mapped_view_unique_handle base, std::byte* data, size_t size, uint64_t offset) noexcept
+            : base_(std::move(base)), data_(data), size_(size), offset_(offset) {}
+
+        mapped_view(const mapped_view& other) = delete;
+        mapped_view& operator=(const mapped_view& other) = delete;
+        ~mapped_view() = default;
+
+        mapped_view(mapped_view&& other) noexcept
+            : base_(std::move(other.base_))
+            , data_(std::exchange(other.data_, nullptr))
+            , size_(std::exchange(other.size_, 0))
+            , offset_(std::exchange(other.offset_, 0)) {}
+
+        mapped_view& operator=(mapped_view&& other) noexcept
+        {
+            base_ = std::move(other.base_);
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            offset_ = std::exchange(other.offset_, 0);
+            return *this;
+        }
+
+        [[nodiscard]] std::byte* data() const noexcept { return data_; }
+        [[nodiscard]] size_t size() const noexcept { return size_; }
+        [[nodiscard]] bool empty() const noexcept { return size_ == 0; }
+        [[nodiscard]] uint64_t offset() const noexcept { return offset_; } // in file
+        [[nodiscard]] std::byte* begin() const noexcept { return data_; }
+        [[nodiscard]] std::byte* end() const noexcept { return data_ + size_; }
+        explicit operator bool() const noexcept { return static_cast<bool>(base_); }
+
+#if defined(__cpp_lib_span)
+        [[nodiscard]] std::span<std::byte> span() const noexcept { return {data_, size_}; }
+        operator std::span<std::byte>() const noexcept { return span(); }
+        operator std::span<const std::byte>() const noexcept { return span(); }
+#endif
+
+        /// Asks the system to read the range in ahead of access (PrefetchVirtualMemory, Windows 8 or later; madvise(MADV_WILLNEED) elsewhere).
+        bool prefetch(size_t offset = 0, size_t length = std::numeric_limits<size_t>::max()) const noexcept
+        {
+            if (offset >= size_) return false;
+#if defined(_WIN32)
+            // WIN32_MEMORY_RANGE_ENTRY, which the SDK declares only for _WIN32_WINNT >= 0x0602.
+            struct memory_range_entry
+            {
+                PVOID VirtualAddress;
+                SIZE_T NumberOfBytes;
+            };
+
+            using PrefetchVirtualMemoryFn = BOOL(WINAPI*)(HANDLE, ULONG_PTR, memory_range_entry*, ULONG);
+            static const auto pfnPrefetchVirtualMemory = reinterpret_cast<PrefetchVirtualMemoryFn>(reinterpret_cast<void (*)()>(::GetProcAddress(::GetModuleHandleW(L"kernel32.dll"), "PrefetchVirtualMemory")));
+            if (!pfnPrefetchVirtualMemory) return false;
+
+            memory_range_entry range{data_ + offset, std::min(length, size_ - offset)};
+            return pfnPrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0);
+#else
+            return advise(offset, length, MADV_WILLNEED);
+#endif
+        }
+
+        /// Removes the range from the working set. Pages stay mapped and are read in again on access.
+        bool evict(size_t offset = 0, size_t length = std::numeric_limits<size_t>::max()) const noexcept
+        {
+            if (offset >= size_) return false;
+#if defined(_WIN32)
+            // VirtualUnlock on unlocked pages removes them from the working set; it reports ERROR_NOT_LOCKED on success.
+            (void)::VirtualUnlock(data_ + offset, std::min(length, size_ - offset));
+            return true;
+#else
+            // views are shared mappings, so dropped pages, dirty or not, stay in the page cache (or the memfd) and nothing is lost.
+            return advise(offset, length, MADV_DONTNEED);
+#endif
+        }
+
+        /// Writes dirty pages of the range back to the file.
+        bool flush(size_t offset = 0, size_t length = std::numeric_limits<size_t>::max()) const noexcept
+        {
+            if (offset >= size_) return false;
+            return ::FlushViewOfFile(data_ + offset, std::min(length, size_ - offset));
+        }
+
+#if !defined(_WIN32)
+    private:
+        // madvise on the pages covering the range; the view base is page-aligned, so they all belong to the view.
+        bool advise(size_t offset, size_t length, int advice) const noexcept
+        {
+            static const auto page = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+            const auto first = reinterpret_cast<uintptr_t>(data_ + offset) / page * page;
+            const auto last = reinterpret_cast<uintptr_t>(data_ + offset + std::min(length, size_ - offset));
+            return ::madvise(reinterpret_cast<void*>(first), last - first, advice) == 0;
+        }
+#endif
+    };
+
+    /// File mapping on unique_handle. Views are mapped on demand, so files larger than the address space can be accessed in windows.
+    class mapped_file final
+    {
+    public:
+        enum struct access
+        {
+            read_only,
+            read_write,
+        };
+
+    private:
+        unique_handle file_{};
+        unique_handle mapping_{};
+        uint64_t size_{};
+        access access_{};
+        bool large_pages_{};
+
+        [[noreturn]] static void throw_last_error()
+        {
+            throw win32_exception(HRESULT_FROM_WIN32(::GetLastError()));
+        }
+
+    public:
+        mapped_file() = default;
+        mapped_file(const mapped_file& other) = delete;
+        mapped_file(mapped_file&& other) noexcept = default;
+        mapped_file& operator=(const mapped_file& other) = delete;
+        mapped_file& operator=(mapped_file&& other) noexcept = default;
+        ~mapped_file() = default;
+
+        /// Opens a file. With access::read_write, the file is created if missing and extended to minimum_size.
+        [[nodiscard]] static mapped_file open(const wchar_t* path, access mode = access::read_only, uint64_t minimum_size = 0)
+        {
+            mapped_file f{};
+            f.access_ = mode;
+
+            const bool writable = mode == access::read_write;
+            f.file_.reset(::CreateFileW(
+                path,
+                writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                writable ? FILE_SHARE_READ : FILE_SHARE_READ | FILE_SHARE_DELETE,
+                nullptr,
+                writable ? OPEN_ALWAYS : OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL,
+                nullptr));
+
+            if (f.file_.get() == INVALID_HANDLE_VALUE)
+            {
+                (void)f.file_.release();
+                throw_last_error();
+            }
+
+            LARGE_INTEGER size{};
+            if (!::GetFileSizeEx(f.file_.get(), &size)) throw_last_error();
+            f.size_ = std::max<uint64_t>(static_cast<uint64_t>(size.QuadPart), writable ? minimum_size : 0);
+
+            if (f.size_ == 0) return f; // empty files cannot be mapped.
+
+            // a writable mapping larger than the file extends the file.
+            f.mapping_.reset(::CreateFileMappingW(
+                f.file_.get(), nullptr,
+                writable ? PAGE_READWRITE : PAGE_READONLY,
+                static_cast<DWORD>(f.size_ >> 32), static_cast<DWORD>(f.size_),
+                nullptr));
+
+            if (!f.mapping_) throw_last_error();
+            return f;
+        }
+
+        /// Creates a pagefile-backed mapping. Large pages require SeLockMemoryPrivilege; falls back to normal pages when unavailable.
+        [[nodiscard]] static mapped_file create_anonymous(uint64_t size, bool large_pages = false)
+        {
+            mapped_file f{};
+            f.access_ = access::read_write;
+            f.size_ = size;
+
+            if (large_pages)
+            {
+                if (const SIZE_T page = ::GetLargePageMinimum())
+                {
+                    const uint64_t rounded = (size + page - 1) / page * page;
+                    f.mapping_.reset(::CreateFileMappingW(
+                        INVALID_HANDLE_VALUE, nullptr,
+                        PAGE_READWRITE | SEC_COMMIT | SEC_LARGE_PAGES,
+                        static_cast<DWORD>(rounded >> 32), static_cast<DWORD>(rounded),
+                        nullptr));
+
+                    if (f.mapping_)
+                    {
+                        f.large_pages_ = true;
+                        return f;
+                    }
+                }
+            }
+
+            f.mapping_.reset(::CreateFileMappingW(
+                INVALID_HANDLE_VALUE, nullptr,
+                PAGE_READWRITE,
+                static_cast<DWORD>(size >> 32), static_cast<DWORD>(size),
+                nullptr));
+
+            if (!f.mapping_) throw_last_error();
+            return f;
+        }
+
+        [[nodiscard]] uint64_t size() const noexcept { return size_; }
+        [[nodiscard]] bool writable() const noexcept { return access_ == access::read_write; }
+        [[nodiscard]] bool large_pages() const noexcept { return large_pages_; }
+        [[nodiscard]] HANDLE file_handle() const noexcept { return file_.get(); }
+        [[nodiscard]] HANDLE mapping_handle() const noexcept { return mapping_.get(); }
+
+        /// Alignment required for view offsets. Any offset can be passed to map(); it is aligned down internally.
+        [[nodiscard]] size_t view_alignment() const noexcept
+        {
+            if (large_pages_) return ::GetLargePageMinimum();
+
+            static const DWORD granularity = []
+            {
+                SYSTEM_INFO si{};
+                ::GetSystemInfo(&si);
+                return si.dwAllocationGranularity;
+            }();
+            return granularity;
+        }
+
+        /// Maps [offset, offset + length) of the file. length is clipped to the end of the file.
+        [[nodiscard]] mapped_view map(uint64_t offset = 0, uint64_t length = std::numeric_limits<uint64_t>::max()) const
+        {
+            if (offset > size_) throw std::out_of_range("offset is out of the file");
+            length = std::min(length, size_ - offset);
+            if (length == 0) return mapped_view(mapped_view_unique_handle{}, nullptr, 0, offset);
+
+            const uint64_t alignment = view_alignment();
+            const uint64_t aligned = offset / alignment * alignment;
+            uint64_t mapped_length = offset - aligned + length;
+            if (large_pages_) mapped_length = (mapped_length + alignment - 1) / alignment * alignment; // within the section, which is rounded up to large pages.
+            if (mapped_length > std::numeric_limits<size_t>::max()) throw std::length_error("view is larger than the address space");
+
+            DWORD desired = writable() ? FILE_MAP_READ | FILE_MAP_WRITE : FILE_MAP_READ;
+            if (large_pages_) desired |= FILE_MAP_LARGE_PAGES;
+
+            auto base = mapped_view_unique_handle(::MapViewOfFile(
+                mapping_.get(), desired,
+                static_cast<DWORD>(aligned >> 32), static_cast<DWORD>(aligned),
+                static_cast<SIZE_T>(mapped_length)));
+
+            if (!base) throw_last_error();
+            auto data = static_cast<std::byte*>(base.get()) + (offset - aligned);
+            return mapped_view(std::move(base), data, static_cast<size_t>(length), offset);
+        }
+    };
+
+    /// Moving window over a mapped file, for sequential access to files larger than the address space.
+    /// Views are remapped only when a requested range leaves the current window.
+    class mapped_window final
+    {
+        const mapped_file* file_{};
+        size_t window_size_{};
+        bool prefetch_{};
+        mapped_view view_{};
+
+    public:
+        explicit mapped_window(const mapped_file& file, size_t window_size = 64u << 20, bool prefetch = true)
+            : file_(&file), window_size_(window_size), prefetch_(prefetch) {}
+
+        /// Returns a pointer to [offset, offset + length) of the file, valid until the next call.
+        [[nodiscard]] std::byte* at(uint64_t offset, size_t length)
+        {
+            if (!view_ || offset < view_.offset() || offset + length > view_.offset() + view_.size())
+            {
+                view_ = mapped_view{}; // unmap first to keep address space usage bounded.
+                view_ = file_->map(offset, std::max<uint64_t>(window_size_, length));
+                if (view_.size() < length) throw std::out_of_range("range is out of the file");
+                if (prefetch_) (void)view_.prefetch();
+            }
+            return view_.data() + (offset - view_.offset());
+        }
+
+        [[nodiscard]] const mapped_view& view() const noexcept { return view_; }
+    };
+}
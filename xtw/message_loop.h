@@ -0,0 +1,362 @@
+/// @file
+/// @brief  xtw::window::message_loop
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "./win32_exception.h"
+
+namespace xtw::window
+{
+    /// A message as message_loop sees it: the fields of MSG, without Win32 types.
+    struct queued_message
+    {
+        void* window;     // HWND
+        uint32_t id;      // WM_*
+        uintptr_t wparam;
+        intptr_t lparam;
+        uint32_t time;
+        int32_t x;        // cursor position when the message was posted
+        int32_t y;
+    };
+
+    /// Where message_loop gets its messages, time and waits from.
+    /// message_loop only talks to this interface, so its scheduling can be driven by a scripted source.
+    class message_source
+    {
+    public:
+        static inline constexpr uint32_t infinite = 0xFFFFFFFF;
+
+        enum struct wake_reason
+        {
+            handle,  // handles[index] is signaled
+            input,   // a message is available
+            timeout,
+        };
+
+        struct wake
+        {
+            wake_reason reason;
+            size_t index;
+        };
+
+        message_source() = default;
+        message_source(const message_source& other) = delete;
+        message_source(message_source&& other) noexcept = delete;
+        message_source& operator=(const message_source& other) = delete;
+        message_source& operator=(message_source&& other) noexcept = delete;
+        virtual ~message_source() = default;
+
+        /// Removes the next message. Returns false when the queue is empty.
+        virtual bool peek(queued_message& msg) = 0;
+
+        virtual void dispatch(const queued_message& msg) = 0;
+
+        /// Waits until one of the handles is signaled, a message is available, or milliseconds (or infinite) pass.
+        /// Throws if the wait fails.
+        virtual wake wait(size_t count, void* const* handles, uint32_t milliseconds) = 0;
+
+        /// Monotonic time in microseconds.
+        virtual int64_t now() = 0;
+    };
+
+#if defined(_WIN32)
+    /// Message queue of the calling thread.
+    class win32_message_source final : public message_source
+    {
+        int64_t frequency_{};
+
+    public:
+        win32_message_source()
+        {
+            LARGE_INTEGER f{};
+            ::QueryPerformanceFrequency(&f);
+            frequency_ = f.QuadPart;
+        }
+
+        bool peek(queued_message& msg) override
+        {
+            MSG m{};
+            if (!::PeekMessageW(&m, nullptr, 0, 0, PM_REMOVE)) return false;
+            msg = queued_message{m.hwnd, m.message, m.wParam, m.lParam, m.time, m.pt.x, m.pt.y};
+            return true;
+        }
+
+        void dispatch(const queued_message& msg) override
+        {
+            const MSG m{static_cast<HWND>(msg.window), msg.id, msg.wparam, msg.lparam, msg.time, POINT{msg.x, msg.y}};
+            ::TranslateMessage(&m);
+            ::DispatchMessageW(&m);
+        }
+
+        wake wait(size_t count, void* const* handles, uint32_t milliseconds) override
+        {
+            // MWMO_INPUTAVAILABLE: also wake for input that is already queued but was seen by an earlier peek.
+            const DWORD n = static_cast<DWORD>(count);
+            const DWORD result = ::MsgWaitForMultipleObjectsEx(n, handles, milliseconds, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+
+            if (result < WAIT_OBJECT_0 + n) return wake{wake_reason::handle, result - WAIT_OBJECT_0};
+            if (result == WAIT_OBJECT_0 + n) return wake{wake_reason::input, 0};
+            if (result == WAIT_TIMEOUT) return wake{wake_reason::timeout, 0};
+            if (result >= WAIT_ABANDONED_0 && result < WAIT_ABANDONED_0 + n) throw std::runtime_error("handle abandoned");
+            throw win32_exception(HRESULT_FROM_WIN32(::GetLastError()));
+        }
+
+        int64_t now() override
+        {
+            LARGE_INTEGER c{};
+            ::QueryPerformanceCounter(&c);
+            return c.QuadPart / frequency_ * 1000000 + c.QuadPart % frequency_ * 1000000 / frequency_;
+        }
+    };
+#endif
+
+    /// Frame-paced message loop.
+    ///
+    /// Each frame drains the queue for at most the message budget; what is left is handled in the next frame, so
+    /// high-rate input cannot starve rendering. While draining, consecutive WM_MOUSEMOVE/WM_NCMOUSEMOVE (same window
+    /// and key state) and WM_SIZE (same window) messages are collapsed to the last one. WM_PAINT is dispatched once per
+    /// window per drain; a repeated WM_PAINT means the window is still invalid, and draining stops for the frame.
+    ///
+    /// Between frames the loop waits for the next frame time on the message queue and on registered handles,
+    /// dispatching messages and calling handle callbacks as they arrive.
+    class message_loop final
+    {
+    public:
+        struct frame_info
+        {
+            uint64_t frame_index;
+            int64_t time;             // microseconds, from message_source::now()
+            int64_t delta_time;       // since the previous frame
+            size_t dispatched_count;  // messages dispatched since the previous frame
+            size_t coalesced_count;   // messages collapsed into later ones
+        };
+
+        /// Returns false to leave the loop.
+        using frame_callback = std::function<bool(const frame_info&)>;
+        using wait_callback = std::function<void()>;
+
+    private:
+        std::unique_ptr<message_source> owned_source_{};
+        message_source* source_{};
+        int64_t message_budget_ = 4000;
+
+        std::vector<HANDLE> wait_handles_{};
+        std::vector<wait_callback> wait_callbacks_{};
+
+        queued_message pending_{};
+        bool has_pending_{};
+        std::vector<void*> painted_{};
+
+        size_t dispatched_count_{};
+        size_t coalesced_count_{};
+        bool quit_{};
+        int exit_code_{};
+
+    public:
+#if defined(_WIN32)
+        /// Loop on the calling thread's message queue.
+        message_loop()
+            : owned_source_(std::make_unique<win32_message_source>())
+            , source_(owned_source_.get()) {}
+#endif
+
+        /// Loop on a custom source. The source must outlive the loop.
+        explicit message_loop(message_source& source)
+            : source_(&source) {}
+
+        message_loop(const message_loop& other) = delete;
+        message_loop(message_loop&& other) noexcept = delete;
+        message_loop& operator=(const message_loop& other) = delete;
+        message_loop& operator=(message_loop&& other) noexcept = delete;
+        ~message_loop() = default;
+
+        /// Sets the time in microseconds a frame may spend draining messages.
+        void set_message_budget(int64_t microseconds) noexcept { message_budget_ = microseconds; }
+
+        [[nodiscard]] bool quit_requested() const noexcept { return quit_; }
+        [[nodiscard]] int exit_code() const noexcept { return exit_code_; }
+
+        /// Calls callback on the loop thread whenever handle is signaled. Up to MAXIMUM_WAIT_OBJECTS - 1 handles.
+        void add_wait(HANDLE handle, wait_callback callback)
+        {
+            if (wait_handles_.size() >= MAXIMUM_WAIT_OBJECTS - 1) throw std::length_error("too many wait handles");
+            wait_handles_.push_back(handle);
+            try { wait_callbacks_.push_back(std::move(callback)); }
+            catch (...)
+            {
+                wait_handles_.pop_back();
+                throw;
+            }
+        }
+
+        /// Same as add_wait(event.handle(), callback), for threading::event and similar.
+        template <class E, std::enable_if_t<std::is_convertible_v<decltype(std::declval<const E&>().handle()), HANDLE>>* = nullptr>
+        void add_wait(const E& event, wait_callback callback)
+        {
+            add_wait(event.handle(), std::move(callback));
+        }
+
+        void remove_wait(HANDLE handle) noexcept
+        {
+            for (size_t i = 0; i < wait_handles_.size(); i++)
+            {
+                if (wait_handles_[i] == handle)
+                {
+                    wait_handles_.erase(wait_handles_.begin() + static_cast<ptrdiff_t>(i));
+                    wait_callbacks_.erase(wait_callbacks_.begin() + static_cast<ptrdiff_t>(i));
+                    return;
+                }
+            }
+        }
+
+        /// Drains the queue within the message budget. Returns false once WM_QUIT has been received.
+        bool pump()
+        {
+            if (quit_) return false;
+
+            const int64_t deadline = source_->now() + message_budget_;
+            painted_.clear();
+
+            for (size_t n = 0;; n++)
+            {
+                if (n != 0 && source_->now() >= deadline) break; // the rest is left for the next frame.
+
+                queued_message msg{};
+                if (!source_->peek(msg)) break;
+
+                if (msg.id == WM_QUIT)
+                {
+                    flush_pending();
+                    quit_ = true;
+                    exit_code_ = static_cast<int>(msg.wparam);
+                    return false;
+                }
+
+                if (is_coalescible(msg))
+                {
+                    if (has_pending_ && is_same_stream(pending_, msg))
+                        coalesced_count_++;
+                    else
+                        flush_pending();
+
+                    pending_ = msg;
+                    has_pending_ = true;
+                    continue;
+                }
+
+                flush_pending(); // keeps the order with other messages.
+
+                if (msg.id == WM_PAINT)
+                {
+                    if (std::find(painted_.begin(), painted_.end(), msg.window) != painted_.end()) break;
+                    painted_.push_back(msg.window);
+                }
+
+                dispatch(msg);
+            }
+
+            flush_pending();
+            return true;
+        }
+
+        /// Runs frames every frame_interval microseconds until on_frame returns false or WM_QUIT is received.
+        /// Returns the WM_QUIT exit code (0 when on_frame ended the loop).
+        int run(const frame_callback& on_frame, int64_t frame_interval)
+        {
+            int64_t last = source_->now();
+            for (uint64_t frame_index = 0;; frame_index++)
+            {
+                const int64_t frame_start = source_->now();
+                if (!pump()) break;
+
+                const frame_info info{frame_index, frame_start, frame_start - last, dispatched_count_, coalesced_count_};
+                dispatched_count_ = 0;
+                coalesced_count_ = 0;
+                last = frame_start;
+
+                if (on_frame && !on_frame(info)) break;
+                if (!wait_until(frame_start + frame_interval)) break;
+            }
+            return exit_code_;
+        }
+
+        /// Runs without frames: dispatches messages and handle callbacks until WM_QUIT is received. Returns the exit code.
+        int run()
+        {
+            while (pump())
+                (void)wait_once(message_source::infinite);
+            return exit_code_;
+        }
+
+    private:
+        static bool is_coalescible(const queued_message& msg) noexcept
+        {
+            return msg.id == WM_MOUSEMOVE || msg.id == WM_NCMOUSEMOVE || msg.id == WM_SIZE;
+        }
+
+        // a later message of the same stream supersedes an earlier one.
+        static bool is_same_stream(const queued_message& a, const queued_message& b) noexcept
+        {
+            if (a.window != b.window || a.id != b.id) return false;
+            return a.id == WM_SIZE || a.wparam == b.wparam; // mouse moves carry key state in wParam.
+        }
+
+        void dispatch(const queued_message& msg)
+        {
+            source_->dispatch(msg);
+            dispatched_count_++;
+        }
+
+        void flush_pending()
+        {
+            if (!has_pending_) return;
+            has_pending_ = false;
+            dispatch(pending_);
+        }
+
+        // waits once and handles what woke it. returns false once WM_QUIT has been received.
+        bool wait_once(uint32_t milliseconds)
+        {
+            const auto woken = source_->wait(wait_handles_.size(), wait_handles_.data(), milliseconds);
+            switch (woken.reason)
+            {
+            case message_source::wake_reason::handle:
+            {
+                auto callback = wait_callbacks_.at(woken.index); // the callback may remove itself.
+                callback();
+                return true;
+            }
+            case message_source::wake_reason::input:
+                return pump();
+            case message_source::wake_reason::timeout:
+            default:
+                return true;
+            }
+        }
+
+        bool wait_until(int64_t deadline)
+        {
+            while (true)
+            {
+                const int64_t remaining = deadline - source_->now();
+                if (remaining <= 0) return true;
+                // rounded up: a zero timeout would spin for the sub-millisecond tail.
+                if (!wait_once(static_cast<uint32_t>(std::min<int64_t>((remaining + 999) / 1000, message_source::infinite - 1)))) return false;
+            }
+        }
+    };
+}
@@ -0,0 +1,389 @@
+/// @file
+/// @brief  xtw::threading parallel algorithms
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+#pragma comment(lib, "Synchronization.lib")
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "./threading.h"
+
+namespace xtw::threading
+{
+    namespace parallel_detail
+    {
+        // waits while a == value: spins briefly, then sleeps in WaitOnAddress.
+        template <class T>
+        static inline void wait_while_equal(const std::atomic<T>& a, T value) noexcept
+        {
+            static_assert(sizeof(std::atomic<T>) == sizeof(T) && std::atomic<T>::is_always_lock_free);
+
+            for (int i = 0; i < 64; i++)
+            {
+                if (a.load(std::memory_order_acquire) != value) return;
+                YieldProcessor();
+            }
+
+            while (a.load(std::memory_order_acquire) == value)
+                ::WaitOnAddress(const_cast<std::atomic<T>*>(&a), &value, sizeof(T), INFINITE);
+        }
+
+        template <class T>
+        static inline void wake_all(std::atomic<T>& a) noexcept { ::WakeByAddressAll(&a); }
+
+        template <class T>
+        static inline void wake_one(std::atomic<T>& a) noexcept { ::WakeByAddressSingle(&a); }
+
+        // set while the thread runs a worker_set job; nested parallel calls then run serially.
+        static inline bool& in_parallel_region() noexcept
+        {
+            static thread_local bool in_region{};
+            return in_region;
+        }
+
+        struct region_scope
+        {
+            bool previous = std::exchange(in_parallel_region(), true);
+            region_scope() = default;
+            region_scope(const region_scope& other) = delete;
+            region_scope(region_scope&& other) noexcept = delete;
+            region_scope& operator=(const region_scope& other) = delete;
+            region_scope& operator=(region_scope&& other) noexcept = delete;
+            ~region_scope() { in_parallel_region() = previous; }
+        };
+    }
+
+    /// Single-use countdown. Waiters sleep on the counter itself (WaitOnAddress); no kernel object is created.
+    class latch final
+    {
+        std::atomic<ptrdiff_t> count_;
+
+    public:
+        explicit latch(ptrdiff_t count) noexcept : count_(count) {}
+
+        latch(const latch& other) = delete;
+        latch(latch&& other) noexcept = delete;
+        latch& operator=(const latch& other) = delete;
+        latch& operator=(latch&& other) noexcept = delete;
+        ~latch() = default;
+
+        void count_down(ptrdiff_t n = 1) noexcept
+        {
+            if (count_.fetch_sub(n, std::memory_order_acq_rel) == n)
+                parallel_detail::wake_all(count_);
+        }
+
+        [[nodiscard]] bool try_wait() const noexcept { return count_.load(std::memory_order_acquire) == 0; }
+
+        void wait() const noexcept
+        {
+            for (ptrdiff_t c; (c = count_.load(std::memory_order_acquire)) != 0;)
+                parallel_detail::wait_while_equal(count_, c);
+        }
+
+        void arrive_and_wait(ptrdiff_t n = 1) noexcept
+        {
+            count_down(n);
+            wait();
+        }
+    };
+
+    /// Reusable barrier for a fixed number of participants.
+    class barrier final
+    {
+        const uint32_t count_;
+        std::atomic<uint32_t> arrived_{};
+        std::atomic<uint32_t> generation_{};
+
+    public:
+        explicit barrier(uint32_t count) noexcept : count_(count) {}
+
+        barrier(const barrier& other) = delete;
+        barrier(barrier&& other) noexcept = delete;
+        barrier& operator=(const barrier& other) = delete;
+        barrier& operator=(barrier&& other) noexcept = delete;
+        ~barrier() = default;
+
+        void arrive_and_wait() noexcept
+        {
+            const uint32_t generation = generation_.load(std::memory_order_acquire);
+            if (arrived_.fetch_add(1, std::memory_order_acq_rel) + 1 == count_)
+            {
+                arrived_.store(0, std::memory_order_relaxed);
+                generation_.fetch_add(1, std::memory_order_release);
+                parallel_detail::wake_all(generation_);
+                return;
+            }
+            parallel_detail::wait_while_equal(generation_, generation);
+        }
+    };
+
+    /// Counting semaphore on WaitOnAddress.
+    class semaphore final
+    {
+        std::atomic<ptrdiff_t> count_;
+
+    public:
+        explicit semaphore(ptrdiff_t initial_count = 0) noexcept : count_(initial_count) {}
+
+        semaphore(const semaphore& other) = delete;
+        semaphore(semaphore&& other) noexcept = delete;
+        semaphore& operator=(const semaphore& other) = delete;
+        semaphore& operator=(semaphore&& other) noexcept = delete;
+        ~semaphore() = default;
+
+        void release(ptrdiff_t n = 1) noexcept
+        {
+            count_.fetch_add(n, std::memory_order_release);
+            if (n == 1) parallel_detail::wake_one(count_);
+            else parallel_detail::wake_all(count_);
+        }
+
+        [[nodiscard]] bool try_acquire() noexcept
+        {
+            ptrdiff_t c = count_.load(std::memory_order_relaxed);
+            while (c > 0)
+                if (count_.compare_exchange_weak(c, c - 1, std::memory_order_acquire, std::memory_order_relaxed))
+                    return true;
+            return false;
+        }
+
+        void acquire() noexcept
+        {
+            while (!try_acquire())
+                parallel_detail::wait_while_equal(count_, ptrdiff_t{0});
+        }
+    };
+
+    /// Persistent worker threads that run one job at a time on all participants (the workers and the calling thread).
+    class worker_set final
+    {
+        using job_function = void (*)(const void* context, size_t participant_index);
+
+        std::mutex execute_mutex_{};
+        job_function job_{};
+        const void* job_context_{};
+        std::atomic<uint32_t> generation_{};
+        std::atomic<uint32_t> remaining_{};
+        std::atomic_bool stop_{};
+
+        std::mutex error_mutex_{};
+        std::exception_ptr error_{};
+
+        std::vector<thread> threads_{};
+
+    public:
+        /// Starts worker_count threads. Jobs run on worker_count + 1 participants.
+        explicit worker_set(size_t worker_count, const wchar_t* thread_name = L"xtw::worker_set")
+        {
+            try
+            {
+                threads_.reserve(worker_count);
+                for (size_t i = 0; i < worker_count; i++)
+                    threads_.emplace_back([this, i] { this->worker_main(i + 1); }, thread::join_on_destructor, 65536, THREAD_PRIORITY_NORMAL, thread_name);
+            }
+            catch (...)
+            {
+                stop_workers(); // the started workers would otherwise be joined while waiting for a job.
+                throw;
+            }
+        }
+
+        worker_set(const worker_set& other) = delete;
+        worker_set(worker_set&& other) noexcept = delete;
+        worker_set& operator=(const worker_set& other) = delete;
+        worker_set& operator=(worker_set&& other) noexcept = delete;
+
+        ~worker_set() { stop_workers(); }
+
+        /// Process-wide set with one worker per logical processor besides the caller.
+        [[nodiscard]] static worker_set& shared()
+        {
+            static worker_set s(std::max(1u, std::thread::hardware_concurrency()) - 1);
+            return s;
+        }
+
+        /// Number of participants of a job.
+        [[nodiscard]] size_t size() const noexcept { return threads_.size() + 1; }
+
+        /// Runs f(participant_index) on every participant and returns when all are done.
+        /// The caller is participant 0. The first exception thrown is rethrown here.
+        /// Called from inside a job (nested), f(0) runs on the calling thread only.
+        template <class F>
+        void execute(F&& f)
+        {
+            if (parallel_detail::in_parallel_region() || threads_.empty())
+            {
+                parallel_detail::region_scope region{};
+                f(size_t{0});
+                return;
+            }
+
+            std::lock_guard lock(execute_mutex_);
+            // the context is stored as const void* so that const functors fit; the thunk restores the exact type of f.
+            using function_type = std::remove_reference_t<F>;
+            job_ = [](const void* context, size_t index) { (*const_cast<function_type*>(static_cast<const function_type*>(context)))(index); };
+            job_context_ = std::addressof(f);
+            error_ = nullptr;
+            remaining_.store(static_cast<uint32_t>(threads_.size()), std::memory_order_relaxed);
+            generation_.fetch_add(1, std::memory_order_release);
+            parallel_detail::wake_all(generation_);
+
+            run_job(0);
+
+            for (uint32_t r; (r = remaining_.load(std::memory_order_acquire)) != 0;)
+                parallel_detail::wait_while_equal(remaining_, r);
+
+            if (error_) std::rethrow_exception(error_);
+        }
+
+    private:
+        void stop_workers() noexcept
+        {
+            stop_.store(true);
+            generation_.fetch_add(1, std::memory_order_release);
+            parallel_detail::wake_all(generation_);
+            threads_.clear(); // joins
+        }
+
+        void run_job(size_t index) noexcept
+        {
+            parallel_detail::region_scope region{};
+            try { job_(job_context_, index); }
+            catch (...)
+            {
+                std::lock_guard lock(error_mutex_);
+                if (!error_) error_ = std::current_exception();
+            }
+        }
+
+        void worker_main(size_t index)
+        {
+            uint32_t seen = 0;
+            while (true)
+            {
+                parallel_detail::wait_while_equal(generation_, seen);
+                seen = generation_.load(std::memory_order_acquire);
+                if (stop_.load()) return;
+
+                run_job(index);
+                if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    parallel_detail::wake_all(remaining_);
+            }
+        }
+    };
+
+    namespace parallel_detail
+    {
+        // chunks are claimed dynamically; the default gives each participant about 8 chunks to balance uneven work.
+        static inline size_t chunk_size(size_t n, size_t grain, const worker_set& workers) noexcept
+        {
+            if (grain) return grain;
+            return std::max<size_t>(1, n / (workers.size() * 8));
+        }
+
+        template <class F>
+        static inline void invoke_range(F& body, size_t begin, size_t end)
+        {
+            if constexpr (std::is_invocable_v<F&, size_t, size_t>)
+                body(begin, end);
+            else
+                for (size_t i = begin; i < end; i++) body(i);
+        }
+    }
+
+    /// Calls body(i) for each i in [first, last), or body(begin, end) for subranges, on the worker set.
+    /// grain is the chunk size (0: automatic). Nested calls run serially on the calling thread.
+    template <class F, std::enable_if_t<std::is_invocable_v<F&, size_t> || std::is_invocable_v<F&, size_t, size_t>>* = nullptr>
+    static inline void parallel_for(size_t first, size_t last, F body, size_t grain = 0, worker_set& workers = worker_set::shared())
+    {
+        if (first >= last) return;
+
+        const size_t n = last - first;
+        const size_t chunk = parallel_detail::chunk_size(n, grain, workers);
+        if (chunk >= n || workers.size() == 1 || parallel_detail::in_parallel_region())
+        {
+            parallel_detail::invoke_range(body, first, last);
+            return;
+        }
+
+        std::atomic<size_t> next{0};
+        workers.execute([&](size_t)
+        {
+            for (size_t offset; (offset = next.fetch_add(chunk, std::memory_order_relaxed)) < n;)
+                parallel_detail::invoke_range(body, first + offset, first + std::min(n, offset + chunk));
+        });
+    }
+
+    /// Reduces [first, last): each chunk is mapped with map(begin, end) -> T, and the chunk results are combined
+    /// in range order, so the result is deterministic for any associative combine.
+    template <class T, class Map, class Combine>
+    static inline T parallel_reduce(size_t first, size_t last, T identity, Map map, Combine combine, size_t grain = 0, worker_set& workers = worker_set::shared())
+    {
+        if (first >= last) return identity;
+
+        const size_t n = last - first;
+        const size_t chunk = parallel_detail::chunk_size(n, grain, workers);
+        if (chunk >= n || workers.size() == 1 || parallel_detail::in_parallel_region())
+            return combine(std::move(identity), map(first, last));
+
+        const size_t chunk_count = (n + chunk - 1) / chunk;
+        std::vector<T> partial(chunk_count, identity);
+
+        std::atomic<size_t> next{0};
+        workers.execute([&](size_t)
+        {
+            for (size_t k; (k = next.fetch_add(1, std::memory_order_relaxed)) < chunk_count;)
+                partial[k] = map(first + k * chunk, first + std::min(n, (k + 1) * chunk));
+        });
+
+        T result = std::move(identity);
+        for (auto& p : partial) result = combine(std::move(result), std::move(p));
+        return result;
+    }
+
+    /// Sorts [first, last): chunks are sorted in parallel, then merged pairwise in rounds.
+    template <class RandomIt, class Compare = std::less<>>
+    static inline void parallel_sort(RandomIt first, RandomIt last, Compare comp = {}, worker_set& workers = worker_set::shared())
+    {
+        const size_t n = static_cast<size_t>(std::distance(first, last));
+        constexpr size_t min_chunk = 4096;
+
+        size_t chunks = 1;
+        while (chunks < workers.size() * 2 && n / (chunks * 2) >= min_chunk) chunks *= 2;
+
+        if (chunks == 1 || parallel_detail::in_parallel_region())
+        {
+            std::sort(first, last, comp);
+            return;
+        }
+
+        const auto bound = [&](size_t k) { return first + static_cast<ptrdiff_t>(n * k / chunks); };
+
+        parallel_for(0, chunks, [&](size_t k) { std::sort(bound(k), bound(k + 1), comp); }, 1, workers);
+
+        for (size_t width = 1; width < chunks; width *= 2)
+        {
+            parallel_for(0, chunks / (width * 2), [&](size_t pair)
+            {
+                const size_t k = pair * width * 2;
+                std::inplace_merge(bound(k), bound(k + width), bound(k + width * 2), comp);
+            }, 1, workers);
+        }
+    }
+}
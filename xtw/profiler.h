@@ -0,0 +1,624 @@
+/// @file
+/// @brief  xtw::debug::sampling_profiler
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <ctime>
+#include <sched.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
+#include "./debug_symbols.h"
+#include "./thread_registry.h"
+#include "./threading.h"
+#include "./unique_handle.h"
+#include "./utf.h"
+
+namespace xtw::debug
+{
+    /// In-process sampling profiler for xtw threads.
+    ///
+    /// A time-critical sampler thread wakes at the sampling frequency (high-resolution waitable timer where available),
+    /// and for each thread in threading::thread_registry: suspends it, copies its context and the used part of its stack
+    /// into a preallocated buffer, and resumes it. Only memcpy runs while the target is suspended; the stack is unwound
+    /// afterwards against the copy, because the unwinder takes loader locks the suspended thread may hold.
+    /// Records go through a single-producer ring; folded_stacks() aggregates them and symbolizes lazily through
+    /// symbol_cache, producing "thread;root;...;leaf count" lines for flame graph tools.
+    ///
+    /// Stacks are fully unwound on x64 (RtlVirtualUnwind); on other architectures only the current PC is recorded.
+    ///
+    /// Off Windows, the sampler sends SIGPROF to each thread in turn (tgkill) and waits for it to answer. The handler, on the
+    /// target thread, walks frame pointers from the interrupted context within the stack bounds recorded by thread_registry,
+    /// and only reads memory; code built without frame pointers (and frameless leaf functions) loses frames. The handler is installed on the first
+    /// start() and stays, replacing any previous SIGPROF handler; one profiler samples at a time.
+    ///
+    /// Constructing a profiler enables thread_registry; threads started before that are not sampled.
+    class sampling_profiler final
+    {
+    public:
+        static inline constexpr size_t max_depth = 64;
+        static inline constexpr size_t max_stack_copy = 256 * 1024; // deeper stacks are truncated at the root side
+        static inline constexpr size_t stack_copy_slack = 64 * 1024; // zeros after the copy, for frames cut at max_stack_copy
+
+    private:
+        struct sample
+        {
+            DWORD thread_id;
+            uint32_t depth;
+            void* frames[max_depth]; // leaf first
+        };
+
+        struct target
+        {
+            DWORD thread_id{};
+#if defined(_WIN32)
+            unique_handle handle{};
+            const NT_TIB* tib{}; // for stack bounds
+#else
+            pid_t native_id{};
+            uintptr_t stack_low{}; // for frame pointer checks
+            uintptr_t stack_high{};
+#endif
+        };
+
+        std::unique_ptr<sample[]> ring_{};
+        size_t capacity_{};
+        std::atomic<size_t> write_{}; // sampler
+        std::atomic<size_t> read_{};  // consumer
+        std::atomic<uint64_t> sample_count_{};
+        std::atomic<uint64_t> dropped_count_{};
+        std::atomic<int64_t> interval_100ns_{};
+
+#if defined(_WIN32)
+        std::unique_ptr<std::byte[]> stack_copy_{}; // sampler thread only
+#else
+        // the sample being taken, answered by the SIGPROF handler on the target thread.
+        struct signal_request
+        {
+            std::atomic<uint32_t> state{}; // sequence << 2 | phase; fields are written by the sampler while idle
+            std::atomic<pid_t> native_id{};
+            std::atomic<uintptr_t> stack_low{};
+            std::atomic<uintptr_t> stack_high{};
+            std::atomic<sample*> slot{};
+        };
+
+        static inline constexpr uint32_t request_idle = 0;    // nothing asked, or given up by the sampler
+        static inline constexpr uint32_t request_armed = 1;   // signal sent
+        static inline constexpr uint32_t request_writing = 2; // taken by the handler
+        static inline constexpr uint32_t request_done = 3;    // slot filled
+
+        signal_request request_{};
+#endif
+
+        std::mutex consumer_mutex_{};
+        std::map<std::vector<uintptr_t>, uint64_t> aggregated_{}; // [thread id, leaf, ..., root] -> count
+
+        struct thread_name
+        {
+            std::wstring name;
+            size_t retired_at; // ring position after the last sample of an exited thread; live while npos
+        };
+
+        static inline constexpr size_t npos = ~size_t{};
+
+        std::mutex names_mutex_{};
+        std::map<DWORD, thread_name> names_{};
+
+        threading::manual_reset_event stop_{};
+        threading::thread sampler_{};
+
+    public:
+        /// buffer_capacity is the number of stack records held between folded_stacks() calls; overflowing samples are dropped.
+        explicit sampling_profiler(uint32_t frequency_hz = 1000, size_t buffer_capacity = 8192)
+        {
+            if (buffer_capacity == 0) throw std::invalid_argument("buffer_capacity must not be 0");
+            (void)threading::thread_registry::instance(); // registration is opt-in
+            ring_ = std::make_unique<sample[]>(buffer_capacity);
+            capacity_ = buffer_capacity;
+#if defined(_WIN32)
+            stack_copy_ = std::make_unique<std::byte[]>(max_stack_copy + stack_copy_slack);
+#endif
+            set_frequency(frequency_hz);
+        }
+
+        sampling_profiler(const sampling_profiler& other) = delete;
+        sampling_profiler(sampling_profiler&& other) noexcept = delete;
+        sampling_profiler& operator=(const sampling_profiler& other) = delete;
+        sampling_profiler& operator=(sampling_profiler&& other) noexcept = delete;
+        ~sampling_profiler() { stop(); }
+
+        void set_frequency(uint32_t hz) noexcept
+        {
+            interval_100ns_.store(10000000 / std::max<uint32_t>(hz, 1), std::memory_order_relaxed);
+        }
+
+        /// Starts sampling. Off Windows, throws std::logic_error while another profiler is sampling.
+        void start()
+        {
+            if (sampler_.joinable()) return;
+            stop_.reset_signal_state();
+#if defined(_WIN32)
+            sampler_ = threading::thread([this] { this->sampler_main(); }, 65536, THREAD_PRIORITY_TIME_CRITICAL, L"xtw::debug::sampling_profiler");
+#else
+            install_signal_handler();
+            signal_request* expected = nullptr;
+            if (!active_request().compare_exchange_strong(expected, &request_)) throw std::logic_error("another sampling_profiler is running");
+            try
+            {
+                sampler_ = threading::thread([this] { this->sampler_main(); }, 65536, THREAD_PRIORITY_TIME_CRITICAL, L"xtw::debug::sampling_profiler");
+            }
+            catch (...)
+            {
+                active_request().store(nullptr);
+                throw;
+            }
+#endif
+        }
+
+        void stop()
+        {
+            if (!sampler_.joinable()) return;
+            stop_.notify_signal();
+            sampler_.join();
+#if !defined(_WIN32)
+            active_request().store(nullptr); // late signals find no request
+#endif
+        }
+
+        [[nodiscard]] uint64_t sample_count() const noexcept { return sample_count_.load(std::memory_order_relaxed); }
+        [[nodiscard]] uint64_t dropped_count() const noexcept { return dropped_count_.load(std::memory_order_relaxed); }
+
+        /// Folded stacks of all samples taken so far (or since the last reset).
+        [[nodiscard]] std::string folded_stacks(bool reset = false)
+        {
+            std::lock_guard lock(consumer_mutex_);
+            drain();
+
+            std::map<DWORD, std::string> thread_names{};
+            {
+                std::lock_guard names_lock(names_mutex_);
+                for (auto& [id, n] : names_)
+                    thread_names[id] = sanitize(display_name(id, n.name));
+            }
+
+            auto& symbols = symbol_cache::instance();
+            std::string result{};
+            for (auto& [stack, count] : aggregated_)
+            {
+                const auto id = static_cast<DWORD>(stack[0]);
+                auto it = thread_names.find(id);
+                result += it != thread_names.end() ? it->second : "thread " + std::to_string(id);
+
+                for (size_t i = stack.size(); i-- > 1;)
+                {
+                    // return addresses point after the call; look up the call itself.
+                    const uintptr_t address = i == 1 ? stack[i] : stack[i] - 1;
+                    result += ';';
+                    result += sanitize(symbols.name_of(reinterpret_cast<const void*>(address)));
+                }
+                result += ' ';
+                result += std::to_string(count);
+                result += '\n';
+            }
+
+            if (reset) aggregated_.clear();
+            prune_names();
+            return result;
+        }
+
+        void clear()
+        {
+            std::lock_guard lock(consumer_mutex_);
+            drain();
+            aggregated_.clear();
+            prune_names();
+        }
+
+    private:
+        // requires consumer_mutex_
+        void drain()
+        {
+            size_t r = read_.load(std::memory_order_relaxed);
+            const size_t w = write_.load(std::memory_order_acquire);
+            std::vector<uintptr_t> key{};
+            for (; r != w; r++)
+            {
+                const sample& s = ring_[r % capacity_];
+                key.assign(1, s.thread_id);
+                for (uint32_t i = 0; i < s.depth; i++) key.push_back(reinterpret_cast<uintptr_t>(s.frames[i]));
+                aggregated_[key]++;
+            }
+            read_.store(r, std::memory_order_release);
+        }
+
+        // forgets exited threads whose samples are all drained and no longer aggregated. requires consumer_mutex_
+        void prune_names()
+        {
+            std::vector<DWORD> referenced{};
+            for (auto& [stack, count] : aggregated_)
+                if (referenced.empty() || referenced.back() != stack[0]) referenced.push_back(static_cast<DWORD>(stack[0]));
+            std::sort(referenced.begin(), referenced.end());
+
+            const size_t drained = read_.load(std::memory_order_relaxed);
+            std::lock_guard lock(names_mutex_);
+            for (auto it = names_.begin(); it != names_.end();)
+            {
+                const bool retired = it->second.retired_at != npos && it->second.retired_at <= drained;
+                if (retired && !std::binary_search(referenced.begin(), referenced.end(), it->first)) it = names_.erase(it);
+                else ++it;
+            }
+        }
+
+        static std::string display_name(DWORD id, const std::wstring& name)
+        {
+            if (!name.empty())
+            {
+                try { return utf::to_utf8(name); }
+                catch (const std::invalid_argument&) {} // ill-formed UTF-16
+            }
+            return "thread " + std::to_string(id);
+        }
+
+        static std::string sanitize(std::string s)
+        {
+            std::replace(s.begin(), s.end(), ';', ':'); // ';' separates frames
+            std::replace(s.begin(), s.end(), '\n', ' ');
+            return s;
+        }
+
+        void refresh_targets(std::vector<target>& targets)
+        {
+            const DWORD self = ::GetCurrentThreadId();
+            auto threads = threading::thread_registry::instance().threads();
+
+#if defined(_WIN32)
+            using NtQueryInformationThreadFn = LONG(WINAPI*)(HANDLE, ULONG, PVOID, ULONG, PULONG);
+            static const auto pfnNtQueryInformationThread = reinterpret_cast<NtQueryInformationThreadFn>(reinterpret_cast<void (*)()>(::GetProcAddress(::GetModuleHandleW(L"ntdll.dll"), "NtQueryInformationThread")));
+
+            struct thread_basic_information
+            {
+                LONG exit_status;
+                PVOID teb_base_address;
+                PVOID unique_process;
+                PVOID unique_thread;
+                ULONG_PTR affinity_mask;
+                LONG priority;
+                LONG base_priority;
+            };
+
+            std::vector<target> next{};
+            next.reserve(threads.size());
+            for (auto& [id, name] : threads)
+            {
+                if (id == self) continue;
+
+                auto it = std::find_if(targets.begin(), targets.end(), [id = id](const target& t) { return t.thread_id == id; });
+                if (it != targets.end())
+                {
+                    next.push_back(std::move(*it));
+                    continue;
+                }
+
+                target t{};
+                t.thread_id = id;
+                t.handle.reset(::OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION, FALSE, id));
+                if (!t.handle) continue;
+
+                thread_basic_information tbi{};
+                if (pfnNtQueryInformationThread && pfnNtQueryInformationThread(t.handle.get(), 0 /* ThreadBasicInformation */, &tbi, sizeof(tbi), nullptr) >= 0)
+                    t.tib = static_cast<const NT_TIB*>(tbi.teb_base_address);
+
+                next.push_back(std::move(t));
+            }
+            targets = std::move(next);
+#else
+            targets.clear();
+            for (auto& n : threading::thread_registry::instance().native_threads())
+            {
+                if (n.thread_id == self) continue;
+                targets.push_back(target{n.thread_id, n.native_id, reinterpret_cast<uintptr_t>(n.stack_low), reinterpret_cast<uintptr_t>(n.stack_high)});
+            }
+#endif
+
+            // samples of threads gone from the registry all precede the current write position.
+            std::lock_guard lock(names_mutex_);
+            for (auto& [id, n] : names_)
+                if (n.retired_at == npos) n.retired_at = write_.load(std::memory_order_relaxed);
+            for (auto& [id, name] : threads)
+                names_[id] = thread_name{name, npos};
+        }
+
+#if defined(_WIN32)
+        // called while the target is suspended: memcpy only. Returns the number of bytes copied from the stack pointer up.
+        size_t copy_stack(const CONTEXT& context, const NT_TIB* tib) noexcept
+        {
+#if defined(_M_X64)
+            if (!tib) return 0;
+            const auto base = reinterpret_cast<DWORD64>(tib->StackBase);
+            const auto limit = reinterpret_cast<DWORD64>(tib->StackLimit);
+            if (context.Rsp < limit || context.Rsp >= base) return 0;
+
+            const size_t length = static_cast<size_t>(std::min<DWORD64>(base - context.Rsp, max_stack_copy));
+            std::memcpy(stack_copy_.get(), reinterpret_cast<const void*>(context.Rsp), length);
+            return length;
+#else
+            (void)context, (void)tib;
+            return 0;
+#endif
+        }
+
+        // called after the target is resumed; reads the stack from the copy only.
+        uint32_t unwind(CONTEXT& context, size_t copied, void** frames) const noexcept
+        {
+#if defined(_M_X64)
+            if (copied == 0)
+            {
+                frames[0] = reinterpret_cast<void*>(context.Rip);
+                return 1;
+            }
+
+            // move stack pointers (and frame pointers) of the target into the copy.
+            const DWORD64 origin = context.Rsp;
+            const auto low = reinterpret_cast<DWORD64>(stack_copy_.get());
+            const DWORD64 high = low + copied;
+            const auto relocate = [&]
+            {
+                for (DWORD64* r : {&context.Rax, &context.Rcx, &context.Rdx, &context.Rbx, &context.Rsp, &context.Rbp, &context.Rsi, &context.Rdi,
+                                   &context.R8, &context.R9, &context.R10, &context.R11, &context.R12, &context.R13, &context.R14, &context.R15})
+                    if (*r >= origin && *r < origin + copied) *r = *r - origin + low;
+            };
+            const auto in_copy = [&](DWORD64 sp) { return sp >= low && sp + 8 <= high; };
+
+            relocate();
+            uint32_t depth = 0;
+            while (depth < max_depth && context.Rip)
+            {
+                frames[depth++] = reinterpret_cast<void*>(context.Rip);
+
+                DWORD64 image_base{};
+                if (auto function = ::RtlLookupFunctionEntry(context.Rip, &image_base, nullptr))
+                {
+                    PVOID handler_data{};
+                    DWORD64 establisher_frame{};
+                    ::RtlVirtualUnwind(UNW_FLAG_NHANDLER, image_base, context.Rip, function, &context, &handler_data, &establisher_frame, nullptr);
+                }
+                else
+                {
+                    // leaf function: the return address is on top of the stack.
+                    if (!in_copy(context.Rsp)) break;
+                    context.Rip = *reinterpret_cast<const DWORD64*>(context.Rsp);
+                    context.Rsp += 8;
+                }
+
+                if (!in_copy(context.Rsp)) break;
+                relocate(); // frame pointers restored from the copy hold original addresses.
+            }
+            return depth;
+#elif defined(_M_IX86)
+            (void)copied;
+            frames[0] = reinterpret_cast<void*>(static_cast<uintptr_t>(context.Eip));
+            return 1;
+#elif defined(_M_ARM64)
+            (void)copied;
+            frames[0] = reinterpret_cast<void*>(context.Pc);
+            return 1;
+#else
+            (void)context, (void)copied, (void)frames;
+            return 0;
+#endif
+        }
+
+        void capture(const target& t) noexcept
+        {
+            const size_t w = write_.load(std::memory_order_relaxed);
+            if (w - read_.load(std::memory_order_acquire) >= capacity_)
+            {
+                dropped_count_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            if (::SuspendThread(t.handle.get()) == static_cast<DWORD>(-1)) return;
+
+            CONTEXT context{};
+            context.ContextFlags = CONTEXT_CONTROL | CONTEXT_INTEGER;
+            const bool ok = ::GetThreadContext(t.handle.get(), &context);
+            const size_t copied = ok ? copy_stack(context, t.tib) : 0;
+
+            ::ResumeThread(t.handle.get());
+            if (!ok) return;
+
+            sample& s = ring_[w % capacity_];
+            const uint32_t depth = unwind(context, copied, s.frames);
+            if (depth == 0) return;
+            s.thread_id = t.thread_id;
+            s.depth = depth;
+            write_.store(w + 1, std::memory_order_release);
+            sample_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void sampler_main()
+        {
+            auto timer = unique_handle(::CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS));
+            if (!timer) timer.reset(::CreateWaitableTimerW(nullptr, FALSE, nullptr)); // before Windows 10 1803
+            if (!timer) return;
+
+            std::vector<target> targets{};
+            for (uint32_t tick = 0;; tick++)
+            {
+                if (tick % 256 == 0) refresh_targets(targets); // picks up new threads; exited ones fail to suspend until then.
+
+                LARGE_INTEGER due{};
+                due.QuadPart = -interval_100ns_.load(std::memory_order_relaxed);
+                (void)::SetWaitableTimer(timer.get(), &due, 0, nullptr, nullptr, FALSE);
+
+                const HANDLE handles[] = {stop_.handle(), timer.get()};
+                if (::WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0 + 1) return;
+
+                for (const target& t : targets)
+                    capture(t);
+            }
+        }
+#else
+        static std::atomic<signal_request*>& active_request() noexcept
+        {
+            static std::atomic<signal_request*> r{};
+            return r;
+        }
+
+        static void install_signal_handler()
+        {
+            static const bool installed = []
+            {
+                struct sigaction action{};
+                action.sa_sigaction = &on_sigprof;
+                action.sa_flags = SA_SIGINFO | SA_RESTART;
+                ::sigemptyset(&action.sa_mask);
+                return ::sigaction(SIGPROF, &action, nullptr) == 0;
+            }();
+            if (!installed) throw std::runtime_error("cannot install the SIGPROF handler");
+        }
+
+        // runs on the target thread: async-signal-safe, no locks, no allocation.
+        static void on_sigprof(int, siginfo_t*, void* context) noexcept
+        {
+            const int saved_errno = errno;
+            signal_request* r = active_request().load(std::memory_order_acquire);
+            uint32_t state = r ? r->state.load(std::memory_order_acquire) : request_idle;
+            if ((state & 3) == request_armed && r->native_id.load(std::memory_order_relaxed) == static_cast<pid_t>(::syscall(SYS_gettid)))
+            {
+                const uintptr_t low = r->stack_low.load(std::memory_order_relaxed);
+                const uintptr_t high = r->stack_high.load(std::memory_order_relaxed);
+                sample* slot = r->slot.load(std::memory_order_relaxed);
+                // the fields belong to this request only if it was not given up and re-armed since they were read.
+                if (r->state.compare_exchange_strong(state, (state & ~3u) | request_writing, std::memory_order_acquire))
+                {
+                    slot->depth = walk_frames(*static_cast<const ucontext_t*>(context), low, high, slot->frames);
+                    r->state.store((state & ~3u) | request_done, std::memory_order_release);
+                }
+            }
+            errno = saved_errno;
+        }
+
+        // the interrupted PC, then the return addresses of the frame records {previous frame pointer, return address}
+        // chained from the frame pointer, each above the last and within [stack pointer, stack_high).
+        static uint32_t walk_frames(const ucontext_t& context, uintptr_t stack_low, uintptr_t stack_high, void** frames) noexcept
+        {
+#if defined(__x86_64__) || defined(__aarch64__)
+#if defined(__x86_64__)
+            const auto pc = static_cast<uintptr_t>(context.uc_mcontext.gregs[REG_RIP]);
+            const auto sp = static_cast<uintptr_t>(context.uc_mcontext.gregs[REG_RSP]);
+            auto fp = static_cast<uintptr_t>(context.uc_mcontext.gregs[REG_RBP]);
+#else
+            const auto pc = static_cast<uintptr_t>(context.uc_mcontext.pc);
+            const auto sp = static_cast<uintptr_t>(context.uc_mcontext.sp);
+            auto fp = static_cast<uintptr_t>(context.uc_mcontext.regs[29]);
+#endif
+            uint32_t depth = 0;
+            frames[depth++] = reinterpret_cast<void*>(pc);
+
+            uintptr_t low = std::max(sp, stack_low);
+            while (depth < max_depth && fp % sizeof(uintptr_t) == 0 && fp >= low && fp + 2 * sizeof(uintptr_t) <= stack_high)
+            {
+                const auto record = reinterpret_cast<const uintptr_t*>(fp);
+                if (record[1] == 0) break;
+                frames[depth++] = reinterpret_cast<void*>(record[1]);
+                low = fp + 2 * sizeof(uintptr_t);
+                fp = record[0];
+            }
+            return depth;
+#else
+            (void)context, (void)stack_low, (void)stack_high, (void)frames;
+            return 0;
+#endif
+        }
+
+        static int64_t monotonic_ns() noexcept
+        {
+            timespec now{};
+            (void)::clock_gettime(CLOCK_MONOTONIC, &now);
+            return int64_t{now.tv_sec} * 1000000000 + now.tv_nsec;
+        }
+
+        void capture(const target& t) noexcept
+        {
+            const size_t w = write_.load(std::memory_order_relaxed);
+            if (w - read_.load(std::memory_order_acquire) >= capacity_)
+            {
+                dropped_count_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            sample& s = ring_[w % capacity_];
+            s.depth = 0;
+            const uint32_t sequence = (request_.state.load(std::memory_order_relaxed) & ~3u) + 4;
+            request_.native_id.store(t.native_id, std::memory_order_relaxed);
+            request_.stack_low.store(t.stack_low, std::memory_order_relaxed);
+            request_.stack_high.store(t.stack_high, std::memory_order_relaxed);
+            request_.slot.store(&s, std::memory_order_relaxed);
+            request_.state.store(sequence | request_armed, std::memory_order_release);
+
+            if (::syscall(SYS_tgkill, ::getpid(), t.native_id, SIGPROF) != 0)
+            {
+                request_.state.store(sequence | request_idle, std::memory_order_relaxed); // the thread has exited
+                return;
+            }
+
+            // the handler runs when the target is next scheduled; threads that do not answer in time are skipped this tick.
+            const int64_t deadline = monotonic_ns() + 10000000;
+            for (uint32_t state; ((state = request_.state.load(std::memory_order_acquire)) & 3) != request_done;)
+            {
+                if ((state & 3) == request_armed && monotonic_ns() > deadline && request_.state.compare_exchange_strong(state, sequence | request_idle))
+                    return;
+                (void)::sched_yield();
+            }
+            request_.state.store(sequence | request_idle, std::memory_order_relaxed);
+
+            if (s.depth == 0) return;
+            s.thread_id = t.thread_id;
+            write_.store(w + 1, std::memory_order_release);
+            sample_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void sampler_main()
+        {
+            std::vector<target> targets{};
+            int64_t next = monotonic_ns();
+            for (uint32_t tick = 0;; tick++)
+            {
+                if (tick % 256 == 0) refresh_targets(targets); // picks up new threads; exited ones fail tgkill until then.
+
+                // the next tick is an interval after the previous one, or after now if sampling fell behind.
+                next = std::max(next + interval_100ns_.load(std::memory_order_relaxed) * 100, monotonic_ns());
+                const timespec due{static_cast<time_t>(next / 1000000000), static_cast<long>(next % 1000000000)};
+                while (::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, nullptr) == EINTR) {}
+                if (stop_.wait_signal(0)) return;
+
+                for (const target& t : targets)
+                    capture(t);
+            }
+        }
+#endif
+    };
+}
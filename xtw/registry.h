@@ -7,21 +7,25 @@
 
 #include <Windows.h>
 #include <combaseapi.h>
+#include <algorithm>
 #include <cstddef>
+#include <iterator>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "./unique_handle.h"
 
 namespace xtw::registry
 {
-    using registry_key_unique_handle = unique_handle_t<HKEY, decltype(&::RegCloseKey)>;
+    using registry_key_unique_handle = unique_handle_for<HKEY, &::RegCloseKey>;
 
     static inline registry_key_unique_handle OpenKey(HKEY parent, const wchar_t* sub_key_name)
     {
         HKEY key{};
-        if (::RegOpenKeyW(parent, sub_key_name, &key) != ERROR_SUCCESS) return {HKEY{}, &::RegCloseKey};
-        return {key, &::RegCloseKey};
+        if (::RegOpenKeyW(parent, sub_key_name, &key) != ERROR_SUCCESS) return registry_key_unique_handle{};
+        return registry_key_unique_handle{key};
     }
 
     static inline std::optional<std::wstring> EnumKeyName(HKEY parent, size_t index)
@@ -60,4 +64,174 @@ namespace xtw::registry
         if (FAILED(::IIDFromString(str->c_str(), &val))) return std::nullopt;
         return std::optional<GUID>(std::in_place, val);
     }
+
+    struct key_info
+    {
+        DWORD sub_key_count;
+        DWORD max_sub_key_name_length;
+        DWORD value_count;
+        DWORD max_value_name_length;
+        DWORD max_value_data_size;
+    };
+
+    static inline std::optional<key_info> QueryKeyInfo(HKEY key)
+    {
+        key_info info{};
+        if (::RegQueryInfoKeyW(key, nullptr, nullptr, nullptr,
+                               &info.sub_key_count, &info.max_sub_key_name_length, nullptr,
+                               &info.value_count, &info.max_value_name_length, &info.max_value_data_size,
+                               nullptr, nullptr) != ERROR_SUCCESS) return std::nullopt;
+        return info;
+    }
+
+    /// Range of sub key names. Sizes are queried once up front and one buffer is reused for all names,
+    /// so the yielded views are valid until the iterator is incremented.
+    class key_name_range final
+    {
+        HKEY key_{};
+        DWORD count_{};
+        std::wstring buffer_{};
+
+    public:
+        explicit key_name_range(HKEY key) : key_(key)
+        {
+            if (auto info = QueryKeyInfo(key))
+            {
+                count_ = info->sub_key_count;
+                buffer_.resize(info->max_sub_key_name_length + 1);
+            }
+        }
+
+        class iterator final
+        {
+            key_name_range* range_{};
+            DWORD index_{};
+            DWORD length_{};
+
+            void fetch()
+            {
+                while (index_ < range_->count_)
+                {
+                    length_ = static_cast<DWORD>(range_->buffer_.size());
+                    LSTATUS s = ::RegEnumKeyExW(range_->key_, index_, range_->buffer_.data(), &length_, nullptr, nullptr, nullptr, nullptr);
+                    if (s == ERROR_SUCCESS) return;
+                    if (s != ERROR_MORE_DATA) break;
+                    range_->buffer_.resize(range_->buffer_.size() * 2); // a longer name was added while enumerating.
+                }
+                index_ = range_->count_; // end
+            }
+
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = std::wstring_view;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const std::wstring_view*;
+            using reference = std::wstring_view;
+
+            iterator() = default;
+            iterator(key_name_range* range, DWORD index) : range_(range), index_(index) { fetch(); }
+
+            std::wstring_view operator*() const noexcept { return std::wstring_view(range_->buffer_.data(), length_); }
+            iterator& operator++() { ++index_, fetch(); return *this; }
+            bool operator==(const iterator& rhs) const noexcept { return index_ == rhs.index_; }
+            bool operator!=(const iterator& rhs) const noexcept { return index_ != rhs.index_; }
+        };
+
+        [[nodiscard]] iterator begin() { return iterator(this, 0); }
+        [[nodiscard]] iterator end() { return iterator(this, count_); }
+        [[nodiscard]] size_t size() const noexcept { return count_; }
+    };
+
+    struct value_entry
+    {
+        std::wstring_view name;
+        DWORD type;
+        const BYTE* data;
+        DWORD size;
+
+        /// REG_SZ / REG_EXPAND_SZ without trailing null characters.
+        [[nodiscard]] std::optional<std::wstring_view> as_string() const noexcept
+        {
+            if (type != REG_SZ && type != REG_EXPAND_SZ) return std::nullopt;
+            auto s = std::wstring_view(reinterpret_cast<const wchar_t*>(data), size / sizeof(wchar_t));
+            while (!s.empty() && s.back() == L'\0') s.remove_suffix(1);
+            return s;
+        }
+    };
+
+    /// Range of values with their data. Buffers are sized once from RegQueryInfoKey and reused,
+    /// so the yielded entries are valid until the iterator is incremented.
+    class value_range final
+    {
+        HKEY key_{};
+        DWORD count_{};
+        std::wstring name_buffer_{};
+        std::vector<BYTE> data_buffer_{};
+
+    public:
+        explicit value_range(HKEY key) : key_(key)
+        {
+            if (auto info = QueryKeyInfo(key))
+            {
+                count_ = info->value_count;
+                name_buffer_.resize(info->max_value_name_length + 1);
+                data_buffer_.resize(std::max<size_t>(info->max_value_data_size, 1)); // never null: RegEnumValueW skips the copy for null data.
+            }
+        }
+
+        class iterator final
+        {
+            value_range* range_{};
+            DWORD index_{};
+            value_entry entry_{};
+
+            void fetch()
+            {
+                while (index_ < range_->count_)
+                {
+                    DWORD name_length = static_cast<DWORD>(range_->name_buffer_.size());
+                    DWORD data_size = static_cast<DWORD>(range_->data_buffer_.size());
+                    DWORD type{};
+                    LSTATUS s = ::RegEnumValueW(range_->key_, index_, range_->name_buffer_.data(), &name_length, nullptr, &type, range_->data_buffer_.data(), &data_size);
+                    if (s == ERROR_SUCCESS)
+                    {
+                        entry_ = value_entry{std::wstring_view(range_->name_buffer_.data(), name_length), type, range_->data_buffer_.data(), data_size};
+                        return;
+                    }
+                    if (s != ERROR_MORE_DATA) break;
+
+                    // a value grew while enumerating.
+                    range_->name_buffer_.resize(range_->name_buffer_.size() * 2);
+                    range_->data_buffer_.resize(std::max<size_t>(range_->data_buffer_.size() * 2, data_size));
+                }
+                index_ = range_->count_; // end
+            }
+
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = value_entry;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const value_entry*;
+            using reference = const value_entry&;
+
+            iterator() = default;
+            iterator(value_range* range, DWORD index) : range_(range), index_(index) { fetch(); }
+
+            const value_entry& operator*() const noexcept { return entry_; }
+            const value_entry* operator->() const noexcept { return &entry_; }
+            iterator& operator++() { ++index_, fetch(); return *this; }
+            bool operator==(const iterator& rhs) const noexcept { return index_ == rhs.index_; }
+            bool operator!=(const iterator& rhs) const noexcept { return index_ != rhs.index_; }
+        };
+
+        [[nodiscard]] iterator begin() { return iterator(this, 0); }
+        [[nodiscard]] iterator end() { return iterator(this, count_); }
+        [[nodiscard]] size_t size() const noexcept { return count_; }
+    };
+
+    /// for (std::wstring_view name : keys(hkey)) { ... }
+    static inline key_name_range keys(HKEY key) { return key_name_range(key); }
+
+    /// for (const value_entry& v : values(hkey)) { ... }
+    static inline value_range values(HKEY key) { return value_range(key); }
 }
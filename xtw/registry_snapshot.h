@@ -0,0 +1,459 @@
+/// @file
+/// @brief  xtw::registry::snapshot
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+#include <combaseapi.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "./registry.h"
+#include "./unique_handle.h"
+
+namespace xtw::registry
+{
+    namespace snapshot_detail
+    {
+        // Image layout. All offsets are relative to the image base, so the image can be used directly from a file mapping.
+        //   header | key_record[key_count] | value_record[value_count] | names (wchar_t) | data (8-byte aligned blobs)
+        // Key 0 is the root. Children of a key are contiguous and sorted by case-insensitive name, and so are values.
+
+        static inline constexpr uint32_t image_magic = 0x53535258; // 'XRSS'
+        static inline constexpr uint32_t image_version = 1;
+
+        struct header
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t key_count;
+            uint32_t value_count;
+            uint64_t keys_offset;
+            uint64_t values_offset;
+            uint64_t names_offset;
+            uint64_t names_length; // in wchar_t
+            uint64_t data_offset;
+            uint64_t data_length;  // in bytes
+            uint64_t image_size;
+        };
+
+        struct key_record
+        {
+            uint32_t name_offset; // in wchar_t, from names_offset
+            uint32_t name_length;
+            uint32_t parent;
+            uint32_t first_child;
+            uint32_t child_count;
+            uint32_t first_value;
+            uint32_t value_count;
+            uint32_t reserved;
+        };
+
+        struct value_record
+        {
+            uint32_t name_offset;
+            uint32_t name_length;
+            uint32_t type;
+            uint32_t data_size;
+            uint64_t data_offset; // from data_offset
+        };
+
+        static inline const header& header_of(const std::byte* image) noexcept { return *reinterpret_cast<const header*>(image); }
+        static inline const key_record* keys_of(const std::byte* image) noexcept { return reinterpret_cast<const key_record*>(image + header_of(image).keys_offset); }
+        static inline const value_record* values_of(const std::byte* image) noexcept { return reinterpret_cast<const value_record*>(image + header_of(image).values_offset); }
+        static inline const BYTE* data_of(const std::byte* image, const value_record& v) noexcept { return reinterpret_cast<const BYTE*>(image + header_of(image).data_offset + v.data_offset); }
+
+        template <class RECORD>
+        static inline std::wstring_view name_of(const std::byte* image, const RECORD& r) noexcept
+        {
+            return std::wstring_view(reinterpret_cast<const wchar_t*>(image + header_of(image).names_offset) + r.name_offset, r.name_length);
+        }
+
+        // registry names are compared case-insensitively.
+        static inline int compare_name(std::wstring_view a, std::wstring_view b) noexcept
+        {
+            // CompareStringOrdinal rejects null strings, which empty views may hold.
+            if (a.empty() || b.empty()) return static_cast<int>(!a.empty()) - static_cast<int>(!b.empty());
+            return ::CompareStringOrdinal(a.data(), static_cast<int>(a.size()), b.data(), static_cast<int>(b.size()), TRUE) - CSTR_EQUAL;
+        }
+
+        // intermediate tree built while walking the live registry.
+        struct walked_value
+        {
+            std::wstring name;
+            DWORD type{};
+            std::vector<BYTE> data;
+        };
+
+        struct walked_key
+        {
+            std::wstring name;
+            std::vector<walked_value> values;
+            std::vector<walked_key> children;
+        };
+
+        static inline void walk(HKEY key, walked_key& node)
+        {
+            for (const value_entry& v : values(key))
+                node.values.push_back(walked_value{std::wstring(v.name), v.type, std::vector<BYTE>(v.data, v.data + v.size)});
+
+            for (std::wstring_view name : keys(key))
+            {
+                auto& c = node.children.emplace_back();
+                c.name.assign(name);
+
+                HKEY child{};
+                if (::RegOpenKeyExW(key, c.name.c_str(), 0, KEY_READ, &child) != ERROR_SUCCESS)
+                {
+                    node.children.pop_back();
+                    continue;
+                }
+
+                auto uh = registry_key_unique_handle{child};
+                walk(uh.get(), c);
+            }
+        }
+
+        static inline std::vector<std::byte> build_image(walked_key& root)
+        {
+            std::vector<key_record> keys;
+            std::vector<value_record> values;
+            std::wstring names;
+            std::vector<std::byte> data;
+            std::unordered_map<std::wstring, uint32_t> interned;
+
+            const auto intern = [&](const std::wstring& name) -> uint32_t
+            {
+                auto [it, inserted] = interned.try_emplace(name, static_cast<uint32_t>(names.size()));
+                if (inserted) names += name;
+                return it->second;
+            };
+
+            const auto less = [](const auto& a, const auto& b) { return compare_name(a.name, b.name) < 0; };
+
+            // breadth first, so that children of each key are laid out contiguously.
+            std::vector<walked_key*> queue{&root};
+            keys.push_back(key_record{intern(root.name), static_cast<uint32_t>(root.name.size()), 0, 0, 0, 0, 0, 0});
+
+            for (size_t i = 0; i < queue.size(); i++)
+            {
+                walked_key& node = *queue[i];
+                std::sort(node.values.begin(), node.values.end(), less);
+                std::sort(node.children.begin(), node.children.end(), less);
+
+                keys[i].first_value = static_cast<uint32_t>(values.size());
+                keys[i].value_count = static_cast<uint32_t>(node.values.size());
+                for (auto& v : node.values)
+                {
+                    data.resize((data.size() + 7) & ~size_t{7});
+                    values.push_back(value_record{intern(v.name), static_cast<uint32_t>(v.name.size()), static_cast<uint32_t>(v.type), static_cast<uint32_t>(v.data.size()), data.size()});
+                    data.insert(data.end(), reinterpret_cast<const std::byte*>(v.data.data()), reinterpret_cast<const std::byte*>(v.data.data() + v.data.size()));
+                    v.data = {};
+                }
+
+                keys[i].first_child = static_cast<uint32_t>(keys.size());
+                keys[i].child_count = static_cast<uint32_t>(node.children.size());
+                for (auto& c : node.children)
+                {
+                    keys.push_back(key_record{intern(c.name), static_cast<uint32_t>(c.name.size()), static_cast<uint32_t>(i), 0, 0, 0, 0, 0});
+                    queue.push_back(&c);
+                }
+            }
+
+            const auto align8 = [](uint64_t x) { return (x + 7) & ~uint64_t{7}; };
+
+            header h{};
+            h.magic = image_magic;
+            h.version = image_version;
+            h.key_count = static_cast<uint32_t>(keys.size());
+            h.value_count = static_cast<uint32_t>(values.size());
+            h.keys_offset = align8(sizeof(header));
+            h.values_offset = align8(h.keys_offset + keys.size() * sizeof(key_record));
+            h.names_offset = align8(h.values_offset + values.size() * sizeof(value_record));
+            h.names_length = names.size();
+            h.data_offset = align8(h.names_offset + names.size() * sizeof(wchar_t));
+            h.data_length = data.size();
+            h.image_size = align8(h.data_offset + data.size());
+
+            std::vector<std::byte> image(static_cast<size_t>(h.image_size));
+            std::memcpy(image.data(), &h, sizeof(h));
+            std::memcpy(image.data() + h.keys_offset, keys.data(), keys.size() * sizeof(key_record));
+            std::memcpy(image.data() + h.values_offset, values.data(), values.size() * sizeof(value_record));
+            std::memcpy(image.data() + h.names_offset, names.data(), names.size() * sizeof(wchar_t));
+            std::memcpy(image.data() + h.data_offset, data.data(), data.size());
+            return image;
+        }
+
+        // offset + count * element_size <= limit, without overflow.
+        static inline bool fits(uint64_t offset, uint64_t count, uint64_t element_size, uint64_t limit) noexcept
+        {
+            return offset <= limit && count <= (limit - offset) / element_size;
+        }
+
+        // checks all offsets and the sibling order once, so that lookups need no bounds checks.
+        static inline bool validate_image(const std::byte* image, size_t size) noexcept
+        {
+            if (size < sizeof(header)) return false;
+
+            header h{};
+            std::memcpy(&h, image, sizeof(h));
+            if (h.magic != image_magic || h.version != image_version || h.image_size > size || h.key_count == 0) return false;
+            if (h.keys_offset % alignof(key_record) || h.values_offset % alignof(value_record) || h.names_offset % alignof(wchar_t)) return false;
+            if (h.keys_offset < sizeof(header)) return false;
+            if (!fits(h.data_offset, h.data_length, 1, h.image_size)) return false;
+            if (!fits(h.names_offset, h.names_length, sizeof(wchar_t), h.data_offset)) return false;
+            if (!fits(h.values_offset, h.value_count, sizeof(value_record), h.names_offset)) return false;
+            if (!fits(h.keys_offset, h.key_count, sizeof(key_record), h.values_offset)) return false;
+
+            auto keys = reinterpret_cast<const key_record*>(image + h.keys_offset);
+            for (uint32_t i = 0; i < h.key_count; i++)
+            {
+                const key_record& k = keys[i];
+                if (!fits(k.name_offset, k.name_length, 1, h.names_length)) return false;
+                if (k.parent >= h.key_count) return false;
+                if (!fits(k.first_child, k.child_count, 1, h.key_count)) return false;
+                if (!fits(k.first_value, k.value_count, 1, h.value_count)) return false;
+            }
+
+            auto values = reinterpret_cast<const value_record*>(image + h.values_offset);
+            for (uint32_t i = 0; i < h.value_count; i++)
+            {
+                const value_record& v = values[i];
+                if (!fits(v.name_offset, v.name_length, 1, h.names_length)) return false;
+                if (!fits(v.data_offset, v.data_size, 1, h.data_length)) return false;
+            }
+
+            // lookups binary-search siblings, so children and values of each key must be strictly ascending by name.
+            const auto names = reinterpret_cast<const wchar_t*>(image + h.names_offset);
+            const auto name = [names](const auto& r) { return std::wstring_view(names + r.name_offset, r.name_length); };
+            for (uint32_t i = 0; i < h.key_count; i++)
+            {
+                const key_record& k = keys[i];
+                for (uint32_t c = 0; c < k.child_count; c++)
+                {
+                    if (keys[k.first_child + c].parent != i) return false;
+                    if (c && compare_name(name(keys[k.first_child + c - 1]), name(keys[k.first_child + c])) >= 0) return false;
+                }
+                for (uint32_t v = 1; v < k.value_count; v++)
+                    if (compare_name(name(values[k.first_value + v - 1]), name(values[k.first_value + v])) >= 0) return false;
+            }
+
+            return true;
+        }
+    }
+
+    /// Immutable in-memory index of a registry subtree.
+    /// Walks the subtree once, then serves lookups without system calls.
+    /// The image is position-independent and can be saved to a file and mapped back on later startups.
+    class snapshot final
+    {
+        std::shared_ptr<const std::byte> image_{};
+        size_t image_size_{};
+
+        explicit snapshot(std::shared_ptr<const std::byte> image, size_t size) : image_(std::move(image)), image_size_(size) {}
+
+    public:
+        class value_view;
+        class key_view;
+
+        snapshot() = default;
+
+        /// Walks the subtree under parent\sub_key_name. Returns nullopt if the key cannot be opened.
+        [[nodiscard]] static std::optional<snapshot> capture(HKEY parent, const wchar_t* sub_key_name)
+        {
+            HKEY key{};
+            if (::RegOpenKeyExW(parent, sub_key_name, 0, KEY_READ, &key) != ERROR_SUCCESS) return std::nullopt;
+            auto uh = registry_key_unique_handle{key};
+
+            snapshot_detail::walked_key root{};
+            snapshot_detail::walk(uh.get(), root);
+            auto image = std::make_shared<std::vector<std::byte>>(snapshot_detail::build_image(root));
+            return snapshot(std::shared_ptr<const std::byte>(image, image->data()), image->size());
+        }
+
+        /// Maps a file written by save(). Returns nullopt if the file is missing or malformed.
+        [[nodiscard]] static std::optional<snapshot> load(const wchar_t* file_path)
+        {
+            auto file = unique_handle(::CreateFileW(file_path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+            if (file.get() == INVALID_HANDLE_VALUE) { (void)file.release(); return std::nullopt; }
+
+            LARGE_INTEGER size{};
+            if (!::GetFileSizeEx(file.get(), &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(snapshot_detail::header))) return std::nullopt;
+            if (static_cast<ULONGLONG>(size.QuadPart) > SIZE_MAX) return std::nullopt;
+
+            auto mapping = unique_handle(::CreateFileMappingW(file.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+            if (!mapping) return std::nullopt;
+
+            auto view = static_cast<const std::byte*>(::MapViewOfFile(mapping.get(), FILE_MAP_READ, 0, 0, 0));
+            if (!view) return std::nullopt;
+
+            auto image = std::shared_ptr<const std::byte>(view, [](const std::byte* p) { ::UnmapViewOfFile(p); });
+            if (!snapshot_detail::validate_image(image.get(), static_cast<size_t>(size.QuadPart))) return std::nullopt;
+            return snapshot(std::move(image), static_cast<size_t>(size.QuadPart));
+        }
+
+        /// Writes the image to a file. Returns false on failure.
+        bool save(const wchar_t* file_path) const
+        {
+            if (!image_) return false;
+
+            auto file = unique_handle(::CreateFileW(file_path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+            if (file.get() == INVALID_HANDLE_VALUE) { (void)file.release(); return false; }
+
+            for (size_t written = 0; written < image_size_;)
+            {
+                DWORD chunk = static_cast<DWORD>(std::min<size_t>(image_size_ - written, 0x40000000));
+                DWORD wrote{};
+                if (!::WriteFile(file.get(), image_.get() + written, chunk, &wrote, nullptr) || wrote == 0) return false;
+                written += wrote;
+            }
+            return true;
+        }
+
+        explicit operator bool() const noexcept { return static_cast<bool>(image_); }
+
+        [[nodiscard]] const std::byte* image() const noexcept { return image_.get(); }
+        [[nodiscard]] size_t image_size() const noexcept { return image_size_; }
+        [[nodiscard]] size_t key_count() const noexcept { return image_ ? snapshot_detail::header_of(image_.get()).key_count : 0; }
+        [[nodiscard]] size_t value_count() const noexcept { return image_ ? snapshot_detail::header_of(image_.get()).value_count : 0; }
+
+        /// Views refer to the image, not to the snapshot object; they stay valid while any snapshot sharing the image is alive.
+        class value_view final
+        {
+            const std::byte* image_{};
+            const snapshot_detail::value_record* record_{};
+
+        public:
+            value_view(const std::byte* image, const snapshot_detail::value_record* r) noexcept : image_(image), record_(r) {}
+
+            [[nodiscard]] std::wstring_view name() const noexcept { return snapshot_detail::name_of(image_, *record_); }
+            [[nodiscard]] DWORD type() const noexcept { return record_->type; }
+            [[nodiscard]] const BYTE* data() const noexcept { return snapshot_detail::data_of(image_, *record_); }
+            [[nodiscard]] size_t size() const noexcept { return record_->data_size; }
+
+            /// REG_SZ / REG_EXPAND_SZ without trailing null characters.
+            [[nodiscard]] std::optional<std::wstring_view> as_string() const noexcept
+            {
+                if (type() != REG_SZ && type() != REG_EXPAND_SZ) return std::nullopt;
+                auto s = std::wstring_view(reinterpret_cast<const wchar_t*>(data()), size() / sizeof(wchar_t));
+                while (!s.empty() && s.back() == L'\0') s.remove_suffix(1);
+                return s;
+            }
+
+            [[nodiscard]] std::optional<DWORD> as_dword() const noexcept
+            {
+                if (type() != REG_DWORD || size() != sizeof(DWORD)) return std::nullopt;
+                DWORD v{};
+                std::memcpy(&v, data(), sizeof(v));
+                return v;
+            }
+
+            [[nodiscard]] std::optional<ULONGLONG> as_qword() const noexcept
+            {
+                if (type() != REG_QWORD || size() != sizeof(ULONGLONG)) return std::nullopt;
+                ULONGLONG v{};
+                std::memcpy(&v, data(), sizeof(v));
+                return v;
+            }
+
+            [[nodiscard]] std::optional<GUID> as_guid() const
+            {
+                auto s = as_string();
+                if (!s) return std::nullopt;
+                GUID val{};
+                if (FAILED(::IIDFromString(std::wstring(*s).c_str(), &val))) return std::nullopt;
+                return val;
+            }
+        };
+
+        class key_view final
+        {
+            const std::byte* image_{};
+            const snapshot_detail::key_record* record_{};
+
+        public:
+            key_view(const std::byte* image, const snapshot_detail::key_record* r) noexcept : image_(image), record_(r) {}
+
+            [[nodiscard]] std::wstring_view name() const noexcept { return snapshot_detail::name_of(image_, *record_); }
+            [[nodiscard]] size_t sub_key_count() const noexcept { return record_->child_count; }
+            [[nodiscard]] size_t value_count() const noexcept { return record_->value_count; }
+            [[nodiscard]] key_view sub_key_at(size_t index) const noexcept { return key_view(image_, snapshot_detail::keys_of(image_) + record_->first_child + index); }
+            [[nodiscard]] value_view value_at(size_t index) const noexcept { return value_view(image_, snapshot_detail::values_of(image_) + record_->first_value + index); }
+
+            [[nodiscard]] std::optional<key_view> parent() const noexcept
+            {
+                if (record_ == snapshot_detail::keys_of(image_)) return std::nullopt;
+                return key_view(image_, snapshot_detail::keys_of(image_) + record_->parent);
+            }
+
+            /// Finds a direct sub key by name. O(log n).
+            [[nodiscard]] std::optional<key_view> sub_key(std::wstring_view name) const noexcept
+            {
+                auto first = snapshot_detail::keys_of(image_) + record_->first_child;
+                auto last = first + record_->child_count;
+                auto it = std::lower_bound(first, last, name, [this](const snapshot_detail::key_record& k, std::wstring_view n) { return snapshot_detail::compare_name(snapshot_detail::name_of(image_, k), n) < 0; });
+                if (it == last || snapshot_detail::compare_name(snapshot_detail::name_of(image_, *it), name) != 0) return std::nullopt;
+                return key_view(image_, it);
+            }
+
+            /// Finds a descendant key by backslash-separated relative path.
+            [[nodiscard]] std::optional<key_view> open(std::wstring_view path) const noexcept
+            {
+                key_view current = *this;
+                while (!path.empty())
+                {
+                    auto sep = path.find(L'\\');
+                    auto name = path.substr(0, sep);
+                    path = sep == std::wstring_view::npos ? std::wstring_view{} : path.substr(sep + 1);
+                    if (name.empty()) continue;
+
+                    auto next = current.sub_key(name);
+                    if (!next) return std::nullopt;
+                    current = *next;
+                }
+                return current;
+            }
+
+            /// Finds a value by name (empty for the default value). O(log n).
+            [[nodiscard]] std::optional<value_view> value(std::wstring_view name) const noexcept
+            {
+                auto first = snapshot_detail::values_of(image_) + record_->first_value;
+                auto last = first + record_->value_count;
+                auto it = std::lower_bound(first, last, name, [this](const snapshot_detail::value_record& v, std::wstring_view n) { return snapshot_detail::compare_name(snapshot_detail::name_of(image_, v), n) < 0; });
+                if (it == last || snapshot_detail::compare_name(snapshot_detail::name_of(image_, *it), name) != 0) return std::nullopt;
+                return value_view(image_, it);
+            }
+        };
+
+        [[nodiscard]] key_view root() const noexcept { return key_view(image_.get(), snapshot_detail::keys_of(image_.get())); }
+        [[nodiscard]] std::optional<key_view> open(std::wstring_view path) const noexcept { return image_ ? root().open(path) : std::nullopt; }
+
+        [[nodiscard]] std::optional<std::wstring> ReadStringValue(std::wstring_view path, std::wstring_view value_name) const
+        {
+            if (auto k = open(path))
+                if (auto v = k->value(value_name))
+                    if (auto s = v->as_string())
+                        return std::optional<std::wstring>(std::in_place, *s);
+            return std::nullopt;
+        }
+
+        [[nodiscard]] std::optional<GUID> ReadGuidValue(std::wstring_view path, std::wstring_view value_name) const
+        {
+            if (auto k = open(path))
+                if (auto v = k->value(value_name))
+                    return v->as_guid();
+            return std::nullopt;
+        }
+    };
+}
@@ -0,0 +1,104 @@
+/// @file
+/// @brief  xtw::registry::WalkSubtreeParallel
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "./registry.h"
+#include "./threading.h"
+
+namespace xtw::registry
+{
+    /// Walks the subtree under parent\sub_key_name on worker threads.
+    /// visitor(std::wstring_view path, HKEY key) is called once for each key, concurrently from several threads.
+    /// path is relative to sub_key_name (empty for the top key). The first exception thrown by the visitor is rethrown after all workers stop.
+    template <class F, std::enable_if_t<std::is_invocable_v<F&, std::wstring_view, HKEY>>* = nullptr>
+    static inline bool WalkSubtreeParallel(HKEY parent, const wchar_t* sub_key_name, F visitor, size_t concurrency = std::thread::hardware_concurrency())
+    {
+        HKEY top{};
+        if (::RegOpenKeyExW(parent, sub_key_name, 0, KEY_READ, &top) != ERROR_SUCCESS) return false;
+        auto uh_top = registry_key_unique_handle{top};
+
+        std::mutex mutex{};
+        std::condition_variable cv{};
+        std::deque<std::wstring> queue{std::wstring()};
+        size_t pending = 1; // queued or being visited
+        std::exception_ptr error{};
+
+        auto worker = [&]
+        {
+            std::unique_lock lock(mutex);
+            while (true)
+            {
+                cv.wait(lock, [&] { return !queue.empty() || pending == 0 || error; });
+                if (queue.empty() || error) return;
+
+                std::wstring path = std::move(queue.front());
+                queue.pop_front();
+                lock.unlock();
+
+                std::vector<std::wstring> children{};
+                try
+                {
+                    HKEY key{};
+                    if (path.empty() || ::RegOpenKeyExW(top, path.c_str(), 0, KEY_READ, &key) == ERROR_SUCCESS)
+                    {
+                        auto uh = registry_key_unique_handle{path.empty() ? HKEY{} : key};
+                        HKEY target = path.empty() ? top : key;
+
+                        visitor(std::wstring_view(path), target);
+
+                        for (std::wstring_view name : keys(target))
+                        {
+                            auto& c = children.emplace_back();
+                            c.reserve(path.size() + 1 + name.size());
+                            if (!path.empty()) (c += path) += L'\\';
+                            c += name;
+                        }
+                    }
+                }
+                catch (...)
+                {
+                    lock.lock();
+                    if (!error) error = std::current_exception();
+                    cv.notify_all();
+                    return;
+                }
+
+                lock.lock();
+                pending += children.size();
+                pending -= 1;
+                for (auto& c : children) queue.push_back(std::move(c));
+                if (!children.empty() || pending == 0) cv.notify_all();
+            }
+        };
+
+        std::vector<threading::thread> threads{};
+        for (size_t i = 1; i < std::max<size_t>(concurrency, 1); i++)
+        {
+            try { threads.emplace_back([&worker] { worker(); }, threading::thread::join_on_destructor); }
+            catch (const std::bad_alloc&) { break; } // continue with fewer workers
+        }
+
+        worker();
+        threads.clear(); // joins
+
+        if (error) std::rethrow_exception(error);
+        return true;
+    }
+}
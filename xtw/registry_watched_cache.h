@@ -0,0 +1,269 @@
+/// @file
+/// @brief  xtw::registry::watched_cache
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "./registry.h"
+#include "./threading.h"
+
+namespace xtw::registry
+{
+    /// Serves registry string values from memory.
+    /// Each key that has a cached value is watched with RegNotifyChangeKeyValue,
+    /// and its values are re-read on one background thread when the key changes.
+    /// Steady-state reads take no locks: a reader compares a version number and looks up its thread-local copy of the table.
+    class watched_cache final
+    {
+        struct value_id
+        {
+            std::wstring sub_key_name;
+            std::wstring value_name;
+        };
+
+        // registry names are compared case-insensitively.
+        struct value_id_less
+        {
+            using is_transparent = void;
+
+            static int compare(std::wstring_view a, std::wstring_view b) noexcept
+            {
+                // CompareStringOrdinal rejects null strings, which empty views may hold.
+                if (a.empty() || b.empty()) return static_cast<int>(!a.empty()) - static_cast<int>(!b.empty());
+                return ::CompareStringOrdinal(a.data(), static_cast<int>(a.size()), b.data(), static_cast<int>(b.size()), TRUE) - CSTR_EQUAL;
+            }
+
+            template <class A, class B>
+            bool operator()(const A& a, const B& b) const noexcept
+            {
+                int c = compare(sub_key_of(a), sub_key_of(b));
+                return c != 0 ? c < 0 : compare(value_of(a), value_of(b)) < 0;
+            }
+
+            static std::wstring_view sub_key_of(const value_id& v) noexcept { return v.sub_key_name; }
+            static std::wstring_view value_of(const value_id& v) noexcept { return v.value_name; }
+            static std::wstring_view sub_key_of(const std::pair<std::wstring_view, std::wstring_view>& v) noexcept { return v.first; }
+            static std::wstring_view value_of(const std::pair<std::wstring_view, std::wstring_view>& v) noexcept { return v.second; }
+        };
+
+        using value_table = std::map<value_id, std::optional<std::wstring>, value_id_less>;
+
+        struct watched_key
+        {
+            std::wstring sub_key_name;
+            registry_key_unique_handle key;
+            threading::auto_reset_event changed{};
+        };
+
+        // one watch slot is used by wake_.
+        static inline constexpr size_t max_watched_keys = MAXIMUM_WAIT_OBJECTS - 1;
+
+        static inline std::atomic<uint64_t> instance_counter_{};
+
+        const HKEY root_;
+        const uint64_t instance_id_ = ++instance_counter_;
+
+        std::mutex mutex_{};
+        std::shared_ptr<const value_table> table_ = std::make_shared<value_table>(); // guarded by mutex_
+        std::vector<std::unique_ptr<watched_key>> keys_{};                         // guarded by mutex_
+        std::atomic<uint64_t> version_{1};
+
+        threading::auto_reset_event wake_{};
+        std::atomic_bool stop_{};
+        threading::thread worker_{};
+
+        struct thread_local_table
+        {
+            uint64_t instance_id{};
+            uint64_t version{};
+            std::shared_ptr<const value_table> table{};
+        };
+
+        // a few slots per thread, so that a thread reading from several caches keeps a table for each.
+        static inline constexpr size_t thread_local_slots = 4;
+
+        thread_local_table& local_table() const noexcept
+        {
+            static thread_local std::array<thread_local_table, thread_local_slots> slots{};
+            static thread_local size_t next_victim{};
+
+            for (auto& t : slots)
+                if (t.instance_id == instance_id_)
+                    return t;
+
+            auto& t = slots[next_victim++ % thread_local_slots];
+            t = thread_local_table{};
+            return t;
+        }
+
+    public:
+        explicit watched_cache(HKEY root, const wchar_t* thread_name = L"xtw::registry::watched_cache")
+            : root_(root)
+        {
+            worker_ = threading::thread([this] { this->worker_main(); }, 65536, THREAD_PRIORITY_NORMAL, thread_name);
+        }
+
+        watched_cache(const watched_cache& other) = delete;
+        watched_cache(watched_cache&& other) noexcept = delete;
+        watched_cache& operator=(const watched_cache& other) = delete;
+        watched_cache& operator=(watched_cache&& other) noexcept = delete;
+
+        ~watched_cache()
+        {
+            stop_.store(true);
+            wake_.notify_signal();
+            worker_.join();
+        }
+
+        /// Reads a REG_SZ/REG_EXPAND_SZ value of root\sub_key_name.
+        /// The first read of a value goes to the registry; later reads are served from memory until the key changes.
+        [[nodiscard]] std::optional<std::wstring> ReadStringValue(std::wstring_view sub_key_name, std::wstring_view value_name)
+        {
+            // fast path
+            auto& local = local_table();
+            if (local.instance_id != instance_id_ || local.version != version_.load(std::memory_order_acquire))
+            {
+                std::lock_guard lock(mutex_);
+                local.instance_id = instance_id_;
+                local.version = version_.load(std::memory_order_relaxed);
+                local.table = table_;
+            }
+
+            if (auto it = local.table->find(std::pair(sub_key_name, value_name)); it != local.table->end())
+                return it->second;
+
+            return read_and_watch(sub_key_name, value_name);
+        }
+
+        [[nodiscard]] size_t watched_key_count()
+        {
+            std::lock_guard lock(mutex_);
+            return keys_.size();
+        }
+
+    private:
+        std::optional<std::wstring> read_and_watch(std::wstring_view sub_key_name, std::wstring_view value_name)
+        {
+            std::lock_guard lock(mutex_);
+
+            if (auto it = table_->find(std::pair(sub_key_name, value_name)); it != table_->end())
+                return it->second;
+
+            watched_key* watched = nullptr;
+            for (auto& k : keys_)
+                if (value_id_less::compare(k->sub_key_name, sub_key_name) == 0)
+                    watched = k.get();
+
+            if (!watched)
+            {
+                auto sub_key = std::wstring(sub_key_name);
+                HKEY key{};
+                if (::RegOpenKeyExW(root_, sub_key.c_str(), 0, KEY_READ, &key) != ERROR_SUCCESS)
+                    return std::nullopt; // missing keys cannot be watched; not cached.
+
+                auto uh = registry_key_unique_handle{key};
+                if (keys_.size() >= max_watched_keys)
+                    return registry::ReadStringValue(uh.get(), std::wstring(value_name).c_str()); // no watch slot left; read through.
+
+                auto w = std::make_unique<watched_key>(watched_key{std::move(sub_key), std::move(uh)});
+                if (!arm(*w))
+                    return registry::ReadStringValue(w->key.get(), std::wstring(value_name).c_str());
+
+                watched = keys_.emplace_back(std::move(w)).get();
+                wake_.notify_signal(); // let the worker wait on the new key.
+            }
+
+            // the watch is armed before reading, so a change after this read is never missed.
+            auto value = registry::ReadStringValue(watched->key.get(), std::wstring(value_name).c_str());
+
+            auto table = std::make_shared<value_table>(*table_);
+            table->insert_or_assign(value_id{watched->sub_key_name, std::wstring(value_name)}, value);
+            publish(std::move(table));
+            return value;
+        }
+
+        static bool arm(watched_key& w) noexcept
+        {
+            constexpr DWORD filter = REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET | REG_NOTIFY_THREAD_AGNOSTIC;
+            return ::RegNotifyChangeKeyValue(w.key.get(), FALSE, filter, w.changed.handle(), TRUE) == ERROR_SUCCESS;
+        }
+
+        // requires mutex_
+        void publish(std::shared_ptr<const value_table> table) noexcept
+        {
+            table_ = std::move(table);
+            version_.fetch_add(1, std::memory_order_release);
+        }
+
+        // re-reads all cached values of the key. requires mutex_
+        void refresh(watched_key& w)
+        {
+            auto table = std::make_shared<value_table>(*table_);
+            auto first = table->lower_bound(std::pair(std::wstring_view(w.sub_key_name), std::wstring_view()));
+            auto last = first;
+            while (last != table->end() && value_id_less::compare(last->first.sub_key_name, w.sub_key_name) == 0) ++last;
+
+            if (!arm(w))
+            {
+                // the key was deleted (ERROR_KEY_DELETED) or cannot be watched any more. A key recreated at the same path
+                // never notifies through this handle, so drop the watch and its values; the next read reopens the key by path.
+                table->erase(first, last);
+                keys_.erase(std::find_if(keys_.begin(), keys_.end(), [&](auto& k) { return k.get() == &w; }));
+                publish(std::move(table));
+                return;
+            }
+
+            for (auto it = first; it != last; ++it)
+                it->second = registry::ReadStringValue(w.key.get(), it->first.value_name.c_str());
+            publish(std::move(table));
+        }
+
+        void worker_main()
+        {
+            std::vector<HANDLE> handles{};
+            std::vector<watched_key*> targets{};
+
+            while (!stop_.load())
+            {
+                handles.assign(1, wake_.handle());
+                targets.assign(1, nullptr);
+                {
+                    std::lock_guard lock(mutex_);
+                    for (auto& k : keys_)
+                    {
+                        handles.push_back(k->changed.handle());
+                        targets.push_back(k.get());
+                    }
+                }
+
+                DWORD result = ::WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), FALSE, INFINITE);
+                if (result > WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + handles.size())
+                {
+                    // targets stay valid here: only this thread removes keys, in refresh().
+                    std::lock_guard lock(mutex_);
+                    refresh(*targets[result - WAIT_OBJECT_0]);
+                }
+                else if (result == WAIT_FAILED)
+                {
+                    ::Sleep(1); // avoid spinning on a broken handle
+                }
+            }
+        }
+    };
+}
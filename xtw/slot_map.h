@@ -0,0 +1,343 @@
+/// @file
+/// @brief  xtw::slot_map
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace xtw
+{
+    /// Bit layout of slot_map ids: generation in the high bits, slot index in the low bits.
+    template <class Id>
+    struct slot_id_layout;
+
+    template <>
+    struct slot_id_layout<uint32_t>
+    {
+        static inline constexpr uint32_t index_bits = 20; // 1M slots
+        static inline constexpr uint32_t generation_bits = 12;
+    };
+
+    template <>
+    struct slot_id_layout<uint64_t>
+    {
+        static inline constexpr uint32_t index_bits = 32;
+        static inline constexpr uint32_t generation_bits = 32;
+    };
+
+    /// Table of values addressed by generational ids.
+    /// Values live in one dense array (erase moves the last value into the hole), so iteration is a linear scan.
+    /// Ids stay valid until their value is erased; a stale id is detected by its generation and finds nothing.
+    /// Insert, erase and lookup are O(1). Ids are never 0.
+    template <class T, class Id = uint32_t>
+    class slot_map final
+    {
+        static_assert(std::is_same_v<Id, uint32_t> || std::is_same_v<Id, uint64_t>, "Id must be uint32_t or uint64_t.");
+
+    public:
+        using id_type = Id;
+        using value_type = T;
+        using layout = slot_id_layout<Id>;
+
+        static inline constexpr uint32_t max_index = static_cast<uint32_t>((uint64_t{1} << layout::index_bits) - 1);
+        static inline constexpr uint32_t max_generation = static_cast<uint32_t>((uint64_t{1} << layout::generation_bits) - 1);
+        static inline constexpr uint32_t no_slot = std::numeric_limits<uint32_t>::max();
+
+        [[nodiscard]] static constexpr Id make_id(uint32_t index, uint32_t generation) noexcept { return static_cast<Id>(static_cast<Id>(generation) << layout::index_bits | index); }
+        [[nodiscard]] static constexpr uint32_t index_of(Id id) noexcept { return static_cast<uint32_t>(id & max_index); }
+        [[nodiscard]] static constexpr uint32_t generation_of(Id id) noexcept { return static_cast<uint32_t>(id >> layout::index_bits); }
+
+    private:
+        struct slot
+        {
+            uint32_t dense_or_next; // live: index into values_; free: next free slot
+            uint32_t generation;    // starts at 1, incremented on erase
+            bool live;
+        };
+
+        std::vector<T> values_{};
+        std::vector<uint32_t> dense_slots_{}; // slot index of each value
+        std::vector<slot> slots_{};
+        uint32_t free_head_ = no_slot;
+        size_t max_slots_{};
+
+    public:
+        /// max_slots limits the number of slots (at most max_index + 1).
+        explicit slot_map(size_t max_slots = size_t{max_index} + 1) noexcept
+            : max_slots_(max_slots < size_t{max_index} + 1 ? max_slots : size_t{max_index} + 1) {}
+
+        slot_map(const slot_map& other) = default;
+        slot_map(slot_map&& other) noexcept = default;
+        slot_map& operator=(const slot_map& other) = default;
+        slot_map& operator=(slot_map&& other) noexcept = default;
+        ~slot_map() = default;
+
+        [[nodiscard]] size_t size() const noexcept { return values_.size(); }
+        [[nodiscard]] bool empty() const noexcept { return values_.empty(); }
+
+        void reserve(size_t count)
+        {
+            values_.reserve(count);
+            dense_slots_.reserve(count);
+            slots_.reserve(count);
+        }
+
+        /// Inserts a value. Throws std::length_error when no slot is left.
+        template <class... Args>
+        Id emplace(Args&&... args)
+        {
+            const bool fresh = free_head_ == no_slot;
+            if (fresh)
+            {
+                if (slots_.size() >= max_slots_) throw std::length_error("slot_map is full");
+                slots_.push_back(slot{0, 1, false});
+            }
+
+            const uint32_t index = fresh ? static_cast<uint32_t>(slots_.size() - 1) : free_head_;
+            try
+            {
+                values_.emplace_back(std::forward<Args>(args)...);
+                try { dense_slots_.push_back(index); }
+                catch (...)
+                {
+                    values_.pop_back();
+                    throw;
+                }
+            }
+            catch (...)
+            {
+                if (fresh) slots_.pop_back();
+                throw;
+            }
+
+            slot& s = slots_[index];
+            if (!fresh) free_head_ = s.dense_or_next;
+            s.dense_or_next = static_cast<uint32_t>(values_.size() - 1);
+            s.live = true;
+            return make_id(index, s.generation);
+        }
+
+        Id insert(T value) { return emplace(std::move(value)); }
+
+        [[nodiscard]] T* find(Id id) noexcept
+        {
+            const slot* s = live_slot(id);
+            return s ? &values_[s->dense_or_next] : nullptr;
+        }
+
+        [[nodiscard]] const T* find(Id id) const noexcept
+        {
+            const slot* s = live_slot(id);
+            return s ? &values_[s->dense_or_next] : nullptr;
+        }
+
+        [[nodiscard]] bool contains(Id id) const noexcept { return live_slot(id) != nullptr; }
+
+        /// Erases the value of id. Returns false for stale or unknown ids.
+        bool erase(Id id)
+        {
+            const slot* found = live_slot(id);
+            if (!found) return false;
+
+            const uint32_t index = index_of(id);
+            const uint32_t dense = found->dense_or_next;
+            const uint32_t last = static_cast<uint32_t>(values_.size() - 1);
+            if (dense != last)
+            {
+                values_[dense] = std::move(values_[last]);
+                dense_slots_[dense] = dense_slots_[last];
+                slots_[dense_slots_[dense]].dense_or_next = dense;
+            }
+            values_.pop_back();
+            dense_slots_.pop_back();
+            release_slot(index);
+            return true;
+        }
+
+        void clear() noexcept
+        {
+            for (uint32_t index : dense_slots_)
+                release_slot(index);
+            values_.clear();
+            dense_slots_.clear();
+        }
+
+        // dense iteration. order changes on erase.
+        [[nodiscard]] T* begin() noexcept { return values_.data(); }
+        [[nodiscard]] T* end() noexcept { return values_.data() + values_.size(); }
+        [[nodiscard]] const T* begin() const noexcept { return values_.data(); }
+        [[nodiscard]] const T* end() const noexcept { return values_.data() + values_.size(); }
+
+        /// Id of the value at position i of the dense array.
+        [[nodiscard]] Id id_at(size_t i) const noexcept
+        {
+            const uint32_t index = dense_slots_[i];
+            return make_id(index, slots_[index].generation);
+        }
+
+    private:
+        [[nodiscard]] const slot* live_slot(Id id) const noexcept
+        {
+            const uint32_t index = index_of(id);
+            if (index >= slots_.size()) return nullptr;
+            const slot& s = slots_[index];
+            return s.live && s.generation == generation_of(id) ? &s : nullptr;
+        }
+
+        void release_slot(uint32_t index) noexcept
+        {
+            slot& s = slots_[index];
+            s.live = false;
+
+            // a slot whose generation is exhausted is retired, so that old ids can never match again.
+            if (s.generation == max_generation) return;
+
+            s.generation++;
+            s.dense_or_next = free_head_;
+            free_head_ = index;
+        }
+    };
+
+    /// Thread-safe slot_map split into Shards independently locked shards.
+    /// The shard is encoded in the low bits of the slot index, so any id finds its shard without a lookup.
+    /// Values are accessed under the shard lock through visit (shared) and update (exclusive).
+    template <class T, class Id = uint64_t, size_t Shards = 16>
+    class sharded_slot_map final
+    {
+        static_assert(Shards != 0 && (Shards & (Shards - 1)) == 0, "Shards must be a power of two.");
+
+    public:
+        using id_type = Id;
+        using value_type = T;
+        using map_type = slot_map<T, Id>;
+
+    private:
+        static inline constexpr uint32_t shard_bits = []
+        {
+            uint32_t n = 0;
+            while ((size_t{1} << n) < Shards) n++;
+            return n;
+        }();
+
+        static_assert(shard_bits < map_type::layout::index_bits, "too many shards for the id layout.");
+
+        struct alignas(64) shard
+        {
+            mutable std::shared_mutex mutex{};
+            map_type map{(size_t{map_type::max_index} + 1) >> shard_bits};
+        };
+
+        shard shards_[Shards]{};
+        std::atomic<size_t> next_shard_{};
+
+        static Id to_global(Id local, size_t shard_index) noexcept
+        {
+            return map_type::make_id(map_type::index_of(local) << shard_bits | static_cast<uint32_t>(shard_index), map_type::generation_of(local));
+        }
+
+        static Id to_local(Id global) noexcept
+        {
+            return map_type::make_id(map_type::index_of(global) >> shard_bits, map_type::generation_of(global));
+        }
+
+        shard& shard_of(Id id) noexcept { return shards_[map_type::index_of(id) & (Shards - 1)]; }
+        const shard& shard_of(Id id) const noexcept { return shards_[map_type::index_of(id) & (Shards - 1)]; }
+
+    public:
+        sharded_slot_map() = default;
+        sharded_slot_map(const sharded_slot_map& other) = delete;
+        sharded_slot_map(sharded_slot_map&& other) noexcept = delete;
+        sharded_slot_map& operator=(const sharded_slot_map& other) = delete;
+        sharded_slot_map& operator=(sharded_slot_map&& other) noexcept = delete;
+        ~sharded_slot_map() = default;
+
+        /// Inserts a value into the next shard in round-robin order.
+        template <class... Args>
+        Id emplace(Args&&... args)
+        {
+            const size_t index = next_shard_.fetch_add(1, std::memory_order_relaxed) & (Shards - 1);
+            shard& s = shards_[index];
+            std::unique_lock lock(s.mutex);
+            return to_global(s.map.emplace(std::forward<Args>(args)...), index);
+        }
+
+        Id insert(T value) { return emplace(std::move(value)); }
+
+        bool erase(Id id)
+        {
+            shard& s = shard_of(id);
+            std::unique_lock lock(s.mutex);
+            return s.map.erase(to_local(id));
+        }
+
+        [[nodiscard]] bool contains(Id id) const
+        {
+            const shard& s = shard_of(id);
+            std::shared_lock lock(s.mutex);
+            return s.map.contains(to_local(id));
+        }
+
+        /// Calls f(const T&) under the shared lock. Returns false for stale or unknown ids.
+        template <class F>
+        bool visit(Id id, F&& f) const
+        {
+            const shard& s = shard_of(id);
+            std::shared_lock lock(s.mutex);
+            const T* value = s.map.find(to_local(id));
+            if (!value) return false;
+            f(*value);
+            return true;
+        }
+
+        /// Calls f(T&) under the exclusive lock. Returns false for stale or unknown ids.
+        template <class F>
+        bool update(Id id, F&& f)
+        {
+            shard& s = shard_of(id);
+            std::unique_lock lock(s.mutex);
+            T* value = s.map.find(to_local(id));
+            if (!value) return false;
+            f(*value);
+            return true;
+        }
+
+        /// Calls f(Id, const T&) for every value, one shard at a time under its shared lock.
+        template <class F>
+        void for_each(F&& f) const
+        {
+            for (size_t i = 0; i < Shards; i++)
+            {
+                const shard& s = shards_[i];
+                std::shared_lock lock(s.mutex);
+                const T* values = s.map.begin();
+                for (size_t j = 0; j < s.map.size(); j++)
+                    f(to_global(s.map.id_at(j), i), values[j]);
+            }
+        }
+
+        /// Sum of shard sizes; approximate while other threads insert or erase.
+        [[nodiscard]] size_t size() const
+        {
+            size_t n = 0;
+            for (const shard& s : shards_)
+            {
+                std::shared_lock lock(s.mutex);
+                n += s.map.size();
+            }
+            return n;
+        }
+    };
+}
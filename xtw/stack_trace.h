@@ -0,0 +1,154 @@
+/// @file
+/// @brief  xtw::debug::stack_trace
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#if !defined(_WIN32)
+#include <execinfo.h>
+#endif
+
+#include "./debug_symbols.h"
+#include "./win32_exception.h"
+
+namespace xtw::debug
+{
+    /// Raw return addresses of the calling thread.
+    /// Capturing is a single RtlCaptureStackBackTrace call (backtrace(3) off Windows) into a fixed array (no symbol lookup);
+    /// names are resolved only when the trace is printed, through symbol_cache.
+    class stack_trace final
+    {
+    public:
+        static inline constexpr size_t max_frames = 62;
+
+    private:
+        void* frames_[max_frames]{};
+        uint32_t size_{};
+        uint32_t hash_{};
+
+    public:
+        stack_trace() = default;
+
+        /// Captures the caller's stack. skip_frames omits that many innermost frames above the caller.
+        [[nodiscard]] static __declspec(noinline) stack_trace capture(uint32_t skip_frames = 0) noexcept
+        {
+            stack_trace t{};
+#if defined(_WIN32)
+            DWORD hash{};
+            t.size_ = ::RtlCaptureStackBackTrace(skip_frames + 1, static_cast<DWORD>(max_frames), t.frames_, &hash);
+            t.hash_ = hash;
+#else
+            // the unwinder walks the frames itself; the first call loads it (libgcc_s), later ones do not allocate.
+            const int count = ::backtrace(t.frames_, static_cast<int>(max_frames));
+            const uint32_t skip = count > 0 ? std::min(skip_frames + 1, static_cast<uint32_t>(count)) : 0;
+            t.size_ = count > 0 ? static_cast<uint32_t>(count) - skip : 0;
+            for (uint32_t i = 0; i < t.size_; i++) t.frames_[i] = t.frames_[i + skip];
+            t.hash_ = hash_of(t.frames_, t.size_);
+#endif
+            return t;
+        }
+
+        [[nodiscard]] size_t size() const noexcept { return size_; }
+        [[nodiscard]] bool empty() const noexcept { return size_ == 0; }
+        [[nodiscard]] void* operator[](size_t i) const noexcept { return frames_[i]; }
+        [[nodiscard]] void* const* begin() const noexcept { return frames_; }
+        [[nodiscard]] void* const* end() const noexcept { return frames_ + size_; }
+
+        /// Captures the stack starting at call_site, a return address into the frame that should come first
+        /// (typically _ReturnAddress() of a noinline function called by user code).
+        /// Library frames above it are dropped no matter which of them were inlined. If call_site is not found, the whole stack is kept.
+        [[nodiscard]] static __declspec(noinline) stack_trace capture_from(const void* call_site) noexcept
+        {
+            stack_trace t = capture();
+            for (uint32_t i = 0; i < t.size_; i++)
+            {
+                if (t.frames_[i] != call_site) continue;
+                for (uint32_t j = i; j < t.size_; j++) t.frames_[j - i] = t.frames_[j];
+                t.size_ -= i;
+                t.hash_ = hash_of(t.frames_, t.size_);
+                break;
+            }
+            return t;
+        }
+
+        /// The frames a win32_exception recorded at its throw site; empty unless capture_on_throw was enabled then.
+        [[nodiscard]] static stack_trace of(const win32_exception& e) noexcept
+        {
+            stack_trace t{};
+            t.size_ = static_cast<uint32_t>(std::min(e.frame_count(), max_frames));
+            for (uint32_t i = 0; i < t.size_; i++) t.frames_[i] = e.frames()[i];
+            t.hash_ = hash_of(t.frames_, t.size_);
+            return t;
+        }
+
+        /// Makes XTW_THROW_ON_FAILURE (and every win32_exception given a call site) record the stack from its call site.
+        /// Off by default: a failure then costs only the exception itself.
+        static void capture_on_throw(bool enable) noexcept
+        {
+            win32_exception::set_stack_capture(enable ? &capture_into : nullptr);
+        }
+
+        /// Hash of the frames as computed by RtlCaptureStackBackTrace; equal traces have equal hashes.
+        [[nodiscard]] uint32_t hash() const noexcept { return hash_; }
+
+        /// One "#n function+0xdisp (file:line) [module]" line per frame, innermost first.
+        [[nodiscard]] std::string to_string() const
+        {
+            auto& symbols = symbol_cache::instance();
+            std::string result{};
+            char buf[16];
+            for (uint32_t i = 0; i < size_; i++)
+            {
+                std::snprintf(buf, sizeof(buf), "#%u ", i);
+                result += buf;
+                // return addresses point after the call; look up the call itself.
+                result += symbols.describe(static_cast<const char*>(frames_[i]) - 1);
+                result += '\n';
+            }
+            return result;
+        }
+
+        /// One "#n module+0xoffset" line per frame, innermost first. Symbols are not loaded (see symbol_cache::module_offset_of),
+        /// so this is cheap enough for logging paths; the offsets resolve later against the module's PDB.
+        [[nodiscard]] std::string to_raw_string() const
+        {
+            std::string result{};
+            char buf[16];
+            for (uint32_t i = 0; i < size_; i++)
+            {
+                std::snprintf(buf, sizeof(buf), "#%u ", i);
+                result += buf;
+                result += symbol_cache::module_offset_of(frames_[i]);
+                result += '\n';
+            }
+            return result;
+        }
+
+    private:
+        // win32_exception's stack_capture_function.
+        static __declspec(noinline) uint32_t capture_into(const void* call_site, void** frames, uint32_t capacity) noexcept
+        {
+            const stack_trace t = capture_from(call_site);
+            const uint32_t count = std::min(t.size_, capacity);
+            for (uint32_t i = 0; i < count; i++) frames[i] = t.frames_[i];
+            return count;
+        }
+
+        // RtlCaptureStackBackTrace's hash: the sum of the frame addresses.
+        static uint32_t hash_of(void* const* frames, uint32_t size) noexcept
+        {
+            uintptr_t sum = 0;
+            for (uint32_t i = 0; i < size; i++) sum += reinterpret_cast<uintptr_t>(frames[i]);
+            return static_cast<uint32_t>(sum);
+        }
+    };
+}
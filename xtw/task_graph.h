@@ -0,0 +1,342 @@
+/// @file
+/// @brief  xtw::threading::task_graph
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./parallel.h"
+
+namespace xtw::threading
+{
+    /// Directed acyclic graph of tasks, declared once and run repeatedly on a worker_set.
+    ///
+    /// A node becomes ready when all of its predecessors have completed and is dispatched to the next free participant.
+    /// Among ready nodes, the one with the longest remaining path (sum of costs to a sink) runs first, so the critical
+    /// path is not delayed by side branches. After the first run, runs do not allocate; each run records per-node timings.
+    class task_graph final
+    {
+    public:
+        using node_id = uint32_t;
+
+        struct node_timing
+        {
+            node_id node;
+            size_t participant; // worker_set participant index that ran the node
+            int64_t start;      // QueryPerformanceCounter ticks
+            int64_t end;
+        };
+
+    private:
+        struct node
+        {
+            std::string name;
+            std::function<void()> work;
+            int64_t cost;
+            int64_t priority;     // cost of the longest path from this node to a sink
+            uint32_t predecessor_count;
+            uint32_t first_successor; // into successors_
+            uint32_t successor_count;
+        };
+
+        std::vector<node> nodes_{};
+        std::vector<std::pair<node_id, node_id>> edges_{};
+        bool prepared_{};
+
+        // built by prepare()
+        std::vector<node_id> successors_{};
+        std::vector<node_id> roots_{};
+        std::unique_ptr<std::atomic<uint32_t>[]> pending_{};
+
+        // run state
+        std::mutex ready_mutex_{};
+        std::vector<node_id> ready_{}; // heap ordered by priority
+        std::atomic<uint32_t> signal_{};
+        std::atomic<uint32_t> completed_{};
+        std::atomic_bool aborted_{};
+        std::exception_ptr error_{};
+        std::vector<node_timing> timings_{};
+
+    public:
+        task_graph() = default;
+        task_graph(const task_graph& other) = delete;
+        task_graph(task_graph&& other) noexcept = delete;
+        task_graph& operator=(const task_graph& other) = delete;
+        task_graph& operator=(task_graph&& other) noexcept = delete;
+        ~task_graph() = default;
+
+        /// Adds a node. cost is the expected relative run time, used for critical-path priorities.
+        node_id add_node(std::string name, std::function<void()> work, int64_t cost = 1)
+        {
+            nodes_.push_back(node{std::move(name), std::move(work), cost, 0, 0, 0, 0});
+            prepared_ = false;
+            return static_cast<node_id>(nodes_.size() - 1);
+        }
+
+        /// Makes `to` wait for `from`.
+        void add_edge(node_id from, node_id to)
+        {
+            if (from >= nodes_.size() || to >= nodes_.size() || from == to) throw std::invalid_argument("invalid edge");
+            edges_.emplace_back(from, to);
+            prepared_ = false;
+        }
+
+        [[nodiscard]] size_t size() const noexcept { return nodes_.size(); }
+        [[nodiscard]] const std::string& name(node_id id) const { return nodes_.at(id).name; }
+        [[nodiscard]] int64_t priority(node_id id) { prepare(); return nodes_.at(id).priority; }
+
+        /// Builds the schedule. Called by run(); throws std::logic_error if the graph has a cycle.
+        void prepare()
+        {
+            if (prepared_) return;
+
+            const size_t n = nodes_.size();
+            for (auto& v : nodes_)
+            {
+                v.predecessor_count = 0;
+                v.successor_count = 0;
+            }
+
+            for (auto& [from, to] : edges_)
+            {
+                nodes_[from].successor_count++;
+                nodes_[to].predecessor_count++;
+            }
+
+            uint32_t offset = 0;
+            for (auto& v : nodes_)
+            {
+                v.first_successor = offset;
+                offset += v.successor_count;
+            }
+
+            successors_.assign(edges_.size(), 0);
+            std::vector<uint32_t> filled(n);
+            for (auto& [from, to] : edges_)
+                successors_[nodes_[from].first_successor + filled[from]++] = to;
+
+            // topological order (Kahn), then priorities in reverse order.
+            std::vector<node_id> order{};
+            order.reserve(n);
+            std::vector<uint32_t> remaining(n);
+            roots_.clear();
+            for (node_id i = 0; i < n; i++)
+            {
+                remaining[i] = nodes_[i].predecessor_count;
+                if (remaining[i] == 0)
+                {
+                    order.push_back(i);
+                    roots_.push_back(i);
+                }
+            }
+
+            for (size_t k = 0; k < order.size(); k++)
+                for (node_id s : successors_of(order[k]))
+                    if (--remaining[s] == 0) order.push_back(s);
+
+            if (order.size() != n) throw std::logic_error("task_graph has a cycle");
+
+            for (size_t k = n; k-- > 0;)
+            {
+                node& v = nodes_[order[k]];
+                int64_t longest = 0;
+                for (node_id s : successors_of(order[k]))
+                    longest = std::max(longest, nodes_[s].priority);
+                v.priority = v.cost + longest;
+            }
+
+            pending_ = std::make_unique<std::atomic<uint32_t>[]>(n);
+            ready_.clear();
+            ready_.reserve(n);
+            timings_.assign(n, node_timing{});
+            prepared_ = true;
+        }
+
+        /// Runs every node once. The first exception thrown by a node stops dispatching and is rethrown.
+        void run(worker_set& workers = worker_set::shared())
+        {
+            prepare();
+            if (nodes_.empty()) return;
+
+            for (size_t i = 0; i < nodes_.size(); i++)
+                pending_[i].store(nodes_[i].predecessor_count, std::memory_order_relaxed);
+
+            for (node_id i = 0; i < nodes_.size(); i++)
+                timings_[i] = node_timing{i, 0, 0, 0};
+
+            ready_.clear();
+            for (node_id r : roots_) push_ready(r);
+            completed_.store(0, std::memory_order_relaxed);
+            aborted_.store(false, std::memory_order_relaxed);
+            error_ = nullptr;
+
+            workers.execute([this](size_t participant) { this->participate(participant); });
+
+            if (error_) std::rethrow_exception(error_);
+        }
+
+        /// Timings of the last run, indexed by node id. Nodes the last run did not reach (after an exception) have zero start and end.
+        [[nodiscard]] const std::vector<node_timing>& timings() const noexcept { return timings_; }
+
+        /// Timings of the last run in Chrome trace event format (chrome://tracing, Perfetto).
+        [[nodiscard]] std::string export_trace_json() const
+        {
+            LARGE_INTEGER f{};
+            ::QueryPerformanceFrequency(&f);
+            const double us_per_tick = 1e6 / static_cast<double>(f.QuadPart);
+
+            int64_t origin = INT64_MAX;
+            for (auto& t : timings_)
+                if (t.end) origin = std::min(origin, t.start);
+
+            std::string json = "{\"traceEvents\":[";
+            char buf[128];
+            bool first = true;
+            for (const node_timing& t : timings_)
+            {
+                if (!t.end) continue; // not run
+                if (!std::exchange(first, false)) json += ',';
+                json += "{\"name\":\"";
+                append_escaped(json, nodes_[t.node].name);
+                std::snprintf(buf, sizeof(buf), "\",\"ph\":\"X\",\"pid\":0,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}",
+                              t.participant, static_cast<double>(t.start - origin) * us_per_tick, static_cast<double>(t.end - t.start) * us_per_tick);
+                json += buf;
+            }
+            json += "]}";
+            return json;
+        }
+
+    private:
+        struct successor_range
+        {
+            const node_id* first;
+            const node_id* last;
+            [[nodiscard]] const node_id* begin() const noexcept { return first; }
+            [[nodiscard]] const node_id* end() const noexcept { return last; }
+        };
+
+        [[nodiscard]] successor_range successors_of(node_id id) const noexcept
+        {
+            const node_id* p = successors_.data() + nodes_[id].first_successor;
+            return {p, p + nodes_[id].successor_count};
+        }
+
+        bool higher_first(node_id a, node_id b) const noexcept { return nodes_[a].priority < nodes_[b].priority; }
+
+        void push_ready(node_id id)
+        {
+            std::lock_guard lock(ready_mutex_);
+            ready_.push_back(id); // capacity reserved in prepare()
+            std::push_heap(ready_.begin(), ready_.end(), [this](node_id a, node_id b) { return higher_first(a, b); });
+        }
+
+        bool pop_ready(node_id& id)
+        {
+            std::lock_guard lock(ready_mutex_);
+            if (ready_.empty()) return false;
+            std::pop_heap(ready_.begin(), ready_.end(), [this](node_id a, node_id b) { return higher_first(a, b); });
+            id = ready_.back();
+            ready_.pop_back();
+            return true;
+        }
+
+        void notify()
+        {
+            signal_.fetch_add(1, std::memory_order_release);
+            parallel_detail::wake_all(signal_);
+        }
+
+        void participate(size_t participant)
+        {
+            const uint32_t total = static_cast<uint32_t>(nodes_.size());
+            while (!aborted_.load(std::memory_order_relaxed) && completed_.load(std::memory_order_acquire) < total)
+            {
+                const uint32_t observed = signal_.load(std::memory_order_acquire);
+
+                node_id id{};
+                if (!pop_ready(id))
+                {
+                    if (completed_.load(std::memory_order_acquire) >= total) break;
+                    parallel_detail::wait_while_equal(signal_, observed);
+                    continue;
+                }
+
+                node_timing& t = timings_[id];
+                t.node = id;
+                t.participant = participant;
+                LARGE_INTEGER c{};
+                ::QueryPerformanceCounter(&c);
+                t.start = c.QuadPart;
+
+                try
+                {
+                    if (nodes_[id].work) nodes_[id].work();
+                }
+                catch (...)
+                {
+                    std::lock_guard lock(ready_mutex_);
+                    if (!error_) error_ = std::current_exception();
+                    aborted_.store(true);
+                }
+
+                ::QueryPerformanceCounter(&c);
+                t.end = c.QuadPart;
+
+                if (aborted_.load(std::memory_order_relaxed))
+                {
+                    notify();
+                    return;
+                }
+
+                bool any_ready = false;
+                for (node_id s : successors_of(id))
+                {
+                    if (pending_[s].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    {
+                        push_ready(s);
+                        any_ready = true;
+                    }
+                }
+
+                if (completed_.fetch_add(1, std::memory_order_acq_rel) + 1 == total || any_ready)
+                    notify();
+            }
+        }
+
+        static void append_escaped(std::string& out, const std::string& s)
+        {
+            for (char c : s)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    out += '\\';
+                    out += c;
+                }
+                else if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(c));
+                    out += buf;
+                }
+                else
+                    out += c;
+            }
+        }
+    };
+}
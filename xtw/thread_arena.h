@@ -0,0 +1,231 @@
+/// @file
+/// @brief  xtw::threading::thread_arena
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+#include "./unique_handle.h"
+
+namespace xtw::threading
+{
+    struct arena_options
+    {
+        size_t reserve_size = size_t{64} << 20;     // address space reserved up front
+        size_t commit_granularity = size_t{64} << 10; // pages are committed in chunks of this size
+        bool large_pages = false;                   // the whole reserve is committed at once; falls back to normal pages (see thread_arena)
+        std::pmr::memory_resource* upstream = nullptr; // used when the arena is exhausted; default: std::pmr::new_delete_resource()
+    };
+
+    /// Bump-pointer scratch allocator over one reserved address range.
+    /// Deallocation is a no-op; memory is reclaimed in bulk by rewinding to a mark (or reset()).
+    /// Requests that do not fit in the range go to the upstream resource and are freed through it as usual.
+    ///
+    /// A thread created with threading::thread(f, arena_options{...}) owns an arena for its lifetime,
+    /// available through thread_arena::current() on that thread.
+    ///
+    /// Large pages come from VirtualAlloc(MEM_LARGE_PAGES) on Windows, which requires SeLockMemoryPrivilege,
+    /// and from the hugetlbfs pool (mmap with MAP_HUGETLB; see /proc/sys/vm/nr_hugepages) elsewhere.
+    class thread_arena final : public std::pmr::memory_resource
+    {
+        struct region_closer
+        {
+            size_t mapped_size; // nonzero for regions from mmap; value-initialized to 0 otherwise
+
+            void operator()(void* p) const noexcept
+            {
+                if (!p) return;
+#if !defined(_WIN32)
+                if (mapped_size) return (void)::munmap(p, mapped_size);
+#endif
+                ::VirtualFree(p, 0, MEM_RELEASE);
+            }
+        };
+
+        unique_handle_t<void*, region_closer> region_{};
+        std::byte* base_{};
+        size_t reserved_{};
+        size_t committed_{};
+        size_t offset_{};
+        size_t commit_granularity_{};
+        bool large_pages_{};
+        std::pmr::memory_resource* upstream_{};
+
+        // trim() decommits from a multiple of the granularity, which must not fall inside a page in use.
+        static size_t round_up_to_page(size_t size) noexcept
+        {
+            static const size_t page = []
+            {
+                SYSTEM_INFO si{};
+                ::GetSystemInfo(&si);
+                return static_cast<size_t>(si.dwPageSize);
+            }();
+            return (size + page - 1) / page * page;
+        }
+
+        static thread_arena*& current_slot() noexcept
+        {
+            static thread_local thread_arena* current{};
+            return current;
+        }
+
+    public:
+        using mark_type = size_t;
+
+        explicit thread_arena(const arena_options& options = {})
+            : commit_granularity_(round_up_to_page(options.commit_granularity ? options.commit_granularity : 65536))
+            , upstream_(options.upstream ? options.upstream : std::pmr::new_delete_resource())
+        {
+            if (options.large_pages)
+            {
+                if (const SIZE_T page = ::GetLargePageMinimum())
+                {
+                    const size_t size = (options.reserve_size + page - 1) / page * page;
+#if defined(_WIN32)
+                    region_.reset(::VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+#else
+                    // the huge pages are taken from the pool now, so touching them later cannot fail.
+                    if (void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0); p != MAP_FAILED)
+                        region_ = decltype(region_)(p, region_closer{size});
+#endif
+                    if (region_)
+                    {
+                        reserved_ = committed_ = size;
+                        large_pages_ = true;
+                    }
+                }
+            }
+
+            if (!region_ && options.reserve_size != 0) // normal pages, committed on demand
+            {
+                region_.reset(::VirtualAlloc(nullptr, options.reserve_size, MEM_RESERVE, PAGE_READWRITE));
+                if (!region_) throw std::bad_alloc();
+                reserved_ = options.reserve_size;
+            }
+
+            base_ = static_cast<std::byte*>(region_.get());
+        }
+
+        thread_arena(const thread_arena& other) = delete;
+        thread_arena(thread_arena&& other) noexcept = delete;
+        thread_arena& operator=(const thread_arena& other) = delete;
+        thread_arena& operator=(thread_arena&& other) noexcept = delete;
+        ~thread_arena() override = default;
+
+        /// Arena of the calling thread, or nullptr.
+        [[nodiscard]] static thread_arena* current() noexcept { return current_slot(); }
+
+        /// Arena of the calling thread, or the default memory resource.
+        [[nodiscard]] static std::pmr::memory_resource* current_resource() noexcept
+        {
+            thread_arena* a = current();
+            return a ? static_cast<std::pmr::memory_resource*>(a) : std::pmr::get_default_resource();
+        }
+
+        /// Makes an arena current() on the calling thread while in scope.
+        class scoped_current final
+        {
+            thread_arena* previous_{};
+
+        public:
+            explicit scoped_current(thread_arena& arena) noexcept : previous_(std::exchange(current_slot(), &arena)) {}
+            scoped_current(const scoped_current& other) = delete;
+            scoped_current(scoped_current&& other) noexcept = delete;
+            scoped_current& operator=(const scoped_current& other) = delete;
+            scoped_current& operator=(scoped_current&& other) noexcept = delete;
+            ~scoped_current() { current_slot() = previous_; }
+        };
+
+        /// Rewinds the arena to where it was when constructed.
+        class scoped_mark final
+        {
+            thread_arena& arena_;
+            mark_type mark_;
+
+        public:
+            explicit scoped_mark(thread_arena& arena) noexcept : arena_(arena), mark_(arena.mark()) {}
+            scoped_mark(const scoped_mark& other) = delete;
+            scoped_mark(scoped_mark&& other) noexcept = delete;
+            scoped_mark& operator=(const scoped_mark& other) = delete;
+            scoped_mark& operator=(scoped_mark&& other) noexcept = delete;
+            ~scoped_mark() { arena_.rewind(mark_); }
+        };
+
+        [[nodiscard]] mark_type mark() const noexcept { return offset_; }
+
+        /// Frees everything allocated from the range after m. Objects there must already be destroyed.
+        void rewind(mark_type m) noexcept { if (m < offset_) offset_ = m; }
+
+        void reset() noexcept { offset_ = 0; }
+
+        /// Returns committed pages above the current offset to the system. No-op for large pages.
+        void trim() noexcept
+        {
+            if (large_pages_) return;
+            const size_t keep = (offset_ + commit_granularity_ - 1) / commit_granularity_ * commit_granularity_;
+            if (keep >= committed_) return;
+            if (::VirtualFree(base_ + keep, committed_ - keep, MEM_DECOMMIT)) committed_ = keep;
+        }
+
+        [[nodiscard]] size_t used() const noexcept { return offset_; }
+        [[nodiscard]] size_t committed() const noexcept { return committed_; }
+        [[nodiscard]] size_t reserved() const noexcept { return reserved_; }
+        [[nodiscard]] bool large_pages() const noexcept { return large_pages_; }
+        [[nodiscard]] std::pmr::memory_resource* upstream() const noexcept { return upstream_; }
+
+        [[nodiscard]] bool owns(const void* p) const noexcept
+        {
+            return base_ && p >= base_ && p < base_ + reserved_;
+        }
+
+    protected:
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            const uintptr_t current = reinterpret_cast<uintptr_t>(base_) + offset_;
+            const uintptr_t aligned = (current + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+            const size_t end = static_cast<size_t>(aligned - reinterpret_cast<uintptr_t>(base_)) + bytes;
+
+            if (base_ && end <= reserved_ && end >= offset_ && commit(end))
+            {
+                offset_ = end;
+                return reinterpret_cast<void*>(aligned);
+            }
+
+            return upstream_->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override
+        {
+            if (!owns(p)) upstream_->deallocate(p, bytes, alignment);
+        }
+
+        [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+
+    private:
+        bool commit(size_t end) noexcept
+        {
+            if (end <= committed_) return true;
+
+            size_t target = (end + commit_granularity_ - 1) / commit_granularity_ * commit_granularity_;
+            if (target > reserved_) target = reserved_;
+            if (!::VirtualAlloc(base_ + committed_, target - committed_, MEM_COMMIT, PAGE_READWRITE)) return false;
+            committed_ = target;
+            return true;
+        }
+    };
+}
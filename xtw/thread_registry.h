@@ -0,0 +1,588 @@
+/// @file
+/// @brief  xtw::threading::thread_registry
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "./threading.h"
+#include "./unique_handle.h"
+
+namespace xtw::threading
+{
+    struct thread_statistics
+    {
+        DWORD thread_id;
+        std::wstring name;
+        blocked_in blocked;          // current xtw-level state
+        int64_t lifetime_us;         // since the thread started
+        int64_t kernel_time_us;      // GetThreadTimes; /proc/self/task/<tid>/stat off Windows
+        int64_t user_time_us;
+        uint64_t cycle_time;         // QueryThreadCycleTime; 0 off Windows
+        int64_t blocked_time_us;     // in event::wait_signal and thread::join, including the current wait
+        uint64_t context_switches;   // total
+        uint64_t voluntary_context_switches; // off Windows only; Windows does not split voluntary and involuntary switches
+        uint32_t os_state;           // KTHREAD_STATE: 2 Running, 5 Waiting, 1 Ready, ...; off Windows, the /proc state letter ('R', 'S', 'D', ...)
+        uint32_t os_wait_reason;     // KWAIT_REASON when os_state is Waiting; 0 off Windows
+        bool os_info_valid;          // context_switches / os_state / os_wait_reason were sampled
+    };
+
+    namespace thread_registry_detail
+    {
+        static inline int64_t qpc() noexcept
+        {
+            LARGE_INTEGER c{};
+            ::QueryPerformanceCounter(&c);
+            return c.QuadPart;
+        }
+
+        static inline int64_t qpc_to_us(int64_t ticks) noexcept
+        {
+            static const int64_t frequency = []
+            {
+                LARGE_INTEGER f{};
+                ::QueryPerformanceFrequency(&f);
+                return f.QuadPart;
+            }();
+            return ticks / frequency * 1000000 + ticks % frequency * 1000000 / frequency;
+        }
+
+        struct thread_record
+        {
+            DWORD thread_id{};
+            std::wstring name{};
+#if defined(_WIN32)
+            unique_handle handle{}; // THREAD_QUERY_LIMITED_INFORMATION
+#else
+            pid_t native_id{}; // the kernel's thread id, for /proc/self/task/<tid>
+            const std::byte* stack_low{};
+            const std::byte* stack_high{};
+#endif
+            int64_t started{}; // qpc
+
+            std::atomic<uint32_t> blocked{};
+            std::atomic<int64_t> blocked_since{};   // qpc, valid while blocked
+            std::atomic<int64_t> blocked_total{};   // qpc ticks of finished waits
+        };
+
+        // appends a UTF-16 string as the inside of a JSON string; ill-formed sequences become U+FFFD.
+        static inline void append_json_string(std::string& out, const std::wstring& s)
+        {
+            for (size_t i = 0; i < s.size(); i++)
+            {
+                uint32_t c = static_cast<uint16_t>(s[i]);
+                if (c >= 0xD800 && c < 0xDC00 && i + 1 < s.size() && static_cast<uint16_t>(s[i + 1]) >= 0xDC00 && static_cast<uint16_t>(s[i + 1]) < 0xE000)
+                    c = 0x10000 + ((c - 0xD800) << 10) + (static_cast<uint16_t>(s[++i]) - 0xDC00);
+                else if (c >= 0xD800 && c < 0xE000)
+                    c = 0xFFFD;
+
+                if (c == '"' || c == '\\')
+                {
+                    out += '\\';
+                    out += static_cast<char>(c);
+                }
+                else if (c < 0x20)
+                {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(c));
+                    out += buf;
+                }
+                else if (c < 0x80) out += static_cast<char>(c);
+                else if (c < 0x800)
+                {
+                    out += static_cast<char>(0xC0 | c >> 6);
+                    out += static_cast<char>(0x80 | (c & 0x3F));
+                }
+                else if (c < 0x10000)
+                {
+                    out += static_cast<char>(0xE0 | c >> 12);
+                    out += static_cast<char>(0x80 | (c >> 6 & 0x3F));
+                    out += static_cast<char>(0x80 | (c & 0x3F));
+                }
+                else
+                {
+                    out += static_cast<char>(0xF0 | c >> 18);
+                    out += static_cast<char>(0x80 | (c >> 12 & 0x3F));
+                    out += static_cast<char>(0x80 | (c >> 6 & 0x3F));
+                    out += static_cast<char>(0x80 | (c & 0x3F));
+                }
+            }
+        }
+
+#if !defined(_WIN32)
+        // reads /proc/self/task/<tid>/<file> into buffer as a string; returns false if the thread is gone.
+        static inline bool read_task_file(pid_t tid, const char* file, char* buffer, size_t size) noexcept
+        {
+            char path[64];
+            std::snprintf(path, sizeof(path), "/proc/self/task/%d/%s", static_cast<int>(tid), file);
+            const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+            if (fd < 0) return false;
+            const ssize_t length = ::read(fd, buffer, size - 1);
+            (void)::close(fd);
+            if (length <= 0) return false;
+            buffer[length] = '\0';
+            return true;
+        }
+
+        // the value of a "name:\tvalue" line of a /proc status file.
+        static inline uint64_t status_value(const char* status, const char* line_name) noexcept
+        {
+            for (const char* p = status; (p = std::strstr(p, line_name)) != nullptr; p++)
+                if (p == status || p[-1] == '\n')
+                    return std::strtoull(p + std::strlen(line_name), nullptr, 10);
+            return 0;
+        }
+#endif
+
+        // layouts of SystemProcessInformation (5) records, declared here with fixed-width fields.
+        struct unicode_string
+        {
+            uint16_t length;
+            uint16_t maximum_length;
+            wchar_t* buffer;
+        };
+
+        struct system_thread_information
+        {
+            int64_t kernel_time;
+            int64_t user_time;
+            int64_t create_time;
+            uint32_t wait_time;
+            void* start_address;
+            void* unique_process;
+            void* unique_thread;
+            int32_t priority;
+            int32_t base_priority;
+            uint32_t context_switches;
+            uint32_t thread_state;
+            uint32_t wait_reason;
+        };
+
+        struct system_process_information
+        {
+            uint32_t next_entry_offset;
+            uint32_t number_of_threads;
+            int64_t working_set_private_size;
+            uint32_t hard_fault_count;
+            uint32_t number_of_threads_high_watermark;
+            uint64_t cycle_time;
+            int64_t create_time;
+            int64_t user_time;
+            int64_t kernel_time;
+            unicode_string image_name;
+            int32_t base_priority;
+            void* unique_process_id;
+            void* inherited_from_unique_process_id;
+            uint32_t handle_count;
+            uint32_t session_id;
+            uintptr_t unique_process_key;
+            size_t peak_virtual_size;
+            size_t virtual_size;
+            uint32_t page_fault_count;
+            size_t peak_working_set_size;
+            size_t working_set_size;
+            size_t quota_peak_paged_pool_usage;
+            size_t quota_paged_pool_usage;
+            size_t quota_peak_non_paged_pool_usage;
+            size_t quota_non_paged_pool_usage;
+            size_t pagefile_usage;
+            size_t peak_pagefile_usage;
+            size_t private_page_count;
+            int64_t io_counters[6];
+            // system_thread_information threads[number_of_threads];
+        };
+
+        static_assert(sizeof(system_process_information) == (sizeof(void*) == 8 ? 0x100 : 0xB8));
+        static_assert(sizeof(system_thread_information) == (sizeof(void*) == 8 ? 0x50 : 0x40));
+    }
+
+    /// Opt-in registry of live xtw::threading::thread threads and their runtime statistics.
+    ///
+    /// Nothing is registered until instance() is first called: it installs a thread_observer, and from then on xtw threads
+    /// register themselves on start and leave on exit; other threads may join with scoped_registration. Time blocked in
+    /// event::wait_signal and thread::join is accumulated per thread with two QueryPerformanceCounter reads per wait.
+    /// sample() queries each registered thread: GetThreadTimes/QueryThreadCycleTime on Windows, /proc/self/task/<tid> elsewhere;
+    /// it is cheap enough to call every second. With include_os_info, it adds context switches and the scheduler state,
+    /// which on Windows come from one NtQuerySystemInformation snapshot of the whole system and cost far more.
+    class thread_registry final
+    {
+        std::mutex mutex_{};
+        std::vector<std::shared_ptr<thread_registry_detail::thread_record>> records_{};
+
+#if defined(_WIN32)
+        std::mutex sample_mutex_{};                          // not held with mutex_, so thread start/exit never waits for a sample
+        std::vector<std::byte> system_information_buffer_{}; // reused between samples; guarded by sample_mutex_
+#endif
+
+        thread_registry() { thread_observer::install(&observer()); }
+
+    public:
+        thread_registry(const thread_registry& other) = delete;
+        thread_registry(thread_registry&& other) noexcept = delete;
+        thread_registry& operator=(const thread_registry& other) = delete;
+        thread_registry& operator=(thread_registry&& other) noexcept = delete;
+        ~thread_registry() { (void)thread_observer::replace(&observer(), nullptr); }
+
+        /// The registry. The first call enables registration of the xtw threads started from then on.
+        [[nodiscard]] static thread_registry& instance()
+        {
+            static thread_registry r{};
+            return r;
+        }
+
+        /// Registers the calling thread while in scope, unless it is registered already. For threads not created by xtw.
+        class scoped_registration final
+        {
+            bool registered_;
+
+        public:
+            explicit scoped_registration(const wchar_t* name) noexcept
+                : registered_(instance().register_current(name)) { }
+
+            scoped_registration(const scoped_registration& other) = delete;
+            scoped_registration(scoped_registration&& other) noexcept = delete;
+            scoped_registration& operator=(const scoped_registration& other) = delete;
+            scoped_registration& operator=(scoped_registration&& other) noexcept = delete;
+
+            ~scoped_registration()
+            {
+                if (registered_) instance().unregister_current();
+            }
+        };
+
+        /// Marks the calling thread as blocked while in scope, for waits other than xtw's own. No-op on unregistered threads.
+        class scoped_blocking final
+        {
+            thread_registry_detail::thread_record* record_;
+
+        public:
+            explicit scoped_blocking(blocked_in reason) noexcept
+                : record_(current_record())
+            {
+                begin_blocking(record_, reason);
+            }
+
+            scoped_blocking(const scoped_blocking& other) = delete;
+            scoped_blocking(scoped_blocking&& other) noexcept = delete;
+            scoped_blocking& operator=(const scoped_blocking& other) = delete;
+            scoped_blocking& operator=(scoped_blocking&& other) noexcept = delete;
+
+            ~scoped_blocking() { end_blocking(record_); }
+        };
+
+        [[nodiscard]] size_t size()
+        {
+            std::lock_guard lock(mutex_);
+            return records_.size();
+        }
+
+        /// Ids and names of the registered threads.
+        [[nodiscard]] std::vector<std::pair<DWORD, std::wstring>> threads()
+        {
+            std::lock_guard lock(mutex_);
+            std::vector<std::pair<DWORD, std::wstring>> result{};
+            result.reserve(records_.size());
+            for (auto& r : records_) result.emplace_back(r->thread_id, r->name);
+            return result;
+        }
+
+#if !defined(_WIN32)
+        struct native_thread
+        {
+            DWORD thread_id;
+            pid_t native_id;
+            const std::byte* stack_low; // null if unknown
+            const std::byte* stack_high;
+        };
+
+        /// Kernel thread ids and stack ranges of the registered threads, for signal-based samplers.
+        [[nodiscard]] std::vector<native_thread> native_threads()
+        {
+            std::lock_guard lock(mutex_);
+            std::vector<native_thread> result{};
+            result.reserve(records_.size());
+            for (auto& r : records_) result.push_back(native_thread{r->thread_id, r->native_id, r->stack_low, r->stack_high});
+            return result;
+        }
+#endif
+
+        /// Samples all registered threads, one query per thread.
+        /// include_os_info adds context switches and the scheduler state (on Windows, from a snapshot of the whole system).
+        [[nodiscard]] std::vector<thread_statistics> sample(bool include_os_info = false)
+        {
+            std::vector<std::shared_ptr<thread_registry_detail::thread_record>> records{};
+            {
+                std::lock_guard lock(mutex_);
+                records = records_;
+            }
+
+            const int64_t now = thread_registry_detail::qpc();
+
+            std::vector<thread_statistics> result{};
+            result.reserve(records.size());
+            for (auto& r : records)
+            {
+                thread_statistics s{};
+                s.thread_id = r->thread_id;
+                s.name = r->name;
+                s.lifetime_us = thread_registry_detail::qpc_to_us(now - r->started);
+
+                s.blocked = static_cast<blocked_in>(r->blocked.load(std::memory_order_acquire));
+                int64_t blocked = r->blocked_total.load(std::memory_order_relaxed);
+                if (s.blocked != blocked_in::none) blocked += std::max<int64_t>(0, now - r->blocked_since.load(std::memory_order_relaxed));
+                s.blocked_time_us = thread_registry_detail::qpc_to_us(blocked);
+
+#if defined(_WIN32)
+                FILETIME creation{}, exit{}, kernel{}, user{};
+                if (r->handle && ::GetThreadTimes(r->handle.get(), &creation, &exit, &kernel, &user))
+                {
+                    s.kernel_time_us = static_cast<int64_t>((uint64_t{kernel.dwHighDateTime} << 32 | kernel.dwLowDateTime) / 10);
+                    s.user_time_us = static_cast<int64_t>((uint64_t{user.dwHighDateTime} << 32 | user.dwLowDateTime) / 10);
+                }
+
+                ULONG64 cycles{};
+                if (r->handle && ::QueryThreadCycleTime(r->handle.get(), &cycles))
+                    s.cycle_time = cycles;
+#else
+                sample_task(*r, s, include_os_info);
+#endif
+
+                result.push_back(std::move(s));
+            }
+
+#if defined(_WIN32)
+            if (include_os_info) fill_os_info(result);
+#endif
+            return result;
+        }
+
+        /// Formats samples as a JSON array.
+        [[nodiscard]] static std::string to_json(const std::vector<thread_statistics>& samples)
+        {
+            std::string json = "[";
+            char buf[512];
+            for (size_t i = 0; i < samples.size(); i++)
+            {
+                const thread_statistics& s = samples[i];
+                if (i) json += ',';
+
+                json += "{\"thread_id\":" + std::to_string(s.thread_id) + ",\"name\":\"";
+                thread_registry_detail::append_json_string(json, s.name);
+
+                std::snprintf(buf, sizeof(buf),
+                              "\",\"blocked\":%u,\"lifetime_us\":%lld,\"kernel_time_us\":%lld,\"user_time_us\":%lld,\"cycle_time\":%llu,"
+                              "\"blocked_time_us\":%lld,\"context_switches\":%llu,\"voluntary_context_switches\":%llu,\"os_state\":%u,\"os_wait_reason\":%u,\"os_info_valid\":%s}",
+                              static_cast<unsigned>(s.blocked),
+                              static_cast<long long>(s.lifetime_us),
+                              static_cast<long long>(s.kernel_time_us),
+                              static_cast<long long>(s.user_time_us),
+                              static_cast<unsigned long long>(s.cycle_time),
+                              static_cast<long long>(s.blocked_time_us),
+                              static_cast<unsigned long long>(s.context_switches),
+                              static_cast<unsigned long long>(s.voluntary_context_switches),
+                              s.os_state,
+                              s.os_wait_reason,
+                              s.os_info_valid ? "true" : "false");
+                json += buf;
+            }
+            json += "]";
+            return json;
+        }
+
+    private:
+        static thread_registry_detail::thread_record*& current_record() noexcept
+        {
+            static thread_local thread_registry_detail::thread_record* current{};
+            return current;
+        }
+
+        // the hooks installed by the constructor.
+        static const thread_observer& observer() noexcept
+        {
+            static const thread_observer o{
+                [](const wchar_t* name) noexcept { (void)instance().register_current(name); },
+                []() noexcept { instance().unregister_current(); },
+                [](blocked_in reason) noexcept { begin_blocking(current_record(), reason); },
+                []() noexcept { end_blocking(current_record()); },
+            };
+            return o;
+        }
+
+        bool register_current(const wchar_t* name) noexcept
+        {
+            if (current_record()) return false;
+            try
+            {
+                auto r = std::make_shared<thread_registry_detail::thread_record>();
+                r->thread_id = ::GetCurrentThreadId();
+                r->name = name ? name : L"";
+#if defined(_WIN32)
+                r->handle.reset(::OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, r->thread_id));
+#else
+                r->native_id = static_cast<pid_t>(::syscall(SYS_gettid));
+                pthread_attr_t attributes{};
+                if (::pthread_getattr_np(::pthread_self(), &attributes) == 0)
+                {
+                    void* address{};
+                    size_t size{};
+                    if (::pthread_attr_getstack(&attributes, &address, &size) == 0)
+                    {
+                        r->stack_low = static_cast<const std::byte*>(address);
+                        r->stack_high = r->stack_low + size;
+                    }
+                    (void)::pthread_attr_destroy(&attributes);
+                }
+#endif
+                r->started = thread_registry_detail::qpc();
+
+                std::lock_guard lock(mutex_);
+                records_.push_back(r);
+                current_record() = r.get();
+                return true;
+            }
+            catch (...)
+            {
+                return false; // statistics are best effort; the thread runs unregistered.
+            }
+        }
+
+        void unregister_current() noexcept
+        {
+            auto* record = std::exchange(current_record(), nullptr);
+            if (!record) return;
+
+            std::lock_guard lock(mutex_);
+            records_.erase(std::remove_if(records_.begin(), records_.end(), [record](const auto& r) { return r.get() == record; }), records_.end());
+        }
+
+        static void begin_blocking(thread_registry_detail::thread_record* record, blocked_in reason) noexcept
+        {
+            if (!record) return;
+            record->blocked_since.store(thread_registry_detail::qpc(), std::memory_order_relaxed);
+            record->blocked.store(static_cast<uint32_t>(reason), std::memory_order_release);
+        }
+
+        static void end_blocking(thread_registry_detail::thread_record* record) noexcept
+        {
+            if (!record) return;
+            const int64_t elapsed = thread_registry_detail::qpc() - record->blocked_since.load(std::memory_order_relaxed);
+            record->blocked.store(static_cast<uint32_t>(blocked_in::none), std::memory_order_release);
+            record->blocked_total.fetch_add(elapsed, std::memory_order_relaxed);
+        }
+
+#if !defined(_WIN32)
+        // times and state from /proc/self/task/<tid>/stat, context switches from .../status.
+        static void sample_task(const thread_registry_detail::thread_record& r, thread_statistics& s, bool include_os_info) noexcept
+        {
+            static const long ticks_per_second = ::sysconf(_SC_CLK_TCK);
+            char stat[512];
+            if (ticks_per_second <= 0 || !thread_registry_detail::read_task_file(r.native_id, "stat", stat, sizeof(stat))) return;
+
+            // "tid (comm) state ppid ... utime stime ...": comm may hold anything, so the fields start after the last ')'.
+            const char* p = std::strrchr(stat, ')');
+            if (!p || p[1] != ' ' || !p[2]) return;
+            const char state = p[2];
+            p += 3;
+
+            uint64_t fields[12]{}; // fields 4 (ppid) to 15 (stime)
+            for (auto& f : fields)
+            {
+                char* end{};
+                f = std::strtoull(p, &end, 10);
+                if (end == p) return;
+                p = end;
+            }
+            s.user_time_us = static_cast<int64_t>(fields[10] * 1000000 / static_cast<uint64_t>(ticks_per_second));
+            s.kernel_time_us = static_cast<int64_t>(fields[11] * 1000000 / static_cast<uint64_t>(ticks_per_second));
+
+            char status[4096];
+            if (!include_os_info || !thread_registry_detail::read_task_file(r.native_id, "status", status, sizeof(status))) return;
+            s.voluntary_context_switches = thread_registry_detail::status_value(status, "voluntary_ctxt_switches:");
+            s.context_switches = s.voluntary_context_switches + thread_registry_detail::status_value(status, "nonvoluntary_ctxt_switches:");
+            s.os_state = static_cast<unsigned char>(state);
+            s.os_info_valid = true;
+        }
+#else
+        // merges one system snapshot into result by thread id.
+        void fill_os_info(std::vector<thread_statistics>& result) noexcept
+        {
+            using NtQuerySystemInformationFn = LONG(WINAPI*)(ULONG, PVOID, ULONG, PULONG);
+            static const auto pfnNtQuerySystemInformation = reinterpret_cast<NtQuerySystemInformationFn>(reinterpret_cast<void (*)()>(::GetProcAddress(::GetModuleHandleW(L"ntdll.dll"), "NtQuerySystemInformation")));
+            if (!pfnNtQuerySystemInformation || result.empty()) return;
+
+            constexpr ULONG SystemProcessInformation = 5;
+            constexpr LONG STATUS_INFO_LENGTH_MISMATCH = static_cast<LONG>(0xC0000004);
+
+            try
+            {
+                std::lock_guard lock(sample_mutex_);
+                auto& buffer = system_information_buffer_;
+                if (buffer.empty()) buffer.resize(256 * 1024);
+
+                LONG status{};
+                for (int retry = 0; retry < 8; retry++)
+                {
+                    ULONG needed{};
+                    status = pfnNtQuerySystemInformation(SystemProcessInformation, buffer.data(), static_cast<ULONG>(buffer.size()), &needed);
+                    if (status != STATUS_INFO_LENGTH_MISMATCH) break;
+                    buffer.resize(std::max<size_t>(buffer.size() * 2, needed + 64 * 1024));
+                }
+                if (status < 0) return;
+
+                const auto pid = reinterpret_cast<void*>(static_cast<uintptr_t>(::GetCurrentProcessId()));
+                const std::byte* p = buffer.data();
+                while (true)
+                {
+                    auto process = reinterpret_cast<const thread_registry_detail::system_process_information*>(p);
+                    if (process->unique_process_id == pid)
+                    {
+                        auto threads = reinterpret_cast<const thread_registry_detail::system_thread_information*>(process + 1);
+                        for (uint32_t i = 0; i < process->number_of_threads; i++)
+                        {
+                            const auto tid = static_cast<DWORD>(reinterpret_cast<uintptr_t>(threads[i].unique_thread));
+                            for (auto& s : result)
+                            {
+                                if (s.thread_id != tid) continue;
+                                s.context_switches = threads[i].context_switches;
+                                s.os_state = threads[i].thread_state;
+                                s.os_wait_reason = threads[i].wait_reason;
+                                s.os_info_valid = true;
+                            }
+                        }
+                        return;
+                    }
+
+                    if (process->next_entry_offset == 0) return;
+                    p += process->next_entry_offset;
+                }
+            }
+            catch (...)
+            {
+                // leaves os_info_valid false.
+            }
+        }
+#endif
+    };
+}
@@ -8,15 +8,106 @@
 #include <Windows.h>
 #include <process.h>
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <type_traits>
 #include <functional>
 #include <future>
 #include <new>
+#include <optional>
 #include <stdexcept>
 
+#include "./thread_arena.h"
 #include "./unique_handle.h"
 
+// thread observer
+namespace xtw::threading
+{
+    /// What an xtw thread is blocked in, as seen by xtw's own waits.
+    enum struct blocked_in : uint32_t
+    {
+        none = 0,
+        event_wait = 1, // event::wait_signal
+        join = 2,       // thread::join
+    };
+
+    /// Hooks called on the start and exit of xtw::threading::thread threads, and around event::wait_signal and thread::join.
+    /// None is installed by default, and then each of these costs one atomic load. thread_registry installs its own when first used.
+    struct thread_observer
+    {
+        void (*started)(const wchar_t* name) noexcept; // on the new thread, before its function body
+        void (*exiting)() noexcept;                    // on the thread, after its function body
+        void (*blocking)(blocked_in reason) noexcept;  // on the waiting thread, before the wait
+        void (*unblocked)() noexcept;                  // after the wait
+
+        /// Installs hooks for threads started and waits entered from now on; nullptr removes them.
+        /// Threads and waits already observed keep calling the hooks they started with, which must stay valid.
+        static void install(const thread_observer* observer) noexcept { slot().store(observer, std::memory_order_release); }
+
+        /// Replaces expected only; returns false if another observer was installed meanwhile.
+        static bool replace(const thread_observer* expected, const thread_observer* observer) noexcept { return slot().compare_exchange_strong(expected, observer, std::memory_order_acq_rel); }
+
+        [[nodiscard]] static const thread_observer* installed() noexcept { return slot().load(std::memory_order_acquire); }
+
+    private:
+        static std::atomic<const thread_observer*>& slot() noexcept
+        {
+            static std::atomic<const thread_observer*> s{};
+            return s;
+        }
+    };
+
+    namespace thread_observer_detail
+    {
+        // calls the observer installed on entry, if any, on the start and exit of a thread body.
+        class scoped_thread final
+        {
+            const thread_observer* observer_;
+
+        public:
+            explicit scoped_thread(const wchar_t* name) noexcept
+                : observer_(thread_observer::installed())
+            {
+                if (observer_) observer_->started(name);
+            }
+
+            scoped_thread(const scoped_thread& other) = delete;
+            scoped_thread(scoped_thread&& other) noexcept = delete;
+            scoped_thread& operator=(const scoped_thread& other) = delete;
+            scoped_thread& operator=(scoped_thread&& other) noexcept = delete;
+
+            ~scoped_thread()
+            {
+                if (observer_) observer_->exiting();
+            }
+        };
+
+        // calls the observer installed on entry, if any, around a wait.
+        class scoped_wait final
+        {
+            const thread_observer* observer_;
+
+        public:
+            explicit scoped_wait(blocked_in reason) noexcept
+                : observer_(thread_observer::installed())
+            {
+                if (observer_) observer_->blocking(reason);
+            }
+
+            scoped_wait(const scoped_wait& other) = delete;
+            scoped_wait(scoped_wait&& other) noexcept = delete;
+            scoped_wait& operator=(const scoped_wait& other) = delete;
+            scoped_wait& operator=(scoped_wait&& other) noexcept = delete;
+
+            ~scoped_wait()
+            {
+                if (observer_) observer_->unblocked();
+            }
+        };
+    }
+}
+
 // thread
 namespace xtw::threading
 {
@@ -65,6 +156,7 @@ namespace xtw::threading
                     auto& thread_is_ready = static_cast<arg_t*>(arg)->thread_is_ready;                    // reference
                     (void)::SetThreadDescription(::GetCurrentThread(), static_cast<arg_t*>(arg)->thread_name);
                     (void)::SetThreadPriority(::GetCurrentThread(), static_cast<arg_t*>(arg)->thread_priority);
+                    thread_observer_detail::scoped_thread observation(static_cast<arg_t*>(arg)->thread_name); // the observer copies the name
 
                     thread_is_ready.set_value(); // notify to caller that sub-thread is ready.
                     function_body();             // invoke
@@ -81,6 +173,44 @@ namespace xtw::threading
             arg.thread_is_ready.get_future().get(); // wait for thread started
         }
 
+        /// Creates a thread that owns a thread_arena for its lifetime. The arena is thread_arena::current() on the new thread.
+        /// If the arena cannot be created, the thread exits and the exception is rethrown here.
+        template <class F, std::enable_if_t<std::is_invocable_v<F>>* = nullptr>
+        explicit thread(F function_body, const arena_options& arena, join_on_destructor_flag flag = join_on_destructor_flag::none, size_t stack_commit_size = 65536, int thread_priority = THREAD_PRIORITY_NORMAL, const wchar_t* thread_name = nullptr)
+            : thread()
+        {
+            std::promise<void> arena_is_ready{};
+            auto arena_future = arena_is_ready.get_future();
+
+            *this = thread([&arena_is_ready, function_body = std::move(function_body), arena]() mutable
+            {
+                std::optional<thread_arena> a{};
+                try
+                {
+                    a.emplace(arena);
+                }
+                catch (...)
+                {
+                    arena_is_ready.set_exception(std::current_exception());
+                    return;
+                }
+
+                thread_arena::scoped_current current(*a);
+                arena_is_ready.set_value(); // arena_is_ready is not touched after this.
+                function_body();
+            }, flag, stack_commit_size, thread_priority, thread_name);
+
+            try
+            {
+                arena_future.get(); // wait for the arena
+            }
+            catch (...)
+            {
+                join();
+                throw;
+            }
+        }
+
         thread(const thread& other) = delete;
         thread(thread&& other) noexcept = default;
         thread& operator=(const thread& other) = delete;
@@ -93,8 +223,15 @@ namespace xtw::threading
 
             if (joinable())
             {
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wterminate" // the same as C4297
+#endif
                 __pragma(warning(suppress: 4297))                                // C4297: function assumed not to throw an exception but does
                 throw std::logic_error("the thread is not joined or detached!"); // causes std::terminate
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
             }
         }
 
@@ -115,7 +252,12 @@ namespace xtw::threading
         {
             if (!thread_handle_) throw std::logic_error("invalid call");
 
-            auto result = ::WaitForSingleObject(handle(), milliseconds);
+            auto result = [&]
+            {
+                thread_observer_detail::scoped_wait wait(blocked_in::join);
+                return ::WaitForSingleObject(handle(), milliseconds);
+            }();
+
             if (result == WAIT_OBJECT_0)
             {
                 thread_handle_.reset();
@@ -153,7 +295,7 @@ namespace xtw::threading
         explicit event(bool initial_state = false)
         {
             MemoryBarrier();
-            handle_.reset(::CreateEventW(nullptr, AutoReset, initial_state, nullptr));
+            handle_.reset(::CreateEventW(nullptr, !AutoReset, initial_state, nullptr)); // bManualReset
             if (!handle_) throw std::bad_alloc();
         }
 
@@ -178,7 +320,12 @@ namespace xtw::threading
         {
             if (!handle()) throw std::logic_error("invalid call");
 
-            auto result = ::WaitForSingleObject(handle(), milliseconds);
+            auto result = [&]
+            {
+                thread_observer_detail::scoped_wait wait(blocked_in::event_wait);
+                return ::WaitForSingleObject(handle(), milliseconds);
+            }();
+
             if (result == WAIT_OBJECT_0) return true;
             if (result == WAIT_TIMEOUT) return false;
             if (result == WAIT_ABANDONED) throw std::runtime_error("handle abandoned");
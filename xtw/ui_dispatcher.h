@@ -0,0 +1,272 @@
+/// @file
+/// @brief  xtw::window::ui_dispatcher
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include "./unique_handle.h"
+#include "./win32_exception.h"
+
+namespace xtw::window
+{
+    /// Runs tasks posted from any thread on the thread that owns a window.
+    ///
+    /// Tasks are pushed onto a lock-free intrusive list. Only the post that finds the list empty wakes the
+    /// window thread (one PostMessageW per batch, not per task); the window thread then drains the whole batch in
+    /// posting order. If the wake-up post fails (e.g. the message queue is full), the next post retries it.
+    ///
+    /// The window procedure (or message loop) forwards messages to handle_message():
+    ///
+    ///   if (dispatcher.handle_message(hWnd, message, wParam, lParam)) return 0;
+    ///
+    /// A dispatcher made with the default constructor wakes through a kernel object of its own instead: an auto-reset
+    /// event on Windows, and an eventfd elsewhere. Its thread blocks in wait(), or waits on wake_handle() / wake_descriptor()
+    /// with its other objects, then calls drain().
+    class ui_dispatcher final
+    {
+    public:
+        /// Wakes the dispatching thread. Returns false on failure.
+        using wake_function = std::function<bool()>;
+
+    private:
+        struct task_node
+        {
+            task_node* next{};
+
+            task_node() = default;
+            task_node(const task_node& other) = delete;
+            task_node(task_node&& other) noexcept = delete;
+            task_node& operator=(const task_node& other) = delete;
+            task_node& operator=(task_node&& other) noexcept = delete;
+            virtual ~task_node() = default;
+
+            virtual void run() = 0;
+        };
+
+        template <class F>
+        struct task final : task_node
+        {
+            F function;
+            explicit task(F&& f) : function(std::move(f)) {}
+            void run() override { function(); }
+        };
+
+        HWND hwnd_{};
+        UINT message_{};
+        wake_function wake_{};
+#if defined(_WIN32)
+        unique_handle wake_event_{};
+#else
+        int wake_descriptor_ = -1;
+#endif
+
+        std::atomic<task_node*> head_{};     // posted tasks, newest first
+        std::atomic_bool wake_failed_{};
+        task_node* ready_{};                 // dispatching thread only: taken tasks, oldest first
+
+    public:
+        static inline constexpr UINT default_message = WM_APP + 0x3FFF;
+
+        /// Dispatcher for the thread that owns hWnd. Wakes it by posting message to hWnd.
+        explicit ui_dispatcher(HWND hWnd, UINT message = default_message)
+            : hwnd_(hWnd)
+            , message_(message)
+            , wake_([hWnd, message] { return ::PostMessageW(hWnd, message, 0, 0) != FALSE; }) {}
+
+        /// Dispatcher woken by a custom function, e.g. setting an event registered with message_loop::add_wait().
+        explicit ui_dispatcher(wake_function wake)
+            : wake_(std::move(wake)) {}
+
+        /// Dispatcher woken through its own event (Windows) or eventfd (elsewhere).
+        ui_dispatcher()
+        {
+#if defined(_WIN32)
+            wake_event_.reset(::CreateEventW(nullptr, FALSE, FALSE, nullptr));
+            if (!wake_event_) throw win32_exception(HRESULT_FROM_WIN32(::GetLastError()));
+            wake_ = [event = wake_event_.get()] { return ::SetEvent(event) != FALSE; };
+#else
+            wake_descriptor_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            if (wake_descriptor_ < 0) throw std::system_error(errno, std::generic_category(), "eventfd");
+            wake_ = [fd = wake_descriptor_]
+            {
+                const uint64_t one = 1;
+                return ::write(fd, &one, sizeof(one)) == static_cast<ssize_t>(sizeof(one));
+            };
+#endif
+        }
+
+        ui_dispatcher(const ui_dispatcher& other) = delete;
+        ui_dispatcher(ui_dispatcher&& other) noexcept = delete;
+        ui_dispatcher& operator=(const ui_dispatcher& other) = delete;
+        ui_dispatcher& operator=(ui_dispatcher&& other) noexcept = delete;
+
+        // tasks not run yet are destroyed without running.
+        ~ui_dispatcher()
+        {
+            delete_list(ready_);
+            delete_list(head_.exchange(nullptr));
+#if !defined(_WIN32)
+            if (wake_descriptor_ >= 0) ::close(wake_descriptor_);
+#endif
+        }
+
+        [[nodiscard]] HWND window() const noexcept { return hwnd_; }
+        [[nodiscard]] UINT message() const noexcept { return message_; }
+
+#if defined(_WIN32)
+        /// Auto-reset event signaled by posts; nullptr unless made with the default constructor.
+        [[nodiscard]] HANDLE wake_handle() const noexcept { return wake_event_.get(); }
+#else
+        /// eventfd readable after posts; -1 unless made with the default constructor.
+        [[nodiscard]] int wake_descriptor() const noexcept { return wake_descriptor_; }
+#endif
+
+        /// Blocks until a post wakes the dispatcher or milliseconds pass; returns true if woken.
+        /// Only for dispatchers made with the default constructor. Call on the dispatching thread, then drain().
+        bool wait(DWORD milliseconds = INFINITE)
+        {
+#if defined(_WIN32)
+            if (!wake_event_) throw std::logic_error("invalid call");
+            return ::WaitForSingleObject(wake_event_.get(), milliseconds) == WAIT_OBJECT_0;
+#else
+            if (wake_descriptor_ < 0) throw std::logic_error("invalid call");
+            pollfd p{wake_descriptor_, POLLIN, 0};
+            const ULONGLONG deadline = ::GetTickCount64() + milliseconds;
+            for (DWORD remaining = milliseconds;;)
+            {
+                const int timeout = remaining == INFINITE ? -1 : static_cast<int>(std::min<DWORD>(remaining, INT_MAX));
+                const int result = ::poll(&p, 1, timeout);
+                if (result >= 0) return result > 0;
+                if (errno != EINTR) return false;
+
+                // interrupted by a signal (e.g. a sampling profiler's): wait for the rest.
+                if (remaining == INFINITE) continue;
+                const ULONGLONG now = ::GetTickCount64();
+                if (now >= deadline) return false;
+                remaining = static_cast<DWORD>(deadline - now);
+            }
+#endif
+        }
+
+        /// Posts a callable (may be move-only) to run on the dispatching thread. Callable from any thread.
+        template <class F, std::enable_if_t<std::is_invocable_v<std::decay_t<F>&>>* = nullptr>
+        void post(F&& function)
+        {
+            task_node* node = new task<std::decay_t<F>>(std::decay_t<F>(std::forward<F>(function)));
+
+            task_node* head = head_.load(std::memory_order_relaxed);
+            do node->next = head;
+            while (!head_.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+
+            if (head == nullptr || wake_failed_.load(std::memory_order_relaxed))
+                wake();
+        }
+
+        /// Runs up to max_count pending tasks in posting order. Call on the dispatching thread.
+        /// If tasks are left over (or a task throws), the dispatcher wakes itself again for the rest.
+        size_t drain(size_t max_count = std::numeric_limits<size_t>::max())
+        {
+#if !defined(_WIN32)
+            // reset the eventfd before taking the tasks: a post after this wakes it again.
+            uint64_t wakes{};
+            if (wake_descriptor_ >= 0) (void)!::read(wake_descriptor_, &wakes, sizeof(wakes));
+#endif
+            take_posted();
+
+            size_t count = 0;
+            try
+            {
+                while (ready_ && count < max_count)
+                {
+                    std::unique_ptr<task_node> node(ready_);
+                    ready_ = node->next;
+                    count++;
+                    node->run();
+                }
+            }
+            catch (...)
+            {
+                if (ready_) wake();
+                throw;
+            }
+
+            if (ready_) wake();
+            return count;
+        }
+
+        /// Drains if message is the wake-up message. Returns true if the message was handled.
+        bool handle_message(HWND hWnd, UINT message, WPARAM, LPARAM)
+        {
+            if (message != message_ || hWnd != hwnd_ || !hwnd_) return false;
+            (void)drain();
+            return true;
+        }
+
+        bool handle_message(const MSG& msg)
+        {
+            return handle_message(msg.hwnd, msg.message, msg.wParam, msg.lParam);
+        }
+
+    private:
+        void wake() noexcept
+        {
+            bool ok = false;
+            try { ok = wake_(); }
+            catch (...) { }
+            wake_failed_.store(!ok, std::memory_order_relaxed);
+        }
+
+        // moves posted tasks to the end of ready_, restoring posting order.
+        void take_posted() noexcept
+        {
+            task_node* posted = head_.exchange(nullptr, std::memory_order_acquire);
+            if (!posted) return;
+
+            task_node* reversed = nullptr;
+            while (posted)
+            {
+                task_node* next = posted->next;
+                posted->next = reversed;
+                reversed = posted;
+                posted = next;
+            }
+
+            task_node** tail = &ready_;
+            while (*tail) tail = &(*tail)->next;
+            *tail = reversed;
+        }
+
+        static void delete_list(task_node* node) noexcept
+        {
+            while (node)
+            {
+                task_node* next = node->next;
+                delete node;
+                node = next;
+            }
+        }
+    };
+}
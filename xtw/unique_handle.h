@@ -14,6 +14,14 @@ namespace xtw
         void operator()(HANDLE p) const noexcept { if (p) ::CloseHandle(p); }
     };
 
+    // stateless closer calling a function fixed at compile time.
+    template <auto Closer>
+    struct closer_constant
+    {
+        template <class HANDLE>
+        void operator()(HANDLE p) const noexcept { if (p) (void)Closer(p); }
+    };
+
     template <class HANDLE, class CLOSER>
     class unique_handle_t
     {
@@ -39,4 +47,10 @@ namespace xtw
     };
 
     using unique_handle = unique_handle_t<HANDLE, default_handle_closer>;
+
+    // pointer-sized handle closed by a function known at compile time, e.g. unique_handle_for<HKEY, &::RegCloseKey>.
+    template <class HANDLE, auto Closer>
+    using unique_handle_for = unique_handle_t<HANDLE, closer_constant<Closer>>;
+
+    static_assert(sizeof(unique_handle) == sizeof(HANDLE));
 }
@@ -0,0 +1,437 @@
+/// @file
+/// @brief  xtw::utf
+/// @author (C) 2023 ttsuki
+/// Distributed under the Boost Software License, Version 1.0.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cwchar>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+
+// XTW_UTF_NO_SIMD selects the scalar paths, e.g. to measure the SIMD paths against them.
+#if defined(XTW_UTF_NO_SIMD)
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define XTW_UTF_USE_AVX2 1
+#elif defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define XTW_UTF_USE_SSE2 1
+#endif
+
+// The wchar_t interface exists where wchar_t holds UTF-16 (Windows, or -fshort-wchar); the char16_t one everywhere.
+#if WCHAR_MAX == 0xFFFF
+#define XTW_UTF_WCHAR_IS_UTF16 1
+#endif
+
+namespace xtw::utf
+{
+    namespace utf_detail
+    {
+        // ascii fast paths: process leading whole blocks of ASCII characters, returns processed character count.
+        // Callers skip them for shorter remainders.
+#if defined(XTW_UTF_USE_AVX2)
+        static inline constexpr size_t ascii_block = 32;
+#elif defined(XTW_UTF_USE_SSE2)
+        static inline constexpr size_t ascii_block = 16;
+#else
+        static inline constexpr size_t ascii_block = ~size_t{};
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Warray-bounds" // GCC reports the block loads as out of bounds on short constant arrays, where they never run.
+#endif
+
+        template <class U16>
+        static inline size_t count_ascii_blocks(const U16* src, size_t length) noexcept
+        {
+            size_t i = 0;
+#if defined(XTW_UTF_USE_AVX2)
+            const __m256i mask = _mm256_set1_epi16(static_cast<short>(0xFF80));
+            for (; i + 32 <= length; i += 32)
+            {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 16));
+                if (!_mm256_testz_si256(_mm256_or_si256(a, b), mask)) break;
+            }
+#elif defined(XTW_UTF_USE_SSE2)
+            const __m128i mask = _mm_set1_epi16(static_cast<short>(0xFF80));
+            const __m128i zero = _mm_setzero_si128();
+            for (; i + 16 <= length; i += 16)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(_mm_or_si128(a, b), mask), zero)) != 0xFFFF) break;
+            }
+#else
+            (void)src, (void)length;
+#endif
+            return i;
+        }
+
+        static inline size_t count_ascii_blocks(const char* src, size_t length) noexcept
+        {
+            size_t i = 0;
+#if defined(XTW_UTF_USE_AVX2)
+            for (; i + 32 <= length; i += 32)
+            {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                if (_mm256_movemask_epi8(a) != 0) break;
+            }
+#elif defined(XTW_UTF_USE_SSE2)
+            for (; i + 16 <= length; i += 16)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                if (_mm_movemask_epi8(a) != 0) break;
+            }
+#else
+            (void)src, (void)length;
+#endif
+            return i;
+        }
+
+        template <class U16>
+        static inline size_t narrow_ascii_blocks(const U16* src, size_t length, char* dst) noexcept
+        {
+            size_t i = 0;
+#if defined(XTW_UTF_USE_AVX2)
+            const __m256i mask = _mm256_set1_epi16(static_cast<short>(0xFF80));
+            for (; i + 32 <= length; i += 32)
+            {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 16));
+                if (!_mm256_testz_si256(_mm256_or_si256(a, b), mask)) break;
+                __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8); // packus works per 128-bit lane
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+            }
+#elif defined(XTW_UTF_USE_SSE2)
+            const __m128i mask = _mm_set1_epi16(static_cast<short>(0xFF80));
+            const __m128i zero = _mm_setzero_si128();
+            for (; i + 16 <= length; i += 16)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(_mm_or_si128(a, b), mask), zero)) != 0xFFFF) break;
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(a, b));
+            }
+#else
+            (void)src, (void)length, (void)dst;
+#endif
+            return i;
+        }
+
+        template <class U16>
+        static inline size_t widen_ascii_blocks(const char* src, size_t length, U16* dst) noexcept
+        {
+            size_t i = 0;
+#if defined(XTW_UTF_USE_AVX2)
+            for (; i + 32 <= length; i += 32)
+            {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                if (_mm256_movemask_epi8(a) != 0) break;
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(a)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(a, 1)));
+            }
+#elif defined(XTW_UTF_USE_SSE2)
+            const __m128i zero = _mm_setzero_si128();
+            for (; i + 16 <= length; i += 16)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                if (_mm_movemask_epi8(a) != 0) break;
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(a, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(a, zero));
+            }
+#else
+            (void)src, (void)length, (void)dst;
+#endif
+            return i;
+        }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+        // decodes one code point from UTF-8. returns sequence length, or 0 if ill-formed.
+        static inline size_t decode_utf8(const unsigned char* p, size_t length, char32_t& code_point) noexcept
+        {
+            const unsigned c = p[0];
+            const auto is_trail = [](unsigned t) { return (t & 0xC0) == 0x80; };
+
+            if (c < 0x80)
+            {
+                code_point = c;
+                return 1;
+            }
+            if (c < 0xC2)
+            {
+                return 0; // unexpected trail byte or overlong 2-byte sequence
+            }
+            if (c < 0xE0)
+            {
+                if (length < 2 || !is_trail(p[1])) return 0;
+                code_point = (c & 0x1F) << 6 | (p[1] & 0x3F);
+                return 2;
+            }
+            if (c < 0xF0)
+            {
+                if (length < 3 || !is_trail(p[1]) || !is_trail(p[2])) return 0;
+                if (c == 0xE0 && p[1] < 0xA0) return 0; // overlong
+                if (c == 0xED && p[1] > 0x9F) return 0; // surrogate
+                code_point = (c & 0x0F) << 12 | (p[1] & 0x3F) << 6 | (p[2] & 0x3F);
+                return 3;
+            }
+            if (c < 0xF5)
+            {
+                if (length < 4 || !is_trail(p[1]) || !is_trail(p[2]) || !is_trail(p[3])) return 0;
+                if (c == 0xF0 && p[1] < 0x90) return 0; // overlong
+                if (c == 0xF4 && p[1] > 0x8F) return 0; // over U+10FFFF
+                code_point = (c & 0x07) << 18 | (p[1] & 0x3F) << 12 | (p[2] & 0x3F) << 6 | (p[3] & 0x3F);
+                return 4;
+            }
+            return 0;
+        }
+
+        // decodes one code point from UTF-16. returns sequence length, or 0 if ill-formed.
+        template <class U16>
+        static inline size_t decode_utf16(const U16* p, size_t length, char32_t& code_point) noexcept
+        {
+            const char32_t c = static_cast<char16_t>(p[0]);
+            if (c < 0xD800 || c > 0xDFFF)
+            {
+                code_point = c;
+                return 1;
+            }
+            if (c > 0xDBFF || length < 2) return 0; // unpaired surrogate
+
+            const char32_t d = static_cast<char16_t>(p[1]);
+            if (d < 0xDC00 || d > 0xDFFF) return 0; // unpaired surrogate
+            code_point = 0x10000 + ((c - 0xD800) << 10 | (d - 0xDC00));
+            return 2;
+        }
+
+        template <class U16>
+        static inline std::optional<size_t> utf8_length(const U16* src, size_t length) noexcept
+        {
+            size_t result = 0;
+            for (size_t i = 0; i < length;)
+            {
+                if (length - i >= ascii_block && static_cast<char16_t>(src[i]) < 0x80)
+                {
+                    if (size_t n = count_ascii_blocks(src + i, length - i))
+                    {
+                        i += n;
+                        result += n;
+                        continue;
+                    }
+                }
+
+                char32_t cp{};
+                size_t n = decode_utf16(src + i, length - i, cp);
+                if (n == 0) return std::nullopt;
+                i += n;
+                result += cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+            }
+            return result;
+        }
+
+        static inline std::optional<size_t> utf16_length(const char* src, size_t length) noexcept
+        {
+            size_t result = 0;
+            for (size_t i = 0; i < length;)
+            {
+                if (length - i >= ascii_block && static_cast<unsigned char>(src[i]) < 0x80)
+                {
+                    if (size_t n = count_ascii_blocks(src + i, length - i))
+                    {
+                        i += n;
+                        result += n;
+                        continue;
+                    }
+                }
+
+                char32_t cp{};
+                size_t n = decode_utf8(reinterpret_cast<const unsigned char*>(src + i), length - i, cp);
+                if (n == 0) return std::nullopt;
+                i += n;
+                result += cp < 0x10000 ? 1 : 2;
+            }
+            return result;
+        }
+
+        template <class U16>
+        static inline std::optional<size_t> utf16_to_utf8(const U16* src, size_t length, char* dst, size_t capacity) noexcept
+        {
+            size_t o = 0;
+            for (size_t i = 0; i < length;)
+            {
+                if (length - i >= ascii_block && capacity - o >= ascii_block && static_cast<char16_t>(src[i]) < 0x80)
+                {
+                    if (size_t n = narrow_ascii_blocks(src + i, std::min(length - i, capacity - o), dst + o))
+                    {
+                        i += n;
+                        o += n;
+                        continue;
+                    }
+                }
+
+                char32_t cp{};
+                size_t n = decode_utf16(src + i, length - i, cp);
+                if (n == 0) return std::nullopt;
+                i += n;
+
+                if (cp < 0x80)
+                {
+                    if (capacity - o < 1) return std::nullopt;
+                    dst[o++] = static_cast<char>(cp);
+                }
+                else if (cp < 0x800)
+                {
+                    if (capacity - o < 2) return std::nullopt;
+                    dst[o++] = static_cast<char>(0xC0 | cp >> 6);
+                    dst[o++] = static_cast<char>(0x80 | (cp & 0x3F));
+                }
+                else if (cp < 0x10000)
+                {
+                    if (capacity - o < 3) return std::nullopt;
+                    dst[o++] = static_cast<char>(0xE0 | cp >> 12);
+                    dst[o++] = static_cast<char>(0x80 | (cp >> 6 & 0x3F));
+                    dst[o++] = static_cast<char>(0x80 | (cp & 0x3F));
+                }
+                else
+                {
+                    if (capacity - o < 4) return std::nullopt;
+                    dst[o++] = static_cast<char>(0xF0 | cp >> 18);
+                    dst[o++] = static_cast<char>(0x80 | (cp >> 12 & 0x3F));
+                    dst[o++] = static_cast<char>(0x80 | (cp >> 6 & 0x3F));
+                    dst[o++] = static_cast<char>(0x80 | (cp & 0x3F));
+                }
+            }
+            return o;
+        }
+
+        template <class U16>
+        static inline std::optional<size_t> utf8_to_utf16(const char* src, size_t length, U16* dst, size_t capacity) noexcept
+        {
+            size_t o = 0;
+            for (size_t i = 0; i < length;)
+            {
+                if (length - i >= ascii_block && capacity - o >= ascii_block && static_cast<unsigned char>(src[i]) < 0x80)
+                {
+                    if (size_t n = widen_ascii_blocks(src + i, std::min(length - i, capacity - o), dst + o))
+                    {
+                        i += n;
+                        o += n;
+                        continue;
+                    }
+                }
+
+                char32_t cp{};
+                size_t n = decode_utf8(reinterpret_cast<const unsigned char*>(src + i), length - i, cp);
+                if (n == 0) return std::nullopt;
+                i += n;
+
+                if (cp < 0x10000)
+                {
+                    if (capacity - o < 1) return std::nullopt;
+                    dst[o++] = static_cast<U16>(cp);
+                }
+                else
+                {
+                    if (capacity - o < 2) return std::nullopt;
+                    dst[o++] = static_cast<U16>(0xD800 + ((cp - 0x10000) >> 10));
+                    dst[o++] = static_cast<U16>(0xDC00 + ((cp - 0x10000) & 0x3FF));
+                }
+            }
+            return o;
+        }
+    }
+
+    /// Calculates the UTF-8 length of a UTF-16 string. Returns nullopt if the source is ill-formed.
+    static inline std::optional<size_t> utf8_length(std::u16string_view utf16) noexcept
+    {
+        return utf_detail::utf8_length(utf16.data(), utf16.size());
+    }
+
+    /// Calculates the UTF-16 length of a UTF-8 string. Returns nullopt if the source is ill-formed.
+    static inline std::optional<size_t> utf16_length(std::string_view utf8) noexcept
+    {
+        return utf_detail::utf16_length(utf8.data(), utf8.size());
+    }
+
+    /// Converts UTF-16 into the buffer without allocation. Returns written length, or nullopt if the source is ill-formed or the buffer is too small.
+    static inline std::optional<size_t> utf16_to_utf8(std::u16string_view utf16, char* buffer, size_t buffer_length) noexcept
+    {
+        return utf_detail::utf16_to_utf8(utf16.data(), utf16.size(), buffer, buffer_length);
+    }
+
+    /// Converts UTF-8 into the buffer without allocation. Returns written length, or nullopt if the source is ill-formed or the buffer is too small.
+    static inline std::optional<size_t> utf8_to_utf16(std::string_view utf8, char16_t* buffer, size_t buffer_length) noexcept
+    {
+        return utf_detail::utf8_to_utf16(utf8.data(), utf8.size(), buffer, buffer_length);
+    }
+
+    static inline std::string to_utf8(std::u16string_view utf16)
+    {
+        auto length = utf8_length(utf16);
+        if (!length) throw std::invalid_argument("ill-formed utf-16 string");
+
+        std::string result(*length, '\0');
+        (void)utf16_to_utf8(utf16, result.data(), result.size());
+        return result;
+    }
+
+    static inline std::u16string to_u16string(std::string_view utf8)
+    {
+        auto length = utf16_length(utf8);
+        if (!length) throw std::invalid_argument("ill-formed utf-8 string");
+
+        std::u16string result(*length, u'\0');
+        (void)utf8_to_utf16(utf8, result.data(), result.size());
+        return result;
+    }
+
+#if defined(XTW_UTF_WCHAR_IS_UTF16)
+    // wchar_t (UTF-16) interface
+
+    static inline std::optional<size_t> utf8_length(std::wstring_view utf16) noexcept
+    {
+        return utf_detail::utf8_length(utf16.data(), utf16.size());
+    }
+
+    static inline std::optional<size_t> utf16_to_utf8(std::wstring_view utf16, char* buffer, size_t buffer_length) noexcept
+    {
+        return utf_detail::utf16_to_utf8(utf16.data(), utf16.size(), buffer, buffer_length);
+    }
+
+    static inline std::optional<size_t> utf8_to_utf16(std::string_view utf8, wchar_t* buffer, size_t buffer_length) noexcept
+    {
+        return utf_detail::utf8_to_utf16(utf8.data(), utf8.size(), buffer, buffer_length);
+    }
+
+    static inline std::string to_utf8(std::wstring_view utf16)
+    {
+        auto length = utf8_length(utf16);
+        if (!length) throw std::invalid_argument("ill-formed utf-16 string");
+
+        std::string result(*length, '\0');
+        (void)utf16_to_utf8(utf16, result.data(), result.size());
+        return result;
+    }
+
+    static inline std::wstring to_utf16(std::string_view utf8)
+    {
+        auto length = utf16_length(utf8);
+        if (!length) throw std::invalid_argument("ill-formed utf-8 string");
+
+        std::wstring result(*length, L'\0');
+        (void)utf8_to_utf16(utf8, result.data(), result.size());
+        return result;
+    }
+#endif
+}
@@ -7,9 +7,13 @@
 
 #include <Windows.h>
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <memory>
 #include <stdexcept>
+#include <utility>
 
 namespace xtw
 {
@@ -31,10 +35,51 @@ namespace xtw
         return len ? std::string(p.get(), len) : std::string("((error message is not resolved))");
     }
 
+    /// Writes the return addresses of the calling thread, starting at call_site, into frames; returns how many were written.
+    /// Must not throw or allocate much: it runs on every failure while installed.
+    using stack_capture_function = uint32_t (*)(const void* call_site, void** frames, uint32_t capacity) noexcept;
+
     class win32_exception : public std::runtime_error
     {
+    public:
+        static inline constexpr size_t max_frames = 32;
+
+    private:
+        const void* call_site_{};
+        uint32_t frame_count_{};
+        void* frames_[max_frames]{};
+
     public:
         explicit win32_exception(HRESULT hr, HMODULE source = nullptr)
             : runtime_error(std::string("com_error: ") + std::to_string(hr) + ":" + get_system_error_message(hr, source)) { }
+
+        /// With the throw site: call_site is a return address into the code that failed.
+        /// The stack from there is recorded only while a capture function is installed (see set_stack_capture).
+        win32_exception(HRESULT hr, HMODULE source, const void* call_site)
+            : win32_exception(hr, source)
+        {
+            call_site_ = call_site;
+            if (const stack_capture_function capture = stack_capture())
+                frame_count_ = capture(call_site, frames_, static_cast<uint32_t>(max_frames));
+        }
+
+        /// Return address into the code that failed, or nullptr if not given.
+        [[nodiscard]] const void* call_site() const noexcept { return call_site_; }
+
+        /// Raw return addresses from the call site outwards; empty unless stack capture was installed when this was constructed.
+        [[nodiscard]] void* const* frames() const noexcept { return frames_; }
+        [[nodiscard]] size_t frame_count() const noexcept { return frame_count_; }
+
+        /// Installs the process-wide stack capture for exceptions constructed with a call site, or removes it with nullptr (the default).
+        /// xtw::debug::stack_trace::capture_on_throw (xtw/stack_trace.h) installs one backed by stack_trace.
+        static void set_stack_capture(stack_capture_function capture) noexcept { capture_slot().store(capture, std::memory_order_release); }
+        [[nodiscard]] static stack_capture_function stack_capture() noexcept { return capture_slot().load(std::memory_order_acquire); }
+
+    private:
+        static std::atomic<stack_capture_function>& capture_slot() noexcept
+        {
+            static std::atomic<stack_capture_function> slot{};
+            return slot;
+        }
     };
 }
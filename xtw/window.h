@@ -118,7 +118,7 @@ namespace xtw::window
             throw std::runtime_error("FAILED to create window");
         }
 
-        auto uhWindow = unique_handle_t{hWnd, &::DestroyWindow};
+        auto uhWindow = unique_handle_for<HWND, &::DestroyWindow>{hWnd};
         fnOnCreated(uhWindow.get());
 
         return {
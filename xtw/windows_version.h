@@ -25,7 +25,7 @@ namespace xtw
         bool operator >(const windows_version& rhs) const noexcept { return this->tie() > rhs.tie(); }
         bool operator >=(const windows_version& rhs) const noexcept { return this->tie() >= rhs.tie(); }
 
-        // gets current version
+        // gets current version. 0.0.0 where ntdll.dll's RtlGetVersion is unavailable, as with the portable backend.
         [[nodiscard]] static windows_version current()
         {
             static ::RTL_OSVERSIONINFOW v = []
@@ -35,7 +35,7 @@ namespace xtw
 
                 if (::HMODULE m = ::LoadLibraryW(L"ntdll.dll"))
                 {
-                    if (auto f = reinterpret_cast<long(__stdcall*)(::PRTL_OSVERSIONINFOW)>(::GetProcAddress(m, "RtlGetVersion")))
+                    if (auto f = reinterpret_cast<long(__stdcall*)(::PRTL_OSVERSIONINFOW)>(reinterpret_cast<void (*)()>(::GetProcAddress(m, "RtlGetVersion"))))
                     {
                         f(&result);
                     }
@@ -5,12 +5,33 @@
 
 #pragma once
 
+#include "./benchmark.h"
+#include "./capabilities.h"
 #include "./com.h"
 #include "./debug.h"
 #include "./debug_output_hook.h"
+#include "./debug_symbols.h"
+#include "./deferred_handle_closer.h"
+#include "./handle_pool.h"
+#include "./io_context.h"
+#include "./ipc.h"
+#include "./mapped_file.h"
+#include "./message_loop.h"
+#include "./parallel.h"
+#include "./profiler.h"
 #include "./registry.h"
+#include "./registry_snapshot.h"
+#include "./registry_walk.h"
+#include "./registry_watched_cache.h"
+#include "./slot_map.h"
+#include "./stack_trace.h"
+#include "./task_graph.h"
+#include "./thread_arena.h"
+#include "./thread_registry.h"
 #include "./threading.h"
+#include "./ui_dispatcher.h"
 #include "./unique_handle.h"
+#include "./utf.h"
 #include "./win32_exception.h"
 #include "./window.h"
 #include "./windows_version.h"